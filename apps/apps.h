@@ -9,5 +9,6 @@ void app_editor_create(void);
 void app_settings_create(void);
 void app_files_create(void);
 void app_game_create(void);
+void app_top_create(void);
 
 #endif /* APPS_H */
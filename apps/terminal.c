@@ -3,11 +3,23 @@
 #include "../drivers/include/framebuffer.h"
 #include "../kernel/include/memory.h"
 #include "../kernel/include/vfs.h"
+#include "../kernel/include/pipe.h"
+#include "../kernel/include/workqueue.h"
+#include "../kernel/include/process.h"
+#include "../kernel/include/syscall.h"
+#include "../kernel/include/ktime.h"
+#include "../kernel/include/hrtimer.h"
+#include "../kernel/include/irq.h"
+#include "../kernel/include/softirq.h"
+#include "../kernel/include/profile.h"
 
 /* Terminal data */
 #define TERM_BUFFER_LINES 100
 #define MAX_LINE_LEN 80
 #define MAX_CMD_LEN 64
+#define CAT_CHUNK 256        /* Bytes drained from the cat pipe per update */
+#define CTXBENCH_ITERATIONS 10000
+#define STRACE_SHOW_RECORDS 16
 
 /* Key codes for control keys */
 #define KEY_CTRL_D  4   /* Scroll down / Page Down */
@@ -20,8 +32,22 @@ typedef struct {
     char current_cmd[MAX_CMD_LEN];
     int cmd_pos;
     char cwd[256];
+    /* cat: a workqueue item splices the file into a pipe while the UI
+     * thread prints lines as they arrive */
+    work_t load_work;
+    volatile bool load_busy;     /* Load queued, running or being printed */
+    char load_path[MAX_CMD_LEN];
+    int load_fds[2];             /* Pipe: UI reads [0], worker writes [1] */
+    int load_result;             /* 0, or negative error once [1] closes */
+    char load_line[MAX_LINE_LEN];
+    int load_line_len;
 } terminal_data_t;
 
+/* Load errors reported back to the UI thread */
+#define LOAD_ERR_NOT_FOUND  -1
+#define LOAD_ERR_OPEN       -3
+#define LOAD_ERR_READ       -4
+
 /* String functions */
 static int term_strcmp(const char *s1, const char *s2) {
     while (*s1 && (*s1 == *s2)) {
@@ -46,6 +72,58 @@ static void term_strcpy(char *dest, const char *src) {
     *dest = '\0';
 }
 
+/* Parse a signed decimal number; returns the position after it or NULL */
+static const char *term_parse_int(const char *s, int *value) {
+    while (*s == ' ') s++;
+
+    bool negative = false;
+    if (*s == '-') {
+        negative = true;
+        s++;
+    }
+    if (*s < '0' || *s > '9') return NULL;
+
+    int v = 0;
+    while (*s >= '0' && *s <= '9') {
+        v = v * 10 + (*s - '0');
+        s++;
+    }
+    *value = negative ? -v : v;
+    return s;
+}
+
+/* Append a string */
+static void term_append(char *dest, const char *src) {
+    while (*dest) dest++;
+    term_strcpy(dest, src);
+}
+
+/* Append an unsigned decimal number to a string */
+static void term_append_uint(char *dest, uint64_t value) {
+    char tmp[24];
+    int i = 0;
+    do {
+        tmp[i++] = '0' + (value % 10);
+        value /= 10;
+    } while (value && i < 23);
+
+    while (*dest) dest++;
+    while (i > 0) {
+        *dest++ = tmp[--i];
+    }
+    *dest = '\0';
+}
+
+/* Pad a string with spaces to width columns */
+static void term_pad(char *dest, int width) {
+    int len = 0;
+    while (dest[len]) len++;
+    while (len < width && len < MAX_LINE_LEN - 1) {
+        dest[len++] = ' ';
+    }
+    dest[len] = '\0';
+}
+
 /* Add line to terminal scrollback buffer */
 static void add_line(terminal_data_t *data, const char *line) {
     if (data->line_count >= TERM_BUFFER_LINES) {
@@ -69,6 +147,226 @@ static void add_line(terminal_data_t *data, const char *line) {
     data->scroll_offset = 0;
 }
 
+/* Worker: move a file into the cat pipe off the UI path. The pipe holds
+ * a page, so the UI prints the start while the rest is still read. */
+static void terminal_load_work(void *arg) {
+    terminal_data_t *data = (terminal_data_t *)arg;
+    int result = 0;
+
+    if (!vfs_exists(data->load_path)) {
+        result = LOAD_ERR_NOT_FOUND;
+    } else {
+        int fd = vfs_open(data->load_path);
+        if (fd < 0) {
+            result = LOAD_ERR_OPEN;
+        } else {
+            int moved;
+            while ((moved = vfs_splice(fd, data->load_fds[1], PIPE_SIZE)) > 0) {
+            }
+            if (moved < 0) {
+                result = LOAD_ERR_READ;
+            }
+            vfs_close(fd);
+        }
+    }
+
+    /* Closing the write end publishes the result as end of file */
+    data->load_result = result;
+    vfs_close(data->load_fds[1]);
+}
+
+/* Emit the line collected so far */
+static void terminal_flush_load_line(terminal_data_t *data) {
+    data->load_line[data->load_line_len] = '\0';
+    add_line(data, data->load_line);
+    data->load_line_len = 0;
+}
+
+/* Print whatever the cat worker has produced (UI thread, never waits) */
+static void terminal_drain_load(terminal_data_t *data) {
+    char buf[CAT_CHUNK];
+    int rd = vfs_read(data->load_fds[0], buf, sizeof(buf));
+    if (rd == VFS_EAGAIN) {
+        return;
+    }
+
+    for (int c = 0; c < rd; c++) {
+        if (buf[c] == '\n') {
+            terminal_flush_load_line(data);
+        } else if (data->load_line_len < MAX_LINE_LEN - 1) {
+            data->load_line[data->load_line_len++] = buf[c];
+        }
+    }
+    if (rd > 0) {
+        return;
+    }
+
+    /* End of file: the worker is done */
+    vfs_close(data->load_fds[0]);
+    if (data->load_line_len > 0) {
+        terminal_flush_load_line(data);
+    }
+
+    int result = data->load_result;
+    if (result == LOAD_ERR_NOT_FOUND) {
+        add_line(data, "File not found");
+    } else if (result == LOAD_ERR_OPEN) {
+        add_line(data, "Error opening file");
+    } else if (result < 0 || rd < 0) {
+        add_line(data, "Error reading file");
+    }
+    data->load_busy = false;
+}
+
+/* Per-call counts and latencies since boot or the last reset */
+static void terminal_show_sysstat(terminal_data_t *data) {
+    static syscall_stat_t stats[SYSCALL_COUNT];
+    char output[MAX_LINE_LEN];
+    bool any = false;
+
+    syscall_get_stats(stats);
+    add_line(data, "call          count     avg       max       p99 (cycles)");
+    for (uint32_t n = 0; n < SYSCALL_COUNT; n++) {
+        const syscall_stat_t *st = &stats[n];
+        if (!st->count) continue;
+        any = true;
+
+        /* p99 as the upper edge of the histogram bucket holding it */
+        uint64_t target = st->count - st->count / 100;
+        uint64_t seen = 0;
+        uint32_t bucket = 0;
+        while (bucket < SYSCALL_HIST_BUCKETS - 1) {
+            seen += st->hist[bucket];
+            if (seen >= target) break;
+            bucket++;
+        }
+
+        output[0] = '\0';
+        term_append(output, syscall_name(n));
+        term_pad(output, 14);
+        term_append_uint(output, st->count);
+        term_pad(output, 24);
+        term_append_uint(output, st->total_cycles / st->count);
+        term_pad(output, 34);
+        term_append_uint(output, st->max_cycles);
+        term_pad(output, 44);
+        term_append(output, "<");
+        term_append_uint(output, 1ULL << (bucket + SYSCALL_HIST_SHIFT + 1));
+        add_line(data, output);
+    }
+    if (!any) {
+        add_line(data, "No system calls recorded");
+    }
+}
+
+/* Interrupt counts and handler time per vector since boot */
+static void terminal_show_interrupts(terminal_data_t *data) {
+    char output[MAX_LINE_LEN];
+    irq_stats_t st;
+
+    add_line(data, "vec  source       count     min     avg     max (cycles)");
+    for (uint32_t vec = 0; vec < 256; vec++) {
+        if (!irq_get_stats((uint8_t)vec, &st)) continue;
+
+        output[0] = '\0';
+        term_append_uint(output, vec);
+        term_pad(output, 5);
+        term_append(output, irq_vector_name((uint8_t)vec));
+        if (st.handlers > 1) {
+            term_append(output, "*");
+        }
+        term_pad(output, 18);
+        term_append_uint(output, st.count);
+        term_pad(output, 28);
+        if (st.count) {
+            term_append_uint(output, st.min_cycles);
+            term_pad(output, 36);
+            term_append_uint(output, st.total_cycles / st.count);
+            term_pad(output, 44);
+            term_append_uint(output, st.max_cycles);
+        }
+        add_line(data, output);
+    }
+    term_strcpy(output, "unhandled ");
+    term_append_uint(output, irq_unhandled_count());
+    term_append(output, "  (* shared vector)");
+    add_line(data, output);
+
+    softirq_stats_t soft;
+    softirq_get_stats(&soft);
+    term_strcpy(output, "softirq: timer ");
+    term_append_uint(output, soft.runs[SOFTIRQ_TIMER]);
+    term_append(output, ", tasklets ");
+    term_append_uint(output, soft.tasklets);
+    term_append(output, " on exit + ");
+    term_append_uint(output, soft.deferred);
+    term_append(output, " in ksoftirqd");
+    add_line(data, output);
+}
+
+/* Profiler state, or the hottest functions once it has stopped */
+#define PROFILE_SHOW_TOP 8
+
+static void terminal_show_profile(terminal_data_t *data) {
+    char output[MAX_LINE_LEN];
+    profile_status_t st;
+    profile_get_status(&st);
+
+    term_strcpy(output, st.running ? "Profiling at " : "Stopped, last rate ");
+    term_append_uint(output, st.hz);
+    term_append(output, " Hz: ");
+    term_append_uint(output, st.samples);
+    term_append(output, " samples, ");
+    term_append_uint(output, st.dropped);
+    term_append(output, " dropped");
+    add_line(data, output);
+    if (st.running) return;
+
+    profile_entry_t top[PROFILE_SHOW_TOP];
+    uint64_t total;
+    uint32_t n = profile_top(top, PROFILE_SHOW_TOP, &total);
+    for (uint32_t i = 0; i < n; i++) {
+        output[0] = '\0';
+        term_append_uint(output, top[i].count);
+        term_pad(output, 8);
+        term_append_uint(output, top[i].count * 100 / total);
+        term_append(output, "%");
+        term_pad(output, 14);
+        term_append(output, top[i].name);
+        add_line(data, output);
+    }
+}
+
+/* The most recent trace records, with times relative to the first */
+static void terminal_show_strace(terminal_data_t *data) {
+    static syscall_trace_t records[STRACE_SHOW_RECORDS];
+    char output[MAX_LINE_LEN];
+
+    int count = syscall_trace_read(records, STRACE_SHOW_RECORDS);
+    if (count == 0) {
+        add_line(data, "Trace empty (strace <pid> on)");
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const syscall_trace_t *rec = &records[i];
+        term_strcpy(output, "+");
+        term_append_uint(output, rec->tsc - records[0].tsc);
+        term_pad(output, 14);
+        term_append(output, "pid ");
+        term_append_uint(output, rec->pid);
+        term_pad(output, 24);
+        term_append(output, rec->exit ? "< " : "> ");
+        term_append(output, syscall_name(rec->num));
+        term_append(output, rec->exit ? " = " : " (");
+        term_append_uint(output, rec->value);
+        if (!rec->exit) {
+            term_append(output, ")");
+        }
+        add_line(data, output);
+    }
+}
+
 /* Execute terminal command */
 static void execute_command(terminal_data_t *data) {
     char output[MAX_LINE_LEN];
@@ -82,6 +380,13 @@ static void execute_command(terminal_data_t *data) {
         add_line(data, "  clear   - Clear screen");
         add_line(data, "  pwd     - Print working dir");
         add_line(data, "  uname   - System info");
+        add_line(data, "  nice    - nice <pid> <-20..19>");
+        add_line(data, "  chrt    - chrt <pid> <runtime> <deadline> <period> (ms)");
+        add_line(data, "  ctxbench - Context switch latency (cycles)");
+        add_line(data, "  sysstat - Syscall counts and latency [reset]");
+        add_line(data, "  interrupts - IRQ counts and handler cycles");
+        add_line(data, "  profile - profile start [hz] | stop | flat | folded");
+        add_line(data, "  strace  - strace <pid> on|off, or show trace");
     } else if (term_strcmp(data->current_cmd, "ls") == 0) {
         vfs_dirent_t entries[32];
         int count = vfs_list_directory(data->cwd, entries, 32);
@@ -106,45 +411,112 @@ static void execute_command(terminal_data_t *data) {
             add_line(data, "No files found or disk not available");
         }
     } else if (term_strncmp(data->current_cmd, "cat ", 4) == 0) {
-        char *filename = data->current_cmd + 4;
-        if (vfs_exists(filename)) {
-            uint32_t size = vfs_file_size(filename);
-            if (size > 0 && size < 1024) {
-                int fd = vfs_open(filename);
-                if (fd >= 0) {
-                    char buf[1024];
-                    int rd = vfs_read(fd, buf, size);
-                    vfs_close(fd);
-                    if (rd > 0) {
-                        buf[rd] = '\0';
-                        /* Output line by line */
-                        int start = 0;
-                        for (int c = 0; c <= rd; c++) {
-                            if (buf[c] == '\n' || buf[c] == '\0') {
-                                char line[MAX_LINE_LEN];
-                                int len = c - start;
-                                if (len > MAX_LINE_LEN - 1) len = MAX_LINE_LEN - 1;
-                                for (int l = 0; l < len; l++) line[l] = buf[start + l];
-                                line[len] = '\0';
-                                add_line(data, line);
-                                start = c + 1;
-                                if (buf[c] == '\0') break;
-                            }
-                        }
-                    } else {
-                        add_line(data, "Error reading file");
-                    }
-                } else {
-                    add_line(data, "Error opening file");
-                }
-            } else {
-                add_line(data, "File too large or empty");
-            }
+        /* Disk reads are slow: load on the workqueue, print from update */
+        if (data->load_busy) {
+            add_line(data, "Busy: previous cat still loading");
+        } else if (vfs_pipe(data->load_fds, 0) < 0) {
+            add_line(data, "Error creating pipe");
         } else {
-            add_line(data, "File not found");
+            /* Only the UI end must never wait; the worker blocks when full */
+            vfs_set_flags(data->load_fds[0], VFS_NONBLOCK);
+            term_strcpy(data->load_path, data->current_cmd + 4);
+            data->load_result = 0;
+            data->load_line_len = 0;
+            data->load_busy = true;
+            if (!schedule_work(&data->load_work)) {
+                vfs_close(data->load_fds[0]);
+                vfs_close(data->load_fds[1]);
+                data->load_busy = false;
+                add_line(data, "Error queueing file load");
+            }
         }
     } else if (term_strncmp(data->current_cmd, "echo ", 5) == 0) {
         add_line(data, data->current_cmd + 5);
+    } else if (term_strncmp(data->current_cmd, "nice ", 5) == 0) {
+        int pid, nice;
+        const char *p = term_parse_int(data->current_cmd + 5, &pid);
+        if (!p || !term_parse_int(p, &nice) || pid < 0) {
+            add_line(data, "Usage: nice <pid> <-20..19>");
+        } else if (process_set_nice((uint32_t)pid, nice) != 0) {
+            add_line(data, "No such task");
+        } else {
+            add_line(data, "Nice level updated");
+        }
+    } else if (term_strncmp(data->current_cmd, "chrt ", 5) == 0) {
+        int pid, runtime = -1, deadline = -1, period = -1;
+        const char *p = term_parse_int(data->current_cmd + 5, &pid);
+        if (p) p = term_parse_int(p, &runtime);
+        if (p && runtime > 0) {
+            p = term_parse_int(p, &deadline);
+            if (p) p = term_parse_int(p, &period);
+        }
+        if (!p || pid < 0 || runtime < 0 || (runtime > 0 && (deadline <= 0 || period <= 0))) {
+            add_line(data, "Usage: chrt <pid> <runtime> <deadline> <period>");
+            add_line(data, "       chrt <pid> 0 (back to fair)");
+        } else if (process_set_deadline((uint32_t)pid, (uint64_t)runtime,
+                                        (uint64_t)deadline, (uint64_t)period) != 0) {
+            add_line(data, "Rejected: no such task, bad parameters or no bandwidth");
+        } else {
+            add_line(data, runtime ? "Deadline reservation set" : "Moved to fair class");
+        }
+    } else if (term_strcmp(data->current_cmd, "ctxbench") == 0) {
+        uint64_t switch_cycles, cr3_cycles;
+        if (!process_bench_switch(CTXBENCH_ITERATIONS, &switch_cycles, &cr3_cycles)) {
+            add_line(data, "Benchmark failed: out of memory");
+        } else {
+            term_strcpy(output, "Context switch: ");
+            term_append_uint(output, switch_cycles);
+            term_append(output, " cycles");
+            add_line(data, output);
+            term_strcpy(output, "CR3 reload (skipped in-space): ");
+            term_append_uint(output, cr3_cycles);
+            term_append(output, " cycles");
+            add_line(data, output);
+        }
+    } else if (term_strcmp(data->current_cmd, "interrupts") == 0) {
+        terminal_show_interrupts(data);
+    } else if (term_strcmp(data->current_cmd, "sysstat") == 0) {
+        terminal_show_sysstat(data);
+    } else if (term_strcmp(data->current_cmd, "sysstat reset") == 0) {
+        syscall_reset_stats();
+        add_line(data, "Syscall statistics cleared");
+    } else if (term_strcmp(data->current_cmd, "strace") == 0) {
+        terminal_show_strace(data);
+    } else if (term_strncmp(data->current_cmd, "strace ", 7) == 0) {
+        int pid;
+        const char *p = term_parse_int(data->current_cmd + 7, &pid);
+        while (p && *p == ' ') p++;
+        bool on = p && term_strcmp(p, "on") == 0;
+        if (!p || pid < 0 || (!on && term_strcmp(p, "off") != 0)) {
+            add_line(data, "Usage: strace <pid> on|off");
+        } else if (process_set_syscall_trace((uint32_t)pid, on) < 0) {
+            add_line(data, "No such process");
+        } else {
+            add_line(data, on ? "Tracing enabled" : "Tracing disabled");
+        }
+    } else if (term_strcmp(data->current_cmd, "profile") == 0) {
+        terminal_show_profile(data);
+    } else if (term_strncmp(data->current_cmd, "profile start", 13) == 0) {
+        int hz = PROFILE_DEFAULT_HZ;
+        const char *p = data->current_cmd + 13;
+        if (*p && (!term_parse_int(p, &hz) || hz <= 0)) {
+            add_line(data, "Usage: profile start [hz]");
+        } else if (!profile_start((uint32_t)hz)) {
+            add_line(data, "Profiler busy or out of memory");
+        } else {
+            add_line(data, "Profiling started");
+        }
+    } else if (term_strcmp(data->current_cmd, "profile stop") == 0) {
+        profile_stop();
+        terminal_show_profile(data);
+    } else if (term_strcmp(data->current_cmd, "profile flat") == 0 ||
+               term_strcmp(data->current_cmd, "profile folded") == 0) {
+        bool folded = term_strcmp(data->current_cmd, "profile folded") == 0;
+        if (profile_dump(folded ? PROFILE_FOLDED : PROFILE_FLAT)) {
+            add_line(data, "Writing profile to the serial port");
+        } else {
+            add_line(data, "A profile dump is already running");
+        }
     } else if (term_strcmp(data->current_cmd, "clear") == 0) {
         data->line_count = 0;
         data->scroll_offset = 0;
@@ -153,6 +525,17 @@ static void execute_command(terminal_data_t *data) {
     } else if (term_strcmp(data->current_cmd, "uname") == 0) {
         add_line(data, "BasicOS v2.0 x86_64");
         add_line(data, "Daily Driver Edition");
+        term_strcpy(output, "Clock: ");
+        term_append(output, ktime_source_name());
+        if (ktime_tsc_khz()) {
+            term_append(output, ", TSC ");
+            term_append_uint(output, ktime_tsc_khz() / 1000);
+            term_append(output, ktime_tsc_invariant() ? " MHz invariant" : " MHz");
+        }
+        add_line(data, output);
+        term_strcpy(output, "Timers: ");
+        term_append(output, hrtimer_device_name());
+        add_line(data, output);
     } else if (data->current_cmd[0] != '\0') {
         term_strcpy(output, "Unknown command: ");
         int i = 17;
@@ -207,6 +590,15 @@ static void terminal_render(window_t *win) {
     fb_draw_string(win->x + 10, win->y + win->height - 30, prompt, COLOR_GREEN);
 }
 
+/* Terminal update function */
+static void terminal_update(window_t *win) {
+    terminal_data_t *data = (terminal_data_t *)win->data;
+
+    if (data->load_busy) {
+        terminal_drain_load(data);
+    }
+}
+
 /* Terminal key handler */
 static void terminal_on_key(window_t *win, char key) {
     terminal_data_t *data = (terminal_data_t *)win->data;
@@ -274,6 +666,8 @@ void app_terminal_create(void) {
     data->cmd_pos = 0;
     data->current_cmd[0] = '\0';
     term_strcpy(data->cwd, "/");
+    data->load_busy = false;
+    INIT_WORK(&data->load_work, terminal_load_work, data);
 
     /* Welcome message */
     add_line(data, "BasicOS Terminal v2.0");
@@ -283,5 +677,6 @@ void app_terminal_create(void) {
     win->data = data;
     win->bg_color = RGB(0, 0, 0);
     win->render = terminal_render;
+    win->update = terminal_update;
     win->on_key = terminal_on_key;
 }
@@ -0,0 +1,236 @@
+#include "apps.h"
+#include "../gui/include/gui.h"
+#include "../drivers/include/framebuffer.h"
+#include "../drivers/include/timer.h"
+#include "../kernel/include/memory.h"
+#include "../kernel/include/process.h"
+#include "../kernel/include/smp.h"
+#include "../kernel/include/sched.h"
+#include "../kernel/include/cpu.h"
+
+/* Top settings */
+#define TOP_MAX_TASKS 32
+#define TOP_INTERVAL  1000   /* Ticks between samples */
+#define TOP_ROWS      14     /* Task rows shown */
+
+/* Column positions (pixels from the window's left edge) */
+#define COL_PID    10
+#define COL_NAME   50
+#define COL_CPU    170
+#define COL_USER   226
+#define COL_SYS    298
+#define COL_WAIT   370
+#define COL_VCSW   442
+#define COL_IVCSW  498
+#define COL_CORE   554
+
+/* Top data */
+typedef struct {
+    process_stat_t prev[TOP_MAX_TASKS];
+    int prev_count;
+    process_stat_t cur[TOP_MAX_TASKS];
+    int cur_count;
+    uint64_t used[TOP_MAX_TASKS];     /* Cycles each cur task ran in the interval */
+    int order[TOP_MAX_TASKS];         /* cur indices sorted by used, descending */
+    uint64_t last_tick;
+    uint64_t last_tsc;
+    uint64_t interval_cycles;         /* TSC cycles in the last interval */
+    uint64_t cycles_per_ms;           /* Measured against the timer */
+    int samples;
+} top_data_t;
+
+/* Unsigned integer to decimal string */
+static void top_utoa(uint64_t value, char *buf) {
+    char tmp[24];
+    int i = 0;
+    do {
+        tmp[i++] = '0' + (value % 10);
+        value /= 10;
+    } while (value && i < 23);
+
+    int j = 0;
+    while (i > 0) {
+        buf[j++] = tmp[--i];
+    }
+    buf[j] = '\0';
+}
+
+/* Percentage with one decimal place from a per-mille value */
+static void top_format_percent(uint64_t permille, char *buf) {
+    top_utoa(permille / 10, buf);
+    int len = 0;
+    while (buf[len]) len++;
+    buf[len++] = '.';
+    buf[len++] = '0' + (permille % 10);
+    buf[len] = '\0';
+}
+
+static const char *top_state_name(process_state_t state) {
+    switch (state) {
+        case PROCESS_READY:      return "R";
+        case PROCESS_RUNNING:    return "R";
+        case PROCESS_BLOCKED:    return "S";
+        case PROCESS_TERMINATED: return "Z";
+        default:                 return "?";
+    }
+}
+
+/* Cycles to milliseconds using the measured TSC rate */
+static uint64_t top_cycles_to_ms(top_data_t *data, uint64_t cycles) {
+    return data->cycles_per_ms ? cycles / data->cycles_per_ms : 0;
+}
+
+/* Take a new sample and work out per-task CPU use since the previous one */
+static void top_sample(top_data_t *data) {
+    uint64_t now = timer_get_ticks();
+    uint64_t tsc = rdtsc();
+
+    for (int i = 0; i < data->cur_count; i++) {
+        data->prev[i] = data->cur[i];
+    }
+    data->prev_count = data->cur_count;
+    data->cur_count = process_get_stats(data->cur, TOP_MAX_TASKS);
+
+    if (data->samples > 0 && now > data->last_tick) {
+        data->interval_cycles = tsc - data->last_tsc;
+        data->cycles_per_ms = data->interval_cycles / (now - data->last_tick);
+    }
+    data->last_tick = now;
+    data->last_tsc = tsc;
+    data->samples++;
+
+    for (int i = 0; i < data->cur_count; i++) {
+        process_stat_t *cur = &data->cur[i];
+        uint64_t total = cur->utime + cur->stime;
+        uint64_t before = 0;
+
+        for (int j = 0; j < data->prev_count; j++) {
+            if (data->prev[j].pid == cur->pid) {
+                before = data->prev[j].utime + data->prev[j].stime;
+                break;
+            }
+        }
+        data->used[i] = (total > before) ? total - before : 0;
+
+        /* Insertion sort by CPU use */
+        int pos = i;
+        while (pos > 0 && data->used[data->order[pos - 1]] < data->used[i]) {
+            data->order[pos] = data->order[pos - 1];
+            pos--;
+        }
+        data->order[pos] = i;
+    }
+}
+
+/* Top update function */
+static void top_update(window_t *win) {
+    top_data_t *data = (top_data_t *)win->data;
+
+    if (data->samples == 0 || timer_get_ticks() - data->last_tick >= TOP_INTERVAL) {
+        top_sample(data);
+    }
+}
+
+/* Draw a number column */
+static void top_draw_number(window_t *win, int col, int y, uint64_t value) {
+    char buf[24];
+    top_utoa(value, buf);
+    fb_draw_string(win->x + col, y, buf, COLOR_BLACK);
+}
+
+/* Top render function */
+static void top_render(window_t *win) {
+    top_data_t *data = (top_data_t *)win->data;
+    char buf[32];
+    int y = win->y + 40;
+
+    /* Summary line */
+    fb_draw_string(win->x + 10, y, "Tasks:", COLOR_BLACK);
+    top_utoa(data->cur_count, buf);
+    fb_draw_string(win->x + 66, y, buf, COLOR_BLACK);
+    fb_draw_string(win->x + 110, y, "CPUs:", COLOR_BLACK);
+    top_utoa(smp_cpu_count(), buf);
+    fb_draw_string(win->x + 158, y, buf, COLOR_BLACK);
+    fb_draw_string(win->x + 200, y, "Uptime (s):", COLOR_BLACK);
+    top_utoa(timer_get_ticks() / 1000, buf);
+    fb_draw_string(win->x + 296, y, buf, COLOR_BLACK);
+
+    /* Deadline tasks and the deadlines they missed */
+    uint64_t dl_tasks = 0;
+    for (int i = 0; i < data->cur_count; i++) {
+        if (data->cur[i].deadline) dl_tasks++;
+    }
+    fb_draw_string(win->x + 360, y, "DL:", COLOR_BLACK);
+    top_utoa(dl_tasks, buf);
+    fb_draw_string(win->x + 392, y, buf, COLOR_BLACK);
+    fb_draw_string(win->x + 430, y, "Missed:", COLOR_BLACK);
+    top_utoa(sched_dl_total_misses(), buf);
+    fb_draw_string(win->x + 494, y, buf, COLOR_BLACK);
+
+    if (data->samples < 2) {
+        fb_draw_string(win->x + 10, y + 30, "Sampling...", COLOR_GRAY);
+        return;
+    }
+
+    /* Column headers */
+    y += 30;
+    fb_draw_string(win->x + COL_PID, y, "PID", RGB(0, 0, 128));
+    fb_draw_string(win->x + COL_NAME, y, "NAME", RGB(0, 0, 128));
+    fb_draw_string(win->x + COL_CPU, y, "CPU%", RGB(0, 0, 128));
+    fb_draw_string(win->x + COL_USER, y, "USR ms", RGB(0, 0, 128));
+    fb_draw_string(win->x + COL_SYS, y, "SYS ms", RGB(0, 0, 128));
+    fb_draw_string(win->x + COL_WAIT, y, "WAIT ms", RGB(0, 0, 128));
+    fb_draw_string(win->x + COL_VCSW, y, "VCSW", RGB(0, 0, 128));
+    fb_draw_string(win->x + COL_IVCSW, y, "IVCS", RGB(0, 0, 128));
+    fb_draw_string(win->x + COL_CORE, y, "C S", RGB(0, 0, 128));
+    y += 20;
+
+    int rows = data->cur_count < TOP_ROWS ? data->cur_count : TOP_ROWS;
+    for (int r = 0; r < rows; r++) {
+        int i = data->order[r];
+        process_stat_t *st = &data->cur[i];
+
+        top_draw_number(win, COL_PID, y, st->pid);
+
+        /* Name clipped to the column */
+        char name[15];
+        int n;
+        for (n = 0; n < 14 && st->name[n]; n++) {
+            name[n] = st->name[n];
+        }
+        name[n] = '\0';
+        /* Deadline tasks are shown in red */
+        fb_draw_string(win->x + COL_NAME, y, name,
+                       st->deadline ? RGB(160, 0, 0) : COLOR_BLACK);
+
+        uint64_t permille = data->interval_cycles ?
+                            data->used[i] * 1000 / data->interval_cycles : 0;
+        top_format_percent(permille, buf);
+        fb_draw_string(win->x + COL_CPU, y, buf, COLOR_BLACK);
+
+        top_draw_number(win, COL_USER, y, top_cycles_to_ms(data, st->utime));
+        top_draw_number(win, COL_SYS, y, top_cycles_to_ms(data, st->stime));
+        top_draw_number(win, COL_WAIT, y, top_cycles_to_ms(data, st->wait_time));
+        top_draw_number(win, COL_VCSW, y, st->nvcsw);
+        top_draw_number(win, COL_IVCSW, y, st->nivcsw);
+        top_draw_number(win, COL_CORE, y, st->cpu);
+        fb_draw_string(win->x + COL_CORE + 16, y, top_state_name(st->state), COLOR_BLACK);
+
+        y += 18;
+    }
+}
+
+/* Create top app */
+void app_top_create(void) {
+    window_t *win = gui_create_window("Top", 120, 80, 600, 400);
+    if (!win) return;
+
+    top_data_t *data = (top_data_t *)kmalloc(sizeof(top_data_t));
+    if (!data) return;
+
+    memset(data, 0, sizeof(top_data_t));
+
+    win->data = data;
+    win->render = top_render;
+    win->update = top_update;
+}
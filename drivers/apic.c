@@ -0,0 +1,133 @@
+#include "apic.h"
+#include "../../kernel/include/cpu.h"
+#include "../../kernel/include/paging.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Local APIC register offsets */
+#define LAPIC_ID        0x020
+#define LAPIC_EOI       0x0B0
+#define LAPIC_SVR       0x0F0
+#define LAPIC_ICR_LOW   0x300
+#define LAPIC_ICR_HIGH  0x310
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_TIMER_INITIAL 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE  0x3E0
+
+/* Register bits */
+#define LAPIC_SVR_ENABLE        (1 << 8)
+#define LAPIC_ICR_PENDING       (1 << 12)
+#define LAPIC_ICR_ASSERT        (1 << 14)
+#define LAPIC_ICR_ALL_BUT_SELF  (3 << 18)
+#define APIC_BASE_ENABLE        (1ULL << 11)
+
+/* LVT timer modes */
+#define LAPIC_TIMER_ONESHOT     (0 << 17)
+#define LAPIC_TIMER_PERIODIC    (1 << 17)
+#define LAPIC_TIMER_TSC_DEADLINE (2 << 17)
+#define LAPIC_LVT_MASKED        (1 << 16)
+
+/* Timer input: bus clock divided by 16 */
+#define LAPIC_TIMER_DIV_16      0x3
+
+/* Mapped local APIC registers (same physical page on every CPU) */
+static volatile uint32_t *lapic_regs = NULL;
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic_regs[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t val) {
+    lapic_regs[reg / 4] = val;
+}
+
+/* Wait for the previous IPI to be accepted */
+static void lapic_wait_icr(void) {
+    while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) {
+        cpu_relax();
+    }
+}
+
+/* Enable the local APIC of the calling CPU */
+void lapic_init(void) {
+    uint64_t base = rdmsr(MSR_APIC_BASE);
+    wrmsr(MSR_APIC_BASE, base | APIC_BASE_ENABLE);
+
+    if (!lapic_regs) {
+        lapic_regs = (volatile uint32_t *)phys_to_virt(base & ~0xFFFULL);
+    }
+
+    /* Software-enable with the spurious vector */
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+}
+
+/* Whether lapic_init() has run */
+bool lapic_available(void) {
+    return lapic_regs != NULL;
+}
+
+/* APIC ID of the calling CPU */
+uint32_t lapic_id(void) {
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+/* Signal end of interrupt */
+void lapic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/* Send a fixed-vector IPI to one CPU */
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector) {
+    lapic_wait_icr();
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, LAPIC_ICR_ASSERT | vector);
+}
+
+/* Send a fixed-vector IPI to every other CPU */
+void lapic_send_ipi_all_but_self(uint8_t vector) {
+    lapic_wait_icr();
+    lapic_write(LAPIC_ICR_HIGH, 0);
+    lapic_write(LAPIC_ICR_LOW, LAPIC_ICR_ALL_BUT_SELF | LAPIC_ICR_ASSERT | vector);
+}
+
+/* Local APIC timer of the calling CPU. Counts run at the bus clock / 16. */
+void lapic_timer_periodic(uint8_t vector, uint32_t count) {
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | vector);
+    lapic_write(LAPIC_TIMER_INITIAL, count);
+}
+
+void lapic_timer_oneshot(uint8_t vector, uint32_t count) {
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_ONESHOT | vector);
+    lapic_write(LAPIC_TIMER_INITIAL, count);
+}
+
+uint32_t lapic_timer_current(void) {
+    return lapic_read(LAPIC_TIMER_CURRENT);
+}
+
+void lapic_timer_stop(void) {
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+}
+
+/* TSC-deadline mode: the timer fires once the TSC reaches the value
+ * written to MSR_TSC_DEADLINE (re-armed by writing the MSR again) */
+bool lapic_tsc_deadline_supported(void) {
+    uint32_t ecx;
+    cpuid(1, 0, NULL, NULL, &ecx, NULL);
+    return (ecx & CPUID_ECX_TSC_DEADLINE) != 0;
+}
+
+void lapic_timer_deadline_mode(uint8_t vector) {
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_TSC_DEADLINE | vector);
+    /* The LVT write must land before the first MSR write arms the timer */
+    __asm__ volatile ("mfence" ::: "memory");
+}
+
+void lapic_timer_set_deadline(uint64_t tsc) {
+    wrmsr(MSR_TSC_DEADLINE, tsc);
+}
@@ -1,6 +1,11 @@
 #include "ata.h"
+#include "ioapic.h"
+#include "../../kernel/include/irq.h"
+#include "../../kernel/include/sync.h"
+#include "../../kernel/include/process.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /* I/O port operations */
 static inline void outb(uint16_t port, uint8_t value) {
@@ -21,6 +26,30 @@ static inline void io_wait(void) {
 static uint16_t ata_io_base = ATA_PRIMARY_IO;
 static bool drive_present = false;
 
+/* Serializes access to the controller between threads and CPUs */
+static mutex_t ata_busy = MUTEX_INIT;
+
+/* Completion of a sector transfer, signalled by IRQ14 */
+static wait_queue_t ata_irq_wait = WAIT_QUEUE_INIT;
+static volatile bool ata_irq_fired = false;
+
+/* Acquire the controller, sleeping while another thread uses it */
+static void ata_lock(void) {
+    mutex_lock(&ata_busy);
+}
+
+static void ata_unlock(void) {
+    mutex_unlock(&ata_busy);
+}
+
+/* IRQ14: the drive finished a sector (reading status acknowledges it) */
+static void ata_irq_handler(void *ctx) {
+    (void)ctx;
+    (void)inb(ata_io_base + 7);
+    ata_irq_fired = true;
+    wake_up_all(&ata_irq_wait);
+}
+
 /* Wait for ATA drive to be ready */
 static bool ata_wait_ready(void) {
     uint8_t status;
@@ -54,8 +83,23 @@ static bool ata_wait_drq(void) {
     return false;
 }
 
+/* Wait for the next data block: sleep until IRQ14 where possible, then
+ * confirm DRQ by polling (which also covers a lost interrupt) */
+static bool ata_wait_data(void) {
+    if (sync_can_block()) {
+        wait_event_timeout(&ata_irq_wait, ata_irq_fired, ATA_IRQ_TIMEOUT);
+        ata_irq_fired = false;
+    }
+    return ata_wait_drq();
+}
+
 /* Initialize ATA driver */
 void ata_init(void) {
+    irq_register(ISA_IRQ_VECTOR(14), ata_irq_handler, NULL);
+
+    /* Clear nIEN so the drive raises IRQ14 */
+    outb(ATA_PRIMARY_CTRL, 0x00);
+
     /* Try to identify the drive */
     if (!ata_wait_ready()) {
         drive_present = false;
@@ -97,8 +141,8 @@ bool ata_drive_present(void) {
     return drive_present;
 }
 
-/* Read sectors from disk */
-bool ata_read_sectors(uint32_t lba, uint8_t sector_count, uint8_t *buffer) {
+/* Read sectors from disk (controller lock held) */
+static bool ata_do_read_sectors(uint32_t lba, uint8_t sector_count, uint8_t *buffer) {
     if (!drive_present || sector_count == 0) {
         return false;
     }
@@ -114,11 +158,12 @@ bool ata_read_sectors(uint32_t lba, uint8_t sector_count, uint8_t *buffer) {
     outb(ata_io_base + 3, (uint8_t)(lba));
     outb(ata_io_base + 4, (uint8_t)(lba >> 8));
     outb(ata_io_base + 5, (uint8_t)(lba >> 16));
+    ata_irq_fired = false;
     outb(ata_io_base + 7, ATA_CMD_READ_PIO);
     
-    /* Read sectors */
+    /* Read sectors (the drive interrupts once per sector) */
     for (uint8_t i = 0; i < sector_count; i++) {
-        if (!ata_wait_drq()) {
+        if (!ata_wait_data()) {
             return false;
         }
         
@@ -138,8 +183,8 @@ bool ata_read_sectors(uint32_t lba, uint8_t sector_count, uint8_t *buffer) {
     return true;
 }
 
-/* Write sectors to disk */
-bool ata_write_sectors(uint32_t lba, uint8_t sector_count, const uint8_t *buffer) {
+/* Write sectors to disk (controller lock held) */
+static bool ata_do_write_sectors(uint32_t lba, uint8_t sector_count, const uint8_t *buffer) {
     if (!drive_present || sector_count == 0) {
         return false;
     }
@@ -155,11 +200,12 @@ bool ata_write_sectors(uint32_t lba, uint8_t sector_count, const uint8_t *buffer
     outb(ata_io_base + 3, (uint8_t)(lba));
     outb(ata_io_base + 4, (uint8_t)(lba >> 8));
     outb(ata_io_base + 5, (uint8_t)(lba >> 16));
+    ata_irq_fired = false;
     outb(ata_io_base + 7, ATA_CMD_WRITE_PIO);
     
-    /* Write sectors */
+    /* Write sectors (the first block is requested without an interrupt) */
     for (uint8_t i = 0; i < sector_count; i++) {
-        if (!ata_wait_drq()) {
+        if (!(i == 0 ? ata_wait_drq() : ata_wait_data())) {
             return false;
         }
         
@@ -182,3 +228,19 @@ bool ata_write_sectors(uint32_t lba, uint8_t sector_count, const uint8_t *buffer
     
     return true;
 }
+
+/* Read sectors from disk */
+bool ata_read_sectors(uint32_t lba, uint8_t sector_count, uint8_t *buffer) {
+    ata_lock();
+    bool ok = ata_do_read_sectors(lba, sector_count, buffer);
+    ata_unlock();
+    return ok;
+}
+
+/* Write sectors to disk */
+bool ata_write_sectors(uint32_t lba, uint8_t sector_count, const uint8_t *buffer) {
+    ata_lock();
+    bool ok = ata_do_write_sectors(lba, sector_count, buffer);
+    ata_unlock();
+    return ok;
+}
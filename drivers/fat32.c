@@ -239,6 +239,115 @@ bool fat32_read_file(const char *path, uint8_t *buffer, uint32_t *size) {
     return true;
 }
 
+/* Read size bytes starting at offset. Only the clusters covering the
+ * range are read from disk. */
+bool fat32_read_range(const char *path, uint8_t *buffer, uint32_t offset, uint32_t size, uint32_t *bytes_read) {
+    if (!fs_initialized) return false;
+    
+    if (path[0] == '/') path++;
+    
+    fat32_dir_entry_t entry;
+    if (!find_file_in_directory(root_dir_first_cluster, path, &entry)) {
+        return false;
+    }
+    
+    *bytes_read = 0;
+    if (offset >= entry.file_size) return true;
+    if (size > entry.file_size - offset) {
+        size = entry.file_size - offset;
+    }
+    
+    /* Walk the chain to the cluster holding offset */
+    uint32_t bytes_per_cluster = sectors_per_cluster * 512;
+    uint32_t cluster = ((uint32_t)entry.first_cluster_high << 16) | entry.first_cluster_low;
+    for (uint32_t skip = offset / bytes_per_cluster; skip > 0 && cluster < 0x0FFFFFF8; skip--) {
+        cluster = read_fat_entry(cluster);
+    }
+    
+    /* Whole clusters are read into a bounce buffer, then the wanted part copied */
+    uint8_t *bounce = (uint8_t *)kmalloc(bytes_per_cluster);
+    if (!bounce) return false;
+    
+    uint32_t pos = offset % bytes_per_cluster;
+    uint32_t done = 0;
+    while (done < size && cluster < 0x0FFFFFF8) {
+        if (!ata_read_sectors(cluster_to_lba(cluster), sectors_per_cluster, bounce)) {
+            kfree(bounce);
+            return false;
+        }
+        
+        uint32_t chunk = bytes_per_cluster - pos;
+        if (chunk > size - done) {
+            chunk = size - done;
+        }
+        memcpy(buffer + done, bounce + pos, chunk);
+        done += chunk;
+        pos = 0;
+        cluster = read_fat_entry(cluster);
+    }
+    
+    kfree(bounce);
+    *bytes_read = done;
+    return true;
+}
+
+/* Overwrite size bytes of an existing file starting at offset. Files do
+ * not grow: bytes past the current end are not written. Partly covered
+ * clusters are read first so their other bytes survive. */
+bool fat32_write_range(const char *path, const uint8_t *buffer, uint32_t offset, uint32_t size, uint32_t *bytes_written) {
+    if (!fs_initialized) return false;
+    
+    if (path[0] == '/') path++;
+    
+    fat32_dir_entry_t entry;
+    if (!find_file_in_directory(root_dir_first_cluster, path, &entry)) {
+        return false;
+    }
+    
+    *bytes_written = 0;
+    if (offset >= entry.file_size) return true;
+    if (size > entry.file_size - offset) {
+        size = entry.file_size - offset;
+    }
+    
+    uint32_t bytes_per_cluster = sectors_per_cluster * 512;
+    uint32_t cluster = ((uint32_t)entry.first_cluster_high << 16) | entry.first_cluster_low;
+    for (uint32_t skip = offset / bytes_per_cluster; skip > 0 && cluster < 0x0FFFFFF8; skip--) {
+        cluster = read_fat_entry(cluster);
+    }
+    
+    uint8_t *bounce = (uint8_t *)kmalloc(bytes_per_cluster);
+    if (!bounce) return false;
+    
+    uint32_t pos = offset % bytes_per_cluster;
+    uint32_t done = 0;
+    while (done < size && cluster < 0x0FFFFFF8) {
+        uint32_t lba = cluster_to_lba(cluster);
+        uint32_t chunk = bytes_per_cluster - pos;
+        if (chunk > size - done) {
+            chunk = size - done;
+        }
+        
+        if (chunk < bytes_per_cluster && !ata_read_sectors(lba, sectors_per_cluster, bounce)) {
+            kfree(bounce);
+            return false;
+        }
+        memcpy(bounce + pos, buffer + done, chunk);
+        if (!ata_write_sectors(lba, sectors_per_cluster, bounce)) {
+            kfree(bounce);
+            return false;
+        }
+        
+        done += chunk;
+        pos = 0;
+        cluster = read_fat_entry(cluster);
+    }
+    
+    kfree(bounce);
+    *bytes_written = done;
+    return true;
+}
+
 /* Write file (simplified - not fully implemented) */
 bool fat32_write_file(const char *path, const uint8_t *buffer, uint32_t size) {
     (void)path;
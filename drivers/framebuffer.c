@@ -119,7 +119,7 @@ void fb_putpixel(uint32_t x, uint32_t y, uint32_t color) {
 /* Swap back buffer to framebuffer (double buffering) */
 void fb_swap(void) {
     if (back_buffer) {
-        memcpy(fb_addr, back_buffer, fb_height * fb_pitch);
+        memcpy_simd(fb_addr, back_buffer, fb_height * fb_pitch);
     }
 }
 
@@ -0,0 +1,189 @@
+#include "hpet.h"
+#include "../../kernel/include/acpi.h"
+#include "../../kernel/include/paging.h"
+#include "../../kernel/include/spinlock.h"
+#include "../../kernel/include/cpu.h"
+#include "ioapic.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Register offsets */
+#define HPET_CAP_ID        0x000
+#define HPET_CONFIG        0x010
+#define HPET_MAIN_COUNTER  0x0F0
+
+#define HPET_TIMER_CONFIG(n)     (0x100 + 0x20 * (n))
+#define HPET_TIMER_COMPARATOR(n) (0x108 + 0x20 * (n))
+
+/* Register bits */
+#define HPET_CAP_COUNT_64  (1ULL << 13)
+#define HPET_CONFIG_ENABLE (1ULL << 0)
+
+/* Timer configuration bits */
+#define HPET_TN_LEVEL       (1ULL << 1)
+#define HPET_TN_INT_ENABLE  (1ULL << 2)
+#define HPET_TN_PERIODIC    (1ULL << 3)
+#define HPET_TN_ROUTE_SHIFT 9
+#define HPET_TN_ROUTE_MASK  (0x1FULL << HPET_TN_ROUTE_SHIFT)
+#define HPET_TN_FSB_ENABLE  (1ULL << 14)
+
+/* One-shot events: arm at least this far ahead so the counter cannot
+ * pass the comparator while it is written, and at most this far so a
+ * 32-bit comparator cannot wrap (a later re-arm covers the rest) */
+#define HPET_MIN_DELTA_NS 2000ULL
+#define HPET_MAX_DELTA_NS 100000000000ULL
+
+/* Largest period the specification allows (100 ns) */
+#define HPET_MAX_PERIOD_FS 100000000U
+
+static volatile uint64_t *hpet_regs = NULL;
+static uint32_t period_fs = 0;
+static bool counter_64 = false;
+
+/* Timer 0 as a one-shot event source */
+static bool oneshot_ready = false;
+static uint64_t ns_to_count_mult = 0;   /* counts = (ns * mult) >> 32 */
+static spinlock_t oneshot_lock = SPINLOCK_INIT;
+
+/* Software extension of a 32-bit main counter */
+static uint32_t last_low = 0;
+static uint64_t high_bits = 0;
+static spinlock_t extend_lock = SPINLOCK_INIT;
+
+static inline uint64_t hpet_read(uint32_t reg) {
+    return hpet_regs[reg / 8];
+}
+
+static inline void hpet_write(uint32_t reg, uint64_t val) {
+    hpet_regs[reg / 8] = val;
+}
+
+/* Map the registers and start the main counter */
+bool hpet_init(void) {
+    const acpi_hpet_t *table = (const acpi_hpet_t *)acpi_find_table("HPET");
+    if (!table || table->base.address_space != 0 || !table->base.address) {
+        return false;
+    }
+
+    volatile uint64_t *regs = (volatile uint64_t *)phys_to_virt(table->base.address);
+    uint64_t cap = regs[HPET_CAP_ID / 8];
+    uint32_t period = (uint32_t)(cap >> 32);
+    if (period == 0 || period > HPET_MAX_PERIOD_FS) {
+        return false;
+    }
+
+    hpet_regs = regs;
+    period_fs = period;
+    counter_64 = (cap & HPET_CAP_COUNT_64) != 0;
+
+    /* Restart the counter from zero (halted while it is written) */
+    hpet_write(HPET_CONFIG, hpet_read(HPET_CONFIG) & ~HPET_CONFIG_ENABLE);
+    hpet_write(HPET_MAIN_COUNTER, 0);
+    hpet_write(HPET_CONFIG, hpet_read(HPET_CONFIG) | HPET_CONFIG_ENABLE);
+    return true;
+}
+
+bool hpet_available(void) {
+    return hpet_regs != NULL;
+}
+
+uint64_t hpet_read_counter(void) {
+    if (!hpet_regs) return 0;
+    if (counter_64) return hpet_read(HPET_MAIN_COUNTER);
+
+    /* Callers read at least once per wrap (minutes at typical rates) */
+    uint64_t flags = spin_lock_irqsave(&extend_lock);
+    uint32_t low = (uint32_t)hpet_read(HPET_MAIN_COUNTER);
+    if (low < last_low) {
+        high_bits += 1ULL << 32;
+    }
+    last_low = low;
+    uint64_t value = high_bits | low;
+    spin_unlock_irqrestore(&extend_lock, flags);
+    return value;
+}
+
+uint32_t hpet_period_fs(void) {
+    return period_fs;
+}
+
+uint64_t hpet_measure_tsc_khz(uint32_t ms) {
+    if (!hpet_regs || ms == 0) return 0;
+
+    uint64_t ticks = (uint64_t)ms * 1000000000000ULL / period_fs;
+    uint64_t flags = irq_save();
+    uint64_t start = hpet_read_counter();
+    uint64_t tsc_start = rdtsc();
+    uint64_t now;
+    while ((now = hpet_read_counter()) - start < ticks) {
+        cpu_relax();
+    }
+    uint64_t tsc_end = rdtsc();
+    irq_restore(flags);
+
+    /* Scale by the time that actually passed, not the requested ms */
+    uint64_t elapsed_ns = (now - start) * period_fs / 1000000;
+    return (tsc_end - tsc_start) * 1000000 / elapsed_ns;
+}
+
+/* Route timer 0 to vector on the CPU with apic_id as a one-shot event
+ * source (edge-triggered, through the highest IOAPIC input it allows) */
+bool hpet_oneshot_init(uint8_t vector, uint32_t apic_id) {
+    if (!hpet_regs || !ioapic_available()) return false;
+
+    uint64_t config = hpet_read(HPET_TIMER_CONFIG(0));
+    uint32_t route_cap = (uint32_t)(config >> 32);
+    int gsi = -1;
+    for (int g = 31; g >= 0; g--) {
+        if ((route_cap & (1U << g)) && ioapic_has_gsi((uint32_t)g)) {
+            gsi = g;
+            break;
+        }
+    }
+    if (gsi < 0) return false;
+
+    config &= ~(HPET_TN_ROUTE_MASK | HPET_TN_FSB_ENABLE | HPET_TN_INT_ENABLE |
+                HPET_TN_PERIODIC | HPET_TN_LEVEL);
+    config |= (uint64_t)gsi << HPET_TN_ROUTE_SHIFT;
+    hpet_write(HPET_TIMER_CONFIG(0), config);
+    if (!ioapic_route_gsi((uint32_t)gsi, vector, apic_id, false, false)) {
+        return false;
+    }
+
+    ns_to_count_mult = (1000000ULL << 32) / period_fs;
+    oneshot_ready = true;
+    return true;
+}
+
+bool hpet_oneshot_available(void) {
+    return oneshot_ready;
+}
+
+/* Raise the timer 0 interrupt delta_ns from now */
+void hpet_oneshot_arm(uint64_t delta_ns) {
+    if (!oneshot_ready) return;
+    if (delta_ns < HPET_MIN_DELTA_NS) delta_ns = HPET_MIN_DELTA_NS;
+    if (delta_ns > HPET_MAX_DELTA_NS) delta_ns = HPET_MAX_DELTA_NS;
+
+    uint64_t flags = spin_lock_irqsave(&oneshot_lock);
+    for (;;) {
+        uint64_t counts = (uint64_t)(((unsigned __int128)delta_ns * ns_to_count_mult) >> 32);
+        uint64_t target = hpet_read_counter() + counts + 1;
+        hpet_write(HPET_TIMER_COMPARATOR(0), target);
+        hpet_write(HPET_TIMER_CONFIG(0), hpet_read(HPET_TIMER_CONFIG(0)) | HPET_TN_INT_ENABLE);
+
+        /* A comparator the counter already passed would not fire until
+         * the counter wraps: try again further ahead */
+        if ((int64_t)(hpet_read_counter() - target) < 0) break;
+        delta_ns *= 2;
+    }
+    spin_unlock_irqrestore(&oneshot_lock, flags);
+}
+
+void hpet_oneshot_disarm(void) {
+    if (!oneshot_ready) return;
+
+    uint64_t flags = spin_lock_irqsave(&oneshot_lock);
+    hpet_write(HPET_TIMER_CONFIG(0), hpet_read(HPET_TIMER_CONFIG(0)) & ~HPET_TN_INT_ENABLE);
+    spin_unlock_irqrestore(&oneshot_lock, flags);
+}
@@ -0,0 +1,29 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Interrupt vectors owned by the local APIC */
+#define IPI_VECTOR_RESCHED  0xF0
+#define IPI_VECTOR_TLB      0xF1
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+/* Local APIC functions */
+void lapic_init(void);
+bool lapic_available(void);
+uint32_t lapic_id(void);
+void lapic_eoi(void);
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector);
+void lapic_send_ipi_all_but_self(uint8_t vector);
+
+/* Local APIC timer (bus clock / 16, or TSC-deadline mode) */
+void lapic_timer_periodic(uint8_t vector, uint32_t count);
+void lapic_timer_oneshot(uint8_t vector, uint32_t count);
+uint32_t lapic_timer_current(void);
+void lapic_timer_stop(void);
+bool lapic_tsc_deadline_supported(void);
+void lapic_timer_deadline_mode(uint8_t vector);
+void lapic_timer_set_deadline(uint64_t tsc);
+
+#endif /* APIC_H */
@@ -25,6 +25,9 @@
 #define ATA_SR_IDX   0x02   /* Index */
 #define ATA_SR_ERR   0x01   /* Error */
 
+/* Ticks to sleep for a sector interrupt before falling back to polling */
+#define ATA_IRQ_TIMEOUT 100
+
 /* Initialize ATA driver */
 void ata_init(void);
 
@@ -62,7 +62,9 @@ typedef struct {
 /* FAT32 functions */
 bool fat32_init(void);
 bool fat32_read_file(const char *path, uint8_t *buffer, uint32_t *size);
+bool fat32_read_range(const char *path, uint8_t *buffer, uint32_t offset, uint32_t size, uint32_t *bytes_read);
 bool fat32_write_file(const char *path, const uint8_t *buffer, uint32_t size);
+bool fat32_write_range(const char *path, const uint8_t *buffer, uint32_t offset, uint32_t size, uint32_t *bytes_written);
 bool fat32_list_directory(const char *path, fat32_dir_entry_t *entries, uint32_t *count);
 bool fat32_file_exists(const char *path);
 bool fat32_create_file(const char *path);
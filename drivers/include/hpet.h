@@ -0,0 +1,29 @@
+#ifndef HPET_H
+#define HPET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* High Precision Event Timer (found through the ACPI HPET table) */
+bool hpet_init(void);
+bool hpet_available(void);
+
+/* Main counter, extended to 64 bits on 32-bit implementations */
+uint64_t hpet_read_counter(void);
+
+/* Counter period in femtoseconds */
+uint32_t hpet_period_fs(void);
+
+/* Vector of the one-shot event interrupt */
+#define HPET_TIMER_VECTOR 48
+
+/* Timer 0 as a one-shot event source for high-resolution timers */
+bool hpet_oneshot_init(uint8_t vector, uint32_t apic_id);
+bool hpet_oneshot_available(void);
+void hpet_oneshot_arm(uint64_t delta_ns);
+void hpet_oneshot_disarm(void);
+
+/* TSC rate measured against the HPET over ms milliseconds, in kHz */
+uint64_t hpet_measure_tsc_khz(uint32_t ms);
+
+#endif /* HPET_H */
@@ -0,0 +1,27 @@
+#ifndef IOAPIC_H
+#define IOAPIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Vector of a legacy ISA IRQ (same numbering as the remapped 8259s) */
+#define ISA_IRQ_VECTOR(irq) (32 + (irq))
+
+/* Find the IOAPICs in the MADT and mask every input */
+bool ioapic_init(void);
+
+/* Whether device IRQs go through the IOAPIC (the 8259s are masked) */
+bool ioapic_available(void);
+
+/* Deliver an ISA IRQ as vector to the CPU with apic_id, honouring the
+ * MADT's source overrides; calling it again moves the IRQ */
+bool ioapic_route_isa(uint8_t irq, uint8_t vector, uint32_t apic_id);
+
+/* Deliver a global system interrupt (non-ISA sources) */
+bool ioapic_route_gsi(uint32_t gsi, uint8_t vector, uint32_t apic_id, bool level, bool active_low);
+bool ioapic_has_gsi(uint32_t gsi);
+
+/* Mask or unmask an ISA IRQ */
+void ioapic_set_masked(uint8_t irq, bool masked);
+
+#endif /* IOAPIC_H */
@@ -0,0 +1,11 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+
+/* COM1 output for debugging (as left configured by the firmware) */
+void serial_putc(char c);
+void serial_write_string(const char *str);
+void serial_write_uint(uint64_t value);
+
+#endif /* SERIAL_H */
@@ -2,10 +2,26 @@
 #define TIMER_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /* Timer functions */
 void timer_init(uint32_t frequency);
 uint64_t timer_get_ticks(void);
 void timer_wait(uint32_t ms);
+bool timer_uses_lapic(void);
+
+/* One-shot events on the tick device (TSC-deadline mode only) */
+bool timer_event_capable(void);
+void timer_set_event(uint64_t tsc);
+void timer_event_sync(void);
+
+/* Dynamic ticks: stop the periodic tick while idle */
+void timer_nohz_enter(void);
+void timer_nohz_exit(void);
+bool timer_nohz_active(void);
+uint64_t timer_get_nohz_entries(void);
+
+/* TSC rate measured against PIT channel 2 over ms (at most 54) ms, in kHz */
+uint64_t timer_pit_measure_tsc_khz(uint32_t ms);
 
 #endif /* TIMER_H */
@@ -0,0 +1,138 @@
+#include "ioapic.h"
+#include "../../kernel/include/acpi.h"
+#include "../../kernel/include/paging.h"
+#include "../../kernel/include/spinlock.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Indirect register access: select with IOREGSEL, then use IOWIN */
+#define IOAPIC_REGSEL   0x00
+#define IOAPIC_WINDOW   0x10
+
+/* Registers */
+#define IOAPIC_REG_VER      0x01
+#define IOAPIC_REG_REDIR    0x10    /* Two registers per input */
+
+/* Redirection entry bits */
+#define IOAPIC_POLARITY_LOW (1U << 13)
+#define IOAPIC_TRIGGER_LEVEL (1U << 15)
+#define IOAPIC_MASKED       (1U << 16)
+
+typedef struct {
+    volatile uint32_t *regs;
+    uint32_t gsi_base;
+    uint32_t inputs;            /* Redirection entries */
+} ioapic_t;
+
+static ioapic_t ioapics[ACPI_MAX_IOAPICS];
+static uint32_t ioapic_count = 0;
+static acpi_madt_info_t madt;
+static spinlock_t ioapic_lock = SPINLOCK_INIT;
+
+static uint32_t ioapic_read(ioapic_t *io, uint32_t reg) {
+    io->regs[IOAPIC_REGSEL / 4] = reg;
+    return io->regs[IOAPIC_WINDOW / 4];
+}
+
+static void ioapic_write(ioapic_t *io, uint32_t reg, uint32_t val) {
+    io->regs[IOAPIC_REGSEL / 4] = reg;
+    io->regs[IOAPIC_WINDOW / 4] = val;
+}
+
+bool ioapic_init(void) {
+    if (!acpi_parse_madt(&madt) || madt.ioapic_count == 0) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < madt.ioapic_count; i++) {
+        ioapic_t *io = &ioapics[i];
+        io->regs = (volatile uint32_t *)phys_to_virt(madt.ioapics[i].address);
+        io->gsi_base = madt.ioapics[i].gsi_base;
+        io->inputs = ((ioapic_read(io, IOAPIC_REG_VER) >> 16) & 0xFF) + 1;
+
+        /* Nothing is delivered until a driver's IRQ is routed */
+        for (uint32_t pin = 0; pin < io->inputs; pin++) {
+            ioapic_write(io, IOAPIC_REG_REDIR + pin * 2, IOAPIC_MASKED);
+            ioapic_write(io, IOAPIC_REG_REDIR + pin * 2 + 1, 0);
+        }
+    }
+    ioapic_count = madt.ioapic_count;
+    return true;
+}
+
+bool ioapic_available(void) {
+    return ioapic_count != 0;
+}
+
+/* IOAPIC serving a global system interrupt, or NULL */
+static ioapic_t *ioapic_for_gsi(uint32_t gsi) {
+    for (uint32_t i = 0; i < ioapic_count; i++) {
+        ioapic_t *io = &ioapics[i];
+        if (gsi >= io->gsi_base && gsi < io->gsi_base + io->inputs) {
+            return io;
+        }
+    }
+    return NULL;
+}
+
+/* ISA IRQs are edge-triggered, active high, on the GSI of the same
+ * number unless the firmware says otherwise */
+static uint32_t ioapic_isa_gsi(uint8_t irq, uint32_t *low_flags) {
+    *low_flags = 0;
+    for (uint32_t i = 0; i < madt.override_count; i++) {
+        const acpi_irq_override_t *iso = &madt.overrides[i];
+        if (iso->source != irq) continue;
+
+        if ((iso->flags & ACPI_MADT_POLARITY_MASK) == ACPI_MADT_POLARITY_LOW) {
+            *low_flags |= IOAPIC_POLARITY_LOW;
+        }
+        if ((iso->flags & ACPI_MADT_TRIGGER_MASK) == ACPI_MADT_TRIGGER_LEVEL) {
+            *low_flags |= IOAPIC_TRIGGER_LEVEL;
+        }
+        return iso->gsi;
+    }
+    return irq;
+}
+
+bool ioapic_route_gsi(uint32_t gsi, uint8_t vector, uint32_t apic_id, bool level, bool active_low) {
+    ioapic_t *io = ioapic_for_gsi(gsi);
+    if (!io) return false;
+
+    uint32_t low = vector;
+    if (level) low |= IOAPIC_TRIGGER_LEVEL;
+    if (active_low) low |= IOAPIC_POLARITY_LOW;
+
+    /* Fixed delivery, physical destination */
+    uint32_t pin = gsi - io->gsi_base;
+    uint64_t flags = spin_lock_irqsave(&ioapic_lock);
+    ioapic_write(io, IOAPIC_REG_REDIR + pin * 2, IOAPIC_MASKED);
+    ioapic_write(io, IOAPIC_REG_REDIR + pin * 2 + 1, apic_id << 24);
+    ioapic_write(io, IOAPIC_REG_REDIR + pin * 2, low);
+    spin_unlock_irqrestore(&ioapic_lock, flags);
+    return true;
+}
+
+bool ioapic_route_isa(uint8_t irq, uint8_t vector, uint32_t apic_id) {
+    uint32_t low_flags;
+    uint32_t gsi = ioapic_isa_gsi(irq, &low_flags);
+    return ioapic_route_gsi(gsi, vector, apic_id, (low_flags & IOAPIC_TRIGGER_LEVEL) != 0,
+                            (low_flags & IOAPIC_POLARITY_LOW) != 0);
+}
+
+bool ioapic_has_gsi(uint32_t gsi) {
+    return ioapic_for_gsi(gsi) != NULL;
+}
+
+void ioapic_set_masked(uint8_t irq, bool masked) {
+    uint32_t low_flags;
+    uint32_t gsi = ioapic_isa_gsi(irq, &low_flags);
+    ioapic_t *io = ioapic_for_gsi(gsi);
+    if (!io) return;
+
+    uint32_t reg = IOAPIC_REG_REDIR + (gsi - io->gsi_base) * 2;
+    uint64_t flags = spin_lock_irqsave(&ioapic_lock);
+    uint32_t low = ioapic_read(io, reg);
+    ioapic_write(io, reg, masked ? (low | IOAPIC_MASKED) : (low & ~IOAPIC_MASKED));
+    spin_unlock_irqrestore(&ioapic_lock, flags);
+}
@@ -1,6 +1,9 @@
 #include "keyboard.h"
+#include "ioapic.h"
+#include "../../kernel/include/irq.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /* Keyboard ports */
 #define KEYBOARD_DATA_PORT 0x60
@@ -28,14 +31,18 @@ static const char scancode_to_ascii[] = {
     '*', 0, ' '
 };
 
+static void keyboard_interrupt_handler(void *ctx);
+
 /* Initialize keyboard */
 void keyboard_init(void) {
     keyboard_buffer_head = 0;
     keyboard_buffer_tail = 0;
+    irq_register(ISA_IRQ_VECTOR(1), keyboard_interrupt_handler, NULL);
 }
 
 /* Keyboard interrupt handler (called from IRQ1) */
-void keyboard_interrupt_handler(void) {
+static void keyboard_interrupt_handler(void *ctx) {
+    (void)ctx;
     uint8_t scancode = inb(KEYBOARD_DATA_PORT);
     
     /* Ignore key release events (bit 7 set) */
@@ -1,16 +1,36 @@
 #include "mouse.h"
+#include "timer.h"
+#include "ioapic.h"
+#include "../../kernel/include/irq.h"
+#include "../../kernel/include/softirq.h"
+#include "../../kernel/include/sync.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /* Mouse ports */
 #define MOUSE_DATA_PORT 0x60
 #define MOUSE_COMMAND_PORT 0x64
 
+/* Controller wait limits */
+#define MOUSE_SPIN_POLLS  1000     /* Status reads before giving up the CPU */
+#define MOUSE_WAIT_POLLS  100000   /* Timeout when the caller cannot sleep */
+#define MOUSE_WAIT_TICKS  100      /* Timeout when sleeping between polls */
+
+/* Bytes read by the interrupt, waiting for the packet tasklet */
+#define MOUSE_RING_SIZE 64
+
 /* Mouse state */
 static struct mouse_state current_mouse_state = {0, 0, false, false, false};
 static uint8_t mouse_cycle = 0;
 static uint8_t mouse_bytes[3];
 
+/* Single producer (IRQ12) and single consumer (the tasklet) */
+static uint8_t mouse_ring[MOUSE_RING_SIZE];
+static volatile uint32_t ring_head = 0;
+static volatile uint32_t ring_tail = 0;
+static tasklet_t mouse_tasklet;
+
 /* I/O port operations */
 static inline void outb(uint16_t port, uint8_t val) {
     __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
@@ -22,21 +42,29 @@ static inline uint8_t inb(uint16_t port) {
     return ret;
 }
 
-/* Wait for mouse */
+/* Controller ready for a read (type 0) or a write (type 1) */
+static bool mouse_ready(uint8_t type) {
+    uint8_t status = inb(MOUSE_COMMAND_PORT);
+    return type == 0 ? (status & 1) == 1 : (status & 2) == 0;
+}
+
+/* Wait for mouse: spin briefly, then sleep a tick between polls if the
+ * caller can block (busy-poll only during early boot) */
 static void mouse_wait(uint8_t type) {
-    uint32_t timeout = 100000;
-    if (type == 0) {
-        while (timeout--) {
-            if ((inb(MOUSE_COMMAND_PORT) & 1) == 1) {
-                return;
-            }
-        }
-    } else {
-        while (timeout--) {
-            if ((inb(MOUSE_COMMAND_PORT) & 2) == 0) {
-                return;
-            }
+    for (uint32_t i = 0; i < MOUSE_SPIN_POLLS; i++) {
+        if (mouse_ready(type)) return;
+    }
+
+    if (!sync_can_block()) {
+        for (uint32_t i = 0; i < MOUSE_WAIT_POLLS; i++) {
+            if (mouse_ready(type)) return;
         }
+        return;
+    }
+
+    uint64_t deadline = timer_get_ticks() + MOUSE_WAIT_TICKS;
+    while (!mouse_ready(type) && timer_get_ticks() < deadline) {
+        process_sleep(1);
     }
 }
 
@@ -54,6 +82,9 @@ static uint8_t mouse_read(void) {
     return inb(MOUSE_DATA_PORT);
 }
 
+static void mouse_interrupt_handler(void *ctx);
+static void mouse_packet_tasklet(void *data);
+
 /* Initialize mouse */
 void mouse_init(void) {
     /* Enable auxiliary device */
@@ -84,12 +115,28 @@ void mouse_init(void) {
     current_mouse_state.right_button = false;
     current_mouse_state.middle_button = false;
     mouse_cycle = 0;
+    ring_head = 0;
+    ring_tail = 0;
+    INIT_TASKLET(&mouse_tasklet, mouse_packet_tasklet, NULL);
+    irq_register(ISA_IRQ_VECTOR(12), mouse_interrupt_handler, NULL);
 }
 
-/* Mouse interrupt handler (called from IRQ12) */
-void mouse_interrupt_handler(void) {
+/* Mouse interrupt handler (called from IRQ12): only takes the byte off
+ * the controller; packets are assembled by the tasklet */
+static void mouse_interrupt_handler(void *ctx) {
+    (void)ctx;
     uint8_t data = inb(MOUSE_DATA_PORT);
-    
+
+    uint32_t head = ring_head;
+    if (head - ring_tail < MOUSE_RING_SIZE) {
+        mouse_ring[head % MOUSE_RING_SIZE] = data;
+        __atomic_store_n(&ring_head, head + 1, __ATOMIC_RELEASE);
+    }
+    tasklet_schedule(&mouse_tasklet);
+}
+
+/* Feed one byte to the packet parser */
+static void mouse_process_byte(uint8_t data) {
     /* Verify first byte alignment - bit 3 must be set in byte 0 */
     if (mouse_cycle == 0 && !(data & 0x08)) {
         return;  /* Discard and resynchronize */
@@ -129,6 +176,17 @@ void mouse_interrupt_handler(void) {
     }
 }
 
+/* Bottom half: parse every byte the interrupt has queued */
+static void mouse_packet_tasklet(void *data) {
+    (void)data;
+
+    uint32_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    while (ring_tail != head) {
+        mouse_process_byte(mouse_ring[ring_tail % MOUSE_RING_SIZE]);
+        __atomic_store_n(&ring_tail, ring_tail + 1, __ATOMIC_RELEASE);
+    }
+}
+
 /* Get mouse state */
 void mouse_get_state(struct mouse_state *state) {
     state->x = current_mouse_state.x;
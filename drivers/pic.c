@@ -56,8 +56,9 @@ void pic_init(void) {
 
     /* Enable needed interrupts: timer (IRQ0), keyboard (IRQ1), cascade (IRQ2) */
     outb(PIC1_DATA, 0xF8);
-    /* Enable needed interrupts: mouse (IRQ12 = slave IRQ4) */
-    outb(PIC2_DATA, 0xEF);
+    /* Enable needed interrupts: mouse (IRQ12 = slave IRQ4),
+     * primary ATA (IRQ14 = slave IRQ6) */
+    outb(PIC2_DATA, 0xAF);
 }
 
 /* Send End Of Interrupt */
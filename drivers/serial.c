@@ -0,0 +1,42 @@
+#include "serial.h"
+#include <stdint.h>
+
+/* Serial port constants for debugging */
+#define COM1_PORT 0x3F8
+#define COM1_LSR  (COM1_PORT + 5)   /* Line status */
+#define LSR_THR_EMPTY 0x20          /* Transmit holding register empty */
+
+/* I/O port operations */
+static inline void outb(uint16_t port, uint8_t val) {
+    __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+void serial_putc(char c) {
+    while ((inb(COM1_LSR) & LSR_THR_EMPTY) == 0);
+    outb(COM1_PORT, (uint8_t)c);
+}
+
+/* Simple serial port output for debugging */
+void serial_write_string(const char *str) {
+    while (*str) {
+        serial_putc(*str++);
+    }
+}
+
+void serial_write_uint(uint64_t value) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n) {
+        serial_putc(digits[--n]);
+    }
+}
@@ -1,44 +1,443 @@
 #include "timer.h"
 #include "pic.h"
+#include "apic.h"
+#include "ioapic.h"
+#include "hpet.h"
+#include "../../kernel/include/cpu.h"
+#include "../../kernel/include/smp.h"
+#include "../../kernel/include/process.h"
+#include "../../kernel/include/vdso_page.h"
+#include "../../kernel/include/ktime.h"
+#include "../../kernel/include/irq.h"
+#include "../../kernel/include/softirq.h"
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 /* PIT (Programmable Interval Timer) */
 #define PIT_CHANNEL0 0x40
+#define PIT_CHANNEL2 0x42
 #define PIT_COMMAND  0x43
+#define PIT_GATE     0x61   /* Channel 2 gate (bit 0), output (bit 5) */
 #define PIT_FREQUENCY 1193182
 
+/* PIT command bytes (channel 0, lobyte/hibyte access) */
+#define PIT_CMD_PERIODIC 0x36   /* Mode 3: square wave */
+#define PIT_CMD_ONESHOT  0x30   /* Mode 0: interrupt on terminal count */
+#define PIT_CMD_LATCH    0x00   /* Latch channel 0 count */
+#define PIT_CMD_CH2_ONESHOT 0xB0   /* Channel 2, mode 0 */
+
+#define PIT_GATE_ENABLE  0x01
+#define PIT_GATE_SPEAKER 0x02
+#define PIT_GATE_OUT2    0x20
+
+/* Largest PIT count (16-bit counter) */
+#define PIT_MAX_COUNT 0xFFFF
+
+/* Largest local APIC timer count (32-bit counter) */
+#define LAPIC_MAX_COUNT 0xFFFFFFFFU
+
+/* Interval over which the local APIC timer rate is measured */
+#define LAPIC_CALIBRATE_MS 10
+
+/* The tick keeps the vector of IRQ0 whichever device raises it */
+#define TIMER_VECTOR ISA_IRQ_VECTOR(0)
+
 /* I/O port operations */
 static inline void outb(uint16_t port, uint8_t val) {
     __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
 }
 
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+/* Device raising the tick on the bootstrap CPU */
+typedef enum {
+    TICK_PIT,               /* 8259-routed PIT channel 0 */
+    TICK_LAPIC,             /* Local APIC timer, periodic / one-shot */
+    TICK_TSC_DEADLINE,      /* Local APIC timer in TSC-deadline mode */
+} tick_device_t;
+
+static tick_device_t tick_device = TICK_PIT;
+
 /* Timer ticks */
 static volatile uint64_t timer_ticks = 0;
 
-/* Forward declaration for scheduler */
+/* Tick length in device units: PIT counts, LAPIC timer counts, or TSC
+ * cycles in deadline mode */
+static uint32_t tick_divisor = 0;
+static uint32_t lapic_tick_count = 0;
+static uint64_t tick_cycles = 0;
+
+/* Tick period in nanoseconds */
+static uint64_t tick_ns = 0;
+
+/* Deadline mode: TSC value of the next tick; ticks stay on this grid,
+ * so re-arming never drifts */
+static uint64_t next_deadline = 0;
+
+/* Deadline mode also carries one-shot events between ticks: the timer is
+ * armed for the earlier of armed_tick and event_deadline (0 = none). Other
+ * CPUs only record a new event; the bootstrap CPU programs it. */
+static uint64_t armed_tick = 0;
+static volatile uint64_t event_deadline = 0;
+static volatile bool event_dirty = false;
+
+/* Dynamic tick state: while idle the periodic tick is replaced by a
+ * one-shot deadline covering oneshot_ticks ticks */
+static volatile bool nohz_active = false;
+static uint32_t oneshot_ticks = 0;
+static uint32_t oneshot_count = 0;
+static uint64_t nohz_entries = 0;
+
+/* Forward declarations for scheduler */
 extern void scheduler_tick(void);
+extern uint64_t scheduler_next_event(void);
+extern bool scheduler_tick_needed(void);
+extern void hrtimer_interrupt(void);
+extern uint64_t hrtimer_tick_deadline(void);
+
+/* Program the PIT */
+static void pit_program(uint8_t command, uint32_t count) {
+    outb(PIT_COMMAND, command);
+    outb(PIT_CHANNEL0, count & 0xFF);
+    outb(PIT_CHANNEL0, (count >> 8) & 0xFF);
+}
+
+/* Read the current channel 0 count */
+static uint32_t pit_read_count(void) {
+    outb(PIT_COMMAND, PIT_CMD_LATCH);
+    uint32_t lo = inb(PIT_CHANNEL0);
+    uint32_t hi = inb(PIT_CHANNEL0);
+    return (hi << 8) | lo;
+}
+
+/* Run PIT channel 2 (free of the tick on channel 0) down from count;
+ * OUT2 goes high at terminal count */
+static void pit_ch2_start(uint32_t count) {
+    uint8_t gate = inb(PIT_GATE);
+    outb(PIT_GATE, (gate & ~PIT_GATE_SPEAKER) | PIT_GATE_ENABLE);
+
+    /* Mode 0 starts counting once the count is loaded */
+    outb(PIT_COMMAND, PIT_CMD_CH2_ONESHOT);
+    outb(PIT_CHANNEL2, count & 0xFF);
+    outb(PIT_CHANNEL2, (count >> 8) & 0xFF);
+}
+
+static void pit_ch2_wait(void) {
+    while (!(inb(PIT_GATE) & PIT_GATE_OUT2)) {
+        cpu_relax();
+    }
+}
+
+/* Count the TSC while PIT channel 2 runs down ms milliseconds; returns
+ * the TSC rate in kHz */
+uint64_t timer_pit_measure_tsc_khz(uint32_t ms) {
+    uint32_t count = (uint32_t)((uint64_t)PIT_FREQUENCY * ms / 1000);
+    if (count == 0 || count > PIT_MAX_COUNT) return 0;
+
+    uint64_t flags = irq_save();
+    uint8_t gate = inb(PIT_GATE);
+    pit_ch2_start(count);
+    uint64_t tsc_start = rdtsc();
+    pit_ch2_wait();
+    uint64_t tsc_end = rdtsc();
+    outb(PIT_GATE, gate);
+    irq_restore(flags);
+
+    return (tsc_end - tsc_start) * PIT_FREQUENCY / ((uint64_t)count * 1000);
+}
+
+/* Local APIC timer counts elapsed over LAPIC_CALIBRATE_MS */
+static uint32_t lapic_measure_counts(void) {
+    uint32_t count = PIT_FREQUENCY * LAPIC_CALIBRATE_MS / 1000;
+
+    uint64_t flags = irq_save();
+    uint8_t gate = inb(PIT_GATE);
+    pit_ch2_start(count);
+    lapic_timer_oneshot(TIMER_VECTOR, LAPIC_MAX_COUNT);
+    pit_ch2_wait();
+    uint32_t elapsed = LAPIC_MAX_COUNT - lapic_timer_current();
+    lapic_timer_stop();
+    outb(PIT_GATE, gate);
+    irq_restore(flags);
+
+    return elapsed;
+}
+
+/* Deadline mode: arm the earlier of the tick and the pending event
+ * (bootstrap CPU, interrupts disabled) */
+static void deadline_program(void) {
+    uint64_t deadline = armed_tick;
+    uint64_t event = event_deadline;
+    if (event && event < deadline) {
+        deadline = event;
+    }
+    event_dirty = false;
+    lapic_timer_set_deadline(deadline);
+}
+
+/* Start the periodic tick on the selected device */
+static void tick_start_periodic(void) {
+    switch (tick_device) {
+        case TICK_PIT:
+            pit_program(PIT_CMD_PERIODIC, tick_divisor);
+            break;
+        case TICK_LAPIC:
+            lapic_timer_periodic(TIMER_VECTOR, lapic_tick_count);
+            break;
+        case TICK_TSC_DEADLINE:
+            /* A deadline already passed has raised its interrupt, whose
+             * handler arms the next one */
+            armed_tick = next_deadline;
+            if (next_deadline > rdtsc()) {
+                deadline_program();
+            }
+            break;
+    }
+}
 
 /* Timer interrupt handler (called from IRQ0) */
-void timer_interrupt_handler(void) {
+static void timer_interrupt_handler(void *ctx) {
+    (void)ctx;
+
+    /* Deadline mode is one-shot and shared with events: work out which
+     * came due, then arm the next tick on the grid (skipping ticks that
+     * were missed rather than firing them back to back) */
+    if (tick_device == TICK_TSC_DEADLINE) {
+        uint64_t now = rdtsc();
+        bool tick_due = now >= next_deadline;
+        if (tick_due) {
+            next_deadline += tick_cycles;
+            if (next_deadline <= now) {
+                next_deadline = now + tick_cycles;
+            }
+        }
+
+        uint64_t event = event_deadline;
+        bool event_due = event && now >= event;
+        if (event_due) {
+            __atomic_compare_exchange_n(&event_deadline, &event, 0, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        }
+        armed_tick = next_deadline;
+        deadline_program();
+
+        if (event_due) {
+            hrtimer_interrupt();
+        }
+        if (!tick_due) return;
+    } else if (!hpet_oneshot_available()) {
+        /* No one-shot event source: high-resolution timers expire at
+         * tick granularity */
+        hrtimer_interrupt();
+    }
+
     timer_ticks++;
-    
-    /* Call scheduler on every tick */
+    vdso_update(timer_ticks);
+
+    /* The scheduler tick runs as a bottom half; ticks that pile up
+     * behind it are charged once */
+    raise_softirq(SOFTIRQ_TIMER);
+}
+
+/* Timer bottom half: sleeper wakeups and time slice accounting */
+static void timer_softirq(void) {
     scheduler_tick();
 }
 
-/* Initialize timer */
+/* Initialize timer. With the IOAPIC in charge the bootstrap CPU's local
+ * APIC timer raises the tick (TSC-deadline mode when the TSC is
+ * invariant and calibrated); otherwise the PIT does. */
 void timer_init(uint32_t frequency) {
-    /* Calculate divisor */
-    uint32_t divisor = PIT_FREQUENCY / frequency;
+    tick_divisor = PIT_FREQUENCY / frequency;
+    tick_ns = 1000000000ULL / frequency;
+    tick_device = TICK_PIT;
 
-    /* Send command byte */
-    outb(PIT_COMMAND, 0x36);
+    if (ioapic_available() && lapic_available()) {
+        if (lapic_tsc_deadline_supported() && ktime_tsc_invariant() && ktime_tsc_khz()) {
+            tick_cycles = ktime_tsc_khz() * 1000 / frequency;
+            lapic_timer_deadline_mode(TIMER_VECTOR);
+            next_deadline = rdtsc() + tick_cycles;
+            tick_device = TICK_TSC_DEADLINE;
+        } else {
+            uint64_t counts = (uint64_t)lapic_measure_counts() * 1000 / LAPIC_CALIBRATE_MS;
+            lapic_tick_count = (uint32_t)(counts / frequency);
+            if (lapic_tick_count) {
+                tick_device = TICK_LAPIC;
+            }
+        }
+    }
 
-    /* Send divisor */
-    outb(PIT_CHANNEL0, divisor & 0xFF);
-    outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
+    /* The PIT's IRQ0 is only routed when it is the tick */
+    if (tick_device == TICK_PIT && ioapic_available()) {
+        ioapic_route_isa(0, TIMER_VECTOR, lapic_id());
+    }
 
     timer_ticks = 0;
+    nohz_active = false;
+    irq_register(TIMER_VECTOR, timer_interrupt_handler, NULL);
+    open_softirq(SOFTIRQ_TIMER, timer_softirq);
+    tick_start_periodic();
+
+    /* Publish the tick length for user-mode clock reads */
+    vdso_init((uint32_t)(1000000000ULL / frequency));
+}
+
+/* Whether the tick comes from the local APIC timer */
+bool timer_uses_lapic(void) {
+    return tick_device != TICK_PIT;
+}
+
+/* Most ticks one one-shot deadline can cover on the current device */
+static uint32_t tick_max_oneshot(void) {
+    switch (tick_device) {
+        case TICK_PIT:   return PIT_MAX_COUNT / tick_divisor;
+        case TICK_LAPIC: return LAPIC_MAX_COUNT / lapic_tick_count;
+        default:         return 0xFFFFFFFFU;
+    }
+}
+
+/* Stop the periodic tick before the bootstrap CPU idles (interrupts
+ * disabled). The next wakeup is programmed as a one-shot deadline. */
+void timer_nohz_enter(void) {
+    if (nohz_active || tick_divisor == 0) return;
+    if (this_cpu()->id != 0) return;   /* Only the bootstrap CPU owns the tick */
+    if (scheduler_tick_needed()) return;
+
+    uint32_t max_ticks = tick_max_oneshot();
+    uint64_t now = timer_ticks;
+    uint64_t next = scheduler_next_event();
+    uint64_t delta = (next > now) ? next - now : 0;
+    if (next == 0 || delta > max_ticks) {
+        delta = max_ticks;
+    }
+
+    /* High-resolution timers polled from the tick: wake for the tick
+     * that catches the earliest one */
+    uint64_t hr_expires = hrtimer_tick_deadline();
+    if (hr_expires) {
+        uint64_t now_ns = ktime_ns();
+        uint64_t hr_delta = hr_expires > now_ns ? (hr_expires - now_ns + tick_ns - 1) / tick_ns : 0;
+        if (hr_delta < delta) {
+            delta = hr_delta;
+        }
+    }
+
+    /* A deadline at the next tick gains nothing */
+    if (delta <= 1) return;
+
+    oneshot_ticks = (uint32_t)delta;
+    switch (tick_device) {
+        case TICK_PIT:
+            oneshot_count = oneshot_ticks * tick_divisor;
+            pit_program(PIT_CMD_ONESHOT, oneshot_count);
+            break;
+        case TICK_LAPIC:
+            oneshot_count = oneshot_ticks * lapic_tick_count;
+            lapic_timer_oneshot(TIMER_VECTOR, oneshot_count);
+            break;
+        case TICK_TSC_DEADLINE:
+            /* next_deadline is the next tick; skip the ones in between */
+            armed_tick = next_deadline + (delta - 1) * tick_cycles;
+            deadline_program();
+            break;
+    }
+    nohz_active = true;
+    nohz_entries++;
+}
+
+/* Whole ticks that passed during a one-shot wait. When the deadline was
+ * reached the pending tick interrupt accounts for the final one. */
+static uint32_t tick_oneshot_elapsed(void) {
+    switch (tick_device) {
+        case TICK_PIT: {
+            uint32_t count = pit_read_count();
+            /* Mode 0 keeps counting past zero */
+            if (count == 0 || count > oneshot_count) return oneshot_ticks - 1;
+            /* Woken early: whole ticks only, the partial one is dropped */
+            return (oneshot_count - count) / tick_divisor;
+        }
+        case TICK_LAPIC: {
+            uint32_t count = lapic_timer_current();
+            if (count == 0) return oneshot_ticks - 1;
+            return (oneshot_count - count) / lapic_tick_count;
+        }
+        case TICK_TSC_DEADLINE: {
+            /* Stay on the tick grid, so no partial tick is lost */
+            uint64_t now = rdtsc();
+            if (now < next_deadline) return 0;
+            uint64_t passed = (now - next_deadline) / tick_cycles + 1;
+            if (passed >= oneshot_ticks) {
+                next_deadline += (uint64_t)(oneshot_ticks - 1) * tick_cycles;
+                return oneshot_ticks - 1;
+            }
+            next_deadline += passed * tick_cycles;
+            return (uint32_t)passed;
+        }
+    }
+    return 0;
+}
+
+/* Restart the periodic tick and account for the time spent idle. Called
+ * on interrupt entry, so the waking handler already sees current ticks. */
+void timer_nohz_exit(void) {
+    if (!nohz_active) return;
+
+    uint64_t flags = irq_save();
+    if (nohz_active && this_cpu()->id == 0) {
+        timer_ticks += tick_oneshot_elapsed();
+        vdso_update(timer_ticks);
+        tick_start_periodic();
+        nohz_active = false;
+    }
+    irq_restore(flags);
+}
+
+/* Whether the tick device can also raise one-shot events */
+bool timer_event_capable(void) {
+    return tick_device == TICK_TSC_DEADLINE;
+}
+
+/* Raise hrtimer_interrupt() on the bootstrap CPU once the TSC reaches
+ * tsc (0 cancels). From another CPU the bootstrap CPU is kicked to
+ * program it. */
+void timer_set_event(uint64_t tsc) {
+    if (tick_device != TICK_TSC_DEADLINE) return;
+
+    uint64_t flags = irq_save();
+    event_deadline = tsc;
+    if (this_cpu()->id == 0) {
+        deadline_program();
+    } else {
+        event_dirty = true;
+        smp_send_resched(smp_get_cpu(0));
+    }
+    irq_restore(flags);
+}
+
+/* Program an event recorded by another CPU (bootstrap CPU, interrupt entry) */
+void timer_event_sync(void) {
+    if (!event_dirty || this_cpu()->id != 0) return;
+
+    uint64_t flags = irq_save();
+    if (event_dirty) {
+        deadline_program();
+    }
+    irq_restore(flags);
+}
+
+/* Whether the periodic tick is currently stopped */
+bool timer_nohz_active(void) {
+    return nohz_active;
+}
+
+/* Number of times the periodic tick was stopped */
+uint64_t timer_get_nohz_entries(void) {
+    return nohz_entries;
 }
 
 /* Get timer ticks */
@@ -46,10 +445,12 @@ uint64_t timer_get_ticks(void) {
     return timer_ticks;
 }
 
-/* Wait for specified milliseconds */
+/* Wait for specified milliseconds (sleeps the calling task) */
 void timer_wait(uint32_t ms) {
     uint64_t target = timer_ticks + ms;
-    while (timer_ticks < target) {
-        __asm__ volatile ("hlt");
+    for (;;) {
+        uint64_t now = timer_ticks;
+        if (now >= target) break;
+        process_sleep(target - now);
     }
 }
@@ -12,6 +12,7 @@ extern void app_editor_create(void);
 extern void app_settings_create(void);
 extern void app_files_create(void);
 extern void app_game_create(void);
+extern void app_top_create(void);
 
 /* Maximum number of windows */
 #define MAX_WINDOWS 16
@@ -293,10 +294,11 @@ static void gui_draw_launcher(void) {
         "Text Editor",
         "Settings",
         "File Manager",
-        "Demo Game"
+        "Demo Game",
+        "Task Monitor"
     };
 
-    for (int i = 0; i < 5; i++) {
+    for (int i = 0; i < 6; i++) {
         fb_draw_string(menu_x + 10, menu_y + 10 + i * 30, items[i], COLOR_WHITE);
     }
 }
@@ -382,7 +384,7 @@ static void handle_mouse_press(int mx, int my) {
 
         if (mx >= menu_x && mx <= menu_x + menu_width && my >= menu_y) {
             int item_index = (my - menu_y - 10) / 30;
-            if (item_index >= 0 && item_index < 5) {
+            if (item_index >= 0 && item_index < 6) {
                 launcher_open = false;
                 switch (item_index) {
                     case 0: app_terminal_create(); break;
@@ -390,6 +392,7 @@ static void handle_mouse_press(int mx, int my) {
                     case 2: app_settings_create(); break;
                     case 3: app_files_create(); break;
                     case 4: app_game_create(); break;
+                    case 5: app_top_create(); break;
                 }
                 return;
             }
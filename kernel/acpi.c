@@ -0,0 +1,196 @@
+#include "acpi.h"
+#include "paging.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Root System Description Pointer (ACPI 2.0+ fields follow rsdt_address) */
+typedef struct {
+    char signature[8];          /* "RSD PTR " */
+    uint8_t checksum;           /* Covers the first 20 bytes */
+    char oem_id[6];
+    uint8_t revision;           /* 0 = ACPI 1.0 (RSDT only) */
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+/* MADT: fixed fields, then variable-length entries */
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t lapic_address;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt_t;
+
+#define MADT_FLAG_PCAT_COMPAT 0x1
+
+/* MADT entry types */
+#define MADT_LAPIC          0
+#define MADT_IOAPIC         1
+#define MADT_IRQ_OVERRIDE   2
+#define MADT_LAPIC_ADDRESS  5
+
+#define MADT_LAPIC_ENABLED  0x1
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) madt_entry_t;
+
+typedef struct {
+    madt_entry_t entry;
+    uint8_t processor_id;
+    uint8_t apic_id;
+    uint32_t flags;
+} __attribute__((packed)) madt_lapic_t;
+
+typedef struct {
+    madt_entry_t entry;
+    uint8_t id;
+    uint8_t reserved;
+    uint32_t address;
+    uint32_t gsi_base;
+} __attribute__((packed)) madt_ioapic_t;
+
+typedef struct {
+    madt_entry_t entry;
+    uint8_t bus;
+    uint8_t source;
+    uint32_t gsi;
+    uint16_t flags;
+} __attribute__((packed)) madt_irq_override_t;
+
+typedef struct {
+    madt_entry_t entry;
+    uint16_t reserved;
+    uint64_t address;
+} __attribute__((packed)) madt_lapic_address_t;
+
+/* Root table: an array of 32-bit (RSDT) or 64-bit (XSDT) table addresses */
+static const acpi_sdt_header_t *root_table = NULL;
+static bool root_is_xsdt = false;
+
+/* Bytes of a table sum to zero */
+static bool acpi_checksum_ok(const void *table, uint32_t length) {
+    const uint8_t *bytes = (const uint8_t *)table;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+static bool acpi_signature_equal(const char *a, const char *b, int len) {
+    for (int i = 0; i < len; i++) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+bool acpi_init(void *rsdp_ptr) {
+    const acpi_rsdp_t *rsdp = (const acpi_rsdp_t *)rsdp_ptr;
+    if (!rsdp || !acpi_signature_equal(rsdp->signature, "RSD PTR ", 8) ||
+        !acpi_checksum_ok(rsdp, 20)) {
+        return false;
+    }
+
+    /* Prefer the XSDT when the firmware provides one */
+    const acpi_sdt_header_t *root;
+    if (rsdp->revision >= 2 && rsdp->xsdt_address &&
+        acpi_checksum_ok(rsdp, rsdp->length)) {
+        root = (const acpi_sdt_header_t *)phys_to_virt(rsdp->xsdt_address);
+        root_is_xsdt = true;
+    } else {
+        root = (const acpi_sdt_header_t *)phys_to_virt(rsdp->rsdt_address);
+        root_is_xsdt = false;
+    }
+
+    if (!acpi_checksum_ok(root, root->length)) {
+        return false;
+    }
+    root_table = root;
+    return true;
+}
+
+bool acpi_available(void) {
+    return root_table != NULL;
+}
+
+const acpi_sdt_header_t *acpi_find_table(const char *signature) {
+    if (!root_table) return NULL;
+
+    uint32_t entry_size = root_is_xsdt ? 8 : 4;
+    uint32_t count = (root_table->length - sizeof(acpi_sdt_header_t)) / entry_size;
+    const uint8_t *entries = (const uint8_t *)(root_table + 1);
+
+    for (uint32_t i = 0; i < count; i++) {
+        /* Entries are not naturally aligned in the RSDT/XSDT */
+        uint64_t phys = 0;
+        for (uint32_t b = 0; b < entry_size; b++) {
+            phys |= (uint64_t)entries[i * entry_size + b] << (b * 8);
+        }
+        if (!phys) continue;
+
+        const acpi_sdt_header_t *table = (const acpi_sdt_header_t *)phys_to_virt(phys);
+        if (acpi_signature_equal(table->signature, signature, 4) &&
+            acpi_checksum_ok(table, table->length)) {
+            return table;
+        }
+    }
+    return NULL;
+}
+
+bool acpi_parse_madt(acpi_madt_info_t *info) {
+    const acpi_madt_t *madt = (const acpi_madt_t *)acpi_find_table("APIC");
+    if (!madt) return false;
+
+    info->lapic_address = madt->lapic_address;
+    info->legacy_pics = (madt->flags & MADT_FLAG_PCAT_COMPAT) != 0;
+    info->cpu_count = 0;
+    info->ioapic_count = 0;
+    info->override_count = 0;
+
+    const uint8_t *pos = (const uint8_t *)(madt + 1);
+    const uint8_t *end = (const uint8_t *)madt + madt->header.length;
+    while (pos + sizeof(madt_entry_t) <= end) {
+        const madt_entry_t *entry = (const madt_entry_t *)pos;
+        if (entry->length < sizeof(madt_entry_t) || pos + entry->length > end) break;
+
+        switch (entry->type) {
+            case MADT_LAPIC: {
+                const madt_lapic_t *lapic = (const madt_lapic_t *)entry;
+                if (lapic->flags & MADT_LAPIC_ENABLED) info->cpu_count++;
+                break;
+            }
+            case MADT_IOAPIC: {
+                const madt_ioapic_t *io = (const madt_ioapic_t *)entry;
+                if (info->ioapic_count < ACPI_MAX_IOAPICS) {
+                    acpi_ioapic_info_t *out = &info->ioapics[info->ioapic_count++];
+                    out->id = io->id;
+                    out->address = io->address;
+                    out->gsi_base = io->gsi_base;
+                }
+                break;
+            }
+            case MADT_IRQ_OVERRIDE: {
+                const madt_irq_override_t *iso = (const madt_irq_override_t *)entry;
+                if (iso->bus == 0 && info->override_count < ACPI_MAX_OVERRIDES) {
+                    acpi_irq_override_t *out = &info->overrides[info->override_count++];
+                    out->source = iso->source;
+                    out->gsi = iso->gsi;
+                    out->flags = iso->flags;
+                }
+                break;
+            }
+            case MADT_LAPIC_ADDRESS: {
+                const madt_lapic_address_t *addr = (const madt_lapic_address_t *)entry;
+                info->lapic_address = addr->address;
+                break;
+            }
+        }
+        pos += entry->length;
+    }
+    return true;
+}
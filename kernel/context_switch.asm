@@ -1,5 +1,10 @@
 ; Context switching for x86_64
 ; void context_switch(cpu_context_t *old_context, cpu_context_t *new_context);
+;
+; Only called from C (the scheduler) with interrupts disabled, so just the
+; callee-saved registers are live across it. RFLAGS is not switched: every
+; task passes through here with IF clear and restores its own flags after
+; returning. CR3 is written only when the address space changes.
 
 section .text
 global context_switch
@@ -8,78 +13,50 @@ context_switch:
     ; Save old context (if not NULL)
     test rdi, rdi
     jz .load_new
-    
-    ; Save general purpose registers
-    mov [rdi + 0], rax
-    mov [rdi + 8], rbx
-    mov [rdi + 16], rcx
-    mov [rdi + 24], rdx
-    mov [rdi + 32], rsi
-    mov [rdi + 40], rdi
-    mov [rdi + 48], rbp
-    mov [rdi + 56], rsp
-    mov [rdi + 64], r8
-    mov [rdi + 72], r9
-    mov [rdi + 80], r10
-    mov [rdi + 88], r11
-    mov [rdi + 96], r12
-    mov [rdi + 104], r13
-    mov [rdi + 112], r14
-    mov [rdi + 120], r15
-    
-    ; Save instruction pointer (return address)
+
+    ; Save callee-saved registers
+    mov [rdi + 0], rbx
+    mov [rdi + 8], rbp
+    mov [rdi + 16], r12
+    mov [rdi + 24], r13
+    mov [rdi + 32], r14
+    mov [rdi + 40], r15
+
+    ; Resume at our return address with the stack as after a return
     mov rax, [rsp]
-    mov [rdi + 128], rax
-    
-    ; Save flags
-    pushfq
-    pop rax
-    mov [rdi + 136], rax
-    
+    mov [rdi + 56], rax
+    lea rax, [rsp + 8]
+    mov [rdi + 48], rax
+
     ; Save CR3 (page table)
     mov rax, cr3
-    mov [rdi + 144], rax
-    
+    mov [rdi + 64], rax
+
 .load_new:
     ; Load new context
     test rsi, rsi
     jz .done
-    
-    ; Load CR3 (page table)
-    mov rax, [rsi + 144]
-    mov cr3, rax
-    
-    ; Load flags
-    mov rax, [rsi + 136]
-    push rax
-    popfq
-    
-    ; Load general purpose registers
-    mov rax, [rsi + 0]
-    mov rbx, [rsi + 8]
-    mov rcx, [rsi + 16]
-    mov rdx, [rsi + 24]
-    mov rdi, [rsi + 40]
-    mov rbp, [rsi + 48]
-    mov rsp, [rsi + 56]
-    mov r8, [rsi + 64]
-    mov r9, [rsi + 72]
-    mov r10, [rsi + 80]
-    mov r11, [rsi + 88]
-    mov r12, [rsi + 96]
-    mov r13, [rsi + 104]
-    mov r14, [rsi + 112]
-    mov r15, [rsi + 120]
-    
-    ; Load instruction pointer
-    mov rax, [rsi + 128]
-    push rax
-    
-    ; Load RSI last
-    mov rsi, [rsi + 32]
-    
-    ; Return to new context
-    ret
-    
+
+    ; Load CR3 only if it differs (kernel threads share one), which
+    ; keeps the TLB warm
+    mov rax, cr3
+    mov rdx, [rsi + 64]
+    cmp rax, rdx
+    je .same_space
+    mov cr3, rdx
+
+.same_space:
+    ; Load callee-saved registers and the new stack
+    mov rbx, [rsi + 0]
+    mov rbp, [rsi + 8]
+    mov r12, [rsi + 16]
+    mov r13, [rsi + 24]
+    mov r14, [rsi + 32]
+    mov r15, [rsi + 40]
+    mov rsp, [rsi + 48]
+
+    ; Continue at the saved instruction pointer
+    jmp [rsi + 56]
+
 .done:
     ret
@@ -0,0 +1,145 @@
+#include "elf.h"
+#include "vma.h"
+#include "process.h"
+#include "paging.h"
+#include "syscall.h"
+#include "vfs.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Check that a header describes an x86_64 executable we can load */
+static bool elf_check_header(const elf64_ehdr_t *eh) {
+    uint32_t magic = (uint32_t)eh->e_ident[0] | ((uint32_t)eh->e_ident[1] << 8) |
+                     ((uint32_t)eh->e_ident[2] << 16) | ((uint32_t)eh->e_ident[3] << 24);
+
+    return magic == ELF_MAGIC &&
+           eh->e_ident[4] == ELF_CLASS_64 &&
+           eh->e_ident[5] == ELF_DATA_LSB &&
+           eh->e_type == ELF_TYPE_EXEC &&
+           eh->e_machine == ELF_MACHINE_X86_64 &&
+           eh->e_phentsize == sizeof(elf64_phdr_t) &&
+           eh->e_phnum > 0 && eh->e_phnum <= ELF_MAX_PHDRS;
+}
+
+/* A loadable segment must fit in user space with its file offset and
+ * address agreeing within a page, so pages can be filled from the file */
+static bool elf_check_segment(const elf64_phdr_t *ph) {
+    return ph->p_filesz <= ph->p_memsz &&
+           ph->p_memsz > 0 &&
+           ph->p_vaddr >= USER_SPACE_BASE &&
+           ph->p_vaddr + ph->p_memsz <= USER_STACK_TOP - USER_STACK_SIZE &&
+           ph->p_vaddr + ph->p_memsz > ph->p_vaddr &&
+           ph->p_offset + ph->p_filesz <= 0xFFFFFFFF &&
+           (ph->p_vaddr % PAGE_SIZE) == (ph->p_offset % PAGE_SIZE);
+}
+
+/* user_enter has no canonical-address check before SYSRET, so the entry
+ * point must lie in an executable segment (which elf_check_segment keeps
+ * inside user space) */
+static bool elf_entry_in_segment(uint64_t entry, const elf64_phdr_t *ph) {
+    return (ph->p_flags & PF_X) &&
+           entry >= ph->p_vaddr && entry - ph->p_vaddr < ph->p_memsz;
+}
+
+static uint32_t elf_vma_flags(uint32_t p_flags) {
+    uint32_t flags = 0;
+    if (p_flags & PF_R) flags |= VMA_READ;
+    if (p_flags & PF_W) flags |= VMA_WRITE;
+    if (p_flags & PF_X) flags |= VMA_EXEC;
+    return flags;
+}
+
+/* Load an executable into the current (single-threaded) process: only
+ * the headers are read here. Each PT_LOAD segment becomes a region whose
+ * pages are read from the file on first touch, so startup cost follows
+ * the code actually used rather than the size of the binary. path is
+ * kernel memory; SYS_EXEC copies and checks the user's string. */
+int elf_exec(const char *path) {
+    process_t *current = process_get_current();
+    if (!current || !current->mm || current->kernel_thread || current->mm->users > 1) {
+        return -1;
+    }
+    mm_t *mm = current->mm;
+
+    /* Keep the name now: path may point into the image torn down below */
+    char name[sizeof(current->name)];
+    const char *base = path;
+    for (const char *p = path; *p; p++) {
+        if (*p == '/') base = p + 1;
+    }
+    uint32_t n = 0;
+    while (base[n] && n < sizeof(name) - 1) {
+        name[n] = base[n];
+        n++;
+    }
+    name[n] = '\0';
+
+    int fd = vfs_open(path);
+    if (fd < 0) return -1;
+
+    /* Validate everything before touching the old image */
+    elf64_ehdr_t eh;
+    elf64_phdr_t phdrs[ELF_MAX_PHDRS];
+    if (vfs_pread(fd, &eh, sizeof(eh), 0) != (int)sizeof(eh) || !elf_check_header(&eh)) {
+        vfs_close(fd);
+        return -1;
+    }
+
+    uint32_t phdrs_size = eh.e_phnum * sizeof(elf64_phdr_t);
+    if (eh.e_phoff > 0xFFFFFFFF ||
+        vfs_pread(fd, phdrs, phdrs_size, (uint32_t)eh.e_phoff) != (int)phdrs_size) {
+        vfs_close(fd);
+        return -1;
+    }
+
+    uint32_t loads = 0;
+    bool entry_ok = false;
+    for (uint32_t i = 0; i < eh.e_phnum; i++) {
+        if (phdrs[i].p_type != PT_LOAD) continue;
+        if (!elf_check_segment(&phdrs[i])) {
+            vfs_close(fd);
+            return -1;
+        }
+        if (elf_entry_in_segment(eh.e_entry, &phdrs[i])) {
+            entry_ok = true;
+        }
+        loads++;
+    }
+    if (loads == 0 || loads >= MM_MAX_VMAS || !entry_ok ||
+        eh.e_entry >= USER_STACK_TOP - USER_STACK_SIZE) {
+        vfs_close(fd);
+        return -1;
+    }
+
+    /* Point of no return: drop the old image and describe the new one */
+    vma_clear(mm);
+    mm->exec_fd = fd;
+    current->user_stack = 0;   /* Went with the old image */
+
+    bool ok = true;
+    for (uint32_t i = 0; i < eh.e_phnum && ok; i++) {
+        const elf64_phdr_t *ph = &phdrs[i];
+        if (ph->p_type != PT_LOAD) continue;
+        ok = vma_add(mm, ph->p_vaddr, ph->p_memsz, ph->p_offset, ph->p_filesz,
+                     elf_vma_flags(ph->p_flags));
+    }
+    if (ok) {
+        ok = vma_add(mm, USER_STACK_TOP - USER_STACK_SIZE, USER_STACK_SIZE, 0, 0,
+                     VMA_READ | VMA_WRITE);
+    }
+    if (!ok) {
+        /* Overlapping segments: nothing left to return to */
+        vma_clear(mm);
+        process_exit(-1);
+        return -1;   /* Not reached */
+    }
+
+    /* Name the process after the file */
+    for (n = 0; n < sizeof(name); n++) {
+        current->name[n] = name[n];
+    }
+
+    thread_set_tls(0);
+    process_account_syscall_exit();
+    user_enter(eh.e_entry, USER_STACK_TOP, 0);
+}
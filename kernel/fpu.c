@@ -0,0 +1,222 @@
+#include "fpu.h"
+#include "cpu.h"
+#include "memory.h"
+#include "process.h"
+#include "smp.h"
+#include "kernel.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* XCR0 state components */
+#define XCR0_X87  (1ULL << 0)
+#define XCR0_SSE  (1ULL << 1)
+#define XCR0_AVX  (1ULL << 2)
+
+/* FXSAVE area size and XSAVE alignment */
+#define FXSAVE_SIZE 512
+#define FPU_ALIGN   64
+
+/* FPU state */
+static bool fpu_ready = false;
+static bool use_xsave = false;
+static uint32_t fpu_state_size = FXSAVE_SIZE;
+static uint64_t xsave_mask = XCR0_X87 | XCR0_SSE;
+
+/* Clean state image copied into every new task */
+static uint8_t *fpu_initial_state = NULL;
+
+/* Set CR0.TS so the next FPU/SSE instruction raises #NM */
+static inline void stts(void) {
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+/* Save FPU registers to a state area */
+static void fpu_save(void *state) {
+    if (use_xsave) {
+        __asm__ volatile ("xsave64 (%0)"
+                          :: "r"(state), "a"((uint32_t)xsave_mask), "d"((uint32_t)(xsave_mask >> 32))
+                          : "memory");
+    } else {
+        __asm__ volatile ("fxsave64 (%0)" :: "r"(state) : "memory");
+    }
+}
+
+/* Restore FPU registers from a state area */
+static void fpu_restore(const void *state) {
+    if (use_xsave) {
+        __asm__ volatile ("xrstor64 (%0)"
+                          :: "r"(state), "a"((uint32_t)xsave_mask), "d"((uint32_t)(xsave_mask >> 32))
+                          : "memory");
+    } else {
+        __asm__ volatile ("fxrstor64 (%0)" :: "r"(state) : "memory");
+    }
+}
+
+/* Program CR0, CR4 and XCR0 on the calling CPU (features detected by fpu_init) */
+void fpu_init_cpu(void) {
+    /* Native x87 with monitoring, no emulation */
+    uint64_t cr0 = read_cr0();
+    cr0 &= ~CR0_EM;
+    cr0 |= CR0_MP | CR0_NE;
+    write_cr0(cr0);
+
+    /* Enable SSE and SSE exceptions */
+    uint64_t cr4 = read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT;
+    if (use_xsave) {
+        cr4 |= CR4_OSXSAVE;
+    }
+    write_cr4(cr4);
+
+    if (use_xsave) {
+        xsetbv(0, xsave_mask);
+    }
+
+    clts();
+    __asm__ volatile ("fninit");
+
+    /* Nobody owns the registers yet: trap on first use */
+    this_cpu()->fpu_owner = NULL;
+    stts();
+}
+
+/* Initialize FPU, SSE and (if present) XSAVE on the bootstrap CPU */
+void fpu_init(void) {
+    uint32_t ecx;
+    cpuid(1, 0, NULL, NULL, &ecx, NULL);
+
+    if (ecx & CPUID_ECX_XSAVE) {
+        xsave_mask = XCR0_X87 | XCR0_SSE;
+        if (ecx & CPUID_ECX_AVX) {
+            xsave_mask |= XCR0_AVX;
+        }
+        use_xsave = true;
+    }
+
+    fpu_init_cpu();
+
+    if (use_xsave) {
+        /* Size of the XSAVE area for the enabled components */
+        uint32_t ebx;
+        cpuid(0xD, 0, NULL, &ebx, NULL, NULL);
+        fpu_state_size = ebx;
+    }
+
+    /* Capture a clean register image for new tasks */
+    clts();
+    __asm__ volatile ("fninit");
+    fpu_ready = true;
+    fpu_initial_state = (uint8_t *)fpu_state_alloc();
+    if (fpu_initial_state) {
+        fpu_save(fpu_initial_state);
+    }
+    stts();
+}
+
+/* Allocate a 64-byte aligned state area (the raw pointer is stored just below it) */
+void *fpu_state_alloc(void) {
+    if (!fpu_ready) return NULL;
+
+    uint8_t *raw = (uint8_t *)kmalloc(fpu_state_size + FPU_ALIGN + sizeof(void *));
+    if (!raw) return NULL;
+
+    uintptr_t aligned = ((uintptr_t)raw + sizeof(void *) + FPU_ALIGN - 1) & ~(uintptr_t)(FPU_ALIGN - 1);
+    ((void **)aligned)[-1] = raw;
+
+    if (fpu_initial_state) {
+        memcpy((void *)aligned, fpu_initial_state, fpu_state_size);
+    } else {
+        memset((void *)aligned, 0, fpu_state_size);
+    }
+    return (void *)aligned;
+}
+
+/* Free a state area allocated with fpu_state_alloc() */
+void fpu_state_free(void *state) {
+    if (!state) return;
+    kfree(((void **)state)[-1]);
+}
+
+/* Forget a task's live register state (called before it is destroyed) */
+void fpu_release(process_t *proc) {
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        cpu_t *cpu = smp_get_cpu(i);
+        process_t *expected = proc;
+        if (__atomic_compare_exchange_n(&cpu->fpu_owner, &expected, NULL, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) &&
+            cpu == this_cpu()) {
+            stts();
+        }
+    }
+}
+
+/* Task switch hook: only grant the FPU if the incoming task already owns it */
+void fpu_switch_to(process_t *next) {
+    if (!fpu_ready) return;
+
+    if (next && next == this_cpu()->fpu_owner) {
+        clts();
+    } else {
+        stts();
+    }
+}
+
+/* Device-not-available (#NM) handler: perform the deferred save/restore */
+void fpu_handle_nm(void) {
+    cpu_t *cpu = this_cpu();
+    process_t *current = cpu->current;
+    process_t *owner = cpu->fpu_owner;
+
+    clts();
+
+    if (owner == current) {
+        return;
+    }
+
+    if (owner && owner->fpu_state) {
+        fpu_save(owner->fpu_state);
+    }
+
+    if (current && current->fpu_state) {
+        fpu_restore(current->fpu_state);
+        cpu->fpu_owner = current;
+    } else {
+        /* Untracked context (e.g. boot code): start from a clean state */
+        if (fpu_initial_state) {
+            fpu_restore(fpu_initial_state);
+        }
+        cpu->fpu_owner = NULL;
+    }
+}
+
+/* Begin a kernel SIMD section */
+void kernel_fpu_begin(void) {
+    uint64_t flags = irq_save();
+    cpu_t *cpu = this_cpu();
+    if (cpu->kernel_fpu_depth++) {
+        kernel_panic("kernel_fpu_begin: nested kernel SIMD section");
+    }
+    cpu->kernel_fpu_flags = flags;
+    clts();
+
+    /* Preserve the owner's registers before the kernel clobbers them */
+    if (cpu->fpu_owner && cpu->fpu_owner->fpu_state) {
+        fpu_save(cpu->fpu_owner->fpu_state);
+    }
+    cpu->fpu_owner = NULL;
+}
+
+/* End a kernel SIMD section */
+void kernel_fpu_end(void) {
+    cpu_t *cpu = this_cpu();
+    if (cpu->kernel_fpu_depth != 1) {
+        kernel_panic("kernel_fpu_end: no kernel SIMD section open");
+    }
+    cpu->kernel_fpu_depth = 0;
+    stts();
+    irq_restore(cpu->kernel_fpu_flags);
+}
+
+/* Whether SIMD sections can be used */
+bool fpu_simd_available(void) {
+    return fpu_ready;
+}
@@ -0,0 +1,156 @@
+#include "futex.h"
+#include "process.h"
+#include "paging.h"
+#include "spinlock.h"
+#include "uaccess.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A task sleeping on a futex (lives on the waiter's stack) */
+typedef struct futex_waiter {
+    process_t *task;
+    uint64_t key;
+    struct futex_waiter *next;
+    bool queued;
+} futex_waiter_t;
+
+typedef struct {
+    spinlock_t lock;
+    futex_waiter_t *head;
+} futex_bucket_t;
+
+/* Waiters hashed by key; a bucket's lock also orders the value check in
+ * futex_wait() against wakers */
+static futex_bucket_t futex_table[FUTEX_HASH_BUCKETS];
+
+/* Physical address of the futex word, so processes mapping the same
+ * memory at different addresses meet on the same key */
+static uint64_t futex_key(volatile uint32_t *uaddr) {
+    if (((uint64_t)uaddr & 3) != 0) return 0;
+    return vmm_virt_to_phys((uint64_t)uaddr);
+}
+
+static futex_bucket_t *futex_bucket(uint64_t key) {
+    uint64_t hash = (key >> 2) * 0x9E3779B97F4A7C15ULL;
+    return &futex_table[(hash >> 32) & (FUTEX_HASH_BUCKETS - 1)];
+}
+
+/* Current value of the word: user addresses go through the checked copy
+ * (SYS_FUTEX admits nothing else); kernel callers such as the boot
+ * self-test use kernel memory. 0 on success, -1 on a bad address. */
+static int futex_read(volatile uint32_t *uaddr, uint32_t *value) {
+    if ((uint64_t)uaddr >= USER_SPACE_END) {
+        *value = __atomic_load_n(uaddr, __ATOMIC_RELAXED);
+        return 0;
+    }
+    return copy_from_user(value, (uint64_t)uaddr, sizeof(*value));
+}
+
+/* The same under the bucket lock, where nothing may fault (the fault
+ * path can sleep on disk I/O): a user word is read through the direct
+ * map of its frame. -1 if the page is gone or no longer the keyed frame;
+ * the caller then faults it in again outside the lock. */
+static int futex_read_locked(volatile uint32_t *uaddr, uint64_t key, uint32_t *value) {
+    if ((uint64_t)uaddr >= USER_SPACE_END) {
+        *value = __atomic_load_n(uaddr, __ATOMIC_RELAXED);
+        return 0;
+    }
+    uint64_t phys = vmm_virt_to_phys((uint64_t)uaddr);
+    if (phys != key) return -1;
+    *value = __atomic_load_n((volatile uint32_t *)phys_to_virt(phys), __ATOMIC_RELAXED);
+    return 0;
+}
+
+/* Unlink a waiter (bucket lock held) */
+static void futex_unlink(futex_bucket_t *bucket, futex_waiter_t *waiter) {
+    for (futex_waiter_t **link = &bucket->head; *link; link = &(*link)->next) {
+        if (*link == waiter) {
+            *link = waiter->next;
+            break;
+        }
+    }
+    waiter->next = NULL;
+    waiter->queued = false;
+}
+
+int futex_wait(volatile uint32_t *uaddr, uint32_t expected, uint64_t timeout) {
+    process_t *current = process_get_current();
+    if (!current || !uaddr) return -1;
+
+    /* Check and queue under the bucket lock: a waker that changes the
+     * value first and then takes the lock cannot miss us. The word is
+     * read first without the lock so a lazily mapped page is faulted in
+     * (a bad address fails there), and again if the page went away
+     * before the lock was taken. */
+    uint32_t value;
+    uint64_t key;
+    uint64_t flags;
+    futex_bucket_t *bucket;
+    for (;;) {
+        if (futex_read(uaddr, &value) != 0 || value != expected) {
+            return -1;
+        }
+        key = futex_key(uaddr);
+        if (!key) return -1;
+        bucket = futex_bucket(key);
+
+        flags = spin_lock_irqsave(&bucket->lock);
+        if (futex_read_locked(uaddr, key, &value) == 0) {
+            break;
+        }
+        spin_unlock_irqrestore(&bucket->lock, flags);
+    }
+    if (value != expected) {
+        spin_unlock_irqrestore(&bucket->lock, flags);
+        return -1;
+    }
+
+    futex_waiter_t waiter = { current, key, NULL, false };
+    futex_waiter_t **tail = &bucket->head;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = &waiter;
+    waiter.queued = true;
+    process_set_blocked(timeout);
+    spin_unlock_irqrestore(&bucket->lock, flags);
+
+    schedule();
+
+    /* Still queued means nobody woke us: timeout */
+    int result = 0;
+    flags = spin_lock_irqsave(&bucket->lock);
+    if (waiter.queued) {
+        futex_unlink(bucket, &waiter);
+        result = -1;
+    }
+    spin_unlock_irqrestore(&bucket->lock, flags);
+
+    process_set_running();
+    return result;
+}
+
+int futex_wake(volatile uint32_t *uaddr, uint32_t count) {
+    uint64_t key = futex_key(uaddr);
+    if (!key || count == 0) return 0;
+    futex_bucket_t *bucket = futex_bucket(key);
+
+    int woken = 0;
+    uint64_t flags = spin_lock_irqsave(&bucket->lock);
+    futex_waiter_t **link = &bucket->head;
+    while (*link && (uint32_t)woken < count) {
+        futex_waiter_t *waiter = *link;
+        if (waiter->key != key) {
+            link = &waiter->next;
+            continue;
+        }
+        *link = waiter->next;
+        waiter->next = NULL;
+        waiter->queued = false;
+        process_wake(waiter->task);
+        woken++;
+    }
+    spin_unlock_irqrestore(&bucket->lock, flags);
+    return woken;
+}
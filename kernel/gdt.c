@@ -1,4 +1,5 @@
 #include "gdt.h"
+#include "smp.h"
 #include <stdint.h>
 
 /* GDT entry structure */
@@ -17,8 +18,11 @@ struct gdt_ptr {
     uint64_t base;
 } __attribute__((packed));
 
-/* GDT with 5 entries */
-static struct gdt_entry gdt[5];
+/* GDT: 5 segment descriptors, then a two-slot TSS descriptor per CPU */
+#define GDT_SEGMENTS 5
+#define GDT_ENTRIES  (GDT_SEGMENTS + 2 * MAX_CPUS)
+
+static struct gdt_entry gdt[GDT_ENTRIES];
 static struct gdt_ptr gdt_pointer;
 
 /* External assembly function to load GDT */
@@ -36,7 +40,7 @@ static void gdt_set_gate(int num, uint32_t base, uint32_t limit, uint8_t access,
 
 /* Initialize GDT */
 void gdt_init(void) {
-    gdt_pointer.limit = (sizeof(struct gdt_entry) * 5) - 1;
+    gdt_pointer.limit = (sizeof(struct gdt_entry) * GDT_ENTRIES) - 1;
     gdt_pointer.base = (uint64_t)&gdt;
 
     /* Null descriptor */
@@ -48,12 +52,37 @@ void gdt_init(void) {
     /* Kernel data segment */
     gdt_set_gate(2, 0, 0xFFFFFFFF, 0x92, 0xA0);
 
-    /* User code segment */
-    gdt_set_gate(3, 0, 0xFFFFFFFF, 0xFA, 0xA0);
+    /* User data segment (before user code, as SYSRET expects) */
+    gdt_set_gate(3, 0, 0xFFFFFFFF, 0xF2, 0xA0);
 
-    /* User data segment */
-    gdt_set_gate(4, 0, 0xFFFFFFFF, 0xF2, 0xA0);
+    /* User code segment */
+    gdt_set_gate(4, 0, 0xFFFFFFFF, 0xFA, 0xA0);
 
     /* Load GDT */
     gdt_flush((uint64_t)&gdt_pointer);
 }
+
+/* Load the shared GDT on the calling CPU */
+void gdt_load(void) {
+    gdt_flush((uint64_t)&gdt_pointer);
+}
+
+/* Install a CPU's TSS descriptor and load the task register */
+void gdt_load_tss(uint32_t cpu, tss_t *tss) {
+    int num = GDT_SEGMENTS + 2 * (int)cpu;
+    uint64_t base = (uint64_t)tss;
+
+    tss->iomap_base = sizeof(tss_t);  /* No I/O permission bitmap */
+
+    /* Available 64-bit TSS; the next slot holds base bits 32-63 */
+    gdt_set_gate(num, (uint32_t)base, sizeof(tss_t) - 1, 0x89, 0x00);
+    gdt[num + 1].limit_low = (base >> 32) & 0xFFFF;
+    gdt[num + 1].base_low = (base >> 48) & 0xFFFF;
+    gdt[num + 1].base_middle = 0;
+    gdt[num + 1].access = 0;
+    gdt[num + 1].granularity = 0;
+    gdt[num + 1].base_high = 0;
+
+    uint16_t selector = GDT_TSS_BASE + 16 * cpu;
+    __asm__ volatile ("ltr %0" :: "r"(selector) : "memory");
+}
@@ -0,0 +1,254 @@
+#include "hrtimer.h"
+#include "ktime.h"
+#include "process.h"
+#include "spinlock.h"
+#include "smp.h"
+#include "cpu.h"
+#include "irq.h"
+#include "../../drivers/include/hpet.h"
+#include "../../drivers/include/apic.h"
+#include "../../drivers/include/timer.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Event device behind the timers */
+typedef enum {
+    HRTIMER_DEV_TICK,       /* Polled from the periodic tick (1 ms) */
+    HRTIMER_DEV_HPET,       /* HPET timer 0 comparator */
+    HRTIMER_DEV_DEADLINE,   /* Local APIC timer in TSC-deadline mode */
+} hrtimer_dev_t;
+
+static hrtimer_dev_t device = HRTIMER_DEV_TICK;
+
+/* Pending timers ordered by expiry, with the earliest cached */
+static rb_root_t timers = RB_ROOT_INIT;
+static rb_node_t *leftmost = NULL;
+static spinlock_t hrtimer_lock = SPINLOCK_INIT;
+
+/* Timer whose callback is executing and the CPU running it, for
+ * hrtimer_cancel() */
+static hrtimer_t *volatile running = NULL;
+static volatile uint32_t running_cpu = 0;
+
+static inline hrtimer_t *timer_of(rb_node_t *node) {
+    return node ? rb_entry(node, hrtimer_t, node) : NULL;
+}
+
+static void hrtimer_hpet_interrupt(void *ctx) {
+    (void)ctx;
+    hrtimer_interrupt();
+}
+
+void hrtimer_subsys_init(void) {
+    if (timer_event_capable()) {
+        device = HRTIMER_DEV_DEADLINE;
+    } else if (hpet_oneshot_init(HPET_TIMER_VECTOR, lapic_id())) {
+        irq_register(HPET_TIMER_VECTOR, hrtimer_hpet_interrupt, NULL);
+        device = HRTIMER_DEV_HPET;
+    } else {
+        device = HRTIMER_DEV_TICK;
+    }
+}
+
+const char *hrtimer_device_name(void) {
+    switch (device) {
+        case HRTIMER_DEV_DEADLINE: return "TSC-deadline";
+        case HRTIMER_DEV_HPET:     return "HPET";
+        default:                   return "tick";
+    }
+}
+
+/* Program the device for the earliest timer (lock held) */
+static void hrtimer_reprogram(void) {
+    hrtimer_t *first = timer_of(leftmost);
+
+    switch (device) {
+        case HRTIMER_DEV_DEADLINE:
+            if (!first) {
+                timer_set_event(0);
+            } else {
+                uint64_t now = ktime_ns();
+                uint64_t delta = first->expires > now ? first->expires - now : 0;
+                timer_set_event(rdtsc() + ktime_ns_to_cycles(delta));
+            }
+            break;
+        case HRTIMER_DEV_HPET:
+            if (!first) {
+                hpet_oneshot_disarm();
+            } else {
+                uint64_t now = ktime_ns();
+                hpet_oneshot_arm(first->expires > now ? first->expires - now : 0);
+            }
+            break;
+        case HRTIMER_DEV_TICK:
+            break;
+    }
+}
+
+/* Earliest expiry that waits for the periodic tick: 0 without timers or
+ * when a one-shot device raises them on its own */
+uint64_t hrtimer_tick_deadline(void) {
+    if (device != HRTIMER_DEV_TICK) return 0;
+
+    uint64_t flags = spin_lock_irqsave(&hrtimer_lock);
+    hrtimer_t *first = timer_of(leftmost);
+    uint64_t expires = first ? first->expires : 0;
+    spin_unlock_irqrestore(&hrtimer_lock, flags);
+    return expires;
+}
+
+/* Insert into the expiry-ordered tree; true if it became the earliest */
+static bool hrtimer_enqueue(hrtimer_t *timer) {
+    rb_node_t **link = &timers.node;
+    rb_node_t *parent = NULL;
+    bool first = true;
+
+    while (*link) {
+        parent = *link;
+        if (timer->expires < timer_of(parent)->expires) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            first = false;
+        }
+    }
+
+    rb_link_node(&timer->node, parent, link);
+    rb_insert_color(&timers, &timer->node);
+    timer->queued = true;
+    if (first) {
+        leftmost = &timer->node;
+    }
+    return first;
+}
+
+/* Remove from the tree; true if it was the earliest */
+static bool hrtimer_dequeue(hrtimer_t *timer) {
+    bool first = leftmost == &timer->node;
+    if (first) {
+        leftmost = rb_next(&timer->node);
+    }
+    rb_erase(&timers, &timer->node);
+    timer->queued = false;
+    return first;
+}
+
+void hrtimer_init(hrtimer_t *timer, hrtimer_restart_t (*function)(hrtimer_t *), void *data) {
+    timer->node.parent = NULL;
+    timer->node.left = NULL;
+    timer->node.right = NULL;
+    timer->expires = 0;
+    timer->function = function;
+    timer->data = data;
+    timer->queued = false;
+}
+
+void hrtimer_start(hrtimer_t *timer, uint64_t expires_ns) {
+    uint64_t flags = spin_lock_irqsave(&hrtimer_lock);
+    bool changed = false;
+    if (timer->queued) {
+        changed = hrtimer_dequeue(timer);
+    }
+    timer->expires = expires_ns;
+    changed |= hrtimer_enqueue(timer);
+    if (changed) {
+        hrtimer_reprogram();
+    }
+    spin_unlock_irqrestore(&hrtimer_lock, flags);
+}
+
+bool hrtimer_cancel(hrtimer_t *timer) {
+    for (;;) {
+        uint64_t flags = spin_lock_irqsave(&hrtimer_lock);
+        bool was_queued = timer->queued;
+        if (was_queued && hrtimer_dequeue(timer)) {
+            hrtimer_reprogram();
+        }
+        bool busy = running == timer;
+        bool self = busy && running_cpu == this_cpu()->id;
+        spin_unlock_irqrestore(&hrtimer_lock, flags);
+
+        /* Called from the timer's own callback: waiting would never end,
+         * and the callback's return value decides about a restart */
+        if (!busy || self) return was_queued;
+
+        /* A callback on another CPU may still touch the timer (or
+         * restart it): wait for it to return, then check again */
+        while (running == timer) {
+            cpu_relax();
+        }
+    }
+}
+
+uint64_t hrtimer_forward(hrtimer_t *timer, uint64_t now, uint64_t interval) {
+    if (interval == 0 || now < timer->expires) return 0;
+
+    uint64_t overruns = (now - timer->expires) / interval + 1;
+    timer->expires += overruns * interval;
+    return overruns;
+}
+
+void hrtimer_interrupt(void) {
+    uint64_t flags = spin_lock_irqsave(&hrtimer_lock);
+
+    /* Callbacks run unlocked, so they may start or cancel other timers */
+    for (;;) {
+        hrtimer_t *timer = timer_of(leftmost);
+        if (!timer || timer->expires > ktime_ns()) break;
+
+        hrtimer_dequeue(timer);
+        running = timer;
+        running_cpu = this_cpu()->id;
+        spin_unlock_irqrestore(&hrtimer_lock, flags);
+
+        hrtimer_restart_t restart = timer->function(timer);
+
+        flags = spin_lock_irqsave(&hrtimer_lock);
+        if (restart == HRTIMER_RESTART && !timer->queued) {
+            hrtimer_enqueue(timer);
+        }
+        running = NULL;
+    }
+
+    hrtimer_reprogram();
+    spin_unlock_irqrestore(&hrtimer_lock, flags);
+}
+
+/* Sleeping task and whether its timer fired */
+typedef struct {
+    process_t *task;
+    volatile bool done;
+} hrtimer_sleeper_t;
+
+static hrtimer_restart_t hrtimer_wakeup(hrtimer_t *timer) {
+    hrtimer_sleeper_t *sleeper = (hrtimer_sleeper_t *)timer->data;
+    sleeper->done = true;
+    process_wake(sleeper->task);
+    return HRTIMER_NORESTART;
+}
+
+void hrtimer_sleep_until(uint64_t expires_ns) {
+    if (ktime_ns() >= expires_ns) return;
+
+    hrtimer_sleeper_t sleeper = { process_get_current(), false };
+    hrtimer_t timer;
+    hrtimer_init(&timer, hrtimer_wakeup, &sleeper);
+    hrtimer_start(&timer, expires_ns);
+
+    /* Blocked before the check, so a wakeup in between is not lost */
+    for (;;) {
+        process_set_blocked(0);
+        if (sleeper.done) break;
+        schedule();
+        if (sleeper.done) break;
+    }
+    process_set_running();
+
+    /* The timer lives on this stack: it must be idle before returning */
+    hrtimer_cancel(&timer);
+}
+
+void hrtimer_sleep_ns(uint64_t ns) {
+    hrtimer_sleep_until(ktime_ns() + ns);
+}
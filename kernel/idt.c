@@ -1,4 +1,6 @@
 #include "idt.h"
+#include "../../drivers/include/apic.h"
+#include "../../drivers/include/hpet.h"
 #include <stdint.h>
 #include <stddef.h>
 
@@ -77,6 +79,12 @@ extern void irq12(void);
 extern void irq13(void);
 extern void irq14(void);
 extern void irq15(void);
+extern void irq16(void);
+
+/* Inter-processor and local APIC interrupts */
+extern void ipi_resched(void);
+extern void ipi_tlb(void);
+extern void spurious_irq(void);
 
 /* Set an IDT entry */
 static void idt_set_gate(uint8_t num, uint64_t handler, uint16_t selector, uint8_t flags) {
@@ -150,7 +158,18 @@ void idt_init(void) {
     idt_set_gate(45, (uint64_t)irq13, 0x08, 0x8E);
     idt_set_gate(46, (uint64_t)irq14, 0x08, 0x8E);
     idt_set_gate(47, (uint64_t)irq15, 0x08, 0x8E);
+    idt_set_gate(HPET_TIMER_VECTOR, (uint64_t)irq16, 0x08, 0x8E);
+
+    /* Set IPI and spurious interrupt gates */
+    idt_set_gate(IPI_VECTOR_RESCHED, (uint64_t)ipi_resched, 0x08, 0x8E);
+    idt_set_gate(IPI_VECTOR_TLB, (uint64_t)ipi_tlb, 0x08, 0x8E);
+    idt_set_gate(APIC_SPURIOUS_VECTOR, (uint64_t)spurious_irq, 0x08, 0x8E);
 
     /* Load IDT */
     idt_flush((uint64_t)&idt_pointer);
 }
+
+/* Load the shared IDT on the calling CPU */
+void idt_load(void) {
+    idt_flush((uint64_t)&idt_pointer);
+}
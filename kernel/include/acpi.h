@@ -0,0 +1,81 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Common header of every system description table */
+typedef struct {
+    char signature[4];
+    uint32_t length;            /* Whole table, header included */
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+/* Generic address structure */
+typedef struct {
+    uint8_t address_space;      /* 0 = memory, 1 = I/O port */
+    uint8_t bit_width;
+    uint8_t bit_offset;
+    uint8_t access_size;
+    uint64_t address;
+} __attribute__((packed)) acpi_gas_t;
+
+/* HPET description table */
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t event_timer_block_id;
+    acpi_gas_t base;
+    uint8_t hpet_number;
+    uint16_t min_tick;
+    uint8_t page_protection;
+} __attribute__((packed)) acpi_hpet_t;
+
+/* MADT contents needed to program the interrupt controllers */
+#define ACPI_MAX_IOAPICS   4
+#define ACPI_MAX_OVERRIDES 16
+
+/* Interrupt source override flags (polarity and trigger mode) */
+#define ACPI_MADT_POLARITY_MASK 0x3
+#define ACPI_MADT_POLARITY_LOW  0x3
+#define ACPI_MADT_TRIGGER_MASK  0xC
+#define ACPI_MADT_TRIGGER_LEVEL 0xC
+
+typedef struct {
+    uint8_t id;
+    uint32_t address;           /* Physical register base */
+    uint32_t gsi_base;          /* First global system interrupt */
+} acpi_ioapic_info_t;
+
+typedef struct {
+    uint8_t source;             /* ISA IRQ */
+    uint32_t gsi;
+    uint16_t flags;             /* ACPI_MADT_* */
+} acpi_irq_override_t;
+
+typedef struct {
+    uint64_t lapic_address;
+    bool legacy_pics;           /* 8259 pair present (must be masked) */
+    uint32_t cpu_count;         /* Enabled local APICs */
+    uint32_t ioapic_count;
+    acpi_ioapic_info_t ioapics[ACPI_MAX_IOAPICS];
+    uint32_t override_count;
+    acpi_irq_override_t overrides[ACPI_MAX_OVERRIDES];
+} acpi_madt_info_t;
+
+/* Parse the root tables from the bootloader's RSDP (a kernel pointer) */
+bool acpi_init(void *rsdp);
+bool acpi_available(void);
+
+/* Table with the given 4-character signature (checksum verified), or NULL */
+const acpi_sdt_header_t *acpi_find_table(const char *signature);
+
+/* Read the MADT ("APIC" table); false if there is none */
+bool acpi_parse_madt(acpi_madt_info_t *info);
+
+#endif /* ACPI_H */
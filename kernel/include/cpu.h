@@ -0,0 +1,145 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Control register bits */
+#define CR0_MP          (1ULL << 1)   /* Monitor coprocessor */
+#define CR0_EM          (1ULL << 2)   /* x87 emulation */
+#define CR0_TS          (1ULL << 3)   /* Task switched */
+#define CR0_NE          (1ULL << 5)   /* Native FPU error reporting */
+
+#define CR4_OSFXSR      (1ULL << 9)   /* FXSAVE/FXRSTOR and SSE enabled */
+#define CR4_OSXMMEXCPT  (1ULL << 10)  /* Unmasked SSE exceptions */
+#define CR4_OSXSAVE     (1ULL << 18)  /* XSAVE and XCR0 enabled */
+
+/* CPUID feature bits (leaf 1) */
+#define CPUID_ECX_TSC_DEADLINE (1U << 24)
+#define CPUID_ECX_XSAVE (1U << 26)
+#define CPUID_ECX_AVX   (1U << 28)
+
+/* Model-specific registers */
+#define MSR_APIC_BASE       0x1B
+#define MSR_TSC_DEADLINE    0x6E0
+#define MSR_EFER            0xC0000080
+#define MSR_STAR            0xC0000081   /* SYSCALL/SYSRET segment bases */
+#define MSR_LSTAR           0xC0000082   /* SYSCALL entry point */
+#define MSR_SFMASK          0xC0000084   /* RFLAGS bits cleared on SYSCALL */
+#define MSR_FS_BASE         0xC0000100
+#define MSR_GS_BASE         0xC0000101
+#define MSR_KERNEL_GS_BASE  0xC0000102
+
+#define EFER_SCE            (1ULL << 0)  /* SYSCALL enable */
+
+/* RFLAGS bits */
+#define RFLAGS_TF           (1ULL << 8)
+#define RFLAGS_IF           (1ULL << 9)
+#define RFLAGS_DF           (1ULL << 10)
+#define RFLAGS_AC           (1ULL << 18)
+
+/* Execute CPUID */
+static inline void cpuid(uint32_t leaf, uint32_t subleaf,
+                         uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    uint32_t a, b, c, d;
+    __asm__ volatile ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(leaf), "c"(subleaf));
+    if (eax) *eax = a;
+    if (ebx) *ebx = b;
+    if (ecx) *ecx = c;
+    if (edx) *edx = d;
+}
+
+/* Read and write model-specific registers */
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t val) {
+    __asm__ volatile ("wrmsr" :: "c"(msr), "a"((uint32_t)val), "d"((uint32_t)(val >> 32)));
+}
+
+/* Control registers */
+static inline uint64_t read_cr0(void) {
+    uint64_t val;
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr0(uint64_t val) {
+    __asm__ volatile ("mov %0, %%cr0" :: "r"(val) : "memory");
+}
+
+static inline uint64_t read_cr2(void) {
+    uint64_t val;
+    __asm__ volatile ("mov %%cr2, %0" : "=r"(val));
+    return val;
+}
+
+static inline uint64_t read_cr3(void) {
+    uint64_t val;
+    __asm__ volatile ("mov %%cr3, %0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr3(uint64_t val) {
+    __asm__ volatile ("mov %0, %%cr3" :: "r"(val) : "memory");
+}
+
+static inline uint64_t read_cr4(void) {
+    uint64_t val;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr4(uint64_t val) {
+    __asm__ volatile ("mov %0, %%cr4" :: "r"(val) : "memory");
+}
+
+/* Extended control registers (XCR0) */
+static inline uint64_t xgetbv(uint32_t index) {
+    uint32_t lo, hi;
+    __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(index));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void xsetbv(uint32_t index, uint64_t val) {
+    __asm__ volatile ("xsetbv" :: "a"((uint32_t)val), "d"((uint32_t)(val >> 32)), "c"(index));
+}
+
+/* Clear the CR0.TS flag */
+static inline void clts(void) {
+    __asm__ volatile ("clts" ::: "memory");
+}
+
+/* Read the time-stamp counter */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Spin-wait hint */
+static inline void cpu_relax(void) {
+    __asm__ volatile ("pause" ::: "memory");
+}
+
+/* Interrupt flag helpers */
+static inline uint64_t irq_save(void) {
+    uint64_t flags;
+    __asm__ volatile ("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint64_t flags) {
+    __asm__ volatile ("push %0; popfq" :: "r"(flags) : "memory", "cc");
+}
+
+static inline bool irqs_enabled(void) {
+    uint64_t flags;
+    __asm__ volatile ("pushfq; pop %0" : "=r"(flags) :: "memory");
+    return (flags & 0x200) != 0;
+}
+
+#endif /* CPU_H */
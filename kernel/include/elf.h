@@ -0,0 +1,58 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include <stdint.h>
+
+/* ELF64 file header */
+typedef struct {
+    uint8_t  e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} __attribute__((packed)) elf64_ehdr_t;
+
+/* ELF64 program header */
+typedef struct {
+    uint32_t p_type;
+    uint32_t p_flags;
+    uint64_t p_offset;
+    uint64_t p_vaddr;
+    uint64_t p_paddr;
+    uint64_t p_filesz;
+    uint64_t p_memsz;
+    uint64_t p_align;
+} __attribute__((packed)) elf64_phdr_t;
+
+/* e_ident */
+#define ELF_MAGIC       0x464C457F   /* "\x7FELF" little endian */
+#define ELF_CLASS_64    2
+#define ELF_DATA_LSB    1
+
+/* e_type / e_machine */
+#define ELF_TYPE_EXEC   2
+#define ELF_MACHINE_X86_64 0x3E
+
+/* p_type / p_flags */
+#define PT_LOAD         1
+#define PF_X            0x1
+#define PF_W            0x2
+#define PF_R            0x4
+
+/* Most program headers an executable may have */
+#define ELF_MAX_PHDRS   16
+
+/* Replace the current process image with an executable; returns -1 on
+ * failure and does not return on success */
+int elf_exec(const char *path);
+
+#endif /* ELF_H */
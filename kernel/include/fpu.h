@@ -0,0 +1,29 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+struct process;
+
+/* FPU/SSE state management */
+void fpu_init(void);
+void fpu_init_cpu(void);
+void *fpu_state_alloc(void);
+void fpu_state_free(void *state);
+void fpu_release(struct process *proc);
+
+/* Lazy switching: called on task switch and from the #NM handler */
+void fpu_switch_to(struct process *next);
+void fpu_handle_nm(void);
+
+/* Kernel SIMD sections (interrupts are disabled inside, keep them short).
+ * Sections do not nest: the registers hold one section's data, so a
+ * kernel_fpu_begin inside another panics. Interrupt handlers may open a
+ * section, since no section can be open on a CPU taking an interrupt. */
+void kernel_fpu_begin(void);
+void kernel_fpu_end(void);
+bool fpu_simd_available(void);
+
+#endif /* FPU_H */
@@ -0,0 +1,22 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stdint.h>
+
+/* Operations (SYS_FUTEX op argument) */
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
+/* Wait table size (power of two) */
+#define FUTEX_HASH_BUCKETS 64
+
+/* Sleep while *uaddr == expected, until woken or timeout ticks pass
+ * (0 = no timeout). Returns 0 when woken, -1 if the value differed, the
+ * wait timed out or the address is bad. uaddr is a user address, or
+ * kernel memory when called from the kernel. */
+int futex_wait(volatile uint32_t *uaddr, uint32_t expected, uint64_t timeout);
+
+/* Wake up to count tasks waiting on uaddr; returns how many were woken */
+int futex_wake(volatile uint32_t *uaddr, uint32_t count);
+
+#endif /* FUTEX_H */
@@ -3,7 +3,30 @@
 
 #include <stdint.h>
 
+/* Segment selectors. The user data/code order is fixed by SYSRET, which
+ * loads SS from STAR[63:48] + 8 and CS from STAR[63:48] + 16. */
+#define GDT_KERNEL_CODE  0x08
+#define GDT_KERNEL_DATA  0x10
+#define GDT_USER_DATA    0x18
+#define GDT_USER_CODE    0x20
+#define GDT_TSS_BASE     0x28      /* One 16-byte TSS descriptor per CPU */
+
+/* 64-bit Task State Segment: stack used on entry to ring 0 */
+typedef struct {
+    uint32_t reserved0;
+    uint64_t rsp0;
+    uint64_t rsp1;
+    uint64_t rsp2;
+    uint64_t reserved1;
+    uint64_t ist[7];
+    uint64_t reserved2;
+    uint16_t reserved3;
+    uint16_t iomap_base;
+} __attribute__((packed)) tss_t;
+
 /* GDT (Global Descriptor Table) */
 void gdt_init(void);
+void gdt_load(void);
+void gdt_load_tss(uint32_t cpu, tss_t *tss);
 
 #endif /* GDT_H */
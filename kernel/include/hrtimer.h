@@ -0,0 +1,54 @@
+#ifndef HRTIMER_H
+#define HRTIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rbtree.h"
+
+/* Returned by a callback: drop the timer, or re-queue it at its
+ * (forwarded) expiry */
+typedef enum {
+    HRTIMER_NORESTART,
+    HRTIMER_RESTART,
+} hrtimer_restart_t;
+
+/* High-resolution timer: one-shot at an absolute ktime_ns() deadline */
+typedef struct hrtimer {
+    rb_node_t node;                  /* Position in the expiry-ordered tree */
+    uint64_t expires;                /* Absolute deadline in nanoseconds */
+    hrtimer_restart_t (*function)(struct hrtimer *timer);
+    void *data;                      /* For the callback */
+    bool queued;                     /* In the tree, not yet expired */
+} hrtimer_t;
+
+/* Pick the event device: the TSC-deadline tick, the HPET comparator, or
+ * (without either) expiry on the periodic tick */
+void hrtimer_subsys_init(void);
+const char *hrtimer_device_name(void);
+
+void hrtimer_init(hrtimer_t *timer, hrtimer_restart_t (*function)(hrtimer_t *), void *data);
+
+/* Arm for an absolute deadline (re-arming moves a queued timer) */
+void hrtimer_start(hrtimer_t *timer, uint64_t expires_ns);
+
+/* Disarm; waits for a callback running on another CPU. From the timer's
+ * own callback it returns at once (return HRTIMER_NORESTART to stay
+ * disarmed). True if the timer was queued. */
+bool hrtimer_cancel(hrtimer_t *timer);
+
+/* Advance expires by whole intervals until it is past now; returns the
+ * number of intervals skipped (for periodic callbacks) */
+uint64_t hrtimer_forward(hrtimer_t *timer, uint64_t now, uint64_t interval);
+
+/* For tickless idle: the earliest timer expiry (ns) only the tick can
+ * catch, or 0 */
+uint64_t hrtimer_tick_deadline(void);
+
+/* Run expired callbacks and program the next event (interrupt context) */
+void hrtimer_interrupt(void);
+
+/* Block the calling task until ktime_ns() reaches expires_ns */
+void hrtimer_sleep_until(uint64_t expires_ns);
+void hrtimer_sleep_ns(uint64_t ns);
+
+#endif /* HRTIMER_H */
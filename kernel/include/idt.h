@@ -3,7 +3,16 @@
 
 #include <stdint.h>
 
+/* Registers saved by interrupt (stub pushes, then the CPU's frame) */
+struct registers {
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t rbp, rdi, rsi, rdx, rcx, rbx, rax;
+    uint64_t int_no, err_code;
+    uint64_t rip, cs, rflags, rsp, ss;
+};
+
 /* IDT (Interrupt Descriptor Table) */
 void idt_init(void);
+void idt_load(void);
 
 #endif /* IDT_H */
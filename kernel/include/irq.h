@@ -0,0 +1,42 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Interrupt handler; ctx is the pointer given at registration */
+typedef void (*irq_handler_t)(void *ctx);
+
+/* Per-vector statistics (handler time in TSC cycles) */
+typedef struct {
+    uint64_t count;
+    uint64_t total_cycles;
+    uint64_t min_cycles;
+    uint64_t max_cycles;
+    uint32_t handlers;               /* Registered handlers */
+} irq_stats_t;
+
+/* Add a handler to a vector; vectors may be shared, and every handler
+ * on a vector runs for each interrupt (registering the same handler twice
+ * runs it twice). Returns false for an exception vector (below 32), a
+ * NULL handler, or when the handler entry cannot be allocated. */
+bool irq_register(uint8_t vector, irq_handler_t handler, void *ctx);
+
+struct registers;
+
+/* Run the handlers of a vector and account the time (interrupt entry) */
+void irq_dispatch(uint8_t vector, struct registers *regs);
+
+/* Context the running handler interrupted (NULL outside handlers) */
+struct registers *irq_get_regs(void);
+
+/* Statistics of a vector; false if it never fired and has no handler */
+bool irq_get_stats(uint8_t vector, irq_stats_t *stats);
+
+/* Short description of a vector ("IRQ1", "HPET", "resched IPI") */
+const char *irq_vector_name(uint8_t vector);
+
+/* Interrupts that arrived on a vector without a handler */
+uint64_t irq_unhandled_count(void);
+
+#endif /* IRQ_H */
@@ -0,0 +1,32 @@
+#ifndef KSYMS_H
+#define KSYMS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Kernel text symbol; the table is sorted by address. It is generated
+ * from the first link (build/ksym_table.c) and linked into the final
+ * image; without it every lookup fails. */
+typedef struct {
+    uint64_t addr;
+    const char *name;
+} ksym_t;
+
+/* Bounds of the kernel text (linker.ld) */
+extern char __text_start[];
+extern char __text_end[];
+
+static inline bool ksym_is_text(uint64_t addr) {
+    return addr >= (uint64_t)__text_start && addr < (uint64_t)__text_end;
+}
+
+/* Index of the symbol containing addr, or -1 */
+int ksym_index(uint64_t addr);
+const ksym_t *ksym_get(int index);
+uint32_t ksym_count_get(void);
+
+/* Name of the function containing addr (offset into it in *offset), or
+ * NULL */
+const char *ksym_lookup(uint64_t addr, uint64_t *offset);
+
+#endif /* KSYMS_H */
@@ -0,0 +1,40 @@
+#ifndef KTIME_H
+#define KTIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Clock sources, worst to best */
+#define KTIME_SOURCE_TICK 0     /* Timer ticks (1 ms resolution) */
+#define KTIME_SOURCE_HPET 1     /* HPET main counter */
+#define KTIME_SOURCE_TSC  2     /* Calibrated time-stamp counter */
+
+/* Calibrate the TSC against the HPET (or PIT channel 2) and pick the
+ * clock source; run before the timer starts ticking */
+void ktime_init(void);
+
+/* Nanoseconds since ktime_init */
+uint64_t ktime_ns(void);
+
+/* TSC read that is not reordered ahead of earlier instructions, for
+ * timing a section of code */
+static inline uint64_t cycles(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("lfence; rdtsc" : "=a"(lo), "=d"(hi) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Calibrated TSC rate in kHz (cycles per ms), or 0 */
+uint64_t ktime_tsc_khz(void);
+
+/* CPUID reports a constant-rate TSC that keeps counting in deep C-states */
+bool ktime_tsc_invariant(void);
+
+int ktime_source(void);
+const char *ktime_source_name(void);
+
+/* Convert between TSC cycles and nanoseconds (0 before calibration) */
+uint64_t ktime_cycles_to_ns(uint64_t cycles);
+uint64_t ktime_ns_to_cycles(uint64_t ns);
+
+#endif /* KTIME_H */
@@ -12,5 +12,6 @@ void kfree(void *ptr);
 void *memset(void *s, int c, size_t n);
 void *memcpy(void *dest, const void *src, size_t n);
 int memcmp(const void *s1, const void *s2, size_t n);
+void *memcpy_simd(void *dest, const void *src, size_t n);
 
 #endif /* MEMORY_H */
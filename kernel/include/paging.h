@@ -50,8 +50,11 @@ typedef struct {
     pml4e_t entries[PAGE_ENTRIES];
 } __attribute__((aligned(PAGE_SIZE))) pml4_t;
 
-/* Physical memory frame allocator */
+/* Physical memory frame allocator. pmm_init() starts with every frame
+ * in use; pmm_add_region() then hands over the usable ranges. */
+#define PMM_MAX_MEMORY (4ULL * 1024 * 1024 * 1024)   /* Frames tracked */
 void pmm_init(void *bitmap, size_t memory_size);
+void pmm_add_region(uint64_t base, uint64_t length);
 void *pmm_alloc_frame(void);
 void pmm_free_frame(void *frame);
 size_t pmm_get_free_memory(void);
@@ -64,8 +67,19 @@ void vmm_destroy_address_space(pml4_t *pml4);
 bool vmm_map_page(pml4_t *pml4, uint64_t virt, uint64_t phys, uint64_t flags);
 void vmm_unmap_page(pml4_t *pml4, uint64_t virt);
 uint64_t vmm_get_physical(pml4_t *pml4, uint64_t virt);
+uint64_t vmm_virt_to_phys(uint64_t virt);
 void vmm_switch_address_space(pml4_t *pml4);
 
+/* Higher-half direct map of physical memory (set from the Limine HHDM response) */
+extern uint64_t hhdm_offset;
+
+static inline void *phys_to_virt(uint64_t phys) {
+    return (void *)(phys + hhdm_offset);
+}
+
+/* Flush a TLB entry on every online CPU */
+void tlb_flush_page(uint64_t virt);
+
 /* Paging initialization */
 void paging_init(void);
 
@@ -0,0 +1,45 @@
+#ifndef PIPE_H
+#define PIPE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Anonymous pipes: a page-sized single-producer/single-consumer ring.
+ * The producer only moves head and the consumer only moves tail, so the
+ * data path takes no spinlock; concurrent readers (or writers) queue on
+ * a mutex for their end. Readers block while the ring is empty and
+ * writers while it is full. */
+
+#define PIPE_SIZE 4096      /* Ring bytes (power of two) */
+
+/* Returned by a non-blocking end that would have to wait */
+#define PIPE_EAGAIN -2
+
+typedef struct pipe pipe_t;
+
+/* New pipe with one reader and one writer, or NULL */
+pipe_t *pipe_create(void);
+
+/* Drop one end, waking every waiter to re-check; the pipe is freed once
+ * both ends are gone and no operation is still inside it */
+void pipe_close(pipe_t *pipe, bool write_end);
+
+/* Read up to size bytes; returns the count, 0 once empty with no
+ * writers left, PIPE_EAGAIN, or -1 */
+int pipe_read(pipe_t *pipe, void *buffer, uint32_t size, bool nonblock);
+
+/* Write all size bytes (blocking while full); returns the count, which
+ * is short only for a non-blocking writer, or -1 with no readers left */
+int pipe_write(pipe_t *pipe, const void *buffer, uint32_t size, bool nonblock);
+
+/* Zero-copy access for splice. fill is handed free ring space to write
+ * into and drain is handed buffered bytes in place (each is called at
+ * most twice, around the wrap) and returns the bytes it used, or -1.
+ * Results are as for pipe_read/pipe_write. */
+typedef int (*pipe_fill_fn)(void *ctx, uint8_t *dst, uint32_t len);
+typedef int (*pipe_drain_fn)(void *ctx, const uint8_t *src, uint32_t len);
+
+int pipe_fill(pipe_t *pipe, pipe_fill_fn fill, void *ctx, uint32_t len, bool nonblock);
+int pipe_drain(pipe_t *pipe, pipe_drain_fn drain, void *ctx, uint32_t len, bool nonblock);
+
+#endif /* PIPE_H */
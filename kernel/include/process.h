@@ -4,6 +4,14 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "paging.h"
+#include "rbtree.h"
+#include "spinlock.h"
+#include "vma.h"
+
+struct sched_class;
+
+/* Kernel stack size for processes and kernel threads */
+#define KERNEL_STACK_SIZE 8192
 
 /* Process states */
 typedef enum {
@@ -13,17 +21,27 @@ typedef enum {
     PROCESS_TERMINATED
 } process_state_t;
 
-/* CPU context for context switching */
+/* CPU context for context switching. Switches happen inside a C call,
+ * so only the callee-saved registers are kept (offsets are used by
+ * context_switch.asm). */
 typedef struct {
-    uint64_t rax, rbx, rcx, rdx;
-    uint64_t rsi, rdi, rbp, rsp;
-    uint64_t r8, r9, r10, r11;
+    uint64_t rbx, rbp;
     uint64_t r12, r13, r14, r15;
+    uint64_t rsp;
     uint64_t rip;
-    uint64_t rflags;
     uint64_t cr3;  /* Page table base */
 } cpu_context_t;
 
+/* Address space shared by the threads of a process */
+typedef struct mm {
+    pml4_t *page_table;
+    volatile uint32_t users;         /* Threads using it */
+    spinlock_t vma_lock;             /* Guards vmas and fault-time mapping */
+    vma_t vmas[MM_MAX_VMAS];         /* Lazily mapped user regions */
+    uint32_t vma_count;
+    int exec_fd;                     /* Executable backing the regions (-1 if none) */
+} mm_t;
+
 /* Process Control Block (PCB) */
 typedef struct process {
     uint32_t pid;                    /* Process ID */
@@ -31,21 +49,96 @@ typedef struct process {
     process_state_t state;           /* Current state */
     cpu_context_t context;           /* Saved CPU context */
     pml4_t *page_table;             /* Virtual memory space */
+    mm_t *mm;                        /* Shared owner of page_table (NULL for the kernel's) */
+    uint32_t tgid;                   /* Thread group (pid of the first thread) */
+    uint64_t fs_base;                /* Thread-local storage pointer (FS base) */
+    uint64_t user_stack;             /* Stack region of a user thread (0 if none) */
+    int exit_code;                   /* Status passed to process_exit() */
+    bool joinable;                   /* Kept after exit until thread_join() */
+    bool join_claimed;               /* A thread_join() is waiting for it */
     uint64_t kernel_stack;           /* Kernel stack pointer */
-    uint32_t priority;               /* Scheduling priority */
+    uint32_t priority;               /* Nice level + 20 (0-39, default 20) */
     uint64_t time_slice;             /* Time slice in ticks */
     uint64_t sleep_until;            /* Wake up time (0 = not sleeping) */
-    struct process *next;            /* Next process in queue */
+    void *fpu_state;                 /* FPU/SSE save area (lazily switched) */
+    bool kernel_thread;              /* Runs in the kernel address space */
+    void (*thread_fn)(void *arg);    /* Kernel thread entry function */
+    void *thread_arg;                /* Kernel thread argument */
+    uint32_t cpu;                    /* CPU whose run queue owns the task */
+    volatile bool on_cpu;            /* Still running (or mid-switch) on a CPU */
+    bool on_rq;                      /* Queued in a run queue */
+    const struct sched_class *sched_class;  /* Scheduling class */
+    rb_node_t run_node;              /* Node in its class's run queue tree */
+    uint64_t vruntime;               /* Weighted virtual runtime (cycles) */
+    uint64_t exec_start;             /* TSC when the current run started */
+    uint64_t sum_exec_runtime;       /* Cycles run in total */
+    /* Deadline class parameters (ticks) and state */
+    uint64_t dl_runtime;             /* Budget per period */
+    uint64_t dl_deadline;            /* Relative deadline */
+    uint64_t dl_period;              /* Reservation period */
+    int64_t dl_budget;               /* Budget left (cycles) */
+    uint64_t dl_abs_deadline;        /* Current absolute deadline (tick) */
+    uint64_t dl_misses;              /* Deadlines passed while runnable */
+    bool throttled;                  /* Out of budget until its next period */
+    /* CPU accounting (TSC cycles), updated on the scheduler path */
+    uint64_t utime;                  /* Cycles running outside the kernel */
+    uint64_t stime;                  /* Cycles running kernel code */
+    uint64_t wait_time;              /* Cycles spent runnable in a run queue */
+    uint64_t nvcsw;                  /* Voluntary context switches */
+    uint64_t nivcsw;                 /* Involuntary context switches */
+    uint64_t acct_stamp;             /* TSC at the last accounting point */
+    uint64_t enqueue_stamp;          /* TSC when last queued */
+    bool in_kernel;                  /* Inside a system call */
+    bool trace_syscalls;             /* Record system calls in the trace ring */
+    struct process *all_next;        /* Next task in the global task list */
+    struct process *next;            /* Next process in run queue */
+    struct process *sleep_next;      /* Next process in the sleep queue */
 } process_t;
 
+/* Accounting snapshot of one task */
+typedef struct {
+    uint32_t pid;
+    char name[64];
+    process_state_t state;
+    uint32_t cpu;
+    uint64_t utime;
+    uint64_t stime;
+    uint64_t wait_time;
+    uint64_t nvcsw;
+    uint64_t nivcsw;
+    bool deadline;                   /* In the deadline class */
+    uint64_t dl_misses;
+} process_stat_t;
+
 /* Process management functions */
 void process_init(void);
+void process_init_ap(void);
 process_t *process_create(const char *name, void (*entry_point)(void));
 void process_destroy(process_t *proc);
 process_t *process_get_current(void);
 void process_yield(void);
 void process_sleep(uint64_t ticks);
 void process_exit(int status);
+void process_block(void);
+void process_set_blocked(uint64_t timeout);
+void process_set_running(void);
+int process_get_stats(process_stat_t *stats, int max);
+int process_set_nice(uint32_t pid, int nice);
+int process_set_deadline(uint32_t pid, uint64_t runtime, uint64_t deadline, uint64_t period);
+int process_set_syscall_trace(uint32_t pid, bool enable);
+void process_account_syscall_enter(void);
+void process_account_syscall_exit(void);
+void process_wake(process_t *proc);
+
+/* Kernel threads (share the kernel address space) */
+process_t *kthread_create(const char *name, void (*fn)(void *arg), void *arg);
+process_t *kthread_run(const char *name, void (*fn)(void *arg), void *arg);
+
+/* Threads of the current process (share its address space) */
+process_t *thread_create(void (*fn)(void *arg), void *arg, uint64_t tls);
+process_t *user_thread_create(uint64_t entry, uint64_t arg, uint64_t tls);
+int thread_join(uint32_t tid, int *status);
+void thread_set_tls(uint64_t tls);
 
 /* Scheduler functions */
 void scheduler_init(void);
@@ -53,8 +146,15 @@ void scheduler_add(process_t *proc);
 void scheduler_remove(process_t *proc);
 void scheduler_tick(void);
 process_t *scheduler_next(void);
+void schedule(void);
+void schedule_tail(void);
+void scheduler_preempt(void);
+uint64_t scheduler_next_event(void);
+bool scheduler_tick_needed(void);
+void cpu_idle(void);
 
 /* Context switching */
 extern void context_switch(cpu_context_t *old_context, cpu_context_t *new_context);
+bool process_bench_switch(uint32_t iterations, uint64_t *switch_cycles, uint64_t *cr3_cycles);
 
 #endif /* PROCESS_H */
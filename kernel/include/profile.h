@@ -0,0 +1,52 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Sampling rate limits (Hz); the default stays off the 1 kHz tick so
+ * samples do not land in lockstep with it */
+#define PROFILE_DEFAULT_HZ 997
+#define PROFILE_MIN_HZ     10
+#define PROFILE_MAX_HZ     10000
+
+/* Frames kept per sample (interrupted RIP first) */
+#define PROFILE_MAX_DEPTH  16
+
+/* Sample slots per CPU; later samples are counted as dropped */
+#define PROFILE_SAMPLES    2048
+
+typedef enum {
+    PROFILE_FLAT,                    /* Samples per function, hottest first */
+    PROFILE_FOLDED,                  /* "outer;...;leaf count" lines for flame graphs */
+} profile_format_t;
+
+typedef struct {
+    bool running;
+    bool dumping;
+    uint32_t hz;
+    uint64_t samples;                /* Recorded on all CPUs */
+    uint64_t dropped;                /* Buffers full */
+} profile_status_t;
+
+/* Function and its share of samples (flat profile) */
+typedef struct {
+    const char *name;
+    uint32_t count;
+} profile_entry_t;
+
+/* Discard old samples and sample the interrupted context hz times per
+ * second; false if the buffers cannot be allocated or a dump is running */
+bool profile_start(uint32_t hz);
+void profile_stop(void);
+void profile_get_status(profile_status_t *status);
+
+/* Stop sampling and write the profile to the serial port from the
+ * system workqueue; false if a dump is already in progress */
+bool profile_dump(profile_format_t format);
+
+/* Hottest functions by samples landing in them (stopped profiler);
+ * returns the number of entries filled and the sample total in *total */
+uint32_t profile_top(profile_entry_t *out, uint32_t max, uint64_t *total);
+
+#endif /* PROFILE_H */
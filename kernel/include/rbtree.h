@@ -0,0 +1,43 @@
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Red-black tree node, embedded in the structure it orders */
+typedef struct rb_node {
+    struct rb_node *parent;
+    struct rb_node *left;
+    struct rb_node *right;
+    bool red;
+} rb_node_t;
+
+/* Tree root */
+typedef struct rb_root {
+    rb_node_t *node;
+} rb_root_t;
+
+#define RB_ROOT_INIT { NULL }
+
+/* Structure containing a node */
+#define rb_entry(ptr, type, member) \
+    ((type *)((uint8_t *)(ptr) - offsetof(type, member)))
+
+/* Link a new node below parent (link is &parent->left or &parent->right,
+ * or &root->node for an empty tree); follow with rb_insert_color() */
+static inline void rb_link_node(rb_node_t *node, rb_node_t *parent, rb_node_t **link) {
+    node->parent = parent;
+    node->left = NULL;
+    node->right = NULL;
+    node->red = true;
+    *link = node;
+}
+
+/* Red-black tree functions */
+void rb_insert_color(rb_root_t *root, rb_node_t *node);
+void rb_erase(rb_root_t *root, rb_node_t *node);
+rb_node_t *rb_first(const rb_root_t *root);
+rb_node_t *rb_next(const rb_node_t *node);
+
+#endif /* RBTREE_H */
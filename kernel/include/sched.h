@@ -0,0 +1,90 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "process.h"
+#include "rbtree.h"
+#include "spinlock.h"
+
+/* Nice levels, stored in process_t.priority as nice + NICE_OFFSET */
+#define NICE_MIN      -20
+#define NICE_MAX      19
+#define NICE_OFFSET   20
+#define NICE_0_WEIGHT 1024
+
+/* Fair class tunables (in timer ticks) */
+#define SCHED_LATENCY_TICKS    6   /* Period in which every task runs once */
+#define SCHED_MIN_GRAN_TICKS   1   /* Shortest slice */
+
+/* Deadline class limits */
+#define DL_BW_SHIFT        20      /* Fixed-point bandwidth (runtime/period) */
+#define DL_BW_LIMIT_PCT    95      /* Share of each CPU deadline tasks may reserve */
+
+/* enqueue_task() flags */
+#define ENQUEUE_WAKEUP  0x1        /* Woken from sleep */
+#define ENQUEUE_NEW     0x2        /* Never run before */
+
+/* Fair (CFS-style) queue: tasks ordered by weighted virtual runtime */
+typedef struct cfs_rq {
+    rb_root_t tasks;                 /* Queued tasks keyed by vruntime */
+    rb_node_t *leftmost;             /* Cached smallest vruntime */
+    uint64_t min_vruntime;           /* Monotonic floor for placement */
+    uint64_t load;                   /* Sum of queued weights */
+    uint32_t nr_running;
+} cfs_rq_t;
+
+/* Deadline queue: tasks ordered by absolute deadline (EDF) */
+typedef struct dl_rq {
+    rb_root_t tasks;                 /* Queued tasks keyed by deadline */
+    rb_node_t *leftmost;             /* Cached earliest deadline */
+    uint32_t nr_running;
+} dl_rq_t;
+
+/* Per-CPU run queue of READY tasks (the running task is not queued) */
+typedef struct runqueue {
+    spinlock_t lock;
+    uint32_t nr_running;             /* Tasks queued in all classes */
+    dl_rq_t dl;
+    cfs_rq_t cfs;
+} runqueue_t;
+
+/* Scheduling class operations (run queue lock held) */
+typedef struct sched_class {
+    const struct sched_class *next;  /* Next lower-priority class */
+    const char *name;
+    void (*enqueue_task)(runqueue_t *rq, process_t *p, int flags);
+    void (*dequeue_task)(runqueue_t *rq, process_t *p);
+    process_t *(*pick_next_task)(runqueue_t *rq);   /* Removes the task */
+    void (*put_prev_task)(runqueue_t *rq, process_t *p);
+    void (*set_next_task)(runqueue_t *rq, process_t *p);
+    void (*task_tick)(runqueue_t *rq, process_t *p);
+    uint64_t (*time_slice)(runqueue_t *rq, process_t *p);
+    bool (*check_preempt)(runqueue_t *rq, process_t *curr, process_t *p);
+    process_t *(*steal_task)(runqueue_t *src, runqueue_t *dst,
+                             bool (*can_steal)(process_t *p, void *arg), void *arg);
+    /* Tick until which a task that used up its budget must wait
+     * (0 = keep running); optional */
+    uint64_t (*throttle_until)(runqueue_t *rq, process_t *p);
+} sched_class_t;
+
+/* Scheduling classes, highest priority first */
+extern const sched_class_t dl_sched_class;
+extern const sched_class_t fair_sched_class;
+
+#define sched_class_highest (&dl_sched_class)
+#define for_each_class(class) \
+    for ((class) = sched_class_highest; (class); (class) = (class)->next)
+
+/* Fair class helpers */
+uint32_t sched_nice_to_weight(int nice);
+void sched_fair_clock_tick(uint64_t ticks);
+uint64_t sched_tick_cycles(void);
+
+/* Deadline class helpers */
+uint64_t sched_dl_bandwidth(uint64_t runtime, uint64_t period);
+bool sched_dl_reserve(uint64_t old_bw, uint64_t new_bw);
+void sched_dl_setup(process_t *p, uint64_t runtime, uint64_t deadline, uint64_t period);
+uint64_t sched_dl_total_misses(void);
+
+#endif /* SCHED_H */
@@ -0,0 +1,14 @@
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+/* Boot-time self-tests of the locking, IPC and timer paths, built with
+ * make SELFTEST=1. Each test logs one line; a failure is logged as an
+ * error but does not stop the boot. Runs from task context with
+ * interrupts enabled. Without the option this does nothing. */
+#ifdef CONFIG_SELFTEST
+void selftest_run(void);
+#else
+static inline void selftest_run(void) {}
+#endif
+
+#endif /* SELFTEST_H */
@@ -0,0 +1,42 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdint.h>
+
+/* Named shared memory objects. An object lives while its name exists or
+ * anything maps it; every mapping shares the same pages, so data passes
+ * between processes without copying. Pages come from the physical frame
+ * allocator. An object belongs to the thread group that created it;
+ * other processes may only open or map it if it was created with
+ * SHM_SHARED, and only the owner may unlink it. The kernel may use any
+ * object. */
+
+#define SHM_NAME_MAX    32
+#define SHM_MAX_OBJECTS 16
+#define SHM_MAX_SIZE    (4 * 1024 * 1024)
+#define SHM_TOTAL_MAX   (16 * 1024 * 1024)   /* All objects together */
+
+/* shm_open flags */
+#define SHM_CREATE 0x1   /* Create the object if it does not exist */
+#define SHM_EXCL   0x2   /* With SHM_CREATE: fail if it exists */
+#define SHM_SHARED 0x4   /* With SHM_CREATE: other processes may use it */
+
+/* Open (or create, zero-filled) an object; returns its id or -1 */
+int shm_open(const char *name, uint32_t size, uint32_t flags);
+
+/* Map an object into the current process; returns the address or 0 */
+uint64_t shm_map(int id);
+int shm_unmap(uint64_t addr);
+
+/* Remove the name; the memory goes once the last mapping is gone */
+int shm_unlink(const char *name);
+
+/* Object size in bytes, or 0 */
+uint32_t shm_size(int id);
+
+/* For the VMA layer: drop a mapping's reference, and find the physical
+ * address of page index of an object */
+void shm_put(uint32_t id);
+uint64_t shm_page_phys(uint32_t id, uint64_t index);
+
+#endif /* SHM_H */
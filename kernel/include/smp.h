@@ -0,0 +1,60 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "process.h"
+#include "spinlock.h"
+#include "sched.h"
+#include "gdt.h"
+
+/* Maximum supported CPUs */
+#define MAX_CPUS 16
+
+/* Offsets used by the SYSCALL entry stub */
+#define CPU_KERNEL_RSP_OFFSET 8
+#define CPU_USER_RSP_OFFSET   16
+
+/* Per-CPU data, reached through the GS base (self must stay first, the
+ * stack slots at the offsets above) */
+typedef struct cpu {
+    struct cpu *self;                /* Pointer to this structure */
+    uint64_t kernel_rsp;             /* Kernel stack top of the current task */
+    uint64_t user_rsp;               /* User stack saved by the SYSCALL entry */
+    uint32_t id;                     /* Logical CPU number */
+    uint32_t lapic_id;               /* Local APIC ID */
+    volatile bool online;            /* Running the scheduler */
+    process_t *current;              /* Task running on this CPU */
+    process_t *idle;                 /* Idle task */
+    process_t *prev;                 /* Task switched away from (for schedule_tail) */
+    process_t *dead;                 /* Exited task to free after the switch */
+    volatile bool need_resched;      /* Switch tasks on interrupt exit */
+    volatile uint32_t softirq_pending;   /* Raised softirqs (bit per softirq_nr_t) */
+    bool in_softirq;                 /* Running bottom halves */
+    struct registers *irq_regs;      /* Context interrupted by the running handler */
+    runqueue_t rq;                   /* Runnable tasks */
+    process_t *fpu_owner;            /* Task whose FPU state is live here */
+    uint64_t kernel_fpu_flags;       /* Saved RFLAGS inside kernel_fpu_begin/end */
+    uint32_t kernel_fpu_depth;       /* Open kernel SIMD sections (0 or 1) */
+    uint64_t steals;                 /* Tasks pulled from other CPUs */
+    tss_t tss;                       /* Ring 0 stack for entries from user mode */
+} cpu_t;
+
+/* Per-CPU data of the calling CPU */
+static inline cpu_t *this_cpu(void) {
+    cpu_t *cpu;
+    __asm__ volatile ("mov %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+struct limine_smp_response;
+
+/* SMP functions */
+void percpu_init_bsp(void);
+void smp_init(struct limine_smp_response *smp);
+uint32_t smp_cpu_count(void);
+cpu_t *smp_get_cpu(uint32_t id);
+void smp_send_resched(cpu_t *cpu);
+void smp_kick_idle(void);
+
+#endif /* SMP_H */
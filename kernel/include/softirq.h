@@ -0,0 +1,62 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Bottom halves: work a top half defers until the interrupt is
+ * acknowledged, run with interrupts enabled on IRQ exit */
+typedef enum {
+    SOFTIRQ_TIMER,                   /* Scheduler tick */
+    SOFTIRQ_TASKLET,                 /* Queued tasklets */
+    SOFTIRQ_COUNT,
+} softirq_nr_t;
+
+/* Deferred function that may run on any CPU, never twice at once. It
+ * must not sleep. */
+typedef struct tasklet {
+    void (*func)(void *data);
+    void *data;
+    volatile bool scheduled;         /* Queued and not yet started */
+    volatile bool running;           /* Executing on some CPU */
+    struct tasklet *next;
+} tasklet_t;
+
+#define INIT_TASKLET(t, f, d) do { \
+    (t)->func = (f);               \
+    (t)->data = (d);               \
+    (t)->scheduled = false;        \
+    (t)->running = false;          \
+    (t)->next = NULL;              \
+} while (0)
+
+/* Per-softirq statistics */
+typedef struct {
+    uint64_t runs[SOFTIRQ_COUNT];    /* Handler invocations */
+    uint64_t tasklets;               /* Tasklets run on IRQ exit */
+    uint64_t deferred;               /* Tasklets run by ksoftirqd */
+} softirq_stats_t;
+
+/* Start ksoftirqd, which takes tasklets left over when IRQ exit runs
+ * out of budget (after the scheduler is up) */
+void softirq_init(void);
+
+void open_softirq(softirq_nr_t nr, void (*handler)(void));
+
+/* Mark a softirq pending on this CPU (interrupt context) */
+void raise_softirq(softirq_nr_t nr);
+
+/* Run pending softirqs on IRQ exit, after the EOI (interrupts disabled;
+ * enabled while handlers run) */
+void do_softirq(void);
+
+/* Whether this CPU is running softirqs (nested interrupts must not
+ * switch tasks) */
+bool in_softirq(void);
+
+/* Queue a tasklet (safe from interrupt context) */
+void tasklet_schedule(tasklet_t *t);
+
+void softirq_get_stats(softirq_stats_t *stats);
+
+#endif /* SOFTIRQ_H */
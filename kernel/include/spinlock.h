@@ -0,0 +1,47 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+/* Busy-waiting lock for short critical sections shared between CPUs */
+typedef struct {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+static inline void spin_init(spinlock_t *lock) {
+    lock->locked = 0;
+}
+
+static inline bool spin_trylock(spinlock_t *lock) {
+    return __atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE) == 0;
+}
+
+static inline void spin_lock(spinlock_t *lock) {
+    while (!spin_trylock(lock)) {
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)) {
+            __asm__ volatile ("pause");
+        }
+    }
+}
+
+static inline void spin_unlock(spinlock_t *lock) {
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+/* Lock with local interrupts disabled; returns the previous RFLAGS */
+static inline uint64_t spin_lock_irqsave(spinlock_t *lock) {
+    uint64_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint64_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+#endif /* SPINLOCK_H */
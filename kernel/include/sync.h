@@ -0,0 +1,114 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "process.h"
+#include "spinlock.h"
+#include "cpu.h"
+#include "softirq.h"
+#include "../../drivers/include/timer.h"
+
+/* A task waiting on a wait queue (lives on the waiter's stack) */
+typedef struct wait_entry {
+    process_t *task;
+    struct wait_entry *next;
+    bool queued;                     /* Linked on the queue */
+} wait_entry_t;
+
+/* FIFO of tasks blocked until some condition becomes true */
+typedef struct wait_queue {
+    spinlock_t lock;
+    wait_entry_t *head;
+    wait_entry_t *tail;
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT { SPINLOCK_INIT, NULL, NULL }
+
+/* Sleeping lock; may only be taken from task context */
+typedef struct mutex {
+    volatile uint32_t locked;
+    process_t *owner;
+    wait_queue_t waiters;
+} mutex_t;
+
+#define MUTEX_INIT { 0, NULL, WAIT_QUEUE_INIT }
+
+/* Counting semaphore */
+typedef struct semaphore {
+    volatile int32_t count;
+    wait_queue_t waiters;
+} semaphore_t;
+
+#define SEMAPHORE_INIT(n) { (n), WAIT_QUEUE_INIT }
+
+/* Condition variable, used with a mutex */
+typedef struct condvar {
+    wait_queue_t waiters;
+} condvar_t;
+
+#define CONDVAR_INIT { WAIT_QUEUE_INIT }
+
+/* Whether the caller may block: a scheduled task with interrupts on,
+ * outside bottom halves (early boot and interrupt handlers must poll
+ * instead) */
+static inline bool sync_can_block(void) {
+    return process_get_current() != NULL && irqs_enabled() && !in_softirq();
+}
+
+/* Wait queue functions */
+void wait_queue_init(wait_queue_t *wq);
+void wait_entry_init(wait_entry_t *entry);
+void wait_prepare(wait_queue_t *wq, wait_entry_t *entry, uint64_t timeout);
+void wait_finish(wait_queue_t *wq, wait_entry_t *entry);
+void wake_up_one(wait_queue_t *wq);
+void wake_up_all(wait_queue_t *wq);
+
+/* Block until cond is true. cond is re-checked after queueing, so a
+ * wakeup between the check and schedule() is not lost. */
+#define wait_event(wq, cond) do {                       \
+    wait_entry_t __wait;                                \
+    wait_entry_init(&__wait);                           \
+    while (!(cond)) {                                   \
+        wait_prepare((wq), &__wait, 0);                 \
+        if (cond) break;                                \
+        schedule();                                     \
+    }                                                   \
+    wait_finish((wq), &__wait);                         \
+} while (0)
+
+/* As wait_event, giving up after ticks timer ticks; the caller re-tests
+ * cond to tell a timeout from success */
+#define wait_event_timeout(wq, cond, ticks) do {        \
+    wait_entry_t __wait;                                \
+    uint64_t __deadline = timer_get_ticks() + (ticks);  \
+    wait_entry_init(&__wait);                           \
+    while (!(cond)) {                                   \
+        uint64_t __now = timer_get_ticks();             \
+        if (__now >= __deadline) break;                 \
+        wait_prepare((wq), &__wait, __deadline - __now);\
+        if (cond) break;                                \
+        schedule();                                     \
+    }                                                   \
+    wait_finish((wq), &__wait);                         \
+} while (0)
+
+/* Mutex functions */
+void mutex_init(mutex_t *mutex);
+bool mutex_trylock(mutex_t *mutex);
+void mutex_lock(mutex_t *mutex);
+void mutex_unlock(mutex_t *mutex);
+
+/* Semaphore functions */
+void sem_init(semaphore_t *sem, int32_t count);
+bool sem_trydown(semaphore_t *sem);
+void sem_down(semaphore_t *sem);
+void sem_up(semaphore_t *sem);
+
+/* Condition variable functions */
+void cond_init(condvar_t *cv);
+void cond_wait(condvar_t *cv, mutex_t *mutex);
+void cond_signal(condvar_t *cv);
+void cond_broadcast(condvar_t *cv);
+
+#endif /* SYNC_H */
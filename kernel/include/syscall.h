@@ -2,6 +2,7 @@
 #define SYSCALL_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /* System call numbers */
 #define SYS_EXIT        0
@@ -15,9 +16,70 @@
 #define SYS_GETPID      8
 #define SYS_SLEEP       9
 #define SYS_YIELD       10
+#define SYS_THREAD_CREATE 11
+#define SYS_THREAD_JOIN   12
+#define SYS_SET_TLS       13
+#define SYS_URING_SETUP   14
+#define SYS_URING_ENTER   15
+#define SYS_URING_EXIT    16
+#define SYS_PREAD         17
+#define SYS_PWRITE        18
+#define SYS_READV         19
+#define SYS_WRITEV        20
+#define SYS_LSEEK         21
+#define SYS_FUTEX         22
+#define SYS_SHM_OPEN      23
+#define SYS_SHM_MAP       24
+#define SYS_SHM_UNMAP     25
+#define SYS_SHM_UNLINK    26
+#define SYS_PIPE          27
+#define SYS_SPLICE        28
+
+#define SYSCALL_COUNT   29
+
+/* Latency histogram: bucket i counts calls taking [2^(i+SHIFT), 2^(i+SHIFT+1))
+ * TSC cycles; the first and last buckets also take everything below/above */
+#define SYSCALL_HIST_BUCKETS 16
+#define SYSCALL_HIST_SHIFT   6
+
+/* Trace ring size (entries, power of two) */
+#define SYSCALL_TRACE_ENTRIES 256
+
+/* Per-call statistics */
+typedef struct {
+    uint64_t count;
+    uint64_t total_cycles;
+    uint64_t max_cycles;
+    uint64_t hist[SYSCALL_HIST_BUCKETS];
+} syscall_stat_t;
+
+/* One trace record: an entry (value = first argument) or an exit
+ * (value = result) */
+typedef struct {
+    uint64_t tsc;
+    uint64_t value;
+    uint32_t pid;
+    uint16_t num;
+    bool exit;
+} syscall_trace_t;
+
+/* System call implementation */
+typedef uint64_t (*syscall_fn_t)(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t arg4);
 
 /* System call handler */
 void syscall_init(void);
-uint64_t syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint64_t arg3);
+void syscall_init_cpu(void);
+uint64_t syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint64_t arg3,
+                         uint64_t arg4);
+
+/* Statistics and tracing */
+const char *syscall_name(uint32_t num);
+void syscall_get_stats(syscall_stat_t stats[SYSCALL_COUNT]);
+void syscall_reset_stats(void);
+int syscall_trace_read(syscall_trace_t *records, int max);
+
+/* Entry stubs (syscall_entry.asm) */
+extern void syscall_entry(void);
+extern void user_enter(uint64_t rip, uint64_t rsp, uint64_t arg) __attribute__((noreturn));
 
 #endif /* SYSCALL_H */
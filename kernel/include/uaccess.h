@@ -0,0 +1,43 @@
+#ifndef UACCESS_H
+#define UACCESS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "idt.h"
+
+/* Access to user memory from system calls. User addresses are passed as
+ * plain integers so they cannot be dereferenced by accident; the copy
+ * helpers check the range and turn a fault on an unmapped page into an
+ * error instead of a kernel panic. */
+
+/* End of the lower (user) half; everything above belongs to the kernel */
+#define USER_SPACE_END 0x0000800000000000ULL
+
+/* Whether [addr, addr + len) lies entirely in user space */
+static inline bool user_range_ok(uint64_t addr, uint64_t len) {
+    return addr < USER_SPACE_END && len <= USER_SPACE_END - addr;
+}
+
+/* Copy len bytes between user and kernel memory; 0 on success, -1 if the
+ * range is not user memory or touches an unmapped page */
+int copy_from_user(void *dst, uint64_t src, uint64_t len);
+int copy_to_user(uint64_t dst, const void *src, uint64_t len);
+
+/* One aligned 32-bit user word read, written or updated with a single
+ * access, for indices and flags shared with a process; 0 or -1 as above
+ * (also for a misaligned address). The atomic forms set or clear bits
+ * with a locked instruction. */
+int get_user_u32(uint32_t *value, uint64_t addr);
+int put_user_u32(uint64_t addr, uint32_t value);
+int user_atomic_or_u32(uint64_t addr, uint32_t bits);
+int user_atomic_andnot_u32(uint64_t addr, uint32_t bits);
+
+/* Copy a NUL-terminated string of at most size - 1 characters; returns
+ * its length, or -1 on a bad pointer or a missing terminator */
+int64_t strncpy_from_user(char *dst, uint64_t src, uint64_t size);
+
+/* Page fault handler: if the fault hit a user access, make it return
+ * the error and report true */
+bool uaccess_fixup(struct registers *regs);
+
+#endif /* UACCESS_H */
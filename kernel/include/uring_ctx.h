@@ -0,0 +1,25 @@
+#ifndef URING_CTX_H
+#define URING_CTX_H
+
+#include <stdint.h>
+#include "uring.h"
+
+/* Kernel side of the submission/completion rings (layout in lib/include/uring.h) */
+
+/* Most rings registered at once */
+#define URING_MAX_RINGS 16
+
+/* A polling thread keeps spinning this many ticks after its last work
+ * before it sleeps and asks for a wakeup */
+#define URING_SQPOLL_IDLE_TICKS 10
+
+/* ring is a user address; all ring accesses are checked, and a fault
+ * makes later calls on the ring fail with -1 */
+int uring_register(uint64_t ring, uint32_t flags);
+int64_t uring_enter_ring(int id, uint32_t min_complete, uint32_t flags);
+int uring_unregister(int id);
+
+/* Stop and reap every ring of the calling process (on its exit) */
+void uring_release_process(void);
+
+#endif /* URING_CTX_H */
@@ -0,0 +1,17 @@
+#ifndef VDSO_PAGE_H
+#define VDSO_PAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "paging.h"
+#include "vdso.h"
+
+/* Kernel side of the shared time page (layout in lib/include/vdso.h) */
+void vdso_init(uint32_t tick_ns);
+void vdso_update(uint64_t ticks);
+bool vdso_map(pml4_t *pml4);
+
+/* The same lock-free clock read from inside the kernel */
+uint64_t vdso_kernel_clock_ns(void);
+
+#endif /* VDSO_PAGE_H */
@@ -3,18 +3,62 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "sync.h"
 
 /* File types */
 #define VFS_FILE      1
 #define VFS_DIRECTORY 2
+#define VFS_PIPE_READ  3
+#define VFS_PIPE_WRITE 4
 
-/* File descriptor */
+/* Descriptor flags */
+#define VFS_NONBLOCK 0x1    /* Pipe ends return VFS_EAGAIN instead of waiting */
+
+/* A non-blocking descriptor had nothing to transfer */
+#define VFS_EAGAIN -2
+
+/* lseek origins */
+#define VFS_SEEK_SET 0
+#define VFS_SEEK_CUR 1
+#define VFS_SEEK_END 2
+
+/* Longest path, terminator included */
+#define VFS_PATH_MAX 256
+
+/* Most segments in one readv/writev */
+#define VFS_IOV_MAX 16
+
+/* Most bytes one *_user call moves (larger requests return short) */
+#define VFS_USER_IO_MAX (64 * 1024)
+
+/* Offset argument of vfs_read_user/vfs_write_user: use the file position */
+#define VFS_POS_CURRENT (-1)
+
+/* One scatter-gather segment (same layout as the user library's) */
+typedef struct {
+    uint64_t base;
+    uint64_t len;
+} vfs_iovec_t;
+
+/* File descriptor. A slot is claimed before it is filled in and open is
+ * set last, so lookups never see a half-built descriptor. Every
+ * operation holds a reference, and the slot (with its pipe end) is only
+ * freed when the last one is dropped, so closing a descriptor another
+ * thread is using waits for that use to finish. Descriptors belong to
+ * the thread group that opened them (0 for the kernel); lookups by
+ * anyone else fail. */
 typedef struct {
-    char path[256];
+    char path[VFS_PATH_MAX];
     uint32_t position;
     uint32_t size;
     uint8_t type;
-    bool open;
+    bool open;              /* Published: usable by lookups */
+    bool claimed;           /* Slot taken (being opened, open, closing or in use) */
+    uint32_t flags;
+    uint32_t owner;         /* Thread group id, 0 for the kernel */
+    uint32_t refs;          /* The descriptor's own plus one per operation */
+    struct pipe *pipe;      /* VFS_PIPE_* only */
+    mutex_t pos_lock;       /* Serializes updates of position */
 } vfs_file_t;
 
 /* Directory entry */
@@ -30,7 +74,27 @@ void vfs_init(void);
 int vfs_open(const char *path);
 void vfs_close(int fd);
 int vfs_read(int fd, void *buffer, uint32_t size);
+int vfs_pread(int fd, void *buffer, uint32_t size, uint32_t offset);
 int vfs_write(int fd, const void *buffer, uint32_t size);
+int vfs_pwrite(int fd, const void *buffer, uint32_t size, uint32_t offset);
+int vfs_readv(int fd, const vfs_iovec_t *iov, int count);
+int vfs_writev(int fd, const vfs_iovec_t *iov, int count);
+int64_t vfs_lseek(int fd, int64_t offset, int whence);
+int vfs_pipe(int fds[2], uint32_t flags);
+
+/* Close every descriptor of a thread group (its last thread is gone) */
+void vfs_close_all(uint32_t owner);
+
+/* The same on user memory (buffers, iovec arrays and paths are user
+ * addresses; a bad one makes the call fail with -1) */
+int vfs_read_user(int fd, uint64_t buffer, uint32_t size, int64_t offset);
+int vfs_write_user(int fd, uint64_t buffer, uint32_t size, int64_t offset);
+int vfs_readv_user(int fd, uint64_t iov, int count);
+int vfs_writev_user(int fd, uint64_t iov, int count);
+int vfs_open_user(uint64_t path);
+
+int vfs_set_flags(int fd, uint32_t flags);
+int vfs_splice(int fd_in, int fd_out, uint32_t len);
 bool vfs_exists(const char *path);
 uint32_t vfs_file_size(const char *path);
 int vfs_list_directory(const char *path, vfs_dirent_t *entries, uint32_t max_count);
@@ -0,0 +1,53 @@
+#ifndef VMA_H
+#define VMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct mm;
+
+/* User address space layout: the stack sits below a guard page under
+ * the vDSO time page at the top of the lower half */
+#define USER_STACK_TOP   0x00007FFFFFFFE000ULL
+#define USER_STACK_SIZE  (64 * 1024)
+#define USER_SPACE_BASE  0x0000000000400000ULL
+#define VMA_SHARED_BASE  0x0000100000000000ULL   /* Shared memory and thread stacks */
+
+/* Regions per address space */
+#define MM_MAX_VMAS 16
+
+/* Region flags */
+#define VMA_READ   0x1
+#define VMA_WRITE  0x2
+#define VMA_EXEC   0x4
+#define VMA_SHARED 0x8   /* Pages belong to a shared memory object */
+#define VMA_DYING  0x10  /* Being unmapped: keeps its range, takes no faults */
+
+/* Page fault error code bits */
+#define PF_PRESENT 0x1   /* Protection violation (page was present) */
+#define PF_WRITE   0x2
+#define PF_USER    0x4
+
+/* A range of user addresses whose pages are filled on first touch: the
+ * bytes in [file_start, file_end) come from the executable at
+ * file_offset, everything else is zero. Shared regions map the pages of
+ * a shared memory object instead. */
+typedef struct {
+    uint64_t start;             /* Page aligned */
+    uint64_t end;               /* Page aligned, exclusive */
+    uint64_t file_start;
+    uint64_t file_end;
+    uint64_t file_offset;       /* File offset of file_start */
+    uint32_t flags;             /* VMA_* */
+    uint32_t shm_id;            /* Shared memory object (VMA_SHARED) */
+} vma_t;
+
+bool vma_add(struct mm *mm, uint64_t start, uint64_t size, uint64_t file_offset,
+             uint64_t file_size, uint32_t flags);
+uint64_t vma_add_shared(struct mm *mm, uint32_t shm_id, uint64_t size, uint32_t flags);
+uint64_t vma_add_anon(struct mm *mm, uint64_t size, uint32_t flags);
+bool vma_remove(struct mm *mm, uint64_t start);
+void vma_clear(struct mm *mm);
+bool vma_handle_fault(uint64_t addr, uint64_t error);
+
+#endif /* VMA_H */
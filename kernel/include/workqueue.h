@@ -0,0 +1,69 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "process.h"
+#include "spinlock.h"
+#include "sync.h"
+
+/* Deferred work item */
+typedef struct work {
+    void (*func)(void *data);        /* Function run by the worker thread */
+    void *data;                      /* Argument passed to func */
+    bool pending;                    /* Queued and not yet started */
+    struct work *next;               /* Next item in the queue */
+} work_t;
+
+/* Work item that becomes runnable after a delay */
+typedef struct delayed_work {
+    work_t work;
+    uint64_t expires;                /* Tick at which the work is queued */
+    bool timer_pending;              /* Waiting for its delay to expire */
+    struct delayed_work *next;       /* Next item in the delayed list */
+} delayed_work_t;
+
+/* Workqueue served by one kernel thread */
+typedef struct workqueue {
+    char name[32];
+    spinlock_t lock;                 /* Protects the lists and counters */
+    work_t *head;
+    work_t *tail;
+    delayed_work_t *delayed;         /* Unsorted list of delayed items */
+    process_t *worker;               /* Worker kernel thread */
+    uint64_t queued;                 /* Items ever queued */
+    uint64_t completed;              /* Items finished */
+    wait_queue_t flush_wait;         /* Tasks in flush_workqueue() */
+} workqueue_t;
+
+/* Initialize a work item */
+#define INIT_WORK(w, f, d) do { \
+    (w)->func = (f);            \
+    (w)->data = (d);            \
+    (w)->pending = false;       \
+    (w)->next = NULL;           \
+} while (0)
+
+#define INIT_DELAYED_WORK(dw, f, d) do { \
+    INIT_WORK(&(dw)->work, f, d);        \
+    (dw)->expires = 0;                   \
+    (dw)->timer_pending = false;         \
+    (dw)->next = NULL;                   \
+} while (0)
+
+/* Shared general-purpose workqueue */
+extern workqueue_t *system_wq;
+
+/* Workqueue API */
+void workqueue_init(void);
+workqueue_t *workqueue_create(const char *name);
+bool queue_work(workqueue_t *wq, work_t *work);
+bool queue_delayed_work(workqueue_t *wq, delayed_work_t *dwork, uint64_t delay_ticks);
+bool cancel_delayed_work(workqueue_t *wq, delayed_work_t *dwork);
+void flush_workqueue(workqueue_t *wq);
+
+/* Convenience wrappers for the system workqueue */
+bool schedule_work(work_t *work);
+bool schedule_delayed_work(delayed_work_t *dwork, uint64_t delay_ticks);
+
+#endif /* WORKQUEUE_H */
@@ -84,12 +84,35 @@ IRQ 12, 44
 IRQ 13, 45
 IRQ 14, 46
 IRQ 15, 47
+IRQ 16, 48          ; HPET one-shot event (IOAPIC only)
+
+; Macro to create inter-processor interrupt stubs
+%macro IPI 2
+global ipi_%1
+ipi_%1:
+    push qword 0        ; Dummy error code
+    push qword %2       ; Vector number
+    jmp irq_common_stub
+%endmacro
+
+IPI resched, 240
+IPI tlb, 241
+
+; Spurious local APIC interrupts need no EOI
+global spurious_irq
+spurious_irq:
+    iretq
 
 extern isr_handler
 extern irq_handler
 
 ; Common ISR stub
 isr_common_stub:
+    ; From user mode: switch GS to this CPU's data
+    test qword [rsp + 24], 3
+    jz .from_kernel
+    swapgs
+.from_kernel:
     ; Save registers
     push rax
     push rbx
@@ -131,11 +154,21 @@ isr_common_stub:
     ; Clean up error code and interrupt number
     add rsp, 16
 
+    ; Back to user mode: restore its GS
+    test qword [rsp + 8], 3
+    jz .to_kernel
+    swapgs
+.to_kernel:
     ; Return from interrupt
     iretq
 
 ; Common IRQ stub
 irq_common_stub:
+    ; From user mode: switch GS to this CPU's data
+    test qword [rsp + 24], 3
+    jz .from_kernel
+    swapgs
+.from_kernel:
     ; Save registers
     push rax
     push rbx
@@ -177,5 +210,10 @@ irq_common_stub:
     ; Clean up error code and interrupt number
     add rsp, 16
 
+    ; Back to user mode: restore its GS
+    test qword [rsp + 8], 3
+    jz .to_kernel
+    swapgs
+.to_kernel:
     ; Return from interrupt
     iretq
@@ -0,0 +1,137 @@
+#include "irq.h"
+#include "memory.h"
+#include "spinlock.h"
+#include "ktime.h"
+#include "smp.h"
+#include "../../drivers/include/apic.h"
+#include "../../drivers/include/hpet.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define IRQ_VECTORS 256
+
+/* First vector past the CPU exceptions */
+#define IRQ_FIRST_VECTOR 32
+
+/* Registered handler; a vector's handlers form a list that only grows,
+ * so interrupt entry walks it without taking the lock */
+typedef struct irq_action {
+    irq_handler_t handler;
+    void *ctx;
+    struct irq_action *next;
+} irq_action_t;
+
+typedef struct {
+    irq_action_t *actions;
+    uint32_t handlers;
+    uint64_t count;
+    uint64_t total_cycles;
+    uint64_t min_cycles;
+    uint64_t max_cycles;
+} irq_vector_t;
+
+static irq_vector_t vectors[IRQ_VECTORS];
+static spinlock_t irq_lock = SPINLOCK_INIT;
+static uint64_t unhandled = 0;
+
+static const char *isa_names[16] = {
+    "IRQ0", "IRQ1", "IRQ2", "IRQ3", "IRQ4", "IRQ5", "IRQ6", "IRQ7",
+    "IRQ8", "IRQ9", "IRQ10", "IRQ11", "IRQ12", "IRQ13", "IRQ14", "IRQ15",
+};
+
+bool irq_register(uint8_t vector, irq_handler_t handler, void *ctx) {
+    if (vector < IRQ_FIRST_VECTOR || !handler) return false;
+
+    irq_action_t *action = (irq_action_t *)kmalloc(sizeof(irq_action_t));
+    if (!action) return false;
+    action->handler = handler;
+    action->ctx = ctx;
+    action->next = NULL;
+
+    /* Append, publishing the fully built entry last */
+    uint64_t flags = spin_lock_irqsave(&irq_lock);
+    irq_vector_t *v = &vectors[vector];
+    irq_action_t **link = &v->actions;
+    while (*link) {
+        link = &(*link)->next;
+    }
+    __atomic_store_n(link, action, __ATOMIC_RELEASE);
+    v->handlers++;
+    spin_unlock_irqrestore(&irq_lock, flags);
+    return true;
+}
+
+/* Lower or raise a bound shared by all CPUs */
+static inline void atomic_min(uint64_t *bound, uint64_t value) {
+    uint64_t old = __atomic_load_n(bound, __ATOMIC_RELAXED);
+    while ((old == 0 || value < old) &&
+           !__atomic_compare_exchange_n(bound, &old, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static inline void atomic_max(uint64_t *bound, uint64_t value) {
+    uint64_t old = __atomic_load_n(bound, __ATOMIC_RELAXED);
+    while (value > old &&
+           !__atomic_compare_exchange_n(bound, &old, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void irq_dispatch(uint8_t vector, struct registers *regs) {
+    irq_vector_t *v = &vectors[vector];
+    irq_action_t *action = __atomic_load_n(&v->actions, __ATOMIC_ACQUIRE);
+    if (!action) {
+        __atomic_fetch_add(&unhandled, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    /* Handlers run with interrupts off, so this cannot nest */
+    cpu_t *cpu = this_cpu();
+    cpu->irq_regs = regs;
+
+    uint64_t start = cycles();
+    for (; action; action = __atomic_load_n(&action->next, __ATOMIC_ACQUIRE)) {
+        action->handler(action->ctx);
+    }
+    uint64_t spent = cycles() - start;
+    cpu->irq_regs = NULL;
+
+    /* Interrupts on a vector may arrive on several CPUs (IPIs) */
+    __atomic_fetch_add(&v->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&v->total_cycles, spent, __ATOMIC_RELAXED);
+    atomic_min(&v->min_cycles, spent ? spent : 1);
+    atomic_max(&v->max_cycles, spent);
+}
+
+bool irq_get_stats(uint8_t vector, irq_stats_t *stats) {
+    const irq_vector_t *v = &vectors[vector];
+    stats->count = __atomic_load_n(&v->count, __ATOMIC_RELAXED);
+    stats->total_cycles = __atomic_load_n(&v->total_cycles, __ATOMIC_RELAXED);
+    stats->min_cycles = __atomic_load_n(&v->min_cycles, __ATOMIC_RELAXED);
+    stats->max_cycles = __atomic_load_n(&v->max_cycles, __ATOMIC_RELAXED);
+    stats->handlers = v->handlers;
+    return stats->count != 0 || stats->handlers != 0;
+}
+
+const char *irq_vector_name(uint8_t vector) {
+    if (vector >= IRQ_FIRST_VECTOR && vector < IRQ_FIRST_VECTOR + 16) {
+        return isa_names[vector - IRQ_FIRST_VECTOR];
+    }
+    switch (vector) {
+        case HPET_TIMER_VECTOR:     return "HPET";
+        case IPI_VECTOR_RESCHED:    return "resched IPI";
+        case IPI_VECTOR_TLB:        return "TLB IPI";
+        case APIC_SPURIOUS_VECTOR:  return "spurious";
+        default:                    return "other";
+    }
+}
+
+struct registers *irq_get_regs(void) {
+    return this_cpu()->irq_regs;
+}
+
+uint64_t irq_unhandled_count(void) {
+    return __atomic_load_n(&unhandled, __ATOMIC_RELAXED);
+}
@@ -1,46 +1,125 @@
 #include "idt.h"
+#include "fpu.h"
+#include "process.h"
+#include "smp.h"
+#include "vma.h"
+#include "cpu.h"
+#include "kernel.h"
+#include "irq.h"
+#include "softirq.h"
+#include "uaccess.h"
+#include "../../drivers/include/apic.h"
+#include "../../drivers/include/ioapic.h"
+#include "../../drivers/include/pic.h"
+#include "../../drivers/include/timer.h"
 #include <stdint.h>
 
-/* Driver interrupt handlers */
-extern void timer_interrupt_handler(void);
-extern void keyboard_interrupt_handler(void);
-extern void mouse_interrupt_handler(void);
+/* Append "0x" and value in hex to buf at pos; returns the new position */
+static int isr_format_hex(char *buf, int pos, uint64_t value) {
+    buf[pos++] = '0';
+    buf[pos++] = 'x';
+    for (int shift = 60; shift >= 0; shift -= 4) {
+        buf[pos++] = "0123456789abcdef"[(value >> shift) & 0xF];
+    }
+    return pos;
+}
+
+/* Append a decimal number below 100 */
+static int isr_format_vector(char *buf, int pos, uint64_t value) {
+    if (value >= 10) {
+        buf[pos++] = (char)('0' + value / 10 % 10);
+    }
+    buf[pos++] = (char)('0' + value % 10);
+    return pos;
+}
+
+static int isr_format_string(char *buf, int pos, const char *str) {
+    while (*str) {
+        buf[pos++] = *str++;
+    }
+    return pos;
+}
 
-/* Registers saved by interrupt */
-struct registers {
-    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
-    uint64_t rbp, rdi, rsi, rdx, rcx, rbx, rax;
-    uint64_t int_no, err_code;
-    uint64_t rip, cs, rflags, rsp, ss;
-};
+/* A kernel-mode exception nothing handles: panic with the vector, the
+ * faulting RIP and the error code */
+static void isr_kernel_fault(struct registers *regs) {
+    char message[96];
+    int pos = isr_format_string(message, 0, "Unhandled exception ");
+    pos = isr_format_vector(message, pos, regs->int_no);
+    pos = isr_format_string(message, pos, " at RIP ");
+    pos = isr_format_hex(message, pos, regs->rip);
+    pos = isr_format_string(message, pos, ", error ");
+    pos = isr_format_hex(message, pos, regs->err_code);
+    message[pos] = '\0';
+    kernel_panic(message);
+}
 
 /* ISR handler */
 void isr_handler(struct registers *regs) {
-    (void)regs;
     /* Handle CPU exceptions */
-    /* For now, just ignore them */
-}
-
-/* IRQ handler */
-void irq_handler(struct registers *regs) {
-    /* Call driver interrupt handlers */
     switch (regs->int_no) {
-        case 32:  /* IRQ0 - Timer */
-            timer_interrupt_handler();
+        case 7:  /* Device not available - lazy FPU switch */
+            fpu_handle_nm();
+            break;
+        case 14: { /* Page fault - demand paging of user regions */
+            uint64_t addr = read_cr2();
+
+            /* Filling the page may sleep on disk I/O: allow interrupts
+             * again if the faulting code had them on */
+            if (regs->rflags & RFLAGS_IF) {
+                __asm__ volatile ("sti");
+            }
+            if (!vma_handle_fault(addr, regs->err_code)) {
+                if (regs->cs & 3) {
+                    process_exit(-1);   /* Bad user access kills the process */
+                }
+                if (uaccess_fixup(regs)) {
+                    break;              /* Bad pointer passed to a system call */
+                }
+                isr_kernel_fault(regs);
+            }
             break;
-        case 33:  /* IRQ1 - Keyboard */
-            keyboard_interrupt_handler();
+        }
+        case 2:  /* NMI - not caused by the interrupted code; nothing
+                  * sends one, so a stray NMI is dropped */
             break;
-        case 44:  /* IRQ12 - Mouse */
-            mouse_interrupt_handler();
+        default:
+            /* Returning would re-run the faulting instruction forever:
+             * kill a faulting process, panic on a kernel fault */
+            if (regs->cs & 3) {
+                __asm__ volatile ("sti");   /* Exiting may sleep */
+                process_exit(-1);
+            }
+            isr_kernel_fault(regs);
             break;
     }
+}
+
+/* IRQ handler */
+void irq_handler(struct registers *regs) {
+    /* Leaving tickless idle: restart the periodic tick and catch up time */
+    timer_nohz_exit();
+
+    /* Program a timer event another CPU queued for this one */
+    timer_event_sync();
+
+    /* Call the handlers drivers registered for this vector */
+    irq_dispatch((uint8_t)regs->int_no, regs);
+
+    /* IPIs, and every IRQ once the IOAPIC routes them, are acknowledged
+     * with one local APIC register write; the 8259s need port I/O */
+    if (regs->int_no >= IPI_VECTOR_RESCHED || ioapic_available()) {
+        lapic_eoi();
+    } else {
+        pic_send_eoi((uint8_t)(regs->int_no - 32));
+    }
+
+    /* Bottom halves run with interrupts enabled; a nested interrupt
+     * leaves them and the task switch to the outer one */
+    do_softirq();
 
-    /* Send EOI to PIC */
-    if (regs->int_no >= 40) {
-        /* Send EOI to slave PIC */
-        __asm__ volatile("outb %0, %1" : : "a"((uint8_t)0x20), "Nd"((uint16_t)0xA0));
+    /* Switch tasks if the tick or a wakeup asked for it */
+    if (!in_softirq()) {
+        scheduler_preempt();
     }
-    /* Send EOI to master PIC */
-    __asm__ volatile("outb %0, %1" : : "a"((uint8_t)0x20), "Nd"((uint16_t)0x20));
 }
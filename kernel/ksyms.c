@@ -0,0 +1,44 @@
+#include "ksyms.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Provided by the generated table in the final link only */
+extern const ksym_t ksym_table[] __attribute__((weak));
+extern const uint32_t ksym_count __attribute__((weak));
+
+uint32_t ksym_count_get(void) {
+    return &ksym_count ? ksym_count : 0;
+}
+
+const ksym_t *ksym_get(int index) {
+    if (index < 0 || (uint32_t)index >= ksym_count_get()) return NULL;
+    return &ksym_table[index];
+}
+
+int ksym_index(uint64_t addr) {
+    if (!ksym_is_text(addr)) return -1;
+
+    /* Last symbol at or below addr */
+    uint32_t lo = 0;
+    uint32_t hi = ksym_count_get();
+    if (hi == 0 || addr < ksym_table[0].addr) return -1;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ksym_table[mid].addr <= addr) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return (int)lo;
+}
+
+const char *ksym_lookup(uint64_t addr, uint64_t *offset) {
+    int index = ksym_index(addr);
+    if (index < 0) return NULL;
+    if (offset) {
+        *offset = addr - ksym_table[index].addr;
+    }
+    return ksym_table[index].name;
+}
@@ -0,0 +1,118 @@
+#include "ktime.h"
+#include "cpu.h"
+#include "../../drivers/include/hpet.h"
+#include "../../drivers/include/timer.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Calibration: several short runs, keeping the lowest rate (a delay in
+ * noticing the end of a run only adds cycles) */
+#define KTIME_CALIBRATE_RUNS 3
+#define KTIME_CALIBRATE_MS   10
+
+/* CPUID leaf 0x80000007 EDX: invariant TSC */
+#define CPUID_EDX_INVARIANT_TSC (1U << 8)
+
+/* Fixed point shift of the conversion multipliers */
+#define KTIME_MULT_SHIFT 32
+
+static int source = KTIME_SOURCE_TICK;
+static bool tsc_invariant = false;
+static uint64_t tsc_khz = 0;
+static uint64_t tsc_base = 0;
+static uint64_t tsc_to_ns_mult = 0;    /* ns = (cycles * mult) >> shift */
+static uint64_t ns_to_tsc_mult = 0;    /* cycles = (ns * mult) >> shift */
+static uint64_t hpet_base = 0;
+static uint64_t hpet_to_ns_mult = 0;
+
+static inline uint64_t mul_shift(uint64_t value, uint64_t mult) {
+    return (uint64_t)(((unsigned __int128)value * mult) >> KTIME_MULT_SHIFT);
+}
+
+static bool detect_invariant_tsc(void) {
+    uint32_t max_leaf, edx;
+    cpuid(0x80000000, 0, &max_leaf, NULL, NULL, NULL);
+    if (max_leaf < 0x80000007) return false;
+    cpuid(0x80000007, 0, NULL, NULL, NULL, &edx);
+    return (edx & CPUID_EDX_INVARIANT_TSC) != 0;
+}
+
+static uint64_t calibrate_tsc_khz(void) {
+    uint64_t best = 0;
+    for (int i = 0; i < KTIME_CALIBRATE_RUNS; i++) {
+        uint64_t khz = hpet_available()
+            ? hpet_measure_tsc_khz(KTIME_CALIBRATE_MS)
+            : timer_pit_measure_tsc_khz(KTIME_CALIBRATE_MS);
+        if (khz && (!best || khz < best)) {
+            best = khz;
+        }
+    }
+    return best;
+}
+
+void ktime_init(void) {
+    tsc_invariant = detect_invariant_tsc();
+    tsc_khz = calibrate_tsc_khz();
+    if (tsc_khz) {
+        tsc_to_ns_mult = (1000000ULL << KTIME_MULT_SHIFT) / tsc_khz;
+        ns_to_tsc_mult = (tsc_khz << KTIME_MULT_SHIFT) / 1000000ULL;
+    }
+    if (hpet_available()) {
+        hpet_to_ns_mult = ((uint64_t)hpet_period_fs() << KTIME_MULT_SHIFT) / 1000000ULL;
+    }
+
+    /* A TSC that may change rate or stop in idle is only used when
+     * there is nothing better */
+    if (tsc_khz && tsc_invariant) {
+        source = KTIME_SOURCE_TSC;
+    } else if (hpet_available()) {
+        source = KTIME_SOURCE_HPET;
+    } else if (tsc_khz) {
+        source = KTIME_SOURCE_TSC;
+    } else {
+        source = KTIME_SOURCE_TICK;
+    }
+
+    tsc_base = rdtsc();
+    hpet_base = hpet_read_counter();
+}
+
+uint64_t ktime_ns(void) {
+    switch (source) {
+        case KTIME_SOURCE_TSC:
+            return mul_shift(rdtsc() - tsc_base, tsc_to_ns_mult);
+        case KTIME_SOURCE_HPET:
+            return mul_shift(hpet_read_counter() - hpet_base, hpet_to_ns_mult);
+        default:
+            return timer_get_ticks() * 1000000ULL;
+    }
+}
+
+uint64_t ktime_tsc_khz(void) {
+    return tsc_khz;
+}
+
+bool ktime_tsc_invariant(void) {
+    return tsc_invariant;
+}
+
+int ktime_source(void) {
+    return source;
+}
+
+const char *ktime_source_name(void) {
+    switch (source) {
+        case KTIME_SOURCE_TSC:  return "tsc";
+        case KTIME_SOURCE_HPET: return "hpet";
+        default:                return "tick";
+    }
+}
+
+uint64_t ktime_cycles_to_ns(uint64_t c) {
+    return mul_shift(c, tsc_to_ns_mult);
+}
+
+uint64_t ktime_ns_to_cycles(uint64_t ns) {
+    return mul_shift(ns, ns_to_tsc_mult);
+}
@@ -1,4 +1,5 @@
 #include "log.h"
+#include "spinlock.h"
 #include "../../drivers/include/framebuffer.h"
 #include <stdarg.h>
 #include <stdbool.h>
@@ -8,6 +9,7 @@
 static char log_buffer[LOG_BUFFER_SIZE];
 static int log_offset = 0;
 static bool log_initialized = false;
+static spinlock_t log_lock = SPINLOCK_INIT;
 
 /* String functions */
 static void strcpy(char *dest, const char *src) {
@@ -70,12 +72,14 @@ void log_message(log_level_t level, const char *subsystem, const char *message)
     int entry_len = 0;
     while (entry[entry_len]) entry_len++;
     
+    uint64_t flags = spin_lock_irqsave(&log_lock);
     if (log_offset + entry_len + 2 < LOG_BUFFER_SIZE) {
         strcpy(log_buffer + log_offset, entry);
         log_offset += entry_len;
         log_buffer[log_offset++] = '\n';
         log_buffer[log_offset] = '\0';
     }
+    spin_unlock_irqrestore(&log_lock, flags);
     
     /* Also output to screen for debugging (optional) */
     /* fb_draw_string(10, 50 + log_offset, entry, COLOR_WHITE); */
@@ -3,16 +3,30 @@
 #include "memory.h"
 #include "gdt.h"
 #include "idt.h"
+#include "fpu.h"
 #include "log.h"
 #include "process.h"
 #include "syscall.h"
 #include "vfs.h"
+#include "workqueue.h"
+#include "softirq.h"
+#include "smp.h"
+#include "paging.h"
+#include "acpi.h"
+#include "ktime.h"
+#include "hrtimer.h"
+#include "elf.h"
+#include "selftest.h"
 #include "../drivers/include/framebuffer.h"
 #include "../drivers/include/pic.h"
 #include "../drivers/include/timer.h"
+#include "../drivers/include/hpet.h"
+#include "../drivers/include/apic.h"
+#include "../drivers/include/ioapic.h"
 #include "../drivers/include/keyboard.h"
 #include "../drivers/include/mouse.h"
 #include "../drivers/include/ata.h"
+#include "../drivers/include/serial.h"
 #include <stdint.h>
 
 /* Limine requests - marked as used to prevent compiler optimization */
@@ -34,6 +48,19 @@ static volatile struct limine_hhdm_request hhdm_request = {
     .revision = 0
 };
 
+__attribute__((used, section(".requests")))
+static volatile struct limine_rsdp_request rsdp_request = {
+    .id = {LIMINE_COMMON_MAGIC, 0xc5e77b6b397e7b43, 0x27637845accdcf3c},
+    .revision = 0
+};
+
+__attribute__((used, section(".requests")))
+static volatile struct limine_smp_request smp_request = {
+    .id = {LIMINE_COMMON_MAGIC, 0x95a67b819a1b857e, 0xa0b61b723b6a73e0},
+    .revision = 0,
+    .flags = 0
+};
+
 /* Limine base revision - required for protocol version checking */
 /* Magic numbers represent: {protocol_magic_1, protocol_magic_2, protocol_version} */
 __attribute__((used, section(".requests")))
@@ -44,27 +71,15 @@ static volatile uint64_t limine_base_revision[3] = {
 /* Global framebuffer pointer */
 struct limine_framebuffer *fb = NULL;
 
-/* Serial port constants for debugging */
-#define COM1_PORT 0x3F8
+/* GUI frame period and the CPU time reserved for each frame (ms) */
+#define GUI_FRAME_MS        16
+#define GUI_FRAME_BUDGET_MS 8
 
-/* Simple port I/O functions */
-static inline void __outb(uint16_t port, uint8_t val) {
-    __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
-}
-
-static inline uint8_t __inb(uint16_t port) {
-    uint8_t ret;
-    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
-    return ret;
-}
+/* Frame bitmap for the physical memory manager */
+static uint8_t pmm_bitmap[PMM_MAX_MEMORY / PAGE_SIZE / 8];
 
-/* Simple serial port output for debugging */
-static void serial_write_string(const char *str) {
-    while (*str) {
-        while ((__inb(COM1_PORT + 5) & 0x20) == 0);
-        __outb(COM1_PORT, *str++);
-    }
-}
+/* First user program, started from the disk when present */
+#define USER_INIT_PATH "/INIT.ELF"
 
 /* Halt the CPU */
 static void halt(void) {
@@ -75,11 +90,63 @@ static void halt(void) {
 
 /* Kernel panic */
 void kernel_panic(const char *message) {
-    (void)message;
-    // TODO: Display error message
+    __asm__ volatile ("cli");
+    serial_write_string("BasicOS: PANIC - ");
+    serial_write_string(message);
+    serial_write_string("\n");
     halt();
 }
 
+/* Give the physical memory manager the usable RAM from the memory map
+ * (page tables and user pages come from it; the heap is static) */
+static void pmm_setup(void) {
+    struct limine_memmap_response *map = memmap_request.response;
+    if (!map) {
+        serial_write_string("BasicOS: WARNING - No memory map, user processes disabled\n");
+        return;
+    }
+
+    uint64_t top = 0;
+    for (uint64_t i = 0; i < map->entry_count; i++) {
+        const struct limine_memmap_entry *entry = map->entries[i];
+        if (entry->type == LIMINE_MEMMAP_USABLE && entry->base + entry->length > top) {
+            top = entry->base + entry->length;
+        }
+    }
+    if (top > PMM_MAX_MEMORY) {
+        top = PMM_MAX_MEMORY;
+    }
+
+    pmm_init(pmm_bitmap, top);
+    for (uint64_t i = 0; i < map->entry_count; i++) {
+        const struct limine_memmap_entry *entry = map->entries[i];
+        if (entry->type == LIMINE_MEMMAP_USABLE) {
+            pmm_add_region(entry->base, entry->length);
+        }
+    }
+}
+
+/* Body of the first user process: replace the kernel-side start with
+ * the program (elf_exec only returns on failure) */
+static void user_init_main(void) {
+    elf_exec(USER_INIT_PATH);
+    LOG_ERROR_MSG("Init", "Could not load " USER_INIT_PATH);
+}
+
+/* Start the first user process if its program is on the disk */
+static void user_init_start(void) {
+    if (!vfs_exists(USER_INIT_PATH)) {
+        LOG_INFO_MSG("Init", "No " USER_INIT_PATH " on disk, no user process started");
+        return;
+    }
+    process_t *init = process_create("init", user_init_main);
+    if (!init) {
+        LOG_ERROR_MSG("Init", "Could not create the user address space");
+        return;
+    }
+    scheduler_add(init);
+}
+
 /* Main kernel entry point */
 void kernel_main(void) {
     serial_write_string("BasicOS: Kernel starting...\n");
@@ -88,6 +155,9 @@ void kernel_main(void) {
     gdt_init();
     serial_write_string("BasicOS: GDT initialized\n");
 
+    /* Per-CPU data for the bootstrap CPU (GS base, reset by gdt_init) */
+    percpu_init_bsp();
+
     /* Initialize IDT */
     idt_init();
     serial_write_string("BasicOS: IDT initialized\n");
@@ -103,8 +173,17 @@ void kernel_main(void) {
 
     fb = framebuffer_request.response->framebuffers[0];
 
+    /* Higher-half direct map of physical memory */
+    if (hhdm_request.response) {
+        hhdm_offset = hhdm_request.response->offset;
+    }
+
     /* Initialize memory management */
     memory_init();
+    pmm_setup();
+
+    /* Initialize FPU/SSE state management (needs the heap) */
+    fpu_init();
 
     /* Initialize framebuffer driver */
     fb_init(fb->address, fb->width, fb->height, fb->pitch, fb->bpp);
@@ -112,9 +191,30 @@ void kernel_main(void) {
     /* Initialize PIC */
     pic_init();
 
+    /* Firmware tables (base revision 0 hands over an HHDM pointer) */
+    acpi_init(rsdp_request.response ? rsdp_request.response->address : NULL);
+    hpet_init();
+
+    /* Calibrate the TSC before the tick starts; the vDSO uses the rate */
+    ktime_init();
+
+    /* Route device IRQs through the IOAPIC when the MADT describes one,
+     * keeping their 8259 vectors; otherwise the 8259s stay in charge */
+    if (ioapic_init()) {
+        lapic_init();
+        pic_disable();
+        uint32_t bsp = lapic_id();
+        ioapic_route_isa(1, ISA_IRQ_VECTOR(1), bsp);     /* Keyboard */
+        ioapic_route_isa(12, ISA_IRQ_VECTOR(12), bsp);   /* Mouse */
+        ioapic_route_isa(14, ISA_IRQ_VECTOR(14), bsp);   /* Primary ATA */
+    }
+
     /* Initialize timer (1000 Hz = 1ms per tick) */
     timer_init(1000);
 
+    /* Nanosecond timers: one-shot events on the tick device or the HPET */
+    hrtimer_subsys_init();
+
     /* Initialize keyboard */
     keyboard_init();
 
@@ -124,6 +224,27 @@ void kernel_main(void) {
     /* Initialize logging system */
     log_init();
     LOG_INFO_MSG("Kernel", "BasicOS v2.0 - Daily Driver Edition");
+    if (ktime_source() == KTIME_SOURCE_TSC) {
+        LOG_INFO_MSG("Clock", ktime_tsc_invariant() ? "Clocksource: invariant TSC"
+                                                    : "Clocksource: TSC (not invariant, no HPET)");
+    } else if (ktime_source() == KTIME_SOURCE_HPET) {
+        LOG_INFO_MSG("Clock", "Clocksource: HPET (TSC not invariant)");
+    } else {
+        LOG_WARN_MSG("Clock", "Clocksource: timer ticks (TSC calibration failed)");
+    }
+    if (ioapic_available()) {
+        LOG_INFO_MSG("IRQ", timer_uses_lapic() ? "IOAPIC routing, local APIC timer"
+                                               : "IOAPIC routing, PIT timer");
+    } else {
+        LOG_INFO_MSG("IRQ", "8259 PIC routing, PIT timer");
+    }
+    if (timer_event_capable()) {
+        LOG_INFO_MSG("Timer", "High-resolution timers on the TSC-deadline timer");
+    } else if (hpet_oneshot_available()) {
+        LOG_INFO_MSG("Timer", "High-resolution timers on the HPET comparator");
+    } else {
+        LOG_WARN_MSG("Timer", "High-resolution timers limited to tick resolution");
+    }
     
     /* Initialize ATA disk driver */
     ata_init();
@@ -137,18 +258,35 @@ void kernel_main(void) {
     vfs_init();
     LOG_INFO_MSG("VFS", "Virtual File System initialized");
     
-    /* Initialize process management */
-    process_init();
+    /* Initialize process management (adopts this boot context as a task) */
     scheduler_init();
+    process_init();
     LOG_INFO_MSG("Scheduler", "Process scheduler initialized");
     
+    /* Start the system workqueue worker thread */
+    workqueue_init();
+    LOG_INFO_MSG("Workqueue", "System workqueue started");
+
+    /* Thread for tasklet backlogs that outlast IRQ exit */
+    softirq_init();
+    
     /* Initialize system calls */
     syscall_init();
     LOG_INFO_MSG("Syscall", "System call interface initialized");
 
+    /* Start the other CPUs; each runs its own scheduler */
+    smp_init(smp_request.response);
+    LOG_INFO_MSG("SMP", "Application processors started");
+
     /* Enable interrupts */
     __asm__ volatile ("sti");
 
+    /* Check the locking, IPC and timer paths before anything relies on them */
+    selftest_run();
+
+    /* Enter user mode: the first process execs its program from disk */
+    user_init_start();
+
     /* Clear screen to dark blue */
     fb_clear(RGB(20, 30, 50));
 
@@ -165,10 +303,24 @@ void kernel_main(void) {
     extern void gui_render(void);
     gui_init();
 
-    /* Main loop */
+    /* Reserve CPU time for each frame so rendering keeps up under load */
+    if (process_set_deadline(process_get_current()->pid, GUI_FRAME_BUDGET_MS,
+                             GUI_FRAME_MS, GUI_FRAME_MS) != 0) {
+        LOG_WARN_MSG("GUI", "Frame reservation refused, using the fair class");
+    }
+
+    /* Main loop: one frame per period (~60 FPS) */
+    uint64_t next_frame = timer_get_ticks();
     while (1) {
         gui_update();
         gui_render();
-        timer_wait(16);  /* ~60 FPS */
+
+        next_frame += GUI_FRAME_MS;
+        uint64_t now = timer_get_ticks();
+        if (now < next_frame) {
+            timer_wait((uint32_t)(next_frame - now));
+        } else {
+            next_frame = now;  /* Fell behind: drop the missed frames */
+        }
     }
 }
@@ -1,4 +1,7 @@
 #include "memory.h"
+#include "fpu.h"
+#include "cpu.h"
+#include "spinlock.h"
 #include <stdint.h>
 #include <stddef.h>
 
@@ -6,6 +9,9 @@
 #define HEAP_SIZE (1024 * 1024 * 16)  /* 16 MB heap */
 #define HEAP_MAGIC 0xDEADBEEF
 
+/* Protects the block list against other CPUs and interrupt handlers */
+static spinlock_t heap_lock = SPINLOCK_INIT;
+
 /* Heap block header */
 typedef struct heap_block {
     uint32_t magic;           /* Magic number for validation */
@@ -62,9 +68,13 @@ void *kmalloc(size_t size) {
     /* Align to 16 bytes */
     size = (size + 15) & ~15;
     
+    /* The heap is shared with other CPUs, threads and IRQ-context code */
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+    
     /* Find a free block */
     heap_block_t *block = find_free_block(size);
     if (!block) {
+        spin_unlock_irqrestore(&heap_lock, flags);
         return NULL;  /* Out of memory */
     }
     
@@ -73,6 +83,7 @@ void *kmalloc(size_t size) {
     
     /* Mark as allocated */
     block->free = false;
+    spin_unlock_irqrestore(&heap_lock, flags);
     
     /* Return pointer after the header */
     return (void *)((uint8_t *)block + sizeof(heap_block_t));
@@ -107,11 +118,14 @@ void kfree(void *ptr) {
         return;  /* Invalid pointer or corrupted memory */
     }
     
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+    
     /* Mark as free */
     block->free = true;
     
     /* Merge adjacent free blocks */
     merge_free_blocks();
+    spin_unlock_irqrestore(&heap_lock, flags);
 }
 
 /* Memory operations */
@@ -132,6 +146,47 @@ void *memcpy(void *dest, const void *src, size_t n) {
     return dest;
 }
 
+/* SIMD copy chunk: bounds how long interrupts stay disabled */
+#define SIMD_CHUNK (64 * 1024)
+
+/* Vectorized copy for large buffers using SSE inside kernel FPU sections */
+void *memcpy_simd(void *dest, const void *src, size_t n) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+
+    if (!fpu_simd_available()) {
+        return memcpy(dest, src, n);
+    }
+
+    while (n >= 64) {
+        size_t chunk = (n < SIMD_CHUNK) ? n : SIMD_CHUNK;
+        size_t blocks = chunk / 64;
+
+        kernel_fpu_begin();
+        for (size_t i = 0; i < blocks; i++) {
+            __asm__ volatile (
+                "movdqu 0(%1), %%xmm0\n\t"
+                "movdqu 16(%1), %%xmm1\n\t"
+                "movdqu 32(%1), %%xmm2\n\t"
+                "movdqu 48(%1), %%xmm3\n\t"
+                "movdqu %%xmm0, 0(%0)\n\t"
+                "movdqu %%xmm1, 16(%0)\n\t"
+                "movdqu %%xmm2, 32(%0)\n\t"
+                "movdqu %%xmm3, 48(%0)\n\t"
+                :: "r"(d), "r"(s) : "memory");
+            d += 64;
+            s += 64;
+        }
+        kernel_fpu_end();
+
+        n -= blocks * 64;
+    }
+
+    /* Tail bytes */
+    memcpy(d, s, n);
+    return dest;
+}
+
 int memcmp(const void *s1, const void *s2, size_t n) {
     const uint8_t *p1 = s1;
     const uint8_t *p2 = s2;
@@ -1,5 +1,7 @@
 #include "paging.h"
 #include "memory.h"
+#include "cpu.h"
+#include "spinlock.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -8,6 +10,10 @@ static uint8_t *pmm_bitmap = NULL;
 static size_t pmm_bitmap_size = 0;
 static size_t pmm_total_frames = 0;
 static size_t pmm_free_frames = 0;
+static spinlock_t pmm_lock = SPINLOCK_INIT;
+
+/* Higher-half direct map offset */
+uint64_t hhdm_offset = 0;
 
 /* Kernel page tables */
 static pml4_t *kernel_pml4 = NULL;
@@ -37,25 +43,42 @@ void pmm_init(void *bitmap, size_t memory_size) {
     pmm_free_frames = 0;
 }
 
+/* Make the whole frames of a usable memory range allocatable. Frame 0
+ * stays in use: its address would read as an allocation failure. */
+void pmm_add_region(uint64_t base, uint64_t length) {
+    uint64_t first = (base + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t end = (base + length) / PAGE_SIZE;
+    if (first == 0) first = 1;
+    for (uint64_t i = first; i < end && i < pmm_total_frames; i++) {
+        pmm_free_frame((void *)(i * PAGE_SIZE));
+    }
+}
+
 /* Allocate a physical frame */
 void *pmm_alloc_frame(void) {
+    void *frame = NULL;
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
     for (size_t i = 0; i < pmm_total_frames; i++) {
         if (!bitmap_test(pmm_bitmap, i)) {
             bitmap_set(pmm_bitmap, i);
             pmm_free_frames--;
-            return (void *)(i * PAGE_SIZE);
+            frame = (void *)(i * PAGE_SIZE);
+            break;
         }
     }
-    return NULL;  /* Out of memory */
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return frame;  /* NULL when out of memory */
 }
 
 /* Free a physical frame */
 void pmm_free_frame(void *frame) {
     size_t frame_index = (size_t)frame / PAGE_SIZE;
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
     if (frame_index < pmm_total_frames && bitmap_test(pmm_bitmap, frame_index)) {
         bitmap_clear(pmm_bitmap, frame_index);
         pmm_free_frames++;
     }
+    spin_unlock_irqrestore(&pmm_lock, flags);
 }
 
 /* Get free memory in bytes */
@@ -85,12 +108,29 @@ static inline uint64_t pt_index(uint64_t virt) {
     return (virt >> 12) & 0x1FF;
 }
 
-/* Create a new address space */
+/* Physical address in a table entry */
+#define PAGE_ENTRY_ADDR 0x000FFFFFFFFFF000ULL
+
+/* Tables are named by physical address (as CR3 and the entries hold
+ * them) and reached through the direct map: the lower half of a user
+ * address space maps nothing of the kernel's */
+static inline void *table_virt(uint64_t phys) {
+    return phys_to_virt(phys & PAGE_ENTRY_ADDR);
+}
+
+/* Create a new address space; returns the physical address of its PML4 */
 pml4_t *vmm_create_address_space(void) {
     pml4_t *pml4 = (pml4_t *)pmm_alloc_frame();
     if (!pml4) return NULL;
     
-    memset(pml4, 0, sizeof(pml4_t));
+    pml4_t *table = (pml4_t *)table_virt((uint64_t)pml4);
+    memset(table, 0, sizeof(pml4_t));
+
+    /* Share the kernel half (and its direct map) with every address space */
+    const pml4_t *active = (const pml4_t *)phys_to_virt(read_cr3() & ~0xFFFULL);
+    for (int i = PAGE_ENTRIES / 2; i < PAGE_ENTRIES; i++) {
+        table->entries[i] = active->entries[i];
+    }
     return pml4;
 }
 
@@ -103,8 +143,9 @@ void vmm_destroy_address_space(pml4_t *pml4) {
 }
 
 /* Map a virtual page to a physical frame */
-bool vmm_map_page(pml4_t *pml4, uint64_t virt, uint64_t phys, uint64_t flags) {
-    if (!pml4) return false;
+bool vmm_map_page(pml4_t *pml4_phys, uint64_t virt, uint64_t phys, uint64_t flags) {
+    if (!pml4_phys) return false;
+    pml4_t *pml4 = (pml4_t *)table_virt((uint64_t)pml4_phys);
     
     /* Get indices */
     uint64_t pml4i = pml4_index(virt);
@@ -115,34 +156,37 @@ bool vmm_map_page(pml4_t *pml4, uint64_t virt, uint64_t phys, uint64_t flags) {
     /* Get or create PDP */
     page_directory_pointer_t *pdp;
     if (!(pml4->entries[pml4i] & PAGE_PRESENT)) {
-        pdp = (page_directory_pointer_t *)pmm_alloc_frame();
-        if (!pdp) return false;
+        void *frame = pmm_alloc_frame();
+        if (!frame) return false;
+        pdp = (page_directory_pointer_t *)table_virt((uint64_t)frame);
         memset(pdp, 0, sizeof(page_directory_pointer_t));
-        pml4->entries[pml4i] = (uint64_t)pdp | PAGE_PRESENT | PAGE_WRITE | (flags & PAGE_USER);
+        pml4->entries[pml4i] = (uint64_t)frame | PAGE_PRESENT | PAGE_WRITE | (flags & PAGE_USER);
     } else {
-        pdp = (page_directory_pointer_t *)(pml4->entries[pml4i] & ~0xFFF);
+        pdp = (page_directory_pointer_t *)table_virt(pml4->entries[pml4i]);
     }
     
     /* Get or create PD */
     page_directory_t *pd;
     if (!(pdp->entries[pdpi] & PAGE_PRESENT)) {
-        pd = (page_directory_t *)pmm_alloc_frame();
-        if (!pd) return false;
+        void *frame = pmm_alloc_frame();
+        if (!frame) return false;
+        pd = (page_directory_t *)table_virt((uint64_t)frame);
         memset(pd, 0, sizeof(page_directory_t));
-        pdp->entries[pdpi] = (uint64_t)pd | PAGE_PRESENT | PAGE_WRITE | (flags & PAGE_USER);
+        pdp->entries[pdpi] = (uint64_t)frame | PAGE_PRESENT | PAGE_WRITE | (flags & PAGE_USER);
     } else {
-        pd = (page_directory_t *)(pdp->entries[pdpi] & ~0xFFF);
+        pd = (page_directory_t *)table_virt(pdp->entries[pdpi]);
     }
     
     /* Get or create PT */
     page_table_t *pt;
     if (!(pd->entries[pdi] & PAGE_PRESENT)) {
-        pt = (page_table_t *)pmm_alloc_frame();
-        if (!pt) return false;
+        void *frame = pmm_alloc_frame();
+        if (!frame) return false;
+        pt = (page_table_t *)table_virt((uint64_t)frame);
         memset(pt, 0, sizeof(page_table_t));
-        pd->entries[pdi] = (uint64_t)pt | PAGE_PRESENT | PAGE_WRITE | (flags & PAGE_USER);
+        pd->entries[pdi] = (uint64_t)frame | PAGE_PRESENT | PAGE_WRITE | (flags & PAGE_USER);
     } else {
-        pt = (page_table_t *)(pd->entries[pdi] & ~0xFFF);
+        pt = (page_table_t *)table_virt(pd->entries[pdi]);
     }
     
     /* Map the page */
@@ -155,50 +199,82 @@ bool vmm_map_page(pml4_t *pml4, uint64_t virt, uint64_t phys, uint64_t flags) {
 }
 
 /* Unmap a virtual page */
-void vmm_unmap_page(pml4_t *pml4, uint64_t virt) {
-    if (!pml4) return;
+void vmm_unmap_page(pml4_t *pml4_phys, uint64_t virt) {
+    if (!pml4_phys) return;
+    pml4_t *pml4 = (pml4_t *)table_virt((uint64_t)pml4_phys);
     
     uint64_t pml4i = pml4_index(virt);
     if (!(pml4->entries[pml4i] & PAGE_PRESENT)) return;
     
-    page_directory_pointer_t *pdp = (page_directory_pointer_t *)(pml4->entries[pml4i] & ~0xFFF);
+    page_directory_pointer_t *pdp = (page_directory_pointer_t *)table_virt(pml4->entries[pml4i]);
     uint64_t pdpi = pdp_index(virt);
     if (!(pdp->entries[pdpi] & PAGE_PRESENT)) return;
     
-    page_directory_t *pd = (page_directory_t *)(pdp->entries[pdpi] & ~0xFFF);
+    page_directory_t *pd = (page_directory_t *)table_virt(pdp->entries[pdpi]);
     uint64_t pdi = pd_index(virt);
     if (!(pd->entries[pdi] & PAGE_PRESENT)) return;
     
-    page_table_t *pt = (page_table_t *)(pd->entries[pdi] & ~0xFFF);
+    page_table_t *pt = (page_table_t *)table_virt(pd->entries[pdi]);
     uint64_t pti = pt_index(virt);
     
     /* Clear the entry */
     pt->entries[pti] = 0;
     
-    /* Flush TLB */
-    __asm__ volatile ("invlpg (%0)" :: "r"(virt) : "memory");
+    /* Flush TLB here and on other CPUs that may cache the mapping */
+    tlb_flush_page(virt);
 }
 
 /* Get physical address for virtual address */
-uint64_t vmm_get_physical(pml4_t *pml4, uint64_t virt) {
-    if (!pml4) return 0;
+uint64_t vmm_get_physical(pml4_t *pml4_phys, uint64_t virt) {
+    if (!pml4_phys) return 0;
+    pml4_t *pml4 = (pml4_t *)table_virt((uint64_t)pml4_phys);
     
     uint64_t pml4i = pml4_index(virt);
     if (!(pml4->entries[pml4i] & PAGE_PRESENT)) return 0;
     
-    page_directory_pointer_t *pdp = (page_directory_pointer_t *)(pml4->entries[pml4i] & ~0xFFF);
+    page_directory_pointer_t *pdp = (page_directory_pointer_t *)table_virt(pml4->entries[pml4i]);
     uint64_t pdpi = pdp_index(virt);
     if (!(pdp->entries[pdpi] & PAGE_PRESENT)) return 0;
     
-    page_directory_t *pd = (page_directory_t *)(pdp->entries[pdpi] & ~0xFFF);
+    page_directory_t *pd = (page_directory_t *)table_virt(pdp->entries[pdpi]);
     uint64_t pdi = pd_index(virt);
     if (!(pd->entries[pdi] & PAGE_PRESENT)) return 0;
     
-    page_table_t *pt = (page_table_t *)(pd->entries[pdi] & ~0xFFF);
+    page_table_t *pt = (page_table_t *)table_virt(pd->entries[pdi]);
     uint64_t pti = pt_index(virt);
     if (!(pt->entries[pti] & PAGE_PRESENT)) return 0;
     
-    return (pt->entries[pti] & ~0xFFF) | (virt & 0xFFF);
+    return (pt->entries[pti] & PAGE_ENTRY_ADDR) | (virt & 0xFFF);
+}
+
+/* Translate a kernel virtual address through the active page tables
+ * (reached via the direct map; 1GB and 2MB pages are handled) */
+uint64_t vmm_virt_to_phys(uint64_t virt) {
+    uint64_t cr3;
+    __asm__ volatile ("mov %%cr3, %0" : "=r"(cr3));
+
+    uint64_t *table = (uint64_t *)phys_to_virt(cr3 & ~0xFFFULL);
+    uint64_t entry = table[pml4_index(virt)];
+    if (!(entry & PAGE_PRESENT)) return 0;
+
+    table = (uint64_t *)phys_to_virt(entry & 0x000FFFFFFFFFF000ULL);
+    entry = table[pdp_index(virt)];
+    if (!(entry & PAGE_PRESENT)) return 0;
+    if (entry & PAGE_HUGE) {
+        return (entry & 0x000FFFFFC0000000ULL) | (virt & 0x3FFFFFFF);
+    }
+
+    table = (uint64_t *)phys_to_virt(entry & 0x000FFFFFFFFFF000ULL);
+    entry = table[pd_index(virt)];
+    if (!(entry & PAGE_PRESENT)) return 0;
+    if (entry & PAGE_HUGE) {
+        return (entry & 0x000FFFFFFFE00000ULL) | (virt & 0x1FFFFF);
+    }
+
+    table = (uint64_t *)phys_to_virt(entry & 0x000FFFFFFFFFF000ULL);
+    entry = table[pt_index(virt)];
+    if (!(entry & PAGE_PRESENT)) return 0;
+    return (entry & 0x000FFFFFFFFFF000ULL) | (virt & 0xFFF);
 }
 
 /* Switch to a different address space */
@@ -0,0 +1,242 @@
+#include "pipe.h"
+#include "sync.h"
+#include "spinlock.h"
+#include "memory.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct pipe {
+    uint8_t buf[PIPE_SIZE];
+    volatile uint32_t head;     /* Next byte to write (producer only) */
+    volatile uint32_t tail;     /* Next byte to read (consumer only) */
+    volatile uint32_t readers;  /* Open ends, under lock */
+    volatile uint32_t writers;
+    uint32_t refs;              /* Open ends plus operations in progress, under lock */
+    spinlock_t lock;
+    mutex_t read_lock;          /* Keeps the ring single-consumer */
+    mutex_t write_lock;         /* Keeps the ring single-producer */
+    wait_queue_t read_wait;     /* Readers waiting for data */
+    wait_queue_t write_wait;    /* Writers waiting for space */
+};
+
+static inline uint32_t pipe_used(pipe_t *pipe) {
+    return __atomic_load_n(&pipe->head, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&pipe->tail, __ATOMIC_ACQUIRE);
+}
+
+static inline bool pipe_readable(pipe_t *pipe) {
+    return pipe_used(pipe) != 0 || pipe->writers == 0;
+}
+
+static inline bool pipe_writable(pipe_t *pipe) {
+    return pipe_used(pipe) != PIPE_SIZE || pipe->readers == 0;
+}
+
+/* Whether the other side has closed its last end, read under the lock
+ * once a waiter is back (pipe_close changes the counts under it) */
+static bool pipe_peer_closed(pipe_t *pipe, bool writing) {
+    uint64_t flags = spin_lock_irqsave(&pipe->lock);
+    bool closed = writing ? pipe->readers == 0 : pipe->writers == 0;
+    spin_unlock_irqrestore(&pipe->lock, flags);
+    return closed;
+}
+
+/* An operation pins the pipe so that closing the last end while it is
+ * asleep on a wait queue cannot free the ring under it. The caller
+ * holds an end, so the pipe is alive when the operation starts. */
+static void pipe_get(pipe_t *pipe) {
+    uint64_t flags = spin_lock_irqsave(&pipe->lock);
+    pipe->refs++;
+    spin_unlock_irqrestore(&pipe->lock, flags);
+}
+
+static void pipe_put(pipe_t *pipe) {
+    uint64_t flags = spin_lock_irqsave(&pipe->lock);
+    bool last = --pipe->refs == 0;
+    spin_unlock_irqrestore(&pipe->lock, flags);
+    if (last) {
+        kfree(pipe);
+    }
+}
+
+pipe_t *pipe_create(void) {
+    pipe_t *pipe = (pipe_t *)kmalloc(sizeof(pipe_t));
+    if (!pipe) return NULL;
+
+    pipe->head = 0;
+    pipe->tail = 0;
+    pipe->readers = 1;
+    pipe->writers = 1;
+    pipe->refs = 2;
+    spin_init(&pipe->lock);
+    mutex_init(&pipe->read_lock);
+    mutex_init(&pipe->write_lock);
+    wait_queue_init(&pipe->read_wait);
+    wait_queue_init(&pipe->write_wait);
+    return pipe;
+}
+
+void pipe_close(pipe_t *pipe, bool write_end) {
+    /* Wake both sides: the other one sees end of file or a broken pipe,
+     * and anyone still waiting re-checks the counts. Sleepers hold a
+     * reference, so the ring outlives them. */
+    uint64_t flags = spin_lock_irqsave(&pipe->lock);
+    if (write_end) {
+        pipe->writers--;
+    } else {
+        pipe->readers--;
+    }
+    wake_up_all(&pipe->read_wait);
+    wake_up_all(&pipe->write_wait);
+    spin_unlock_irqrestore(&pipe->lock, flags);
+
+    pipe_put(pipe);
+}
+
+/* Take the lock for one end; a non-blocking caller never sleeps on it */
+static bool pipe_lock_end(mutex_t *lock, bool nonblock) {
+    if (nonblock) return mutex_trylock(lock);
+    mutex_lock(lock);
+    return true;
+}
+
+/* Producer step (write_lock held): wait for space, let fill write into
+ * it and publish what it wrote */
+static int pipe_produce(pipe_t *pipe, pipe_fill_fn fill, void *ctx, uint32_t len, bool nonblock) {
+    if (!nonblock) {
+        wait_event(&pipe->write_wait, pipe_writable(pipe));
+    }
+    if (pipe_peer_closed(pipe, true)) return -1;
+
+    uint32_t head = pipe->head;
+    uint32_t space = PIPE_SIZE - (head - __atomic_load_n(&pipe->tail, __ATOMIC_ACQUIRE));
+    if (space == 0) return PIPE_EAGAIN;
+    if (len > space) len = space;
+
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t offset = (head + done) & (PIPE_SIZE - 1);
+        uint32_t chunk = len - done;
+        if (chunk > PIPE_SIZE - offset) chunk = PIPE_SIZE - offset;
+
+        int n = fill(ctx, &pipe->buf[offset], chunk);
+        if (n < 0) {
+            if (done == 0) return -1;
+            break;
+        }
+        done += (uint32_t)n;
+        if ((uint32_t)n < chunk) break;
+    }
+
+    if (done) {
+        /* Data before index: pairs with the consumer's acquire load */
+        __atomic_store_n(&pipe->head, head + done, __ATOMIC_RELEASE);
+        wake_up_all(&pipe->read_wait);
+    }
+    return (int)done;
+}
+
+/* Consumer step (read_lock held): wait for data, hand it to drain in
+ * place and release what it used */
+static int pipe_consume(pipe_t *pipe, pipe_drain_fn drain, void *ctx, uint32_t len, bool nonblock) {
+    if (!nonblock) {
+        wait_event(&pipe->read_wait, pipe_readable(pipe));
+    }
+
+    uint32_t tail = pipe->tail;
+    uint32_t avail = __atomic_load_n(&pipe->head, __ATOMIC_ACQUIRE) - tail;
+    if (avail == 0) {
+        return pipe_peer_closed(pipe, false) ? 0 : PIPE_EAGAIN;
+    }
+    if (len > avail) len = avail;
+
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t offset = (tail + done) & (PIPE_SIZE - 1);
+        uint32_t chunk = len - done;
+        if (chunk > PIPE_SIZE - offset) chunk = PIPE_SIZE - offset;
+
+        int n = drain(ctx, &pipe->buf[offset], chunk);
+        if (n < 0) {
+            if (done == 0) return -1;
+            break;
+        }
+        done += (uint32_t)n;
+        if ((uint32_t)n < chunk) break;
+    }
+
+    if (done) {
+        /* Reads finish before the space is handed back */
+        __atomic_store_n(&pipe->tail, tail + done, __ATOMIC_RELEASE);
+        wake_up_all(&pipe->write_wait);
+    }
+    return (int)done;
+}
+
+int pipe_fill(pipe_t *pipe, pipe_fill_fn fill, void *ctx, uint32_t len, bool nonblock) {
+    if (len == 0) return 0;
+    pipe_get(pipe);
+    int result = PIPE_EAGAIN;
+    if (pipe_lock_end(&pipe->write_lock, nonblock)) {
+        result = pipe_produce(pipe, fill, ctx, len, nonblock);
+        mutex_unlock(&pipe->write_lock);
+    }
+    pipe_put(pipe);
+    return result;
+}
+
+int pipe_drain(pipe_t *pipe, pipe_drain_fn drain, void *ctx, uint32_t len, bool nonblock) {
+    if (len == 0) return 0;
+    pipe_get(pipe);
+    int result = PIPE_EAGAIN;
+    if (pipe_lock_end(&pipe->read_lock, nonblock)) {
+        result = pipe_consume(pipe, drain, ctx, len, nonblock);
+        mutex_unlock(&pipe->read_lock);
+    }
+    pipe_put(pipe);
+    return result;
+}
+
+/* Plain read/write copy through a cursor into the caller's buffer */
+static int pipe_copy_out(void *ctx, const uint8_t *src, uint32_t len) {
+    uint8_t **cursor = (uint8_t **)ctx;
+    memcpy(*cursor, src, len);
+    *cursor += len;
+    return (int)len;
+}
+
+static int pipe_copy_in(void *ctx, uint8_t *dst, uint32_t len) {
+    const uint8_t **cursor = (const uint8_t **)ctx;
+    memcpy(dst, *cursor, len);
+    *cursor += len;
+    return (int)len;
+}
+
+int pipe_read(pipe_t *pipe, void *buffer, uint32_t size, bool nonblock) {
+    uint8_t *cursor = (uint8_t *)buffer;
+    return pipe_drain(pipe, pipe_copy_out, &cursor, size, nonblock);
+}
+
+int pipe_write(pipe_t *pipe, const void *buffer, uint32_t size, bool nonblock) {
+    if (size == 0) return 0;
+    pipe_get(pipe);
+    if (!pipe_lock_end(&pipe->write_lock, nonblock)) {
+        pipe_put(pipe);
+        return PIPE_EAGAIN;
+    }
+
+    /* Holding write_lock throughout keeps one write's bytes contiguous */
+    const uint8_t *cursor = (const uint8_t *)buffer;
+    uint32_t written = 0;
+    int result = 0;
+    while (written < size) {
+        result = pipe_produce(pipe, pipe_copy_in, &cursor, size - written, nonblock);
+        if (result <= 0) break;
+        written += (uint32_t)result;
+    }
+
+    mutex_unlock(&pipe->write_lock);
+    pipe_put(pipe);
+    return written ? (int)written : result;
+}
@@ -1,18 +1,42 @@
 #include "process.h"
 #include "memory.h"
+#include "fpu.h"
+#include "cpu.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "sched.h"
+#include "sync.h"
+#include "vdso_page.h"
+#include "vfs.h"
+#include "uring_ctx.h"
+#include "syscall.h"
+#include "../../drivers/include/timer.h"
 #include <stdint.h>
 #include <stdbool.h>
 
 /* Process management state */
-static process_t *current_process = NULL;
-static process_t *process_queue_head = NULL;
-static process_t *process_queue_tail = NULL;
 static uint32_t next_pid = 1;
-static uint64_t system_ticks = 0;
 
-/* Default time slice in ticks (10ms at 1000Hz) */
+/* Sleeping tasks sorted by wake-up tick (linked through sleep_next) */
+static process_t *sleep_queue = NULL;
+static spinlock_t sleep_lock = SPINLOCK_INIT;
+
+/* Every live task, for accounting snapshots (linked through all_next) */
+static process_t *task_list = NULL;
+static spinlock_t task_list_lock = SPINLOCK_INIT;
+
+/* Kernel address space shared by all kernel threads */
+static uint64_t kernel_cr3 = 0;
+
+/* Joiners waiting for a thread to exit */
+static wait_queue_t thread_exit_wait = WAIT_QUEUE_INIT;
+
+/* Initial time slice in ticks (replaced by the class's slice on first run) */
 #define DEFAULT_TIME_SLICE 10
 
+/* Sleepers woken per tick (the rest wait for the next tick) */
+#define WAKE_BATCH 32
+
 /* String copy helper */
 static void strncpy_safe(char *dest, const char *src, int n) {
     int i;
@@ -22,195 +46,1102 @@ static void strncpy_safe(char *dest, const char *src, int n) {
     dest[i] = '\0';
 }
 
-/* Initialize process management */
-void process_init(void) {
-    current_process = NULL;
-    process_queue_head = NULL;
-    process_queue_tail = NULL;
-    next_pid = 1;
-    system_ticks = 0;
-}
-
-/* Create a new process */
-process_t *process_create(const char *name, void (*entry_point)(void)) {
+/* Allocate and fill the common parts of a process structure */
+static process_t *process_alloc(const char *name) {
     process_t *proc = (process_t *)kmalloc(sizeof(process_t));
     if (!proc) return NULL;
-    
-    /* Initialize process structure */
-    proc->pid = next_pid++;
+
+    memset(proc, 0, sizeof(process_t));
+    proc->pid = __atomic_fetch_add(&next_pid, 1, __ATOMIC_RELAXED);
+    proc->tgid = proc->pid;
     strncpy_safe(proc->name, name, 64);
     proc->state = PROCESS_READY;
-    proc->priority = 1;
+    proc->priority = NICE_OFFSET;
+    proc->sched_class = &fair_sched_class;
     proc->time_slice = DEFAULT_TIME_SLICE;
     proc->sleep_until = 0;
+    proc->cpu = this_cpu()->id;
     proc->next = NULL;
-    
+    proc->acct_stamp = rdtsc();
+
+    uint64_t flags = spin_lock_irqsave(&task_list_lock);
+    proc->all_next = task_list;
+    task_list = proc;
+    spin_unlock_irqrestore(&task_list_lock, flags);
+    return proc;
+}
+
+/* Charge cycles since the last accounting point to user or kernel time */
+static void account_charge(process_t *proc, uint64_t now) {
+    uint64_t delta = now - proc->acct_stamp;
+    if (proc->kernel_thread || proc->in_kernel) {
+        proc->stime += delta;
+    } else {
+        proc->utime += delta;
+    }
+    proc->acct_stamp = now;
+}
+
+/* System call boundaries split a process's time into user and kernel */
+void process_account_syscall_enter(void) {
+    uint64_t flags = irq_save();
+    process_t *self = this_cpu()->current;
+    if (self) {
+        account_charge(self, rdtsc());
+        self->in_kernel = true;
+    }
+    irq_restore(flags);
+}
+
+void process_account_syscall_exit(void) {
+    uint64_t flags = irq_save();
+    process_t *self = this_cpu()->current;
+    if (self) {
+        account_charge(self, rdtsc());
+        self->in_kernel = false;
+    }
+    irq_restore(flags);
+}
+
+/* Copy accounting figures for up to max tasks; returns the count. A
+ * running task's figures include its current run. */
+int process_get_stats(process_stat_t *stats, int max) {
+    int count = 0;
+    uint64_t now = rdtsc();
+    uint64_t flags = spin_lock_irqsave(&task_list_lock);
+
+    for (process_t *p = task_list; p && count < max; p = p->all_next) {
+        process_stat_t *st = &stats[count++];
+        st->pid = p->pid;
+        strncpy_safe(st->name, p->name, 64);
+        st->state = p->state;
+        st->cpu = p->cpu;
+        st->utime = p->utime;
+        st->stime = p->stime;
+        st->wait_time = p->wait_time;
+        st->nvcsw = p->nvcsw;
+        st->nivcsw = p->nivcsw;
+        st->deadline = (p->sched_class == &dl_sched_class);
+        st->dl_misses = p->dl_misses;
+
+        if (p->state == PROCESS_RUNNING && now > p->acct_stamp) {
+            uint64_t running = now - p->acct_stamp;
+            if (p->kernel_thread || p->in_kernel) {
+                st->stime += running;
+            } else {
+                st->utime += running;
+            }
+        }
+    }
+
+    spin_unlock_irqrestore(&task_list_lock, flags);
+    return count;
+}
+
+/* Idle loop: halt until there is something to run */
+void cpu_idle(void) {
+    for (;;) {
+        __asm__ volatile ("cli");
+        cpu_t *cpu = this_cpu();
+        if (cpu->need_resched || cpu->rq.nr_running) {
+            schedule();
+            continue;
+        }
+
+        /* Nothing due soon: stop the periodic tick until the next event */
+        timer_nohz_enter();
+        __asm__ volatile ("sti; hlt");
+    }
+}
+
+static void idle_loop(void *arg) {
+    (void)arg;
+    cpu_idle();
+}
+
+/* Adopt the running context as a task that is current on this CPU */
+static process_t *process_adopt(const char *name) {
+    process_t *proc = process_alloc(name);
+    if (!proc) return NULL;
+
+    proc->state = PROCESS_RUNNING;
+    proc->on_cpu = true;
+    proc->kernel_thread = true;
+    proc->context.cr3 = kernel_cr3;
+    proc->fpu_state = fpu_state_alloc();
+    proc->exec_start = rdtsc();
+    this_cpu()->current = proc;
+    return proc;
+}
+
+/* Initialize process management (bootstrap CPU) */
+void process_init(void) {
+    next_pid = 1;
+    sleep_queue = NULL;
+    kernel_cr3 = read_cr3();
+
+    /* Adopt the running boot context as a schedulable task */
+    process_t *boot = process_adopt("kernel");
+    if (!boot) return;
+    boot->pid = 0;
+    boot->tgid = 0;
+
+    /* Idle task runs only when nothing else is ready; it is not queued */
+    this_cpu()->idle = kthread_create("idle", idle_loop, NULL);
+}
+
+/* Initialize process management on an application processor: the AP's
+ * boot context becomes its idle task */
+void process_init_ap(void) {
+    cpu_t *cpu = this_cpu();
+    cpu->idle = process_adopt("idle");
+}
+
+/* Entry trampoline for processes */
+static void process_entry(void) {
+    schedule_tail();
+    __asm__ volatile ("sti");
+
+    process_t *self = this_cpu()->current;
+    void (*entry_point)(void) = (void (*)(void))(uintptr_t)self->thread_arg;
+    entry_point();
+    process_exit(0);
+}
+
+/* Create a new process */
+process_t *process_create(const char *name, void (*entry_point)(void)) {
+    process_t *proc = process_alloc(name);
+    if (!proc) return NULL;
+
     /* Allocate kernel stack (8KB) */
-    proc->kernel_stack = (uint64_t)kmalloc(8192);
+    proc->kernel_stack = (uint64_t)kmalloc(KERNEL_STACK_SIZE);
     if (!proc->kernel_stack) {
-        kfree(proc);
+        process_destroy(proc);
         return NULL;
     }
-    proc->kernel_stack += 8192;  /* Stack grows down */
-    
+    proc->kernel_stack += KERNEL_STACK_SIZE;  /* Stack grows down */
+
     /* Create address space */
-    proc->page_table = vmm_create_address_space();
-    if (!proc->page_table) {
-        kfree((void *)(proc->kernel_stack - 8192));
-        kfree(proc);
+    proc->mm = (mm_t *)kmalloc(sizeof(mm_t));
+    if (!proc->mm) {
+        process_destroy(proc);
         return NULL;
     }
-    
+    proc->mm->users = 1;
+    spin_init(&proc->mm->vma_lock);
+    proc->mm->vma_count = 0;
+    proc->mm->exec_fd = -1;
+    proc->mm->page_table = vmm_create_address_space();
+    proc->page_table = proc->mm->page_table;
+    if (!proc->page_table || !vdso_map(proc->page_table)) {
+        process_destroy(proc);
+        return NULL;
+    }
+
     /* Initialize CPU context */
     memset(&proc->context, 0, sizeof(cpu_context_t));
-    proc->context.rip = (uint64_t)entry_point;
-    proc->context.rsp = proc->kernel_stack;
-    proc->context.rflags = 0x202;  /* Interrupts enabled */
+    proc->thread_arg = (void *)(uintptr_t)entry_point;
+    proc->context.rip = (uint64_t)process_entry;
+    proc->context.rsp = proc->kernel_stack - 8;  /* As if entered by a call */
     proc->context.cr3 = (uint64_t)proc->page_table;
-    
+
+    /* FPU state starts clean and is loaded on first use */
+    proc->fpu_state = fpu_state_alloc();
+
+    return proc;
+}
+
+/* Entry trampoline for kernel threads */
+static void kthread_entry(void) {
+    schedule_tail();
+    __asm__ volatile ("sti");
+
+    process_t *self = this_cpu()->current;
+    self->thread_fn(self->thread_arg);
+    process_exit(0);
+}
+
+/* Create a kernel thread sharing the kernel address space */
+process_t *kthread_create(const char *name, void (*fn)(void *arg), void *arg) {
+    process_t *proc = process_alloc(name);
+    if (!proc) return NULL;
+
+    proc->kernel_stack = (uint64_t)kmalloc(KERNEL_STACK_SIZE);
+    if (!proc->kernel_stack) {
+        process_destroy(proc);
+        return NULL;
+    }
+    proc->kernel_stack += KERNEL_STACK_SIZE;
+
+    /* No private address space: run on the kernel page tables */
+    proc->page_table = NULL;
+    proc->kernel_thread = true;
+    proc->thread_fn = fn;
+    proc->thread_arg = arg;
+
+    memset(&proc->context, 0, sizeof(cpu_context_t));
+    proc->context.rip = (uint64_t)kthread_entry;
+    proc->context.rsp = proc->kernel_stack - 8;
+    proc->context.cr3 = kernel_cr3;
+
+    proc->fpu_state = fpu_state_alloc();
+    return proc;
+}
+
+/* Create a kernel thread and make it runnable */
+process_t *kthread_run(const char *name, void (*fn)(void *arg), void *arg) {
+    process_t *proc = kthread_create(name, fn, arg);
+    if (proc) {
+        scheduler_add(proc);
+    }
+    return proc;
+}
+
+/* Create a thread in the current process: it shares the address space
+ * (and the file descriptors) but has its own stack and TLS pointer.
+ * The thread is joinable and starts runnable. fn runs in ring 0, so
+ * only kernel code may choose it. */
+process_t *thread_create(void (*fn)(void *arg), void *arg, uint64_t tls) {
+    process_t *self = this_cpu()->current;
+    if (!self || !fn) return NULL;
+
+    process_t *proc = process_alloc(self->name);
+    if (!proc) return NULL;
+
+    proc->kernel_stack = (uint64_t)kmalloc(KERNEL_STACK_SIZE);
+    if (!proc->kernel_stack) {
+        process_destroy(proc);
+        return NULL;
+    }
+    proc->kernel_stack += KERNEL_STACK_SIZE;
+
+    proc->tgid = self->tgid;
+    proc->kernel_thread = self->kernel_thread;
+    proc->page_table = self->page_table;
+    proc->mm = self->mm;
+    if (proc->mm) {
+        __atomic_add_fetch(&proc->mm->users, 1, __ATOMIC_RELAXED);
+    }
+    proc->priority = self->priority;
+    proc->fs_base = tls;
+    proc->trace_syscalls = self->trace_syscalls;
+    proc->joinable = true;
+    proc->thread_fn = fn;
+    proc->thread_arg = arg;
+
+    memset(&proc->context, 0, sizeof(cpu_context_t));
+    proc->context.rip = (uint64_t)kthread_entry;
+    proc->context.rsp = proc->kernel_stack - 8;
+    proc->context.cr3 = proc->page_table ? (uint64_t)proc->page_table : kernel_cr3;
+
+    proc->fpu_state = fpu_state_alloc();
+    scheduler_add(proc);
+    return proc;
+}
+
+/* Where a user thread enters ring 3 */
+typedef struct {
+    uint64_t entry;
+    uint64_t arg;
+    uint64_t stack;             /* Start of its stack region */
+} user_thread_start_t;
+
+static void user_thread_entry(void *arg) {
+    user_thread_start_t start = *(user_thread_start_t *)arg;
+    kfree(arg);
+
+    /* Owned from here on: process_exit() unmaps it */
+    this_cpu()->current->user_stack = start.stack;
+
+    /* Entered as if called: the return address slot keeps rsp + 8
+     * 16-byte aligned. The zero there faults if entry returns. */
+    process_account_syscall_exit();
+    user_enter(start.entry, start.stack + USER_STACK_SIZE - 8, start.arg);
+}
+
+/* Create a thread of the current user process that runs entry(arg) in
+ * ring 3 on a new USER_STACK_SIZE stack, with FS base tls. The caller
+ * checks that entry and tls are user addresses. The thread ends with
+ * process_exit(), which frees the stack. */
+process_t *user_thread_create(uint64_t entry, uint64_t arg, uint64_t tls) {
+    process_t *self = this_cpu()->current;
+    if (!self || !self->mm) return NULL;
+
+    user_thread_start_t *start = kmalloc(sizeof(user_thread_start_t));
+    if (!start) return NULL;
+
+    start->entry = entry;
+    start->arg = arg;
+    start->stack = vma_add_anon(self->mm, USER_STACK_SIZE, VMA_READ | VMA_WRITE);
+    if (!start->stack) {
+        kfree(start);
+        return NULL;
+    }
+
+    process_t *proc = thread_create(user_thread_entry, start, tls);
+    if (!proc) {
+        vma_remove(self->mm, start->stack);
+        kfree(start);
+    }
     return proc;
 }
 
+/* Wait for a thread of the current process to exit and free it. Returns
+ * -1 if tid is not a joinable thread of this process. */
+int thread_join(uint32_t tid, int *status) {
+    process_t *self = this_cpu()->current;
+    process_t *thread = NULL;
+
+    /* Claim the thread so no one else joins it */
+    uint64_t flags = spin_lock_irqsave(&task_list_lock);
+    for (process_t *p = task_list; p; p = p->all_next) {
+        if (p->pid == tid && p != self && p->tgid == self->tgid &&
+            p->joinable && !p->join_claimed) {
+            p->join_claimed = true;
+            thread = p;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&task_list_lock, flags);
+    if (!thread) return -1;
+
+    /* Done once it has left its CPU for the last time */
+    wait_event(&thread_exit_wait,
+               thread->state == PROCESS_TERMINATED &&
+               !__atomic_load_n(&thread->on_cpu, __ATOMIC_ACQUIRE));
+
+    if (status) {
+        *status = thread->exit_code;
+    }
+    process_destroy(thread);
+    return 0;
+}
+
+/* Set the current thread's TLS pointer */
+void thread_set_tls(uint64_t tls) {
+    uint64_t flags = irq_save();
+    this_cpu()->current->fs_base = tls;
+    wrmsr(MSR_FS_BASE, tls);
+    irq_restore(flags);
+}
+
 /* Destroy a process */
 void process_destroy(process_t *proc) {
     if (!proc) return;
-    
-    /* Free page table */
-    if (proc->page_table) {
-        vmm_destroy_address_space(proc->page_table);
+
+    /* Give back a deadline reservation */
+    if (proc->sched_class == &dl_sched_class) {
+        sched_dl_reserve(sched_dl_bandwidth(proc->dl_runtime, proc->dl_period), 0);
+    }
+
+    /* Leave the task list */
+    uint64_t flags = spin_lock_irqsave(&task_list_lock);
+    for (process_t **link = &task_list; *link; link = &(*link)->all_next) {
+        if (*link == proc) {
+            *link = proc->all_next;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&task_list_lock, flags);
+
+    /* Drop FPU ownership and state */
+    fpu_release(proc);
+    fpu_state_free(proc->fpu_state);
+
+    /* Free the address space and close the descriptors with the last
+     * thread. This runs on another task, which cannot close the
+     * process's descriptors by number: the executable's is closed with
+     * the rest instead of by vma_clear. */
+    if (proc->mm && __atomic_sub_fetch(&proc->mm->users, 1, __ATOMIC_ACQ_REL) == 0) {
+        proc->mm->exec_fd = -1;
+        vfs_close_all(proc->tgid);
+        vma_clear(proc->mm);
+        vmm_destroy_address_space(proc->mm->page_table);
+        kfree(proc->mm);
     }
-    
+
     /* Free kernel stack */
     if (proc->kernel_stack) {
-        kfree((void *)(proc->kernel_stack - 8192));
+        kfree((void *)(proc->kernel_stack - KERNEL_STACK_SIZE));
     }
-    
+
     /* Free process structure */
     kfree(proc);
 }
 
 /* Get current running process */
 process_t *process_get_current(void) {
-    return current_process;
+    return this_cpu()->current;
 }
 
 /* Yield CPU to another process */
 void process_yield(void) {
-    /* This will be called by scheduler_tick() */
+    schedule();
+}
+
+/* Queue a task in its class (queue lock held) */
+static void rq_enqueue(runqueue_t *rq, process_t *proc, int flags) {
+    proc->sched_class->enqueue_task(rq, proc, flags);
+    proc->on_rq = true;
+    proc->enqueue_stamp = rdtsc();
+    rq->nr_running++;
+}
+
+/* Unlink a queued task (queue lock held) */
+static void rq_dequeue(runqueue_t *rq, process_t *proc) {
+    if (!proc->on_rq) return;
+    proc->sched_class->dequeue_task(rq, proc);
+    proc->on_rq = false;
+    rq->nr_running--;
+}
+
+/* Insert into the sleep queue in wake-up order (sleep_lock held) */
+static void sleep_insert(process_t *proc) {
+    process_t **link = &sleep_queue;
+    while (*link && (*link)->sleep_until <= proc->sleep_until) {
+        link = &(*link)->sleep_next;
+    }
+    proc->sleep_next = *link;
+    *link = proc;
+}
+
+/* Remove from the sleep queue if present (sleep_lock held) */
+static void sleep_remove(process_t *proc) {
+    for (process_t **link = &sleep_queue; *link; link = &(*link)->sleep_next) {
+        if (*link == proc) {
+            *link = proc->sleep_next;
+            proc->sleep_next = NULL;
+            return;
+        }
+    }
+}
+
+/* Lock the run queue that currently owns a task */
+static cpu_t *task_rq_lock(process_t *proc, uint64_t *flags) {
+    for (;;) {
+        cpu_t *cpu = smp_get_cpu(proc->cpu);
+        *flags = spin_lock_irqsave(&cpu->rq.lock);
+        if (proc->cpu == cpu->id) {
+            return cpu;
+        }
+        /* Migrated while we waited */
+        spin_unlock_irqrestore(&cpu->rq.lock, *flags);
+    }
+}
+
+/* Turn system call tracing on or off for every thread of process pid.
+ * Returns the number of threads changed, or -1 if there are none. */
+int process_set_syscall_trace(uint32_t pid, bool enable) {
+    int count = 0;
+    uint64_t flags = spin_lock_irqsave(&task_list_lock);
+    for (process_t *p = task_list; p; p = p->all_next) {
+        if (p->tgid == pid) {
+            p->trace_syscalls = enable;
+            count++;
+        }
+    }
+    spin_unlock_irqrestore(&task_list_lock, flags);
+    return count ? count : -1;
+}
+
+/* Set a task's nice level (-20..19); returns -1 if no such task */
+int process_set_nice(uint32_t pid, int nice) {
+    if (nice < NICE_MIN) nice = NICE_MIN;
+    if (nice > NICE_MAX) nice = NICE_MAX;
+
+    int result = -1;
+    uint64_t flags = spin_lock_irqsave(&task_list_lock);
+    for (process_t *p = task_list; p; p = p->all_next) {
+        if (p->pid != pid) continue;
+
+        /* Requeue so the class sees the new weight */
+        uint64_t rq_flags;
+        cpu_t *cpu = task_rq_lock(p, &rq_flags);
+        bool queued = p->on_rq;
+        if (queued) {
+            rq_dequeue(&cpu->rq, p);
+        }
+        p->priority = (uint32_t)(nice + NICE_OFFSET);
+        if (queued) {
+            rq_enqueue(&cpu->rq, p, 0);
+        }
+        spin_unlock_irqrestore(&cpu->rq.lock, rq_flags);
+
+        result = 0;
+        break;
+    }
+    spin_unlock_irqrestore(&task_list_lock, flags);
+    return result;
+}
+
+/* Move a task to the deadline class with runtime/deadline/period in ticks
+ * (runtime <= deadline <= period), or back to the fair class with a zero
+ * runtime. Returns -1 if there is no such task, the parameters are
+ * invalid or admission control refuses the reservation. */
+int process_set_deadline(uint32_t pid, uint64_t runtime, uint64_t deadline, uint64_t period) {
+    if (runtime && (runtime > deadline || deadline > period)) return -1;
+
+    int result = -1;
+    uint64_t flags = spin_lock_irqsave(&task_list_lock);
+    for (process_t *p = task_list; p; p = p->all_next) {
+        if (p->pid != pid) continue;
+
+        uint64_t old_bw = 0;
+        if (p->sched_class == &dl_sched_class) {
+            old_bw = sched_dl_bandwidth(p->dl_runtime, p->dl_period);
+        }
+        if (!sched_dl_reserve(old_bw, sched_dl_bandwidth(runtime, period))) break;
+
+        uint64_t rq_flags;
+        cpu_t *cpu = task_rq_lock(p, &rq_flags);
+        bool running = (cpu->current == p);
+        bool queued = p->on_rq;
+        if (queued) {
+            rq_dequeue(&cpu->rq, p);
+        }
+        if (running) {
+            p->sched_class->put_prev_task(&cpu->rq, p);
+        }
+
+        if (runtime) {
+            p->sched_class = &dl_sched_class;
+            sched_dl_setup(p, runtime, deadline, period);
+        } else {
+            p->sched_class = &fair_sched_class;
+            p->dl_runtime = p->dl_deadline = p->dl_period = 0;
+            p->vruntime = cpu->rq.cfs.min_vruntime;
+        }
+
+        if (queued) {
+            rq_enqueue(&cpu->rq, p, 0);
+        }
+        if (running) {
+            p->sched_class->set_next_task(&cpu->rq, p);
+            p->time_slice = p->sched_class->time_slice(&cpu->rq, p);
+        }
+        spin_unlock_irqrestore(&cpu->rq.lock, rq_flags);
+
+        /* Let the task's CPU re-pick under the new class */
+        smp_send_resched(cpu);
+        result = 0;
+        break;
+    }
+    spin_unlock_irqrestore(&task_list_lock, flags);
+    return result;
+}
+
+/* Mark the current task blocked, optionally with a wake-up timeout in
+ * ticks (0 = until process_wake). The caller re-checks its wait condition
+ * and then calls schedule(); a wakeup in between simply makes the task
+ * runnable again, so none is lost. */
+void process_set_blocked(uint64_t timeout) {
+    uint64_t flags = irq_save();
+    cpu_t *cpu = this_cpu();
+    process_t *self = cpu->current;
+
+    spin_lock(&cpu->rq.lock);
+    if (timeout) {
+        spin_lock(&sleep_lock);
+        self->sleep_until = timer_get_ticks() + timeout;
+        sleep_insert(self);
+        spin_unlock(&sleep_lock);
+    }
+    self->state = PROCESS_BLOCKED;
+    spin_unlock(&cpu->rq.lock);
+
+    /* The bootstrap CPU may be idle with a one-shot deadline past ours:
+     * wake it so it re-arms the periodic tick */
+    if (timeout && cpu->id != 0 && timer_nohz_active()) {
+        smp_send_resched(smp_get_cpu(0));
+    }
+    irq_restore(flags);
+}
+
+/* Undo process_set_blocked() when the wait condition turned out to be
+ * true before schedule(): keep running, whether or not a wakeup already
+ * queued the task */
+void process_set_running(void) {
+    uint64_t flags = irq_save();
+    cpu_t *cpu = this_cpu();
+    process_t *self = cpu->current;
+
+    spin_lock(&cpu->rq.lock);
+    if (self->state != PROCESS_RUNNING) {
+        rq_dequeue(&cpu->rq, self);
+        if (self->sleep_until) {
+            spin_lock(&sleep_lock);
+            sleep_remove(self);
+            spin_unlock(&sleep_lock);
+            self->sleep_until = 0;
+        }
+        self->state = PROCESS_RUNNING;
+    }
+    spin_unlock(&cpu->rq.lock);
+    irq_restore(flags);
+}
+
+/* Park a running task until tick until; only its timer wakes it
+ * (run queue lock held) */
+static void throttle_task(cpu_t *cpu, process_t *proc, uint64_t until) {
+    spin_lock(&sleep_lock);
+    proc->sleep_until = until;
+    sleep_insert(proc);
+    spin_unlock(&sleep_lock);
+    proc->state = PROCESS_BLOCKED;
+
+    if (cpu->id != 0 && timer_nohz_active()) {
+        smp_send_resched(smp_get_cpu(0));
+    }
 }
 
 /* Sleep for specified ticks */
 void process_sleep(uint64_t ticks) {
-    if (current_process) {
-        current_process->sleep_until = system_ticks + ticks;
-        current_process->state = PROCESS_BLOCKED;
+    process_set_blocked(ticks ? ticks : 1);
+    schedule();
+}
+
+/* Block the current process until process_wake() */
+void process_block(void) {
+    process_set_blocked(0);
+    schedule();
+}
+
+/* Whether a task just queued on cpu should preempt what runs there
+ * (run queue lock held) */
+static bool wakeup_preempts(cpu_t *cpu, process_t *proc) {
+    process_t *curr = cpu->current;
+    if (!curr || curr == cpu->idle) return true;
+
+    if (curr->sched_class != proc->sched_class) {
+        /* Classes are listed highest first */
+        const sched_class_t *class;
+        for_each_class(class) {
+            if (class == proc->sched_class) return true;
+            if (class == curr->sched_class) return false;
+        }
+        return false;
     }
+    return proc->sched_class->check_preempt(&cpu->rq, curr, proc);
+}
+
+/* Make a blocked task runnable on its CPU. A non-zero now only wakes a
+ * sleeper whose deadline has passed. */
+static void wake_task(process_t *proc, uint64_t now) {
+    uint64_t flags;
+    bool woke = false;
+    bool preempt = false;
+    cpu_t *cpu = task_rq_lock(proc, &flags);
+
+    /* A throttled task is only released by its replenishment timer */
+    if (proc->state == PROCESS_BLOCKED &&
+        (now ? (proc->sleep_until && proc->sleep_until <= now) : !proc->throttled)) {
+        if (proc->sleep_until) {
+            spin_lock(&sleep_lock);
+            sleep_remove(proc);
+            spin_unlock(&sleep_lock);
+            proc->sleep_until = 0;
+        }
+        proc->throttled = false;
+        proc->state = PROCESS_READY;
+        rq_enqueue(&cpu->rq, proc, ENQUEUE_WAKEUP);
+        woke = true;
+        preempt = wakeup_preempts(cpu, proc);
+    }
+    spin_unlock_irqrestore(&cpu->rq.lock, flags);
+
+    if (!woke) return;
+
+    /* Preempt the task's CPU if the woken task should run first, else let
+     * an idle CPU steal it */
+    if (preempt) {
+        smp_send_resched(cpu);
+    } else {
+        smp_kick_idle();
+    }
+}
+
+/* Make a blocked process runnable again */
+void process_wake(process_t *proc) {
+    if (!proc) return;
+    wake_task(proc, 0);
 }
 
 /* Exit current process */
 void process_exit(int status) {
-    (void)status;  /* TODO: Store exit status */
-    if (current_process) {
-        current_process->state = PROCESS_TERMINATED;
+    /* The process's first thread leaving ends its rings (their polling
+     * threads would otherwise keep using its address space) */
+    process_t *self = this_cpu()->current;
+    if (self && self->mm && self->pid == self->tgid) {
+        uring_release_process();
+    }
+
+    /* A user thread's stack goes now; the address space may outlive it */
+    if (self && self->user_stack) {
+        vma_remove(self->mm, self->user_stack);
+        self->user_stack = 0;
+    }
+
+    irq_save();
+    if (self) {
+        self->exit_code = status;
+        self->state = PROCESS_TERMINATED;
+        schedule();
+    }
+    /* Not reached for scheduled tasks */
+    for (;;) {
+        __asm__ volatile ("hlt");
     }
 }
 
 /* Initialize scheduler */
 void scheduler_init(void) {
-    process_queue_head = NULL;
-    process_queue_tail = NULL;
+    sleep_queue = NULL;
 }
 
-/* Add process to scheduler queue */
+/* Add a new task to this CPU's run queue */
 void scheduler_add(process_t *proc) {
     if (!proc) return;
-    
-    proc->next = NULL;
-    if (!process_queue_head) {
-        process_queue_head = proc;
-        process_queue_tail = proc;
-    } else {
-        process_queue_tail->next = proc;
-        process_queue_tail = proc;
-    }
+
+    cpu_t *cpu = this_cpu();
+    uint64_t flags = spin_lock_irqsave(&cpu->rq.lock);
+    proc->cpu = cpu->id;
+    proc->state = PROCESS_READY;
+    rq_enqueue(&cpu->rq, proc, ENQUEUE_NEW);
+    spin_unlock_irqrestore(&cpu->rq.lock, flags);
+
+    smp_kick_idle();
 }
 
-/* Remove process from scheduler queue */
+/* Remove process from its run queue and the sleep queue */
 void scheduler_remove(process_t *proc) {
-    if (!proc || !process_queue_head) return;
-    
-    if (process_queue_head == proc) {
-        process_queue_head = proc->next;
-        if (!process_queue_head) {
-            process_queue_tail = NULL;
+    if (!proc) return;
+
+    uint64_t flags;
+    cpu_t *cpu = task_rq_lock(proc, &flags);
+    rq_dequeue(&cpu->rq, proc);
+    spin_lock(&sleep_lock);
+    sleep_remove(proc);
+    spin_unlock(&sleep_lock);
+    spin_unlock_irqrestore(&cpu->rq.lock, flags);
+}
+
+/* Scheduler tick - called on the bootstrap CPU's timer interrupt */
+void scheduler_tick(void) {
+    uint64_t now = timer_get_ticks();
+    sched_fair_clock_tick(now);
+
+    /* Wake up sleeping processes. This runs as a bottom half with
+     * interrupts enabled, so the locks are taken with them off. */
+    process_t *expired[WAKE_BATCH];
+    int count = 0;
+    uint64_t flags = spin_lock_irqsave(&sleep_lock);
+    while (sleep_queue && sleep_queue->sleep_until <= now && count < WAKE_BATCH) {
+        process_t *proc = sleep_queue;
+        sleep_queue = proc->sleep_next;
+        proc->sleep_next = NULL;
+        expired[count++] = proc;
+    }
+    spin_unlock_irqrestore(&sleep_lock, flags);
+
+    for (int i = 0; i < count; i++) {
+        wake_task(expired[i], now);
+    }
+
+    /* Charge the current task and count down its slice */
+    cpu_t *self = this_cpu();
+    flags = spin_lock_irqsave(&self->rq.lock);
+    process_t *current = self->current;
+    if (current && current != self->idle && current->state == PROCESS_RUNNING) {
+        current->sched_class->task_tick(&self->rq, current);
+        if (current->time_slice > 0) {
+            current->time_slice--;
+        }
+
+        /* If time slice expired, reschedule on interrupt exit */
+        if (current->time_slice == 0) {
+            self->need_resched = true;
         }
-        return;
     }
-    
-    process_t *current = process_queue_head;
-    while (current->next) {
-        if (current->next == proc) {
-            current->next = proc->next;
-            if (process_queue_tail == proc) {
-                process_queue_tail = current;
-            }
-            return;
+    spin_unlock_irqrestore(&self->rq.lock, flags);
+
+    /* Other CPUs have no timer of their own yet: reschedule them once per
+     * scheduling period and let idle CPUs look for work to steal */
+    if (now % SCHED_LATENCY_TICKS != 0) return;
+
+    uint32_t queued = 0;
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        queued += smp_get_cpu(i)->rq.nr_running;
+    }
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        cpu_t *cpu = smp_get_cpu(i);
+        if (cpu == self || !cpu->online) continue;
+        bool idle = cpu->current == cpu->idle;
+        if (cpu->rq.nr_running || (idle && queued)) {
+            smp_send_resched(cpu);
         }
-        current = current->next;
     }
 }
 
-/* Scheduler tick - called on timer interrupt */
-void scheduler_tick(void) {
-    system_ticks++;
-    
-    /* Wake up sleeping processes */
-    process_t *proc = process_queue_head;
-    while (proc) {
-        if (proc->state == PROCESS_BLOCKED && proc->sleep_until > 0) {
-            if (system_ticks >= proc->sleep_until) {
-                proc->sleep_until = 0;
-                proc->state = PROCESS_READY;
-            }
+/* Tick of the earliest sleeper (0 = none) */
+uint64_t scheduler_next_event(void) {
+    spin_lock(&sleep_lock);
+    uint64_t next = sleep_queue ? sleep_queue->sleep_until : 0;
+    spin_unlock(&sleep_lock);
+    return next;
+}
+
+/* Whether the periodic tick is still needed: queued tasks must be rotated
+ * at slice boundaries on every CPU */
+bool scheduler_tick_needed(void) {
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        if (smp_get_cpu(i)->rq.nr_running) {
+            return true;
         }
-        proc = proc->next;
     }
-    
-    /* Decrement current process time slice */
-    if (current_process && current_process->state == PROCESS_RUNNING) {
-        if (current_process->time_slice > 0) {
-            current_process->time_slice--;
+    return false;
+}
+
+/* Tasks still switching out and tasks whose FPU registers are live on
+ * their CPU stay where they are */
+static bool can_steal(process_t *proc, void *arg) {
+    cpu_t *victim = (cpu_t *)arg;
+    return !proc->on_cpu && victim->fpu_owner != proc;
+}
+
+/* Pull a runnable task from another CPU */
+static process_t *steal_task(cpu_t *self) {
+    uint32_t ncpus = smp_cpu_count();
+
+    for (uint32_t i = 1; i < ncpus; i++) {
+        cpu_t *victim = smp_get_cpu((self->id + i) % ncpus);
+        if (!victim->online || victim->rq.nr_running == 0) continue;
+        if (!spin_trylock(&victim->rq.lock)) continue;
+
+        process_t *proc = NULL;
+        const sched_class_t *class;
+        for_each_class(class) {
+            proc = class->steal_task(&victim->rq, &self->rq, can_steal, victim);
+            if (proc) {
+                proc->on_rq = false;
+                victim->rq.nr_running--;
+                break;
+            }
         }
-        
-        /* If time slice expired, mark as ready for rescheduling */
-        if (current_process->time_slice == 0) {
-            current_process->state = PROCESS_READY;
-            current_process->time_slice = DEFAULT_TIME_SLICE;
+        spin_unlock(&victim->rq.lock);
+
+        if (proc) {
+            self->steals++;
+            return proc;
         }
     }
+    return NULL;
 }
 
-/* Get next process to run (simple round-robin) */
+/* Get next process to run (this CPU's run queue lock held): the highest
+ * class with a queued task, then another CPU's task, then the idle task */
 process_t *scheduler_next(void) {
-    if (!process_queue_head) return NULL;
-    
-    /* Start from current process or head */
-    process_t *start = current_process ? current_process->next : process_queue_head;
-    if (!start) start = process_queue_head;
-    
-    process_t *proc = start;
-    do {
-        if (proc->state == PROCESS_READY) {
-            proc->state = PROCESS_RUNNING;
-            proc->time_slice = DEFAULT_TIME_SLICE;
-            current_process = proc;
-            return proc;
+    cpu_t *cpu = this_cpu();
+    const sched_class_t *class;
+
+    for_each_class(class) {
+        process_t *next = class->pick_next_task(&cpu->rq);
+        if (next) {
+            next->on_rq = false;
+            cpu->rq.nr_running--;
+            return next;
+        }
+    }
+
+    process_t *next = steal_task(cpu);
+    return next ? next : cpu->idle;
+}
+
+/* Switch to the next runnable task. preempt is set when the switch is
+ * forced on interrupt exit rather than requested by the task. */
+static void schedule_common(bool preempt) {
+    uint64_t flags = irq_save();
+    cpu_t *cpu = this_cpu();
+    process_t *prev = cpu->current;
+
+    if (!prev) {
+        irq_restore(flags);
+        return;
+    }
+
+    spin_lock(&cpu->rq.lock);
+    cpu->need_resched = false;
+
+    /* Charge prev for its run; a running task that gives up the CPU
+     * stays runnable */
+    bool was_running = (prev->state == PROCESS_RUNNING);
+    if (prev != cpu->idle) {
+        prev->sched_class->put_prev_task(&cpu->rq, prev);
+    }
+
+    /* A task that used up its reserved budget sits out the rest of its
+     * period on the sleep queue */
+    if (was_running && prev != cpu->idle && prev->sched_class->throttle_until) {
+        uint64_t until = prev->sched_class->throttle_until(&cpu->rq, prev);
+        if (until) {
+            throttle_task(cpu, prev, until);
+            was_running = false;
+        }
+    }
+    if (was_running) {
+        prev->state = PROCESS_READY;
+        if (prev != cpu->idle) {
+            rq_enqueue(&cpu->rq, prev, 0);
         }
-        
-        proc = proc->next;
-        if (!proc) proc = process_queue_head;
-    } while (proc != start);
-    
-    /* No ready process, keep current */
-    return current_process;
+    }
+
+    process_t *next = scheduler_next();
+    if (!next) {
+        next = prev;
+    }
+
+    /* Nothing else to run: keep going */
+    if (next == prev) {
+        prev->state = PROCESS_RUNNING;
+        if (prev != cpu->idle) {
+            prev->sched_class->set_next_task(&cpu->rq, prev);
+            prev->time_slice = prev->sched_class->time_slice(&cpu->rq, prev);
+        }
+        spin_unlock(&cpu->rq.lock);
+        irq_restore(flags);
+        return;
+    }
+
+    /* Terminated tasks are freed after the switch */
+    if (prev->state == PROCESS_TERMINATED) {
+        cpu->dead = prev;
+    }
+
+    /* Accounting: prev's run ends, next's queue wait ends */
+    uint64_t now = rdtsc();
+    account_charge(prev, now);
+    if ((preempt && was_running) || prev->throttled) {
+        prev->nivcsw++;
+    } else {
+        prev->nvcsw++;
+    }
+    if (next != cpu->idle) {
+        next->wait_time += now - next->enqueue_stamp;
+    }
+    next->acct_stamp = now;
+
+    next->state = PROCESS_RUNNING;
+    next->cpu = cpu->id;
+    next->on_cpu = true;
+    if (next != cpu->idle) {
+        next->sched_class->set_next_task(&cpu->rq, next);
+        next->time_slice = next->sched_class->time_slice(&cpu->rq, next);
+    }
+    cpu->current = next;
+    cpu->prev = prev;
+    fpu_switch_to(next);
+    if (next->fs_base != prev->fs_base) {
+        wrmsr(MSR_FS_BASE, next->fs_base);
+    }
+
+    /* Entries from user mode land on the next task's kernel stack */
+    if (next->kernel_stack) {
+        cpu->kernel_rsp = next->kernel_stack;
+        cpu->tss.rsp0 = next->kernel_stack;
+    }
+
+    /* The run queue lock stays held across the switch and is released by
+     * schedule_tail() on the new stack, so no other CPU can pick up prev
+     * while it is still running here */
+    context_switch(&prev->context, &next->context);
+
+    /* Back on this task's stack */
+    schedule_tail();
+    irq_restore(flags);
+}
+
+void schedule(void) {
+    schedule_common(false);
+}
+
+/* Finish a switch: release the run queue and free a task that exited on
+ * the previous stack */
+void schedule_tail(void) {
+    cpu_t *cpu = this_cpu();
+    process_t *prev = cpu->prev;
+    process_t *dead = cpu->dead;
+
+    cpu->prev = NULL;
+    cpu->dead = NULL;
+    if (prev) {
+        __atomic_store_n(&prev->on_cpu, false, __ATOMIC_RELEASE);
+    }
+    spin_unlock(&cpu->rq.lock);
+
+    /* Joinable threads stay until thread_join() collects them */
+    if (dead) {
+        if (dead->joinable) {
+            wake_up_all(&thread_exit_wait);
+        } else {
+            process_destroy(dead);
+        }
+    }
+}
+
+/* Preempt on interrupt exit if a reschedule is pending */
+void scheduler_preempt(void) {
+    if (this_cpu()->need_resched) {
+        schedule_common(true);
+    }
+}
+
+/* Context switch benchmark: ping-pong between this task and a bare
+ * context on a private stack, with interrupts off so nothing else runs */
+#define BENCH_STACK_SIZE 4096
+
+static cpu_context_t bench_main_ctx;
+static cpu_context_t bench_peer_ctx;
+
+static void bench_peer(void) {
+    for (;;) {
+        context_switch(&bench_peer_ctx, &bench_main_ctx);
+    }
+}
+
+/* Average TSC cycles per switch within one address space, and per CR3
+ * reload (the cost that path skips). Returns false if out of memory. */
+bool process_bench_switch(uint32_t iterations, uint64_t *switch_cycles, uint64_t *cr3_cycles) {
+    if (iterations == 0) return false;
+
+    uint8_t *stack = (uint8_t *)kmalloc(BENCH_STACK_SIZE);
+    if (!stack) return false;
+
+    memset(&bench_peer_ctx, 0, sizeof(cpu_context_t));
+    bench_peer_ctx.rip = (uint64_t)bench_peer;
+    bench_peer_ctx.rsp = (uint64_t)(stack + BENCH_STACK_SIZE) - 8;
+    bench_peer_ctx.cr3 = read_cr3();
+
+    uint64_t flags = irq_save();
+
+    /* First round trip starts the peer */
+    context_switch(&bench_main_ctx, &bench_peer_ctx);
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < iterations; i++) {
+        context_switch(&bench_main_ctx, &bench_peer_ctx);
+    }
+    uint64_t switched = rdtsc() - start;
+
+    uint64_t cr3 = read_cr3();
+    start = rdtsc();
+    for (uint32_t i = 0; i < iterations; i++) {
+        write_cr3(cr3);
+    }
+    uint64_t reloaded = rdtsc() - start;
+
+    irq_restore(flags);
+    kfree(stack);
+
+    *switch_cycles = switched / ((uint64_t)iterations * 2);
+    *cr3_cycles = reloaded / iterations;
+    return true;
 }
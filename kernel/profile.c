@@ -0,0 +1,317 @@
+#include "profile.h"
+#include "hrtimer.h"
+#include "ktime.h"
+#include "ksyms.h"
+#include "irq.h"
+#include "idt.h"
+#include "smp.h"
+#include "process.h"
+#include "memory.h"
+#include "workqueue.h"
+#include "../../drivers/include/serial.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Leaf buckets for samples that have no kernel symbol */
+#define BUCKET_USER    (-2)
+#define BUCKET_UNKNOWN (-1)
+
+typedef struct {
+    uint32_t depth;
+    bool user;                       /* Interrupted user mode: RIP only */
+    uint64_t pc[PROFILE_MAX_DEPTH];  /* RIP, then return addresses */
+} profile_sample_t;
+
+/* Filled only by the CPU that owns it, from its timer interrupt */
+typedef struct {
+    profile_sample_t *samples;
+    uint32_t count;
+    uint64_t dropped;
+} profile_buf_t;
+
+static profile_buf_t buffers[MAX_CPUS];
+static hrtimer_t sample_timer;
+static uint64_t period_ns = 0;
+static uint32_t rate_hz = 0;
+static volatile bool running = false;
+static volatile bool dumping = false;
+
+static work_t dump_work;
+static profile_format_t dump_format;
+
+/* Stack range the frame chain may point into: the interrupted task's
+ * kernel stack. False when the stack is not known (adopted boot and idle
+ * contexts) or RSP is not on it; the sample then keeps only its RIP,
+ * since a frame pointer followed off the stack may hit unmapped memory. */
+static bool profile_stack_bounds(const struct registers *regs, uint64_t *lo, uint64_t *hi) {
+    process_t *task = process_get_current();
+    uint64_t top = task ? task->kernel_stack : 0;
+
+    if (!top || regs->rsp >= top || top - regs->rsp > KERNEL_STACK_SIZE) {
+        return false;
+    }
+    *lo = regs->rsp;
+    *hi = top;
+    return true;
+}
+
+/* Record the interrupted RIP and walk the saved frame pointers */
+static void profile_record(const struct registers *regs) {
+    profile_buf_t *buf = &buffers[this_cpu()->id];
+    if (!buf->samples) return;
+    if (buf->count >= PROFILE_SAMPLES) {
+        buf->dropped++;
+        return;
+    }
+
+    profile_sample_t *s = &buf->samples[buf->count];
+    s->user = (regs->cs & 3) != 0;
+    s->pc[0] = regs->rip;
+    s->depth = 1;
+
+    uint64_t lo, hi;
+    if (!s->user && profile_stack_bounds(regs, &lo, &hi)) {
+        /* Each frame holds the caller's RBP, then the return address */
+        uint64_t fp = regs->rbp;
+        while (s->depth < PROFILE_MAX_DEPTH && fp >= lo && fp + 16 <= hi && !(fp & 7)) {
+            const uint64_t *frame = (const uint64_t *)fp;
+            if (!ksym_is_text(frame[1])) break;
+            s->pc[s->depth++] = frame[1];
+            if (frame[0] <= fp) break;
+            fp = frame[0];
+        }
+    }
+    buf->count++;
+}
+
+static hrtimer_restart_t profile_tick(hrtimer_t *timer) {
+    struct registers *regs = irq_get_regs();
+    if (regs) {
+        profile_record(regs);
+    }
+    if (!running) return HRTIMER_NORESTART;
+
+    hrtimer_forward(timer, ktime_ns(), period_ns);
+    return HRTIMER_RESTART;
+}
+
+bool profile_start(uint32_t hz) {
+    if (dumping) return false;
+    if (hz < PROFILE_MIN_HZ) hz = PROFILE_MIN_HZ;
+    if (hz > PROFILE_MAX_HZ) hz = PROFILE_MAX_HZ;
+
+    profile_stop();
+    for (uint32_t i = 0; i < smp_cpu_count() && i < MAX_CPUS; i++) {
+        profile_buf_t *buf = &buffers[i];
+        if (!buf->samples) {
+            buf->samples = (profile_sample_t *)kmalloc(PROFILE_SAMPLES * sizeof(profile_sample_t));
+            if (!buf->samples) return false;
+        }
+        buf->count = 0;
+        buf->dropped = 0;
+    }
+
+    rate_hz = hz;
+    period_ns = 1000000000ULL / hz;
+    running = true;
+    hrtimer_init(&sample_timer, profile_tick, NULL);
+    hrtimer_start(&sample_timer, ktime_ns() + period_ns);
+    return true;
+}
+
+void profile_stop(void) {
+    if (!running) return;
+    running = false;
+    hrtimer_cancel(&sample_timer);
+}
+
+void profile_get_status(profile_status_t *status) {
+    status->running = running;
+    status->dumping = dumping;
+    status->hz = rate_hz;
+    status->samples = 0;
+    status->dropped = 0;
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        status->samples += buffers[i].count;
+        status->dropped += buffers[i].dropped;
+    }
+}
+
+/* Symbol of a frame; return addresses point after the call, so they
+ * are looked up one byte back */
+static int frame_bucket(const profile_sample_t *s, uint32_t frame) {
+    if (s->user) return BUCKET_USER;
+    uint64_t pc = frame ? s->pc[frame] - 1 : s->pc[frame];
+    int index = ksym_index(pc);
+    return index >= 0 ? index : BUCKET_UNKNOWN;
+}
+
+static const char *bucket_name(int bucket) {
+    if (bucket == BUCKET_USER) return "[user]";
+    const ksym_t *sym = ksym_get(bucket);
+    return sym ? sym->name : "[unknown]";
+}
+
+/* Leaf samples per symbol; the two extra slots hold [user] and [unknown].
+ * Caller frees the array. */
+static uint32_t *profile_count_leaves(uint32_t *slots, uint64_t *total) {
+    uint32_t nsyms = ksym_count_get();
+    uint32_t *counts = (uint32_t *)kmalloc((nsyms + 2) * sizeof(uint32_t));
+    if (!counts) return NULL;
+    for (uint32_t i = 0; i < nsyms + 2; i++) {
+        counts[i] = 0;
+    }
+
+    *total = 0;
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        const profile_buf_t *buf = &buffers[c];
+        for (uint32_t i = 0; i < buf->count; i++) {
+            int bucket = frame_bucket(&buf->samples[i], 0);
+            counts[bucket >= 0 ? (uint32_t)bucket : nsyms + (uint32_t)(-bucket - 1)]++;
+            (*total)++;
+        }
+    }
+    *slots = nsyms + 2;
+    return counts;
+}
+
+static const char *slot_name(uint32_t slot, uint32_t nsyms) {
+    if (slot == nsyms) return bucket_name(BUCKET_UNKNOWN);
+    if (slot == nsyms + 1) return bucket_name(BUCKET_USER);
+    return bucket_name((int)slot);
+}
+
+uint32_t profile_top(profile_entry_t *out, uint32_t max, uint64_t *total) {
+    uint32_t slots;
+    *total = 0;
+    if (running || max == 0) return 0;
+    uint32_t *counts = profile_count_leaves(&slots, total);
+    if (!counts) return 0;
+
+    /* Insertion into a short list kept hottest first */
+    uint32_t filled = 0;
+    for (uint32_t slot = 0; slot < slots; slot++) {
+        uint32_t count = counts[slot];
+        if (!count) continue;
+        if (filled == max && count <= out[max - 1].count) continue;
+
+        uint32_t pos = filled < max ? filled++ : max - 1;
+        while (pos > 0 && out[pos - 1].count < count) {
+            out[pos] = out[pos - 1];
+            pos--;
+        }
+        out[pos].name = slot_name(slot, slots - 2);
+        out[pos].count = count;
+    }
+    kfree(counts);
+    return filled;
+}
+
+static void dump_header(uint64_t total) {
+    profile_status_t status;
+    profile_get_status(&status);
+    serial_write_string("# profile: ");
+    serial_write_uint(total);
+    serial_write_string(" samples at ");
+    serial_write_uint(status.hz);
+    serial_write_string(" Hz, ");
+    serial_write_uint(status.dropped);
+    serial_write_string(" dropped\n");
+}
+
+/* Every function with samples, hottest first: "count percent name" */
+static void dump_flat(void) {
+    uint32_t slots;
+    uint64_t total;
+    uint32_t *counts = profile_count_leaves(&slots, &total);
+    if (!counts) {
+        serial_write_string("# profile: out of memory\n");
+        return;
+    }
+    dump_header(total);
+
+    /* Repeatedly take the largest count (profiles touch few functions) */
+    for (;;) {
+        uint32_t best = 0;
+        for (uint32_t slot = 1; slot < slots; slot++) {
+            if (counts[slot] > counts[best]) best = slot;
+        }
+        if (!counts[best]) break;
+
+        uint64_t tenths = (uint64_t)counts[best] * 1000 / total;
+        serial_write_uint(counts[best]);
+        serial_putc('\t');
+        serial_write_uint(tenths / 10);
+        serial_putc('.');
+        serial_write_uint(tenths % 10);
+        serial_write_string("%\t");
+        serial_write_string(slot_name(best, slots - 2));
+        serial_putc('\n');
+        counts[best] = 0;
+    }
+    kfree(counts);
+}
+
+static bool same_stack(const profile_sample_t *a, const profile_sample_t *b) {
+    if (a->depth != b->depth || a->user != b->user) return false;
+    for (uint32_t f = 0; f < a->depth; f++) {
+        if (frame_bucket(a, f) != frame_bucket(b, f)) return false;
+    }
+    return true;
+}
+
+/* One line per stack, outermost frame first; runs of identical stacks
+ * are merged and flamegraph.pl sums any repeats */
+static void dump_folded(void) {
+    uint64_t total = 0;
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        total += buffers[c].count;
+    }
+    dump_header(total);
+
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        const profile_buf_t *buf = &buffers[c];
+        uint32_t i = 0;
+        while (i < buf->count) {
+            const profile_sample_t *s = &buf->samples[i];
+            uint32_t run = 1;
+            while (i + run < buf->count && same_stack(s, &buf->samples[i + run])) {
+                run++;
+            }
+
+            for (uint32_t f = s->depth; f-- > 0;) {
+                serial_write_string(bucket_name(frame_bucket(s, f)));
+                if (f) serial_putc(';');
+            }
+            serial_putc(' ');
+            serial_write_uint(run);
+            serial_putc('\n');
+            i += run;
+        }
+    }
+}
+
+static void profile_dump_work(void *data) {
+    (void)data;
+    if (dump_format == PROFILE_FOLDED) {
+        dump_folded();
+    } else {
+        dump_flat();
+    }
+    dumping = false;
+}
+
+bool profile_dump(profile_format_t format) {
+    if (dumping) return false;
+    profile_stop();
+
+    dumping = true;
+    dump_format = format;
+    INIT_WORK(&dump_work, profile_dump_work, NULL);
+    if (!schedule_work(&dump_work)) {
+        dumping = false;
+        return false;
+    }
+    return true;
+}
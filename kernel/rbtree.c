@@ -0,0 +1,234 @@
+#include "rbtree.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Make new take old's place under old's parent */
+static void rb_replace_child(rb_root_t *root, rb_node_t *old, rb_node_t *new) {
+    rb_node_t *parent = old->parent;
+    if (!parent) {
+        root->node = new;
+    } else if (parent->left == old) {
+        parent->left = new;
+    } else {
+        parent->right = new;
+    }
+}
+
+static void rb_rotate_left(rb_root_t *root, rb_node_t *x) {
+    rb_node_t *y = x->right;
+
+    x->right = y->left;
+    if (y->left) {
+        y->left->parent = x;
+    }
+    rb_replace_child(root, x, y);
+    y->parent = x->parent;
+    y->left = x;
+    x->parent = y;
+}
+
+static void rb_rotate_right(rb_root_t *root, rb_node_t *x) {
+    rb_node_t *y = x->left;
+
+    x->left = y->right;
+    if (y->right) {
+        y->right->parent = x;
+    }
+    rb_replace_child(root, x, y);
+    y->parent = x->parent;
+    y->right = x;
+    x->parent = y;
+}
+
+static inline bool rb_is_red(const rb_node_t *node) {
+    return node && node->red;
+}
+
+/* Restore the red-black properties after rb_link_node() */
+void rb_insert_color(rb_root_t *root, rb_node_t *node) {
+    rb_node_t *parent;
+
+    while ((parent = node->parent) && parent->red) {
+        rb_node_t *gparent = parent->parent;
+
+        if (parent == gparent->left) {
+            rb_node_t *uncle = gparent->right;
+            if (rb_is_red(uncle)) {
+                /* Recolor and continue from the grandparent */
+                uncle->red = false;
+                parent->red = false;
+                gparent->red = true;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->right) {
+                rb_rotate_left(root, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = false;
+            gparent->red = true;
+            rb_rotate_right(root, gparent);
+        } else {
+            rb_node_t *uncle = gparent->left;
+            if (rb_is_red(uncle)) {
+                uncle->red = false;
+                parent->red = false;
+                gparent->red = true;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->left) {
+                rb_rotate_right(root, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = false;
+            gparent->red = true;
+            rb_rotate_left(root, gparent);
+        }
+    }
+
+    root->node->red = false;
+}
+
+/* Rebalance after removing a black node; node (possibly NULL) is the
+ * child that took its place under parent */
+static void rb_erase_fixup(rb_root_t *root, rb_node_t *node, rb_node_t *parent) {
+    while (node != root->node && !rb_is_red(node)) {
+        if (node == parent->left) {
+            rb_node_t *sibling = parent->right;
+            if (sibling->red) {
+                sibling->red = false;
+                parent->red = true;
+                rb_rotate_left(root, parent);
+                sibling = parent->right;
+            }
+            if (!rb_is_red(sibling->left) && !rb_is_red(sibling->right)) {
+                sibling->red = true;
+                node = parent;
+                parent = node->parent;
+            } else {
+                if (!rb_is_red(sibling->right)) {
+                    sibling->left->red = false;
+                    sibling->red = true;
+                    rb_rotate_right(root, sibling);
+                    sibling = parent->right;
+                }
+                sibling->red = parent->red;
+                parent->red = false;
+                sibling->right->red = false;
+                rb_rotate_left(root, parent);
+                node = root->node;
+                break;
+            }
+        } else {
+            rb_node_t *sibling = parent->left;
+            if (sibling->red) {
+                sibling->red = false;
+                parent->red = true;
+                rb_rotate_right(root, parent);
+                sibling = parent->left;
+            }
+            if (!rb_is_red(sibling->left) && !rb_is_red(sibling->right)) {
+                sibling->red = true;
+                node = parent;
+                parent = node->parent;
+            } else {
+                if (!rb_is_red(sibling->left)) {
+                    sibling->right->red = false;
+                    sibling->red = true;
+                    rb_rotate_left(root, sibling);
+                    sibling = parent->left;
+                }
+                sibling->red = parent->red;
+                parent->red = false;
+                sibling->left->red = false;
+                rb_rotate_right(root, parent);
+                node = root->node;
+                break;
+            }
+        }
+    }
+
+    if (node) {
+        node->red = false;
+    }
+}
+
+/* Remove a node from the tree */
+void rb_erase(rb_root_t *root, rb_node_t *node) {
+    rb_node_t *child;
+    rb_node_t *parent;
+    bool removed_red;
+
+    if (node->left && node->right) {
+        /* Two children: the in-order successor takes node's place */
+        rb_node_t *succ = node->right;
+        while (succ->left) {
+            succ = succ->left;
+        }
+
+        child = succ->right;
+        parent = succ->parent;
+        removed_red = succ->red;
+
+        if (parent == node) {
+            parent = succ;
+        } else {
+            parent->left = child;
+            succ->right = node->right;
+            node->right->parent = succ;
+        }
+        if (child) {
+            child->parent = parent;
+        }
+
+        rb_replace_child(root, node, succ);
+        succ->parent = node->parent;
+        succ->left = node->left;
+        node->left->parent = succ;
+        succ->red = node->red;
+    } else {
+        child = node->left ? node->left : node->right;
+        parent = node->parent;
+        removed_red = node->red;
+
+        if (child) {
+            child->parent = parent;
+        }
+        rb_replace_child(root, node, child);
+    }
+
+    if (!removed_red) {
+        rb_erase_fixup(root, child, parent);
+    }
+}
+
+/* Leftmost (smallest) node */
+rb_node_t *rb_first(const rb_root_t *root) {
+    rb_node_t *node = root->node;
+    if (!node) return NULL;
+
+    while (node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+/* In-order successor */
+rb_node_t *rb_next(const rb_node_t *node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) {
+            node = node->left;
+        }
+        return (rb_node_t *)node;
+    }
+
+    while (node->parent && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
@@ -0,0 +1,230 @@
+#include "sched.h"
+#include "rbtree.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "cpu.h"
+#include "../../drivers/include/timer.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Reserved bandwidth of all deadline tasks (DL_BW_SHIFT fixed point) */
+static uint64_t dl_total_bw = 0;
+static spinlock_t dl_bw_lock = SPINLOCK_INIT;
+
+/* Deadlines missed by all tasks */
+static volatile uint64_t dl_misses_total = 0;
+
+static inline process_t *task_of(rb_node_t *node) {
+    return node ? rb_entry(node, process_t, run_node) : NULL;
+}
+
+/* Budget of one period in TSC cycles */
+static inline int64_t dl_budget_cycles(const process_t *p) {
+    return (int64_t)(p->dl_runtime * sched_tick_cycles());
+}
+
+/* Start a new instance: full budget, deadline relative to now */
+static void dl_replenish(process_t *p, uint64_t now) {
+    p->dl_abs_deadline = now + p->dl_deadline;
+    p->dl_budget = dl_budget_cycles(p);
+    p->throttled = false;
+}
+
+/* A runnable task whose deadline has passed missed it: count it and
+ * restart the reservation so the miss is counted once */
+static void dl_check_miss(process_t *p, uint64_t now) {
+    if (now > p->dl_abs_deadline) {
+        p->dl_misses++;
+        __atomic_add_fetch(&dl_misses_total, 1, __ATOMIC_RELAXED);
+        dl_replenish(p, now);
+    }
+}
+
+/* Charge the running task's budget */
+static void update_curr(process_t *curr) {
+    uint64_t now = rdtsc();
+    if (now <= curr->exec_start) return;
+
+    uint64_t delta = now - curr->exec_start;
+    curr->exec_start = now;
+    curr->sum_exec_runtime += delta;
+    curr->dl_budget -= (int64_t)delta;
+
+    if (curr->dl_budget > 0) {
+        dl_check_miss(curr, timer_get_ticks());
+    }
+}
+
+/* Insert into the deadline-ordered tree, keeping the leftmost cache */
+static void dl_insert(dl_rq_t *dl, process_t *p) {
+    rb_node_t **link = &dl->tasks.node;
+    rb_node_t *parent = NULL;
+    bool leftmost = true;
+
+    while (*link) {
+        parent = *link;
+        if (p->dl_abs_deadline < task_of(parent)->dl_abs_deadline) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = false;
+        }
+    }
+
+    rb_link_node(&p->run_node, parent, link);
+    rb_insert_color(&dl->tasks, &p->run_node);
+    if (leftmost) {
+        dl->leftmost = &p->run_node;
+    }
+}
+
+static void dl_remove(dl_rq_t *dl, process_t *p) {
+    if (dl->leftmost == &p->run_node) {
+        dl->leftmost = rb_next(&p->run_node);
+    }
+    rb_erase(&dl->tasks, &p->run_node);
+}
+
+/* A task arriving from sleep keeps its deadline only if its leftover
+ * budget cannot exceed its reserved bandwidth before that deadline
+ * (constant bandwidth server rule); otherwise it starts a new instance */
+static void dl_enqueue_task(runqueue_t *rq, process_t *p, int flags) {
+    if (flags & (ENQUEUE_WAKEUP | ENQUEUE_NEW)) {
+        uint64_t now = timer_get_ticks();
+        uint64_t cycles = sched_tick_cycles();
+
+        if (p->throttled || p->dl_budget <= 0 || now >= p->dl_abs_deadline ||
+            (uint64_t)p->dl_budget * p->dl_deadline >
+                p->dl_runtime * cycles * (p->dl_abs_deadline - now)) {
+            dl_replenish(p, now);
+        }
+    }
+    dl_insert(&rq->dl, p);
+    rq->dl.nr_running++;
+}
+
+static void dl_dequeue_task(runqueue_t *rq, process_t *p) {
+    dl_remove(&rq->dl, p);
+    rq->dl.nr_running--;
+}
+
+/* Earliest deadline first */
+static process_t *dl_pick_next_task(runqueue_t *rq) {
+    process_t *p = task_of(rq->dl.leftmost);
+    if (p) {
+        dl_dequeue_task(rq, p);
+        dl_check_miss(p, timer_get_ticks());
+    }
+    return p;
+}
+
+static void dl_put_prev_task(runqueue_t *rq, process_t *p) {
+    (void)rq;
+    update_curr(p);
+}
+
+static void dl_set_next_task(runqueue_t *rq, process_t *p) {
+    (void)rq;
+    p->exec_start = rdtsc();
+}
+
+static void dl_task_tick(runqueue_t *rq, process_t *p) {
+    (void)rq;
+    update_curr(p);
+    if (p->dl_budget <= 0) {
+        p->time_slice = 1;   /* Reschedule on this tick */
+    }
+}
+
+/* Run until the budget is used up (whole ticks) */
+static uint64_t dl_time_slice(runqueue_t *rq, process_t *p) {
+    (void)rq;
+    uint64_t cycles = sched_tick_cycles();
+    if (p->dl_budget <= 0 || !cycles) return 1;
+
+    uint64_t slice = ((uint64_t)p->dl_budget + cycles - 1) / cycles;
+    return slice ? slice : 1;
+}
+
+static bool dl_check_preempt(runqueue_t *rq, process_t *curr, process_t *p) {
+    (void)rq;
+    return p->dl_abs_deadline < curr->dl_abs_deadline;
+}
+
+/* Deadlines are absolute ticks, so a stolen task needs no adjustment */
+static process_t *dl_steal_task(runqueue_t *src, runqueue_t *dst,
+                                bool (*can_steal)(process_t *p, void *arg), void *arg) {
+    (void)dst;
+    for (rb_node_t *node = src->dl.leftmost; node; node = rb_next(node)) {
+        process_t *p = task_of(node);
+        if (!can_steal(p, arg)) continue;
+
+        dl_dequeue_task(src, p);
+        return p;
+    }
+    return NULL;
+}
+
+/* Out of budget: wait for the start of the next period */
+static uint64_t dl_throttle_until(runqueue_t *rq, process_t *p) {
+    (void)rq;
+    if (p->dl_budget > 0) return 0;
+
+    uint64_t now = timer_get_ticks();
+    uint64_t next_period = p->dl_abs_deadline - p->dl_deadline + p->dl_period;
+    if (next_period <= now) {
+        dl_replenish(p, now);
+        return 0;
+    }
+    p->throttled = true;
+    return next_period;
+}
+
+/* runtime/period in fixed point */
+uint64_t sched_dl_bandwidth(uint64_t runtime, uint64_t period) {
+    if (!runtime || !period) return 0;
+    return (runtime << DL_BW_SHIFT) / period;
+}
+
+/* Admission control: swap a task's reservation from old_bw to new_bw if
+ * the total stays within DL_BW_LIMIT_PCT of every CPU */
+bool sched_dl_reserve(uint64_t old_bw, uint64_t new_bw) {
+    uint64_t limit = ((uint64_t)smp_cpu_count() * DL_BW_LIMIT_PCT << DL_BW_SHIFT) / 100;
+    bool ok = false;
+
+    uint64_t flags = spin_lock_irqsave(&dl_bw_lock);
+    uint64_t total = dl_total_bw - old_bw + new_bw;
+    if (new_bw <= old_bw || total <= limit) {
+        dl_total_bw = total;
+        ok = true;
+    }
+    spin_unlock_irqrestore(&dl_bw_lock, flags);
+    return ok;
+}
+
+/* Set a task's reservation (ticks) and start its first instance */
+void sched_dl_setup(process_t *p, uint64_t runtime, uint64_t deadline, uint64_t period) {
+    p->dl_runtime = runtime;
+    p->dl_deadline = deadline;
+    p->dl_period = period;
+    dl_replenish(p, timer_get_ticks());
+}
+
+uint64_t sched_dl_total_misses(void) {
+    return dl_misses_total;
+}
+
+const sched_class_t dl_sched_class = {
+    .next = &fair_sched_class,
+    .name = "deadline",
+    .enqueue_task = dl_enqueue_task,
+    .dequeue_task = dl_dequeue_task,
+    .pick_next_task = dl_pick_next_task,
+    .put_prev_task = dl_put_prev_task,
+    .set_next_task = dl_set_next_task,
+    .task_tick = dl_task_tick,
+    .time_slice = dl_time_slice,
+    .check_preempt = dl_check_preempt,
+    .steal_task = dl_steal_task,
+    .throttle_until = dl_throttle_until,
+};
@@ -0,0 +1,237 @@
+#include "sched.h"
+#include "rbtree.h"
+#include "cpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Nice level to load weight (each step is roughly 10% of CPU) */
+static const uint32_t prio_to_weight[40] = {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */  9548,  7620,  6100,  4904,  3906,
+    /*  -5 */  3121,  2501,  1991,  1586,  1277,
+    /*   0 */  1024,   820,   655,   526,   423,
+    /*   5 */   335,   272,   215,   172,   137,
+    /*  10 */   110,    87,    70,    56,    45,
+    /*  15 */    36,    29,    23,    18,    15,
+};
+
+/* TSC cycles per timer tick, refined from the tick interrupt */
+static uint64_t tick_cycles = 1000000;
+static uint64_t last_tick = 0;
+static uint64_t last_tick_tsc = 0;
+
+uint32_t sched_nice_to_weight(int nice) {
+    if (nice < NICE_MIN) nice = NICE_MIN;
+    if (nice > NICE_MAX) nice = NICE_MAX;
+    return prio_to_weight[nice + NICE_OFFSET];
+}
+
+static inline uint32_t task_weight(const process_t *p) {
+    return sched_nice_to_weight((int)p->priority - NICE_OFFSET);
+}
+
+/* Track the TSC rate so tick-based tunables can be applied to cycles */
+void sched_fair_clock_tick(uint64_t ticks) {
+    uint64_t tsc = rdtsc();
+
+    /* Only consecutive ticks give a clean sample (tickless idle skips) */
+    if (last_tick && ticks == last_tick + 1 && tsc > last_tick_tsc) {
+        tick_cycles = (tick_cycles * 7 + (tsc - last_tick_tsc)) / 8;
+    }
+    last_tick = ticks;
+    last_tick_tsc = tsc;
+}
+
+/* Current estimate of TSC cycles per tick */
+uint64_t sched_tick_cycles(void) {
+    return tick_cycles;
+}
+
+/* Real runtime to virtual runtime: heavier tasks age more slowly */
+static inline uint64_t calc_delta_fair(uint64_t delta, const process_t *p) {
+    uint32_t weight = task_weight(p);
+    if (weight == NICE_0_WEIGHT) return delta;
+    return delta * NICE_0_WEIGHT / weight;
+}
+
+static inline bool vruntime_before(uint64_t a, uint64_t b) {
+    return (int64_t)(a - b) < 0;
+}
+
+static inline process_t *task_of(rb_node_t *node) {
+    return node ? rb_entry(node, process_t, run_node) : NULL;
+}
+
+/* Advance min_vruntime to the smallest of curr and the leftmost task */
+static void update_min_vruntime(cfs_rq_t *cfs, const process_t *curr) {
+    uint64_t vruntime = cfs->min_vruntime;
+    bool found = false;
+
+    if (curr) {
+        vruntime = curr->vruntime;
+        found = true;
+    }
+    if (cfs->leftmost) {
+        uint64_t left = task_of(cfs->leftmost)->vruntime;
+        if (!found || vruntime_before(left, vruntime)) {
+            vruntime = left;
+        }
+        found = true;
+    }
+
+    if (found && vruntime_before(cfs->min_vruntime, vruntime)) {
+        cfs->min_vruntime = vruntime;
+    }
+}
+
+/* Charge the running task for the time since it was last accounted */
+static void update_curr(cfs_rq_t *cfs, process_t *curr) {
+    uint64_t now = rdtsc();
+    if (now <= curr->exec_start) return;
+
+    uint64_t delta = now - curr->exec_start;
+    curr->exec_start = now;
+    curr->sum_exec_runtime += delta;
+    curr->vruntime += calc_delta_fair(delta, curr);
+    update_min_vruntime(cfs, curr);
+}
+
+/* Insert into the timeline, keeping the leftmost cache */
+static void timeline_insert(cfs_rq_t *cfs, process_t *p) {
+    rb_node_t **link = &cfs->tasks.node;
+    rb_node_t *parent = NULL;
+    bool leftmost = true;
+
+    while (*link) {
+        parent = *link;
+        if (vruntime_before(p->vruntime, task_of(parent)->vruntime)) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = false;
+        }
+    }
+
+    rb_link_node(&p->run_node, parent, link);
+    rb_insert_color(&cfs->tasks, &p->run_node);
+    if (leftmost) {
+        cfs->leftmost = &p->run_node;
+    }
+}
+
+static void timeline_remove(cfs_rq_t *cfs, process_t *p) {
+    if (cfs->leftmost == &p->run_node) {
+        cfs->leftmost = rb_next(&p->run_node);
+    }
+    rb_erase(&cfs->tasks, &p->run_node);
+}
+
+/* Place a task that was away from the queue: sleepers get a bounded
+ * credit, new tasks start at the current floor */
+static void place_task(cfs_rq_t *cfs, process_t *p, int flags) {
+    uint64_t vruntime = cfs->min_vruntime;
+
+    if (flags & ENQUEUE_WAKEUP) {
+        vruntime -= SCHED_LATENCY_TICKS * tick_cycles / 2;
+    }
+
+    if ((flags & ENQUEUE_NEW) || vruntime_before(p->vruntime, vruntime)) {
+        p->vruntime = vruntime;
+    }
+}
+
+static void fair_enqueue_task(runqueue_t *rq, process_t *p, int flags) {
+    cfs_rq_t *cfs = &rq->cfs;
+
+    if (flags & (ENQUEUE_WAKEUP | ENQUEUE_NEW)) {
+        place_task(cfs, p, flags);
+    }
+    timeline_insert(cfs, p);
+    cfs->load += task_weight(p);
+    cfs->nr_running++;
+}
+
+static void fair_dequeue_task(runqueue_t *rq, process_t *p) {
+    cfs_rq_t *cfs = &rq->cfs;
+
+    timeline_remove(cfs, p);
+    cfs->load -= task_weight(p);
+    cfs->nr_running--;
+    update_min_vruntime(cfs, NULL);
+}
+
+/* Run the task with the smallest virtual runtime */
+static process_t *fair_pick_next_task(runqueue_t *rq) {
+    process_t *p = task_of(rq->cfs.leftmost);
+    if (p) {
+        fair_dequeue_task(rq, p);
+    }
+    return p;
+}
+
+static void fair_put_prev_task(runqueue_t *rq, process_t *p) {
+    update_curr(&rq->cfs, p);
+}
+
+static void fair_set_next_task(runqueue_t *rq, process_t *p) {
+    (void)rq;
+    p->exec_start = rdtsc();
+}
+
+static void fair_task_tick(runqueue_t *rq, process_t *p) {
+    update_curr(&rq->cfs, p);
+}
+
+/* Share of the scheduling period in proportion to weight (ticks) */
+static uint64_t fair_time_slice(runqueue_t *rq, process_t *p) {
+    cfs_rq_t *cfs = &rq->cfs;
+    uint64_t weight = task_weight(p);
+    uint64_t load = cfs->load + weight;
+    uint64_t nr = cfs->nr_running + 1;
+
+    uint64_t period = SCHED_LATENCY_TICKS;
+    if (nr * SCHED_MIN_GRAN_TICKS > period) {
+        period = nr * SCHED_MIN_GRAN_TICKS;
+    }
+
+    uint64_t slice = period * weight / load;
+    return slice < SCHED_MIN_GRAN_TICKS ? SCHED_MIN_GRAN_TICKS : slice;
+}
+
+/* Preempt curr for a woken task that is clearly behind it */
+static bool fair_check_preempt(runqueue_t *rq, process_t *curr, process_t *p) {
+    (void)rq;
+    uint64_t gran = calc_delta_fair(tick_cycles, p);
+    return (int64_t)(curr->vruntime - p->vruntime) > (int64_t)gran;
+}
+
+/* Take the leftmost task the caller allows from another queue, moving its
+ * vruntime from the source queue's clock to the destination's */
+static process_t *fair_steal_task(runqueue_t *src, runqueue_t *dst,
+                                  bool (*can_steal)(process_t *p, void *arg), void *arg) {
+    for (rb_node_t *node = src->cfs.leftmost; node; node = rb_next(node)) {
+        process_t *p = task_of(node);
+        if (!can_steal(p, arg)) continue;
+
+        fair_dequeue_task(src, p);
+        p->vruntime = p->vruntime - src->cfs.min_vruntime + dst->cfs.min_vruntime;
+        return p;
+    }
+    return NULL;
+}
+
+const sched_class_t fair_sched_class = {
+    .next = NULL,
+    .name = "fair",
+    .enqueue_task = fair_enqueue_task,
+    .dequeue_task = fair_dequeue_task,
+    .pick_next_task = fair_pick_next_task,
+    .put_prev_task = fair_put_prev_task,
+    .set_next_task = fair_set_next_task,
+    .task_tick = fair_task_tick,
+    .time_slice = fair_time_slice,
+    .check_preempt = fair_check_preempt,
+    .steal_task = fair_steal_task,
+    .throttle_until = NULL,
+};
@@ -0,0 +1,404 @@
+#include "selftest.h"
+
+#ifdef CONFIG_SELFTEST
+
+#include "log.h"
+#include "process.h"
+#include "sync.h"
+#include "futex.h"
+#include "vfs.h"
+#include "pipe.h"
+#include "memory.h"
+#include "hrtimer.h"
+#include "ktime.h"
+#include "uaccess.h"
+#include "vma.h"
+#include "paging.h"
+#include "../../drivers/include/timer.h"
+#include "../../drivers/include/hpet.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Subsystem name in the log */
+#define SELFTEST_LOG "Selftest"
+
+/* Pipe test: bytes streamed between threads (several trips round the
+ * ring, ending off a ring boundary) */
+#define PIPE_STREAM_BYTES (3 * PIPE_SIZE + 123)
+
+/* File test: bytes compared at the start of the file, the window read
+ * concurrently at its end, and the directory entries searched for it */
+#define FILE_TEST_BYTES   64
+#define FILE_RACE_WINDOW  128
+#define FILE_RACE_CHUNK   4
+#define FILE_SCAN_ENTRIES 16
+
+/* Timer test: sleep length, allowed lateness with a one-shot event device
+ * and with expiry polled from the 1 ms tick, and the restart interval */
+#define HRTIMER_SLEEP_NS       2000000ULL
+#define HRTIMER_SLEEPS         3
+#define HRTIMER_SLACK_EVENT_NS 1000000ULL
+#define HRTIMER_SLACK_TICK_NS  2000000ULL
+#define HRTIMER_PERIOD_NS      1000000ULL
+#define HRTIMER_PERIOD_RUNS    3
+
+/* Mutex test: threads and increments per thread */
+#define MUTEX_THREADS    2
+#define MUTEX_INCREMENTS 2000
+
+static int failures = 0;
+
+/* Test threads: count copies of a function, each passed its index, that
+ * the boot task waits for with selftest_join_threads */
+static struct {
+    void (*fn)(void *arg);
+    semaphore_t done;
+} threads;
+
+static void selftest_thread(void *arg) {
+    threads.fn(arg);
+    sem_up(&threads.done);
+}
+
+/* Start the threads; returns how many started */
+static int selftest_start_threads(void (*fn)(void *arg), int count) {
+    threads.fn = fn;
+    sem_init(&threads.done, 0);
+    int started = 0;
+    for (int i = 0; i < count; i++) {
+        if (kthread_run("selftest", selftest_thread, (void *)(uintptr_t)i)) {
+            started++;
+        }
+    }
+    return started;
+}
+
+static void selftest_join_threads(int started) {
+    for (int i = 0; i < started; i++) {
+        sem_down(&threads.done);
+    }
+}
+
+static void selftest_skip(const char *name, const char *reason) {
+    log_printf(LOG_INFO, SELFTEST_LOG, "%s: skipped (%s)", name, reason);
+}
+
+static void selftest_report(const char *name, bool ok) {
+    if (ok) {
+        log_printf(LOG_INFO, SELFTEST_LOG, "%s: ok", name);
+    } else {
+        failures++;
+        log_printf(LOG_ERROR, SELFTEST_LOG, "%s: FAILED", name);
+    }
+}
+
+/* Mutex and semaphore: threads (on any CPU) add to a counter under the
+ * mutex with a yield inside the critical section; the total shows
+ * whether an increment was lost. The harness joins them on a semaphore. */
+static struct {
+    mutex_t lock;
+    volatile uint32_t counter;
+} mutex_test;
+
+static void mutex_test_thread(void *arg) {
+    (void)arg;
+    for (uint32_t i = 0; i < MUTEX_INCREMENTS; i++) {
+        mutex_lock(&mutex_test.lock);
+        uint32_t value = mutex_test.counter;
+        if ((i & 63) == 0) {
+            process_yield();
+        }
+        mutex_test.counter = value + 1;
+        mutex_unlock(&mutex_test.lock);
+    }
+}
+
+static void selftest_mutex(void) {
+    mutex_init(&mutex_test.lock);
+    mutex_test.counter = 0;
+
+    int started = selftest_start_threads(mutex_test_thread, MUTEX_THREADS);
+    selftest_join_threads(started);
+    selftest_report("mutex/semaphore", started == MUTEX_THREADS &&
+                    mutex_test.counter == MUTEX_THREADS * MUTEX_INCREMENTS);
+}
+
+/* Futex: a thread sleeps on a word until the boot task changes it and
+ * wakes it; a wait on a stale value and a timed-out wait must fail */
+static struct {
+    volatile uint32_t word;
+    volatile bool ready;
+    volatile int result;
+} futex_test;
+
+static void futex_test_thread(void *arg) {
+    (void)arg;
+    futex_test.ready = true;
+    futex_test.result = futex_wait(&futex_test.word, 0, 1000);
+}
+
+static void selftest_futex(void) {
+    futex_test.word = 1;
+    bool stale = futex_wait(&futex_test.word, 0, 10) == -1;
+
+    futex_test.word = 0;
+    uint64_t start = timer_get_ticks();
+    bool timeout = futex_wait(&futex_test.word, 0, 5) == -1 &&
+                   timer_get_ticks() - start >= 4;
+
+    futex_test.ready = false;
+    futex_test.result = 1;
+    bool woken = false;
+    if (selftest_start_threads(futex_test_thread, 1)) {
+        while (!futex_test.ready) {
+            process_sleep(1);
+        }
+        process_sleep(20);   /* Let it queue on the word */
+        futex_test.word = 1;
+        int count = futex_wake(&futex_test.word, 1);
+        selftest_join_threads(1);
+        woken = count == 1 && futex_test.result == 0;
+    }
+    selftest_report("futex wait/wake", stale && timeout && woken);
+}
+
+/* Test byte for position i of a stream */
+static inline uint8_t pattern_byte(uint32_t i) {
+    return (uint8_t)(i * 7 + (i >> 8));
+}
+
+/* Pipes: a round trip, vectored I/O whose segments split differently on
+ * each side, end of file and a non-blocking empty read, then a stream
+ * larger than the ring from a writer thread */
+static int pipe_test_wfd;
+
+static void pipe_test_writer(void *arg) {
+    (void)arg;
+    uint8_t chunk[100];
+    uint32_t sent = 0;
+    while (sent < PIPE_STREAM_BYTES) {
+        uint32_t len = PIPE_STREAM_BYTES - sent < sizeof(chunk) ? PIPE_STREAM_BYTES - sent
+                                                                 : sizeof(chunk);
+        for (uint32_t i = 0; i < len; i++) {
+            chunk[i] = pattern_byte(sent + i);
+        }
+        if (vfs_write(pipe_test_wfd, chunk, len) != (int)len) break;
+        sent += len;
+    }
+    vfs_close(pipe_test_wfd);
+}
+
+static void selftest_pipe(void) {
+    int fds[2];
+    if (vfs_pipe(fds, 0) < 0) {
+        selftest_report("pipe round trip", false);
+        return;
+    }
+
+    uint8_t out[96], in[96];
+    for (uint32_t i = 0; i < sizeof(out); i++) {
+        out[i] = pattern_byte(i);
+    }
+    memset(in, 0, sizeof(in));
+    bool ok = vfs_write(fds[1], out, 40) == 40 && vfs_read(fds[0], in, 40) == 40 &&
+              memcmp(in, out, 40) == 0;
+
+    /* 10 + 30 + 56 bytes in, 50 + 46 bytes out */
+    vfs_iovec_t wiov[3] = {
+        { (uint64_t)out, 10 }, { (uint64_t)(out + 10), 30 }, { (uint64_t)(out + 40), 56 },
+    };
+    vfs_iovec_t riov[2] = { { (uint64_t)in, 50 }, { (uint64_t)(in + 50), 46 } };
+    memset(in, 0, sizeof(in));
+    bool vector = vfs_writev(fds[1], wiov, 3) == 96 && vfs_readv(fds[0], riov, 2) == 96 &&
+                  memcmp(in, out, sizeof(out)) == 0;
+
+    vfs_set_flags(fds[0], VFS_NONBLOCK);
+    bool eagain = vfs_read(fds[0], in, 1) == VFS_EAGAIN;
+    vfs_close(fds[1]);
+    bool eof = vfs_read(fds[0], in, 1) == 0;
+    vfs_close(fds[0]);
+
+    selftest_report("pipe round trip", ok && eagain && eof);
+    selftest_report("pipe readv/writev", vector);
+
+    /* Stream through a blocking pipe */
+    bool stream = false;
+    if (vfs_pipe(fds, 0) == 0) {
+        pipe_test_wfd = fds[1];
+        if (selftest_start_threads(pipe_test_writer, 1)) {
+            uint32_t received = 0;
+            bool match = true;
+            int bytes;
+            while ((bytes = vfs_read(fds[0], in, sizeof(in))) > 0) {
+                for (int i = 0; i < bytes; i++) {
+                    match &= in[i] == pattern_byte(received + (uint32_t)i);
+                }
+                received += (uint32_t)bytes;
+            }
+            selftest_join_threads(1);
+            stream = match && bytes == 0 && received == PIPE_STREAM_BYTES;
+        } else {
+            vfs_close(fds[1]);
+        }
+        vfs_close(fds[0]);
+    }
+    selftest_report("pipe stream", stream);
+}
+
+/* File positions: readv from a seeked position must match pread and
+ * leave the position after the bytes read; two threads reading one fd
+ * must together read the window exactly once. Read-only, on the first
+ * big enough file in the root directory. */
+static struct {
+    int fd;
+    volatile uint32_t bytes[2];
+} file_test;
+
+static void file_test_reader(void *arg) {
+    uint32_t index = (uint32_t)(uintptr_t)arg;
+    uint8_t buf[FILE_RACE_CHUNK];
+    int bytes;
+    while ((bytes = vfs_read(file_test.fd, buf, sizeof(buf))) > 0) {
+        file_test.bytes[index] += (uint32_t)bytes;
+    }
+}
+
+static void selftest_file(void) {
+    vfs_dirent_t *entries = kmalloc(FILE_SCAN_ENTRIES * sizeof(vfs_dirent_t));
+    if (!entries) {
+        selftest_report("file readv offsets", false);
+        return;
+    }
+
+    char path[VFS_PATH_MAX];
+    uint32_t size = 0;
+    int count = vfs_list_directory("/", entries, FILE_SCAN_ENTRIES);
+    for (int i = 0; i < count && !size; i++) {
+        if (entries[i].is_directory || entries[i].size < FILE_RACE_WINDOW) continue;
+        path[0] = '/';
+        uint32_t n = 0;
+        while (entries[i].name[n] && n < sizeof(path) - 2) {
+            path[n + 1] = entries[i].name[n];
+            n++;
+        }
+        path[n + 1] = '\0';
+        size = entries[i].size;
+    }
+    kfree(entries);
+    if (!size) {
+        selftest_skip("file readv offsets", "no file on disk");
+        return;
+    }
+
+    int fd = vfs_open(path);
+    uint8_t ref[FILE_TEST_BYTES], buf[FILE_TEST_BYTES];
+    if (fd < 0 || vfs_pread(fd, ref, sizeof(ref), 0) != (int)sizeof(ref)) {
+        if (fd >= 0) vfs_close(fd);
+        selftest_report("file readv offsets", false);
+        return;
+    }
+
+    /* 5 + 0 + 20 + 23 bytes from offset 8, then a plain read */
+    memset(buf, 0, sizeof(buf));
+    vfs_iovec_t iov[4] = {
+        { (uint64_t)buf, 5 }, { (uint64_t)(buf + 5), 0 },
+        { (uint64_t)(buf + 5), 20 }, { (uint64_t)(buf + 25), 23 },
+    };
+    bool ok = vfs_lseek(fd, 8, VFS_SEEK_SET) == 8 && vfs_readv(fd, iov, 4) == 48 &&
+              vfs_lseek(fd, 0, VFS_SEEK_CUR) == 56 && memcmp(buf, ref + 8, 48) == 0 &&
+              vfs_read(fd, buf, 8) == 8 && memcmp(buf, ref + 56, 8) == 0 &&
+              vfs_lseek(fd, 0, VFS_SEEK_CUR) == 64;
+    selftest_report("file readv offsets", ok);
+
+    /* Two readers share the position over the last bytes of the file */
+    file_test.fd = fd;
+    file_test.bytes[0] = 0;
+    file_test.bytes[1] = 0;
+    int started = 0;
+    if (vfs_lseek(fd, (int64_t)(size - FILE_RACE_WINDOW), VFS_SEEK_SET) >= 0) {
+        started = selftest_start_threads(file_test_reader, 2);
+    }
+    selftest_join_threads(started);
+    vfs_close(fd);
+    selftest_report("file shared position", started == 2 &&
+                    file_test.bytes[0] + file_test.bytes[1] == FILE_RACE_WINDOW);
+}
+
+/* hrtimers: a sleep never ends early and, at least once out of a few
+ * tries, ends within the device's slack; a periodic timer restarts from
+ * its callback and then cancels itself there */
+static volatile uint32_t hrtimer_test_runs;
+
+static hrtimer_restart_t hrtimer_test_callback(hrtimer_t *timer) {
+    if (++hrtimer_test_runs < HRTIMER_PERIOD_RUNS) {
+        hrtimer_forward(timer, ktime_ns(), HRTIMER_PERIOD_NS);
+        return HRTIMER_RESTART;
+    }
+    hrtimer_cancel(timer);
+    return HRTIMER_NORESTART;
+}
+
+static void selftest_hrtimer(void) {
+    uint64_t slack = (timer_event_capable() || hpet_oneshot_available())
+                     ? HRTIMER_SLACK_EVENT_NS : HRTIMER_SLACK_TICK_NS;
+    bool early = false;
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < HRTIMER_SLEEPS; i++) {
+        uint64_t start = ktime_ns();
+        hrtimer_sleep_ns(HRTIMER_SLEEP_NS);
+        uint64_t elapsed = ktime_ns() - start;
+        if (elapsed < HRTIMER_SLEEP_NS) {
+            early = true;
+        } else if (elapsed - HRTIMER_SLEEP_NS < best) {
+            best = elapsed - HRTIMER_SLEEP_NS;
+        }
+    }
+    selftest_report("hrtimer sleep accuracy", !early && best <= slack);
+
+    hrtimer_t timer;
+    hrtimer_test_runs = 0;
+    hrtimer_init(&timer, hrtimer_test_callback, NULL);
+    hrtimer_start(&timer, ktime_ns() + HRTIMER_PERIOD_NS);
+    hrtimer_sleep_ns(HRTIMER_PERIOD_NS * HRTIMER_PERIOD_RUNS + 10 * slack);
+    bool queued = hrtimer_cancel(&timer);
+    selftest_report("hrtimer restart and self-cancel",
+                    hrtimer_test_runs == HRTIMER_PERIOD_RUNS && !queued);
+}
+
+/* User copies: kernel and straddling ranges are refused up front, and a
+ * copy that faults on an unmapped user page (this context has no address
+ * space) returns an error instead of panicking */
+static void selftest_uaccess(void) {
+    static const char kernel_string[] = "kernel";
+    char buf[16];
+    uint64_t unmapped = USER_STACK_TOP - PAGE_SIZE;
+
+    bool ok = copy_from_user(buf, (uint64_t)kernel_string, sizeof(kernel_string)) != 0 &&
+              copy_from_user(buf, USER_SPACE_END - 4, 8) != 0 &&
+              strncpy_from_user(buf, (uint64_t)kernel_string, sizeof(buf)) < 0;
+    selftest_report("uaccess range checks", ok);
+
+    ok = copy_from_user(buf, unmapped, sizeof(buf)) != 0 &&
+         copy_to_user(unmapped, buf, sizeof(buf)) != 0 &&
+         strncpy_from_user(buf, unmapped, sizeof(buf)) < 0;
+    selftest_report("uaccess fault recovery", ok);
+}
+
+void selftest_run(void) {
+    failures = 0;
+
+    selftest_mutex();
+    selftest_futex();
+    selftest_pipe();
+    selftest_file();
+    selftest_hrtimer();
+    selftest_uaccess();
+
+    if (failures) {
+        log_printf(LOG_ERROR, SELFTEST_LOG, "%d test(s) failed", failures);
+    } else {
+        LOG_INFO_MSG(SELFTEST_LOG, "All tests passed");
+    }
+}
+
+#endif /* CONFIG_SELFTEST */
@@ -0,0 +1,268 @@
+#include "shm.h"
+#include "vma.h"
+#include "process.h"
+#include "paging.h"
+#include "memory.h"
+#include "spinlock.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    bool in_use;
+    bool linked;                /* Reachable by name */
+    bool shared;                /* Usable by other thread groups */
+    char name[SHM_NAME_MAX];
+    uint32_t owner;             /* Creating thread group (0 for the kernel) */
+    uint32_t size;              /* Page aligned */
+    uint32_t refs;              /* Mappings */
+    uint64_t *pages;            /* Physical frame of each page */
+} shm_object_t;
+
+static shm_object_t shm_objects[SHM_MAX_OBJECTS];
+static uint64_t shm_total;      /* Bytes held by all objects */
+static spinlock_t shm_lock = SPINLOCK_INIT;
+
+/* Thread group of the caller, 0 for kernel threads */
+static uint32_t shm_caller(void) {
+    process_t *current = process_get_current();
+    return (current && current->mm) ? current->tgid : 0;
+}
+
+static bool shm_allowed(const shm_object_t *obj, uint32_t caller) {
+    return caller == 0 || obj->shared || obj->owner == caller;
+}
+
+/* Give back an object's frames and frame list */
+static void shm_free_pages(uint64_t *pages, uint32_t size) {
+    if (!pages) return;
+    for (uint32_t i = 0; i < size / PAGE_SIZE; i++) {
+        if (pages[i]) {
+            pmm_free_frame((void *)pages[i]);
+        }
+    }
+    kfree(pages);
+}
+
+/* Zero-filled frames for size bytes, or NULL */
+static uint64_t *shm_alloc_pages(uint32_t size) {
+    uint32_t count = size / PAGE_SIZE;
+    uint64_t *pages = (uint64_t *)kmalloc(count * sizeof(uint64_t));
+    if (!pages) return NULL;
+    memset(pages, 0, count * sizeof(uint64_t));
+
+    for (uint32_t i = 0; i < count; i++) {
+        pages[i] = (uint64_t)pmm_alloc_frame();
+        if (!pages[i]) {
+            shm_free_pages(pages, size);
+            return NULL;
+        }
+        memset(phys_to_virt(pages[i]), 0, PAGE_SIZE);
+    }
+    return pages;
+}
+
+static bool shm_name_equal(const char *a, const char *b) {
+    for (int i = 0; i < SHM_NAME_MAX; i++) {
+        if (a[i] != b[i]) return false;
+        if (!a[i]) return true;
+    }
+    return true;
+}
+
+static bool shm_name_valid(const char *name) {
+    if (!name || !name[0]) return false;
+    for (int i = 0; i < SHM_NAME_MAX; i++) {
+        if (!name[i]) return true;
+    }
+    return false;   /* Too long */
+}
+
+/* Object for an id, or NULL (shm_lock held) */
+static shm_object_t *shm_lookup(uint32_t id) {
+    if (id < 1 || id > SHM_MAX_OBJECTS) return NULL;
+    shm_object_t *obj = &shm_objects[id - 1];
+    return obj->in_use ? obj : NULL;
+}
+
+/* Free an object nobody can reach any more (shm_lock held); returns the
+ * frame list to release with shm_free_pages() after unlocking */
+static uint64_t *shm_release_if_unused(shm_object_t *obj, uint32_t *size) {
+    if (obj->linked || obj->refs) return NULL;
+    uint64_t *pages = obj->pages;
+    *size = obj->size;
+    shm_total -= obj->size;
+    obj->in_use = false;
+    obj->pages = NULL;
+    return pages;
+}
+
+int shm_open(const char *name, uint32_t size, uint32_t flags) {
+    if (!shm_name_valid(name)) return -1;
+    uint32_t caller = shm_caller();
+
+    uint64_t irq = spin_lock_irqsave(&shm_lock);
+    for (int i = 0; i < SHM_MAX_OBJECTS; i++) {
+        shm_object_t *obj = &shm_objects[i];
+        if (obj->in_use && obj->linked && shm_name_equal(obj->name, name)) {
+            bool ok = !(flags & SHM_EXCL) && shm_allowed(obj, caller);
+            spin_unlock_irqrestore(&shm_lock, irq);
+            return ok ? i + 1 : -1;
+        }
+    }
+
+    /* Reserve the size against the total before allocating outside the
+     * lock */
+    if (!(flags & SHM_CREATE) || size == 0 || size > SHM_MAX_SIZE) {
+        spin_unlock_irqrestore(&shm_lock, irq);
+        return -1;
+    }
+    size = (size + PAGE_SIZE - 1) & ~(uint32_t)(PAGE_SIZE - 1);
+    if (shm_total + size > SHM_TOTAL_MAX) {
+        spin_unlock_irqrestore(&shm_lock, irq);
+        return -1;
+    }
+    shm_total += size;
+    spin_unlock_irqrestore(&shm_lock, irq);
+
+    uint64_t *pages = shm_alloc_pages(size);
+
+    int id = -1;
+    bool exists = false;
+    irq = spin_lock_irqsave(&shm_lock);
+    for (int i = 0; i < SHM_MAX_OBJECTS && pages; i++) {
+        shm_object_t *obj = &shm_objects[i];
+        /* Someone may have created it meanwhile */
+        if (obj->in_use && obj->linked && shm_name_equal(obj->name, name)) {
+            exists = true;
+            id = (!(flags & SHM_EXCL) && shm_allowed(obj, caller)) ? i + 1 : -1;
+            break;
+        }
+    }
+    if (pages && !exists) {
+        for (int i = 0; i < SHM_MAX_OBJECTS; i++) {
+            shm_object_t *obj = &shm_objects[i];
+            if (obj->in_use) continue;
+
+            obj->in_use = true;
+            obj->linked = true;
+            obj->shared = (flags & SHM_SHARED) != 0;
+            obj->owner = caller;
+            for (int c = 0; c < SHM_NAME_MAX; c++) {
+                obj->name[c] = name[c];
+                if (!name[c]) break;
+            }
+            obj->size = size;
+            obj->refs = 0;
+            obj->pages = pages;
+            pages = NULL;
+            id = i + 1;
+            break;
+        }
+    }
+    if (id < 0 || exists) {
+        shm_total -= size;   /* Out of frames, lost a race, or the table is full */
+    }
+    spin_unlock_irqrestore(&shm_lock, irq);
+
+    shm_free_pages(pages, size);
+    return id;
+}
+
+/* Take a mapping reference if the caller may use the object; returns
+ * the object size or 0 */
+static uint32_t shm_get(uint32_t id) {
+    uint32_t caller = shm_caller();
+    uint32_t size = 0;
+    uint64_t irq = spin_lock_irqsave(&shm_lock);
+    shm_object_t *obj = shm_lookup(id);
+    if (obj && shm_allowed(obj, caller)) {
+        obj->refs++;
+        size = obj->size;
+    }
+    spin_unlock_irqrestore(&shm_lock, irq);
+    return size;
+}
+
+void shm_put(uint32_t id) {
+    uint64_t *pages = NULL;
+    uint32_t size = 0;
+    uint64_t irq = spin_lock_irqsave(&shm_lock);
+    shm_object_t *obj = shm_lookup(id);
+    if (obj && obj->refs) {
+        obj->refs--;
+        pages = shm_release_if_unused(obj, &size);
+    }
+    spin_unlock_irqrestore(&shm_lock, irq);
+
+    shm_free_pages(pages, size);
+}
+
+/* Map lazily: pages are entered by the fault handler on first touch */
+uint64_t shm_map(int id) {
+    process_t *current = process_get_current();
+    if (!current || !current->mm || id < 1) return 0;
+
+    uint32_t size = shm_get((uint32_t)id);
+    if (!size) return 0;
+
+    uint64_t addr = vma_add_shared(current->mm, (uint32_t)id, size, VMA_READ | VMA_WRITE);
+    if (!addr) {
+        shm_put((uint32_t)id);
+    }
+    return addr;
+}
+
+int shm_unmap(uint64_t addr) {
+    process_t *current = process_get_current();
+    if (!current || !current->mm) return -1;
+    return vma_remove(current->mm, addr) ? 0 : -1;
+}
+
+int shm_unlink(const char *name) {
+    if (!shm_name_valid(name)) return -1;
+
+    uint32_t caller = shm_caller();
+    int result = -1;
+    uint64_t *pages = NULL;
+    uint32_t size = 0;
+    uint64_t irq = spin_lock_irqsave(&shm_lock);
+    for (int i = 0; i < SHM_MAX_OBJECTS; i++) {
+        shm_object_t *obj = &shm_objects[i];
+        if (obj->in_use && obj->linked && shm_name_equal(obj->name, name)) {
+            if (caller == 0 || obj->owner == caller) {
+                obj->linked = false;
+                pages = shm_release_if_unused(obj, &size);
+                result = 0;
+            }
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&shm_lock, irq);
+
+    shm_free_pages(pages, size);
+    return result;
+}
+
+uint32_t shm_size(int id) {
+    uint32_t caller = shm_caller();
+    uint32_t size = 0;
+    uint64_t irq = spin_lock_irqsave(&shm_lock);
+    shm_object_t *obj = id > 0 ? shm_lookup((uint32_t)id) : NULL;
+    if (obj && shm_allowed(obj, caller)) {
+        size = obj->size;
+    }
+    spin_unlock_irqrestore(&shm_lock, irq);
+    return size;
+}
+
+uint64_t shm_page_phys(uint32_t id, uint64_t index) {
+    uint64_t phys = 0;
+    uint64_t irq = spin_lock_irqsave(&shm_lock);
+    shm_object_t *obj = shm_lookup(id);
+    if (obj && index < obj->size / PAGE_SIZE) {
+        phys = obj->pages[index];
+    }
+    spin_unlock_irqrestore(&shm_lock, irq);
+    return phys;
+}
@@ -0,0 +1,200 @@
+#include "smp.h"
+#include "limine.h"
+#include "gdt.h"
+#include "idt.h"
+#include "fpu.h"
+#include "cpu.h"
+#include "memory.h"
+#include "paging.h"
+#include "process.h"
+#include "syscall.h"
+#include "irq.h"
+#include "../../drivers/include/apic.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Per-CPU data for every CPU (index = logical CPU number) */
+static cpu_t cpus[MAX_CPUS];
+static uint32_t cpu_count = 1;
+static bool smp_started = false;
+
+/* TLB shootdown request */
+static spinlock_t tlb_lock = SPINLOCK_INIT;
+static volatile uint64_t tlb_addr = 0;
+static volatile uint32_t tlb_pending = 0;    /* Bitmask of CPUs still to flush */
+
+/* How long the BSP waits for an AP to come online (spin iterations) */
+#define AP_START_TIMEOUT 100000000
+
+/* Prepare a per-CPU structure */
+static void percpu_setup(cpu_t *cpu, uint32_t id) {
+    memset(cpu, 0, sizeof(cpu_t));
+    cpu->self = cpu;
+    cpu->id = id;
+    spin_init(&cpu->rq.lock);
+}
+
+_Static_assert(offsetof(cpu_t, kernel_rsp) == CPU_KERNEL_RSP_OFFSET, "SYSCALL stub offset");
+_Static_assert(offsetof(cpu_t, user_rsp) == CPU_USER_RSP_OFFSET, "SYSCALL stub offset");
+
+/* Point GS base at this CPU's data (swapgs exchanges it with the user
+ * value kept in KERNEL_GS_BASE) and load its TSS */
+static void percpu_load(cpu_t *cpu) {
+    wrmsr(MSR_GS_BASE, (uint64_t)cpu);
+    wrmsr(MSR_KERNEL_GS_BASE, 0);
+    gdt_load_tss(cpu->id, &cpu->tss);
+}
+
+/* Set up per-CPU data for the bootstrap CPU (call right after gdt_init) */
+void percpu_init_bsp(void) {
+    percpu_setup(&cpus[0], 0);
+    percpu_load(&cpus[0]);
+    cpus[0].online = true;
+}
+
+/* Invalidate the local TLB entry named by a pending shootdown */
+static void tlb_service(void) {
+    uint32_t bit = 1U << this_cpu()->id;
+    if (__atomic_load_n(&tlb_pending, __ATOMIC_ACQUIRE) & bit) {
+        __asm__ volatile ("invlpg (%0)" :: "r"(tlb_addr) : "memory");
+        __atomic_fetch_and(&tlb_pending, ~bit, __ATOMIC_RELEASE);
+    }
+}
+
+/* Flush a TLB entry on every online CPU */
+void tlb_flush_page(uint64_t virt) {
+    __asm__ volatile ("invlpg (%0)" :: "r"(virt) : "memory");
+
+    if (!smp_started || cpu_count == 1) return;
+
+    uint64_t flags = irq_save();
+    cpu_t *self = this_cpu();
+
+    /* Keep answering other CPUs' shootdowns while waiting for the lock */
+    while (!spin_trylock(&tlb_lock)) {
+        tlb_service();
+        cpu_relax();
+    }
+
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        if (cpus[i].online && &cpus[i] != self) {
+            mask |= 1U << i;
+        }
+    }
+
+    tlb_addr = virt;
+    __atomic_store_n(&tlb_pending, mask, __ATOMIC_RELEASE);
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        if (mask & (1U << i)) {
+            lapic_send_ipi(cpus[i].lapic_id, IPI_VECTOR_TLB);
+        }
+    }
+
+    while (__atomic_load_n(&tlb_pending, __ATOMIC_ACQUIRE)) {
+        cpu_relax();
+    }
+
+    spin_unlock(&tlb_lock);
+    irq_restore(flags);
+}
+
+/* Application processor entry point (called by Limine on the AP) */
+static void ap_entry(struct limine_smp_info *info) {
+    cpu_t *cpu = (cpu_t *)info->extra_argument;
+
+    /* Kernel descriptor tables, then per-CPU data (gdt_load clears GS base) */
+    gdt_load();
+    idt_load();
+    percpu_load(cpu);
+
+    fpu_init_cpu();
+    lapic_init();
+    syscall_init_cpu();
+
+    /* This boot context becomes the CPU's idle task */
+    process_init_ap();
+    __atomic_store_n(&cpu->online, true, __ATOMIC_RELEASE);
+
+    cpu_idle();
+}
+
+/* Inter-processor interrupt handlers */
+static void ipi_resched_handler(void *ctx) {
+    (void)ctx;
+    this_cpu()->need_resched = true;
+}
+
+static void ipi_tlb_handler(void *ctx) {
+    (void)ctx;
+    tlb_service();
+}
+
+/* Start the application processors reported by Limine */
+void smp_init(struct limine_smp_response *smp) {
+    irq_register(IPI_VECTOR_RESCHED, ipi_resched_handler, NULL);
+    irq_register(IPI_VECTOR_TLB, ipi_tlb_handler, NULL);
+
+    if (!smp) return;
+
+    lapic_init();
+    cpus[0].lapic_id = lapic_id();
+
+    for (uint64_t i = 0; i < smp->cpu_count; i++) {
+        struct limine_smp_info *info = smp->cpus[i];
+        if (info->lapic_id == smp->bsp_lapic_id) continue;
+        if (cpu_count >= MAX_CPUS) break;
+
+        cpu_t *cpu = &cpus[cpu_count];
+        percpu_setup(cpu, cpu_count);
+        cpu->lapic_id = info->lapic_id;
+        cpu_count++;
+
+        info->extra_argument = (uint64_t)cpu;
+        __atomic_store_n(&info->goto_address, ap_entry, __ATOMIC_SEQ_CST);
+
+        /* Bring CPUs up one at a time */
+        for (uint32_t spin = 0; spin < AP_START_TIMEOUT; spin++) {
+            if (__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE)) break;
+            cpu_relax();
+        }
+    }
+
+    smp_started = true;
+}
+
+/* Number of CPUs (online or starting) */
+uint32_t smp_cpu_count(void) {
+    return cpu_count;
+}
+
+/* Per-CPU data by logical CPU number */
+cpu_t *smp_get_cpu(uint32_t id) {
+    return (id < cpu_count) ? &cpus[id] : NULL;
+}
+
+/* Ask a CPU to reschedule */
+void smp_send_resched(cpu_t *cpu) {
+    if (!cpu) return;
+
+    cpu->need_resched = true;
+    if (cpu != this_cpu() && cpu->online && lapic_available()) {
+        lapic_send_ipi(cpu->lapic_id, IPI_VECTOR_RESCHED);
+    }
+}
+
+/* Wake one idle CPU so it can steal queued work */
+void smp_kick_idle(void) {
+    if (!smp_started) return;
+
+    cpu_t *self = this_cpu();
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        cpu_t *cpu = &cpus[i];
+        if (cpu == self || !cpu->online) continue;
+        if (cpu->current == cpu->idle && cpu->rq.nr_running == 0) {
+            smp_send_resched(cpu);
+            return;
+        }
+    }
+}
@@ -0,0 +1,170 @@
+#include "softirq.h"
+#include "smp.h"
+#include "cpu.h"
+#include "process.h"
+#include "spinlock.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Passes over newly raised softirqs before IRQ exit gives up and leaves
+ * the rest pending for the next interrupt */
+#define SOFTIRQ_MAX_RESTART 10
+
+/* Tasklets run per softirq pass; a longer backlog goes to ksoftirqd */
+#define TASKLET_BUDGET 16
+
+static void tasklet_softirq(void);
+
+/* Tasklets are always available; other softirqs are opened by drivers */
+static void (*softirq_handlers[SOFTIRQ_COUNT])(void) = {
+    [SOFTIRQ_TASKLET] = tasklet_softirq,
+};
+
+/* Tasklets are not tied to a CPU: one queue serves them all */
+static tasklet_t *tasklet_head = NULL;
+static tasklet_t *tasklet_tail = NULL;
+static spinlock_t tasklet_lock = SPINLOCK_INIT;
+
+static process_t *ksoftirqd = NULL;
+static softirq_stats_t stats;
+
+void open_softirq(softirq_nr_t nr, void (*handler)(void)) {
+    if (nr < SOFTIRQ_COUNT) {
+        softirq_handlers[nr] = handler;
+    }
+}
+
+void raise_softirq(softirq_nr_t nr) {
+    uint64_t flags = irq_save();
+    this_cpu()->softirq_pending |= 1U << nr;
+    irq_restore(flags);
+}
+
+bool in_softirq(void) {
+    return this_cpu()->in_softirq;
+}
+
+void do_softirq(void) {
+    cpu_t *cpu = this_cpu();
+    if (cpu->in_softirq || !cpu->softirq_pending) return;
+
+    /* Interrupts are off here; handlers run with them on, and anything a
+     * nested interrupt raises is picked up by the next pass */
+    cpu->in_softirq = true;
+    for (int pass = 0; pass < SOFTIRQ_MAX_RESTART; pass++) {
+        uint32_t pending = cpu->softirq_pending;
+        if (!pending) break;
+        cpu->softirq_pending = 0;
+
+        __asm__ volatile ("sti" ::: "memory");
+        for (uint32_t nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+            if ((pending & (1U << nr)) && softirq_handlers[nr]) {
+                softirq_handlers[nr]();
+                __atomic_fetch_add(&stats.runs[nr], 1, __ATOMIC_RELAXED);
+            }
+        }
+        __asm__ volatile ("cli" ::: "memory");
+    }
+    cpu->in_softirq = false;
+}
+
+void tasklet_schedule(tasklet_t *t) {
+    uint64_t flags = spin_lock_irqsave(&tasklet_lock);
+    if (!t->scheduled) {
+        t->scheduled = true;
+        t->next = NULL;
+        if (tasklet_tail) {
+            tasklet_tail->next = t;
+        } else {
+            tasklet_head = t;
+        }
+        tasklet_tail = t;
+    }
+    spin_unlock_irqrestore(&tasklet_lock, flags);
+    raise_softirq(SOFTIRQ_TASKLET);
+}
+
+/* Run up to budget queued tasklets; true if more are waiting */
+static bool tasklet_run(uint32_t budget, uint64_t *counter) {
+    uint32_t done = 0;
+
+    uint64_t flags = spin_lock_irqsave(&tasklet_lock);
+    while (tasklet_head && done < budget) {
+        tasklet_t *t = tasklet_head;
+        tasklet_head = t->next;
+        if (!tasklet_head) {
+            tasklet_tail = NULL;
+        }
+        t->next = NULL;
+
+        /* Still running elsewhere: leave it queued for a later pass */
+        if (t->running) {
+            if (tasklet_tail) {
+                tasklet_tail->next = t;
+            } else {
+                tasklet_head = t;
+            }
+            tasklet_tail = t;
+            break;
+        }
+
+        t->scheduled = false;
+        t->running = true;
+        spin_unlock_irqrestore(&tasklet_lock, flags);
+
+        t->func(t->data);
+        done++;
+
+        flags = spin_lock_irqsave(&tasklet_lock);
+        t->running = false;
+    }
+    bool more = tasklet_head != NULL;
+    spin_unlock_irqrestore(&tasklet_lock, flags);
+
+    __atomic_fetch_add(counter, done, __ATOMIC_RELAXED);
+    return more;
+}
+
+static void tasklet_softirq(void) {
+    if (!tasklet_run(TASKLET_BUDGET, &stats.tasklets)) return;
+
+    /* Over budget: let the thread drain the backlog so this interrupt
+     * returns, or retry on the next IRQ exit before it is up */
+    if (ksoftirqd) {
+        process_wake(ksoftirqd);
+    } else {
+        raise_softirq(SOFTIRQ_TASKLET);
+    }
+}
+
+/* Preemptible tasklet runner for backlogs that outlast IRQ exit */
+static void ksoftirqd_thread(void *arg) {
+    (void)arg;
+
+    for (;;) {
+        /* Block before the check, so a wakeup in between is not lost */
+        uint64_t flags = spin_lock_irqsave(&tasklet_lock);
+        if (!tasklet_head) {
+            process_set_blocked(0);
+            spin_unlock_irqrestore(&tasklet_lock, flags);
+            schedule();
+            continue;
+        }
+        spin_unlock_irqrestore(&tasklet_lock, flags);
+
+        tasklet_run(TASKLET_BUDGET, &stats.deferred);
+    }
+}
+
+void softirq_init(void) {
+    ksoftirqd = kthread_run("ksoftirqd", ksoftirqd_thread, NULL);
+}
+
+void softirq_get_stats(softirq_stats_t *out) {
+    for (uint32_t nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+        out->runs[nr] = __atomic_load_n(&stats.runs[nr], __ATOMIC_RELAXED);
+    }
+    out->tasklets = __atomic_load_n(&stats.tasklets, __ATOMIC_RELAXED);
+    out->deferred = __atomic_load_n(&stats.deferred, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,183 @@
+#include "sync.h"
+#include "process.h"
+#include "spinlock.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Initialize a wait queue */
+void wait_queue_init(wait_queue_t *wq) {
+    spin_init(&wq->lock);
+    wq->head = NULL;
+    wq->tail = NULL;
+}
+
+void wait_entry_init(wait_entry_t *entry) {
+    entry->task = process_get_current();
+    entry->next = NULL;
+    entry->queued = false;
+}
+
+/* Unlink an entry (queue lock held) */
+static void wait_unlink(wait_queue_t *wq, wait_entry_t *entry) {
+    wait_entry_t *prev = NULL;
+    for (wait_entry_t *e = wq->head; e; prev = e, e = e->next) {
+        if (e != entry) continue;
+
+        if (prev) {
+            prev->next = e->next;
+        } else {
+            wq->head = e->next;
+        }
+        if (wq->tail == e) {
+            wq->tail = prev;
+        }
+        break;
+    }
+    entry->next = NULL;
+    entry->queued = false;
+}
+
+/* Queue the current task and mark it blocked (optionally with a timeout
+ * in ticks); the caller then re-checks its condition and calls schedule() */
+void wait_prepare(wait_queue_t *wq, wait_entry_t *entry, uint64_t timeout) {
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    if (!entry->queued) {
+        entry->next = NULL;
+        if (wq->tail) {
+            wq->tail->next = entry;
+        } else {
+            wq->head = entry;
+        }
+        wq->tail = entry;
+        entry->queued = true;
+    }
+    process_set_blocked(timeout);
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+/* Leave the queue after the wait is over */
+void wait_finish(wait_queue_t *wq, wait_entry_t *entry) {
+    if (entry->queued) {
+        uint64_t flags = spin_lock_irqsave(&wq->lock);
+        if (entry->queued) {
+            wait_unlink(wq, entry);
+        }
+        spin_unlock_irqrestore(&wq->lock, flags);
+    }
+    process_set_running();
+}
+
+/* Wake the longest waiter. Woken entries are taken off the queue, so a
+ * waiter whose condition is false again re-queues at the tail. */
+void wake_up_one(wait_queue_t *wq) {
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    wait_entry_t *entry = wq->head;
+    if (entry) {
+        wait_unlink(wq, entry);
+        process_wake(entry->task);
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+/* Wake every waiter */
+void wake_up_all(wait_queue_t *wq) {
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    while (wq->head) {
+        wait_entry_t *entry = wq->head;
+        wait_unlink(wq, entry);
+        process_wake(entry->task);
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+/* Initialize a mutex */
+void mutex_init(mutex_t *mutex) {
+    mutex->locked = 0;
+    mutex->owner = NULL;
+    wait_queue_init(&mutex->waiters);
+}
+
+bool mutex_trylock(mutex_t *mutex) {
+    if (__atomic_exchange_n(&mutex->locked, 1, __ATOMIC_ACQUIRE) != 0) {
+        return false;
+    }
+    mutex->owner = process_get_current();
+    return true;
+}
+
+/* Take the mutex, sleeping while another task holds it */
+void mutex_lock(mutex_t *mutex) {
+    while (!mutex_trylock(mutex)) {
+        wait_event(&mutex->waiters, !mutex->locked);
+    }
+}
+
+void mutex_unlock(mutex_t *mutex) {
+    mutex->owner = NULL;
+    /* Full barrier: the waiter check below must not pass the release */
+    __atomic_exchange_n(&mutex->locked, 0, __ATOMIC_SEQ_CST);
+    if (mutex->waiters.head) {
+        wake_up_one(&mutex->waiters);
+    }
+}
+
+/* Initialize a semaphore with count available units */
+void sem_init(semaphore_t *sem, int32_t count) {
+    sem->count = count;
+    wait_queue_init(&sem->waiters);
+}
+
+/* Take a unit if one is available */
+bool sem_trydown(semaphore_t *sem) {
+    int32_t count = __atomic_load_n(&sem->count, __ATOMIC_RELAXED);
+    while (count > 0) {
+        if (__atomic_compare_exchange_n(&sem->count, &count, count - 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Take a unit, sleeping until one is available */
+void sem_down(semaphore_t *sem) {
+    while (!sem_trydown(sem)) {
+        wait_event(&sem->waiters, sem->count > 0);
+    }
+}
+
+/* Release a unit (safe from interrupt context) */
+void sem_up(semaphore_t *sem) {
+    __atomic_add_fetch(&sem->count, 1, __ATOMIC_RELEASE);
+    if (sem->waiters.head) {
+        wake_up_one(&sem->waiters);
+    }
+}
+
+/* Initialize a condition variable */
+void cond_init(condvar_t *cv) {
+    wait_queue_init(&cv->waiters);
+}
+
+/* Release the mutex and sleep until signalled, then retake it. Wakeups
+ * may be spurious, so callers wait in a loop on their predicate. */
+void cond_wait(condvar_t *cv, mutex_t *mutex) {
+    wait_entry_t entry;
+    wait_entry_init(&entry);
+
+    /* Queue before unlocking so a signal sent in between is not lost */
+    wait_prepare(&cv->waiters, &entry, 0);
+    mutex_unlock(mutex);
+    schedule();
+    wait_finish(&cv->waiters, &entry);
+
+    mutex_lock(mutex);
+}
+
+void cond_signal(condvar_t *cv) {
+    wake_up_one(&cv->waiters);
+}
+
+void cond_broadcast(condvar_t *cv) {
+    wake_up_all(&cv->waiters);
+}
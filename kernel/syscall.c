@@ -1,94 +1,429 @@
 #include "syscall.h"
 #include "process.h"
 #include "vfs.h"
+#include "cpu.h"
+#include "gdt.h"
+#include "uring_ctx.h"
+#include "elf.h"
+#include "futex.h"
+#include "shm.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "uaccess.h"
 #include <stdint.h>
+#include <stdbool.h>
 
-/* System call implementations */
+/* System call implementations (unused arguments are ignored). Pointer
+ * arguments are user addresses: they only reach user memory through the
+ * uaccess helpers or the vfs_*_user calls. */
 
-static uint64_t sys_exit(uint64_t status) {
+static uint64_t sys_exit(uint64_t status, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg2; (void)arg3; (void)arg4;
     process_exit((int)status);
     return 0;
 }
 
-static uint64_t sys_fork(void) {
+static uint64_t sys_fork(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg1; (void)arg2; (void)arg3; (void)arg4;
     /* TODO: Implement fork */
     return 0;
 }
 
-static uint64_t sys_read(uint64_t fd, uint64_t buffer, uint64_t size) {
-    return (uint64_t)vfs_read((int)fd, (void *)buffer, (uint32_t)size);
+static uint64_t sys_read(uint64_t fd, uint64_t buffer, uint64_t size, uint64_t arg4) {
+    (void)arg4;
+    if (size > 0xFFFFFFFF) size = 0xFFFFFFFF;
+    return (uint64_t)(int64_t)vfs_read_user((int)fd, buffer, (uint32_t)size, VFS_POS_CURRENT);
 }
 
-static uint64_t sys_write(uint64_t fd, uint64_t buffer, uint64_t size) {
-    return (uint64_t)vfs_write((int)fd, (const void *)buffer, (uint32_t)size);
+static uint64_t sys_write(uint64_t fd, uint64_t buffer, uint64_t size, uint64_t arg4) {
+    (void)arg4;
+    if (size > 0xFFFFFFFF) size = 0xFFFFFFFF;
+    return (uint64_t)(int64_t)vfs_write_user((int)fd, buffer, (uint32_t)size, VFS_POS_CURRENT);
 }
 
-static uint64_t sys_open(uint64_t path) {
-    return (uint64_t)vfs_open((const char *)path);
+/* Positional I/O: the file position is neither used nor moved */
+static uint64_t sys_pread(uint64_t fd, uint64_t buffer, uint64_t size, uint64_t offset) {
+    if (offset > 0xFFFFFFFF) return 0;
+    if (size > 0xFFFFFFFF) size = 0xFFFFFFFF;
+    return (uint64_t)(int64_t)vfs_read_user((int)fd, buffer, (uint32_t)size, (int64_t)offset);
 }
 
-static uint64_t sys_close(uint64_t fd) {
+static uint64_t sys_pwrite(uint64_t fd, uint64_t buffer, uint64_t size, uint64_t offset) {
+    if (offset > 0xFFFFFFFF) return 0;
+    if (size > 0xFFFFFFFF) size = 0xFFFFFFFF;
+    return (uint64_t)(int64_t)vfs_write_user((int)fd, buffer, (uint32_t)size, (int64_t)offset);
+}
+
+/* Vectored I/O over an array of count vfs_iovec_t */
+static uint64_t sys_readv(uint64_t fd, uint64_t iov, uint64_t count, uint64_t arg4) {
+    (void)arg4;
+    return (uint64_t)(int64_t)vfs_readv_user((int)fd, iov, (int)count);
+}
+
+static uint64_t sys_writev(uint64_t fd, uint64_t iov, uint64_t count, uint64_t arg4) {
+    (void)arg4;
+    return (uint64_t)(int64_t)vfs_writev_user((int)fd, iov, (int)count);
+}
+
+static uint64_t sys_lseek(uint64_t fd, uint64_t offset, uint64_t whence, uint64_t arg4) {
+    (void)arg4;
+    return (uint64_t)vfs_lseek((int)fd, (int64_t)offset, (int)whence);
+}
+
+static uint64_t sys_open(uint64_t path, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg2; (void)arg3; (void)arg4;
+    return (uint64_t)(int64_t)vfs_open_user(path);
+}
+
+static uint64_t sys_close(uint64_t fd, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg2; (void)arg3; (void)arg4;
     vfs_close((int)fd);
     return 0;
 }
 
-static uint64_t sys_wait(void) {
+static uint64_t sys_wait(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg1; (void)arg2; (void)arg3; (void)arg4;
     /* TODO: Implement wait */
     return 0;
 }
 
-static uint64_t sys_exec(void) {
-    /* TODO: Implement exec */
-    return 0;
+/* Replace the process image with an ELF executable (returns only on error) */
+static uint64_t sys_exec(uint64_t path, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg2; (void)arg3; (void)arg4;
+    char kpath[VFS_PATH_MAX];
+    if (strncpy_from_user(kpath, path, sizeof(kpath)) < 0) return (uint64_t)-1;
+    return (uint64_t)(int64_t)elf_exec(kpath);
 }
 
-static uint64_t sys_getpid(void) {
+static uint64_t sys_getpid(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg1; (void)arg2; (void)arg3; (void)arg4;
     process_t *current = process_get_current();
-    return current ? current->pid : 0;
+    return current ? current->tgid : 0;  /* Same for every thread */
 }
 
-static uint64_t sys_sleep(uint64_t ticks) {
+static uint64_t sys_sleep(uint64_t ticks, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg2; (void)arg3; (void)arg4;
     process_sleep(ticks);
     return 0;
 }
 
-static uint64_t sys_yield(void) {
+static uint64_t sys_yield(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg1; (void)arg2; (void)arg3; (void)arg4;
     process_yield();
     return 0;
 }
 
-/* System call handler */
-uint64_t syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint64_t arg3) {
-    switch (syscall_num) {
-        case SYS_EXIT:
-            return sys_exit(arg1);
-        case SYS_FORK:
-            return sys_fork();
-        case SYS_READ:
-            return sys_read(arg1, arg2, arg3);
-        case SYS_WRITE:
-            return sys_write(arg1, arg2, arg3);
-        case SYS_OPEN:
-            return sys_open(arg1);
-        case SYS_CLOSE:
-            return sys_close(arg1);
-        case SYS_WAIT:
-            return sys_wait();
-        case SYS_EXEC:
-            return sys_exec();
-        case SYS_GETPID:
-            return sys_getpid();
-        case SYS_SLEEP:
-            return sys_sleep(arg1);
-        case SYS_YIELD:
-            return sys_yield();
+/* Start a thread at entry(arg) in ring 3 with TLS pointer tls (0 for
+ * none) on a stack of its own; returns its tid. Both addresses go to
+ * SYSRET or the FS base MSR, so they must be user addresses. */
+static uint64_t sys_thread_create(uint64_t entry, uint64_t arg, uint64_t tls, uint64_t arg4) {
+    (void)arg4;
+    if (!user_range_ok(entry, 1)) return (uint64_t)-1;
+    if (tls && !user_range_ok(tls, 1)) return (uint64_t)-1;
+
+    process_t *thread = user_thread_create(entry, arg, tls);
+    return thread ? thread->pid : (uint64_t)-1;
+}
+
+/* Wait for a thread; its exit status is stored at status if non-zero */
+static uint64_t sys_thread_join(uint64_t tid, uint64_t status, uint64_t arg3, uint64_t arg4) {
+    (void)arg3; (void)arg4;
+    if (status && !user_range_ok(status, sizeof(int))) return (uint64_t)-1;
+
+    int code;
+    if (thread_join((uint32_t)tid, &code) < 0) return (uint64_t)-1;
+    if (status && copy_to_user(status, &code, sizeof(code)) != 0) return (uint64_t)-1;
+    return 0;
+}
+
+static uint64_t sys_set_tls(uint64_t tls, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg2; (void)arg3; (void)arg4;
+    if (tls && !user_range_ok(tls, 1)) return (uint64_t)-1;
+    thread_set_tls(tls);
+    return 0;
+}
+
+/* Register a submission/completion ring; returns its id */
+static uint64_t sys_uring_setup(uint64_t ring, uint64_t flags, uint64_t arg3, uint64_t arg4) {
+    (void)arg3; (void)arg4;
+    return (uint64_t)(int64_t)uring_register(ring, (uint32_t)flags);
+}
+
+/* Consume a ring's submissions and optionally wait for completions */
+static uint64_t sys_uring_enter(uint64_t id, uint64_t min_complete, uint64_t flags, uint64_t arg4) {
+    (void)arg4;
+    return (uint64_t)uring_enter_ring((int)id, (uint32_t)min_complete, (uint32_t)flags);
+}
+
+static uint64_t sys_uring_exit(uint64_t id, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg2; (void)arg3; (void)arg4;
+    return (uint64_t)(int64_t)uring_unregister((int)id);
+}
+
+/* FUTEX_WAIT: sleep while *uaddr == val (timeout in ticks, 0 = none);
+ * FUTEX_WAKE: wake up to val waiters */
+static uint64_t sys_futex(uint64_t uaddr, uint64_t op, uint64_t val, uint64_t timeout) {
+    if (!user_range_ok(uaddr, sizeof(uint32_t))) return (uint64_t)-1;
+    switch (op) {
+        case FUTEX_WAIT:
+            return (uint64_t)(int64_t)futex_wait((volatile uint32_t *)uaddr, (uint32_t)val, timeout);
+        case FUTEX_WAKE:
+            return (uint64_t)(int64_t)futex_wake((volatile uint32_t *)uaddr, (uint32_t)val);
         default:
             return (uint64_t)-1;
     }
 }
 
-/* Initialize system call interface */
+/* Open or create a named shared memory object; returns its id */
+static uint64_t sys_shm_open(uint64_t name, uint64_t size, uint64_t flags, uint64_t arg4) {
+    (void)arg4;
+    char kname[SHM_NAME_MAX];
+    if (strncpy_from_user(kname, name, sizeof(kname)) < 0) return (uint64_t)-1;
+    return (uint64_t)(int64_t)shm_open(kname, (uint32_t)size, (uint32_t)flags);
+}
+
+/* Map an object into the caller; returns the address (0 on failure) */
+static uint64_t sys_shm_map(uint64_t id, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg2; (void)arg3; (void)arg4;
+    return shm_map((int)id);
+}
+
+static uint64_t sys_shm_unmap(uint64_t addr, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg2; (void)arg3; (void)arg4;
+    return (uint64_t)(int64_t)shm_unmap(addr);
+}
+
+static uint64_t sys_shm_unlink(uint64_t name, uint64_t arg2, uint64_t arg3, uint64_t arg4) {
+    (void)arg2; (void)arg3; (void)arg4;
+    char kname[SHM_NAME_MAX];
+    if (strncpy_from_user(kname, name, sizeof(kname)) < 0) return (uint64_t)-1;
+    return (uint64_t)(int64_t)shm_unlink(kname);
+}
+
+/* Create a pipe, storing the read and write descriptors in fds[0..1] */
+static uint64_t sys_pipe(uint64_t fds, uint64_t flags, uint64_t arg3, uint64_t arg4) {
+    (void)arg3; (void)arg4;
+    int ends[2];
+    if (!fds || !user_range_ok(fds, sizeof(ends))) return (uint64_t)-1;
+    if (vfs_pipe(ends, (uint32_t)flags) < 0) return (uint64_t)-1;
+    if (copy_to_user(fds, ends, sizeof(ends)) != 0) {
+        vfs_close(ends[0]);
+        vfs_close(ends[1]);
+        return (uint64_t)-1;
+    }
+    return 0;
+}
+
+/* Move up to len bytes between a pipe and a file without a user buffer */
+static uint64_t sys_splice(uint64_t fd_in, uint64_t fd_out, uint64_t len, uint64_t arg4) {
+    (void)arg4;
+    return (uint64_t)(int64_t)vfs_splice((int)fd_in, (int)fd_out, (uint32_t)len);
+}
+
+/* Dispatch table indexed by system call number */
+static const syscall_fn_t syscall_table[SYSCALL_COUNT] = {
+    [SYS_EXIT]          = sys_exit,
+    [SYS_FORK]          = sys_fork,
+    [SYS_READ]          = sys_read,
+    [SYS_WRITE]         = sys_write,
+    [SYS_OPEN]          = sys_open,
+    [SYS_CLOSE]         = sys_close,
+    [SYS_WAIT]          = sys_wait,
+    [SYS_EXEC]          = sys_exec,
+    [SYS_GETPID]        = sys_getpid,
+    [SYS_SLEEP]         = sys_sleep,
+    [SYS_YIELD]         = sys_yield,
+    [SYS_THREAD_CREATE] = sys_thread_create,
+    [SYS_THREAD_JOIN]   = sys_thread_join,
+    [SYS_SET_TLS]       = sys_set_tls,
+    [SYS_URING_SETUP]   = sys_uring_setup,
+    [SYS_URING_ENTER]   = sys_uring_enter,
+    [SYS_URING_EXIT]    = sys_uring_exit,
+    [SYS_PREAD]         = sys_pread,
+    [SYS_PWRITE]        = sys_pwrite,
+    [SYS_READV]         = sys_readv,
+    [SYS_WRITEV]        = sys_writev,
+    [SYS_LSEEK]         = sys_lseek,
+    [SYS_FUTEX]         = sys_futex,
+    [SYS_SHM_OPEN]      = sys_shm_open,
+    [SYS_SHM_MAP]       = sys_shm_map,
+    [SYS_SHM_UNMAP]     = sys_shm_unmap,
+    [SYS_SHM_UNLINK]    = sys_shm_unlink,
+    [SYS_PIPE]          = sys_pipe,
+    [SYS_SPLICE]        = sys_splice,
+};
+
+static const char *const syscall_names[SYSCALL_COUNT] = {
+    [SYS_EXIT]          = "exit",
+    [SYS_FORK]          = "fork",
+    [SYS_READ]          = "read",
+    [SYS_WRITE]         = "write",
+    [SYS_OPEN]          = "open",
+    [SYS_CLOSE]         = "close",
+    [SYS_WAIT]          = "wait",
+    [SYS_EXEC]          = "exec",
+    [SYS_GETPID]        = "getpid",
+    [SYS_SLEEP]         = "sleep",
+    [SYS_YIELD]         = "yield",
+    [SYS_THREAD_CREATE] = "thread_create",
+    [SYS_THREAD_JOIN]   = "thread_join",
+    [SYS_SET_TLS]       = "set_tls",
+    [SYS_URING_SETUP]   = "uring_setup",
+    [SYS_URING_ENTER]   = "uring_enter",
+    [SYS_URING_EXIT]    = "uring_exit",
+    [SYS_PREAD]         = "pread",
+    [SYS_PWRITE]        = "pwrite",
+    [SYS_READV]         = "readv",
+    [SYS_WRITEV]        = "writev",
+    [SYS_LSEEK]         = "lseek",
+    [SYS_FUTEX]         = "futex",
+    [SYS_SHM_OPEN]      = "shm_open",
+    [SYS_SHM_MAP]       = "shm_map",
+    [SYS_SHM_UNMAP]     = "shm_unmap",
+    [SYS_SHM_UNLINK]    = "shm_unlink",
+    [SYS_PIPE]          = "pipe",
+    [SYS_SPLICE]        = "splice",
+};
+
+/* Counters per CPU, so the hot path never shares a cache line */
+static syscall_stat_t syscall_stats[MAX_CPUS][SYSCALL_COUNT];
+
+/* Trace ring shared by all traced tasks (oldest records are overwritten) */
+static syscall_trace_t trace_ring[SYSCALL_TRACE_ENTRIES];
+static uint64_t trace_next = 0;
+static spinlock_t trace_lock = SPINLOCK_INIT;
+
+const char *syscall_name(uint32_t num) {
+    return (num < SYSCALL_COUNT && syscall_names[num]) ? syscall_names[num] : "?";
+}
+
+static inline uint32_t syscall_hist_bucket(uint64_t cycles) {
+    if (cycles >> SYSCALL_HIST_SHIFT == 0) return 0;
+    uint32_t bucket = (uint32_t)(63 - __builtin_clzll(cycles)) - SYSCALL_HIST_SHIFT;
+    return bucket < SYSCALL_HIST_BUCKETS ? bucket : SYSCALL_HIST_BUCKETS - 1;
+}
+
+/* Charge one call to this CPU's counters */
+static void syscall_record_stat(uint64_t num, uint64_t cycles) {
+    uint64_t flags = irq_save();
+    syscall_stat_t *stat = &syscall_stats[this_cpu()->id][num];
+    stat->count++;
+    stat->total_cycles += cycles;
+    if (cycles > stat->max_cycles) {
+        stat->max_cycles = cycles;
+    }
+    stat->hist[syscall_hist_bucket(cycles)]++;
+    irq_restore(flags);
+}
+
+static void syscall_trace(const process_t *task, uint64_t num, uint64_t value, bool exit) {
+    uint64_t tsc = rdtsc();
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    syscall_trace_t *rec = &trace_ring[trace_next++ & (SYSCALL_TRACE_ENTRIES - 1)];
+    rec->tsc = tsc;
+    rec->value = value;
+    rec->pid = task->pid;
+    rec->num = (uint16_t)num;
+    rec->exit = exit;
+    spin_unlock_irqrestore(&trace_lock, flags);
+}
+
+/* System call handler (from the SYSCALL entry stub or called directly).
+ * Untraced calls only pay for two TSC reads and a per-CPU update. */
+uint64_t syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint64_t arg3,
+                         uint64_t arg4) {
+    if (syscall_num >= SYSCALL_COUNT || !syscall_table[syscall_num]) {
+        return (uint64_t)-1;
+    }
+
+    process_t *current = process_get_current();
+    bool traced = current && current->trace_syscalls;
+    if (__builtin_expect(traced, 0)) {
+        syscall_trace(current, syscall_num, arg1, false);
+    }
+
+    process_account_syscall_enter();
+    uint64_t start = rdtsc();
+    uint64_t ret = syscall_table[syscall_num](arg1, arg2, arg3, arg4);
+    syscall_record_stat(syscall_num, rdtsc() - start);
+    process_account_syscall_exit();
+
+    if (__builtin_expect(traced, 0)) {
+        syscall_trace(current, syscall_num, ret, true);
+    }
+    return ret;
+}
+
+/* Sum the per-CPU counters */
+void syscall_get_stats(syscall_stat_t stats[SYSCALL_COUNT]) {
+    for (uint32_t n = 0; n < SYSCALL_COUNT; n++) {
+        syscall_stat_t *sum = &stats[n];
+        sum->count = 0;
+        sum->total_cycles = 0;
+        sum->max_cycles = 0;
+        for (uint32_t b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+            sum->hist[b] = 0;
+        }
+
+        for (uint32_t c = 0; c < MAX_CPUS; c++) {
+            const syscall_stat_t *stat = &syscall_stats[c][n];
+            sum->count += stat->count;
+            sum->total_cycles += stat->total_cycles;
+            if (stat->max_cycles > sum->max_cycles) {
+                sum->max_cycles = stat->max_cycles;
+            }
+            for (uint32_t b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+                sum->hist[b] += stat->hist[b];
+            }
+        }
+    }
+}
+
+void syscall_reset_stats(void) {
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        for (uint32_t n = 0; n < SYSCALL_COUNT; n++) {
+            syscall_stat_t *stat = &syscall_stats[c][n];
+            stat->count = 0;
+            stat->total_cycles = 0;
+            stat->max_cycles = 0;
+            for (uint32_t b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+                stat->hist[b] = 0;
+            }
+        }
+    }
+}
+
+/* Copy up to max of the most recent trace records, oldest first */
+int syscall_trace_read(syscall_trace_t *records, int max) {
+    if (max <= 0) return 0;
+
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    uint64_t available = trace_next < SYSCALL_TRACE_ENTRIES ? trace_next : SYSCALL_TRACE_ENTRIES;
+    if ((uint64_t)max < available) {
+        available = (uint64_t)max;
+    }
+    uint64_t first = trace_next - available;
+    for (uint64_t i = 0; i < available; i++) {
+        records[i] = trace_ring[(first + i) & (SYSCALL_TRACE_ENTRIES - 1)];
+    }
+    spin_unlock_irqrestore(&trace_lock, flags);
+    return (int)available;
+}
+
+/* Enable SYSCALL/SYSRET on the calling CPU */
+void syscall_init_cpu(void) {
+    /* SYSCALL loads CS = STAR[47:32] and SS = +8; SYSRET loads
+     * SS = STAR[63:48] + 8 and CS = STAR[63:48] + 16, with RPL 3 */
+    uint64_t star = ((uint64_t)(GDT_USER_DATA - 8) << 48) | ((uint64_t)GDT_KERNEL_CODE << 32);
+
+    wrmsr(MSR_STAR, star);
+    wrmsr(MSR_LSTAR, (uint64_t)syscall_entry);
+    wrmsr(MSR_SFMASK, RFLAGS_IF | RFLAGS_DF | RFLAGS_TF | RFLAGS_AC);
+    wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_SCE);
+}
+
+/* Initialize system call interface (bootstrap CPU; APs call
+ * syscall_init_cpu() as they start) */
 void syscall_init(void) {
-    /* System calls will be invoked through software interrupts */
-    /* For now, we'll use a simple function call interface */
+    syscall_init_cpu();
 }
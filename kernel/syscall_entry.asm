@@ -0,0 +1,93 @@
+; Fast system call entry (SYSCALL from ring 3)
+;
+; In:  rax = call number, rdi/rsi/rdx/r10 = arguments,
+;      rcx = user RIP, r11 = user RFLAGS (saved by the CPU)
+; Out: rax = result; every other register except rcx and r11 is preserved
+
+section .text
+bits 64
+
+; Per-CPU data offsets (CPU_*_OFFSET in smp.h)
+%define CPU_KERNEL_RSP  8
+%define CPU_USER_RSP    16
+
+extern syscall_handler
+
+global syscall_entry
+syscall_entry:
+    ; GS base -> this CPU's data, then move to the task's kernel stack
+    swapgs
+    mov [gs:CPU_USER_RSP], rsp
+    mov rsp, [gs:CPU_KERNEL_RSP]
+
+    ; Return state and the registers the C handler may clobber
+    push qword [gs:CPU_USER_RSP]
+    push r11
+    push rcx
+    push rdi
+    push rsi
+    push rdx
+    push r8
+    push r9
+    push r10
+    sub rsp, 8                      ; Keep the call 16-byte aligned
+
+    ; SFMASK cleared IF; the stack is private now, so allow interrupts
+    sti
+
+    ; syscall_handler(number, arg1, arg2, arg3, arg4) dispatches via
+    ; syscall_table (the fourth argument comes in r10: rcx holds the RIP)
+    mov r8, r10
+    mov rcx, rdx
+    mov rdx, rsi
+    mov rsi, rdi
+    mov rdi, rax
+    call syscall_handler
+
+    cli
+    add rsp, 8
+    pop r10
+    pop r9
+    pop r8
+    pop rdx
+    pop rsi
+    pop rdi
+    pop rcx
+    pop r11
+
+    ; SYSRET to a non-canonical RIP would fault in ring 0: sign-extend
+    ; bit 47 so a bad address faults in user mode instead
+    shl rcx, 16
+    sar rcx, 16
+
+    pop rsp
+    swapgs
+    o64 sysret
+
+; void user_enter(uint64_t rip, uint64_t rsp, uint64_t arg)
+; First entry of a task into ring 3 (interrupts enabled there), with arg
+; in rdi as the first argument of the code at rip
+global user_enter
+user_enter:
+    cli
+    mov rcx, rdi
+    mov rsp, rsi
+    mov rdi, rdx
+    mov r11, 0x202
+
+    ; Do not leak kernel values into user mode
+    xor eax, eax
+    xor ebx, ebx
+    xor edx, edx
+    xor esi, esi
+    xor ebp, ebp
+    xor r8d, r8d
+    xor r9d, r9d
+    xor r10d, r10d
+    xor r12d, r12d
+    xor r13d, r13d
+    xor r14d, r14d
+    xor r15d, r15d
+
+    swapgs
+    o64 sysret
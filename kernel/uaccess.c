@@ -0,0 +1,160 @@
+#include "uaccess.h"
+#include "paging.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The instructions that touch user memory, and where a fault in each
+ * resumes (labels in the functions below) */
+extern const char uaccess_copy_insn[], uaccess_copy_fixup[];
+extern const char uaccess_get32_insn[], uaccess_get32_fixup[];
+extern const char uaccess_put32_insn[], uaccess_put32_fixup[];
+extern const char uaccess_or32_insn[], uaccess_or32_fixup[];
+extern const char uaccess_and32_insn[], uaccess_and32_fixup[];
+
+static const struct {
+    const char *insn;
+    const char *fixup;
+} uaccess_fixups[] = {
+    { uaccess_copy_insn,  uaccess_copy_fixup },
+    { uaccess_get32_insn, uaccess_get32_fixup },
+    { uaccess_put32_insn, uaccess_put32_fixup },
+    { uaccess_or32_insn,  uaccess_or32_fixup },
+    { uaccess_and32_insn, uaccess_and32_fixup },
+};
+
+/* Copy len bytes; returns how many were not copied. A fault in the
+ * rep movsb resumes at uaccess_copy_fixup with rcx holding the bytes
+ * left. Never inlined or cloned, so the labels exist exactly once. */
+__attribute__((noinline, noclone))
+static uint64_t uaccess_copy(void *dst, const void *src, uint64_t len) {
+    __asm__ volatile ("uaccess_copy_insn:\n\t"
+                      "rep movsb\n"
+                      "uaccess_copy_fixup:"
+                      : "+D"(dst), "+S"(src), "+c"(len)
+                      :
+                      : "memory");
+    return len;
+}
+
+int copy_from_user(void *dst, uint64_t src, uint64_t len) {
+    if (!user_range_ok(src, len)) return -1;
+    return uaccess_copy(dst, (const void *)src, len) ? -1 : 0;
+}
+
+int copy_to_user(uint64_t dst, const void *src, uint64_t len) {
+    if (!user_range_ok(dst, len)) return -1;
+    return uaccess_copy((void *)dst, src, len) ? -1 : 0;
+}
+
+/* Word accesses: err starts at -1 and the instruction after the access
+ * clears it, so a fault (resuming past both) leaves -1. Never inlined or
+ * cloned, like uaccess_copy. */
+__attribute__((noinline, noclone))
+static int uaccess_get32(uint32_t *value, uint64_t addr) {
+    int err = -1;
+    uint32_t v = 0;
+    __asm__ volatile ("uaccess_get32_insn:\n\t"
+                      "movl (%2), %1\n\t"
+                      "xorl %0, %0\n"
+                      "uaccess_get32_fixup:"
+                      : "+r"(err), "+r"(v)
+                      : "r"(addr)
+                      : "memory");
+    *value = v;
+    return err;
+}
+
+__attribute__((noinline, noclone))
+static int uaccess_put32(uint64_t addr, uint32_t value) {
+    int err = -1;
+    __asm__ volatile ("uaccess_put32_insn:\n\t"
+                      "movl %1, (%2)\n\t"
+                      "xorl %0, %0\n"
+                      "uaccess_put32_fixup:"
+                      : "+r"(err)
+                      : "r"(value), "r"(addr)
+                      : "memory");
+    return err;
+}
+
+__attribute__((noinline, noclone))
+static int uaccess_or32(uint64_t addr, uint32_t bits) {
+    int err = -1;
+    __asm__ volatile ("uaccess_or32_insn:\n\t"
+                      "lock orl %1, (%2)\n\t"
+                      "xorl %0, %0\n"
+                      "uaccess_or32_fixup:"
+                      : "+r"(err)
+                      : "r"(bits), "r"(addr)
+                      : "memory", "cc");
+    return err;
+}
+
+__attribute__((noinline, noclone))
+static int uaccess_and32(uint64_t addr, uint32_t mask) {
+    int err = -1;
+    __asm__ volatile ("uaccess_and32_insn:\n\t"
+                      "lock andl %1, (%2)\n\t"
+                      "xorl %0, %0\n"
+                      "uaccess_and32_fixup:"
+                      : "+r"(err)
+                      : "r"(mask), "r"(addr)
+                      : "memory", "cc");
+    return err;
+}
+
+static inline bool user_word_ok(uint64_t addr) {
+    return (addr & 3) == 0 && user_range_ok(addr, sizeof(uint32_t));
+}
+
+int get_user_u32(uint32_t *value, uint64_t addr) {
+    if (!user_word_ok(addr)) return -1;
+    return uaccess_get32(value, addr);
+}
+
+int put_user_u32(uint64_t addr, uint32_t value) {
+    if (!user_word_ok(addr)) return -1;
+    return uaccess_put32(addr, value);
+}
+
+int user_atomic_or_u32(uint64_t addr, uint32_t bits) {
+    if (!user_word_ok(addr)) return -1;
+    return uaccess_or32(addr, bits);
+}
+
+int user_atomic_andnot_u32(uint64_t addr, uint32_t bits) {
+    if (!user_word_ok(addr)) return -1;
+    return uaccess_and32(addr, ~bits);
+}
+
+/* Copied a page at a time: a terminator early in the last mapped page
+ * must not fail because the maximum length reaches past it */
+int64_t strncpy_from_user(char *dst, uint64_t src, uint64_t size) {
+    uint64_t copied = 0;
+    while (copied < size) {
+        uint64_t chunk = PAGE_SIZE - ((src + copied) & (PAGE_SIZE - 1));
+        if (chunk > size - copied) {
+            chunk = size - copied;
+        }
+        if (copy_from_user(dst + copied, src + copied, chunk) != 0) {
+            return -1;
+        }
+        for (uint64_t i = 0; i < chunk; i++) {
+            if (dst[copied + i] == '\0') {
+                return (int64_t)(copied + i);
+            }
+        }
+        copied += chunk;
+    }
+    return -1;
+}
+
+bool uaccess_fixup(struct registers *regs) {
+    for (uint32_t i = 0; i < sizeof(uaccess_fixups) / sizeof(uaccess_fixups[0]); i++) {
+        if (regs->rip == (uint64_t)uaccess_fixups[i].insn) {
+            regs->rip = (uint64_t)uaccess_fixups[i].fixup;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,327 @@
+#include "uring_ctx.h"
+#include "process.h"
+#include "sync.h"
+#include "spinlock.h"
+#include "vfs.h"
+#include "uaccess.h"
+#include "../../drivers/include/timer.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A registered ring. Slots are never freed, so a stale id can only find
+ * an unused or different ring, never freed memory. */
+typedef struct {
+    bool in_use;
+    uint32_t tgid;              /* Owning process */
+    uint32_t flags;             /* URING_SETUP_* */
+    uint64_t ring;              /* User address of the uring_t */
+
+    /* Private copies of the indices the kernel produces, so a process
+     * scribbling on the shared ones cannot confuse the kernel */
+    uint32_t sq_head;
+    uint32_t cq_tail;
+
+    mutex_t lock;               /* Serializes consuming the rings */
+    wait_queue_t cq_wait;       /* Tasks waiting for completions */
+    wait_queue_t sq_wait;       /* Sleeping polling thread */
+    uint32_t poller_tid;
+    volatile bool stopping;
+    volatile bool broken;       /* An access to the ring faulted */
+} uring_ctx_t;
+
+static uring_ctx_t uring_table[URING_MAX_RINGS];
+static spinlock_t uring_table_lock = SPINLOCK_INIT;
+
+/* User address of a field or entry of a context's ring */
+#define URING_FIELD(ctx, field) ((ctx)->ring + offsetof(uring_t, field))
+
+/* Look up a ring of the current process */
+static uring_ctx_t *uring_get(int id) {
+    process_t *current = process_get_current();
+    if (id < 1 || id > URING_MAX_RINGS || !current) return NULL;
+
+    uring_ctx_t *ctx = &uring_table[id - 1];
+    if (!ctx->in_use || ctx->stopping || ctx->tgid != current->tgid) return NULL;
+    return ctx;
+}
+
+/* Run one submission (buffers and paths are the process's addresses) */
+static int64_t uring_execute(const uring_sqe_t *sqe) {
+    switch (sqe->opcode) {
+        case URING_OP_NOP:
+            return 0;
+        case URING_OP_READ:
+            return vfs_read_user(sqe->fd, sqe->addr, sqe->len, VFS_POS_CURRENT);
+        case URING_OP_WRITE:
+            return vfs_write_user(sqe->fd, sqe->addr, sqe->len, VFS_POS_CURRENT);
+        case URING_OP_OPEN:
+            return vfs_open_user(sqe->addr);
+        case URING_OP_CLOSE:
+            vfs_close(sqe->fd);
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/* The ring lives in user memory the process can unmap at any time, so
+ * every access goes through the uaccess helpers; a fault marks the ring
+ * broken and the operation fails. */
+
+/* Submissions waiting to be consumed; 0 and false on a fault */
+static bool uring_sq_pending(uring_ctx_t *ctx, uint32_t *pending) {
+    uint32_t tail;
+    if (get_user_u32(&tail, URING_FIELD(ctx, sq_tail)) != 0) {
+        ctx->broken = true;
+        *pending = 0;
+        return false;
+    }
+    *pending = tail - ctx->sq_head;
+    return true;
+}
+
+/* Completions the process has not consumed yet; 0 and false on a fault */
+static bool uring_cq_ready(uring_ctx_t *ctx, uint32_t *ready) {
+    uint32_t head;
+    if (get_user_u32(&head, URING_FIELD(ctx, cq_head)) != 0) {
+        ctx->broken = true;
+        *ready = 0;
+        return false;
+    }
+    *ready = ctx->cq_tail - head;
+    return true;
+}
+
+/* Wait conditions: a fault ends the wait so the caller sees broken */
+static bool uring_sq_wait_done(uring_ctx_t *ctx) {
+    uint32_t pending;
+    return ctx->stopping || !uring_sq_pending(ctx, &pending) || pending != 0;
+}
+
+static bool uring_cq_wait_done(uring_ctx_t *ctx, uint32_t min_complete) {
+    uint32_t ready;
+    return ctx->stopping || !uring_cq_ready(ctx, &ready) || ready >= min_complete;
+}
+
+/* Consume every pending submission that has room for its completion
+ * (ctx->lock held). Returns the number consumed, or -1 if the ring
+ * faulted. */
+static int64_t uring_drain(uring_ctx_t *ctx) {
+    if (ctx->broken) return -1;
+
+    uint32_t pending, ready;
+    if (!uring_sq_pending(ctx, &pending)) return -1;
+
+    /* A tail more than a ring ahead of the head is garbage */
+    if (pending > URING_SQ_ENTRIES) return 0;
+
+    uint32_t done = 0;
+    bool ok = true;
+    while (done < pending) {
+        if (!uring_cq_ready(ctx, &ready)) {
+            ok = false;
+            break;
+        }
+        if (ready >= URING_CQ_ENTRIES) break;
+
+        /* Copy the entry first: the process may reuse the slot as soon
+         * as sq_head moves past it */
+        uring_sqe_t sqe;
+        uint64_t sqe_addr = URING_FIELD(ctx, sqes) +
+                            (ctx->sq_head & (URING_SQ_ENTRIES - 1)) * sizeof(uring_sqe_t);
+        if (copy_from_user(&sqe, sqe_addr, sizeof(sqe)) != 0 ||
+            put_user_u32(URING_FIELD(ctx, sq_head), ctx->sq_head + 1) != 0) {
+            ok = false;
+            break;
+        }
+        ctx->sq_head++;
+
+        /* Entry before index: x86 keeps the stores in order */
+        uring_cqe_t cqe = { sqe.user_data, uring_execute(&sqe) };
+        uint64_t cqe_addr = URING_FIELD(ctx, cqes) +
+                            (ctx->cq_tail & (URING_CQ_ENTRIES - 1)) * sizeof(uring_cqe_t);
+        if (copy_to_user(cqe_addr, &cqe, sizeof(cqe)) != 0 ||
+            put_user_u32(URING_FIELD(ctx, cq_tail), ctx->cq_tail + 1) != 0) {
+            ok = false;
+            break;
+        }
+        ctx->cq_tail++;
+        done++;
+    }
+
+    if (!ok) {
+        ctx->broken = true;
+    }
+    if (done || !ok) {
+        wake_up_all(&ctx->cq_wait);
+    }
+    return ok ? (int64_t)done : -1;
+}
+
+/* Polling thread: consumes submissions as they appear so the process
+ * never enters the kernel to submit. After URING_SQPOLL_IDLE_TICKS
+ * without work it sleeps until woken through URING_ENTER_SQ_WAKEUP. It
+ * stops when the ring is unregistered, its process exits or the ring
+ * faults. */
+static void uring_sqpoll(void *arg) {
+    uring_ctx_t *ctx = (uring_ctx_t *)arg;
+    uint64_t last_work = timer_get_ticks();
+
+    while (!ctx->stopping && !ctx->broken) {
+        mutex_lock(&ctx->lock);
+        int64_t done = uring_drain(ctx);
+        mutex_unlock(&ctx->lock);
+
+        if (done < 0) {
+            break;
+        } else if (done) {
+            last_work = timer_get_ticks();
+        } else if (timer_get_ticks() - last_work >= URING_SQPOLL_IDLE_TICKS) {
+            /* Advertise the sleep before the last check (pairs with the
+             * fence in uring_submit) so a new submission is not missed */
+            if (user_atomic_or_u32(URING_FIELD(ctx, sq_flags), URING_SQ_NEED_WAKEUP) != 0) {
+                ctx->broken = true;
+                break;
+            }
+            wait_event(&ctx->sq_wait, uring_sq_wait_done(ctx));
+            if (user_atomic_andnot_u32(URING_FIELD(ctx, sq_flags), URING_SQ_NEED_WAKEUP) != 0) {
+                ctx->broken = true;
+                break;
+            }
+            last_work = timer_get_ticks();
+            continue;
+        }
+        process_yield();
+    }
+    wake_up_all(&ctx->cq_wait);
+}
+
+/* Register a ring for the current process. With URING_SETUP_SQPOLL a
+ * thread of the process (sharing its address space) polls it. */
+int uring_register(uint64_t ring, uint32_t flags) {
+    process_t *current = process_get_current();
+    if (!current || !current->mm || (flags & ~URING_SETUP_SQPOLL)) return -1;
+    if (!user_range_ok(ring, sizeof(uring_t)) || (ring & 7)) return -1;
+
+    /* Read the indices through the checked path first, so an unmapped
+     * ring fails here */
+    uint32_t sq_head, cq_tail;
+    if (get_user_u32(&sq_head, ring + offsetof(uring_t, sq_head)) != 0 ||
+        get_user_u32(&cq_tail, ring + offsetof(uring_t, cq_tail)) != 0 ||
+        put_user_u32(ring + offsetof(uring_t, sq_flags), 0) != 0) {
+        return -1;
+    }
+
+    uring_ctx_t *ctx = NULL;
+    int id = -1;
+    uint64_t irq = spin_lock_irqsave(&uring_table_lock);
+    for (int i = 0; i < URING_MAX_RINGS; i++) {
+        if (!uring_table[i].in_use) {
+            ctx = &uring_table[i];
+            ctx->in_use = true;
+            id = i + 1;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&uring_table_lock, irq);
+    if (!ctx) return -1;
+
+    ctx->tgid = current->tgid;
+    ctx->flags = flags;
+    ctx->ring = ring;
+    ctx->sq_head = sq_head;
+    ctx->cq_tail = cq_tail;
+    ctx->poller_tid = 0;
+    ctx->stopping = false;
+    ctx->broken = false;
+    mutex_init(&ctx->lock);
+    wait_queue_init(&ctx->cq_wait);
+    wait_queue_init(&ctx->sq_wait);
+
+    if (flags & URING_SETUP_SQPOLL) {
+        process_t *poller = thread_create(uring_sqpoll, ctx, 0);
+        if (!poller) {
+            ctx->in_use = false;
+            return -1;
+        }
+        ctx->poller_tid = poller->pid;
+    }
+    return id;
+}
+
+/* Consume pending submissions (unless a thread polls the ring), then
+ * with URING_ENTER_GETEVENTS wait for min_complete completions. -1 once
+ * the ring has faulted. */
+int64_t uring_enter_ring(int id, uint32_t min_complete, uint32_t flags) {
+    uring_ctx_t *ctx = uring_get(id);
+    if (!ctx || ctx->broken) return -1;
+
+    int64_t submitted = 0;
+    if (ctx->flags & URING_SETUP_SQPOLL) {
+        if (flags & URING_ENTER_SQ_WAKEUP) {
+            wake_up_all(&ctx->sq_wait);
+        }
+    } else {
+        mutex_lock(&ctx->lock);
+        if (!ctx->stopping) {
+            submitted = uring_drain(ctx);
+        }
+        mutex_unlock(&ctx->lock);
+    }
+
+    if (submitted >= 0 && (flags & URING_ENTER_GETEVENTS) && min_complete) {
+        if (min_complete > URING_CQ_ENTRIES) {
+            min_complete = URING_CQ_ENTRIES;
+        }
+        wait_event(&ctx->cq_wait, uring_cq_wait_done(ctx, min_complete));
+    }
+    return ctx->broken ? -1 : submitted;
+}
+
+/* Stop a ring and reap its polling thread (called by a thread of the
+ * owning process) */
+static void uring_stop(uring_ctx_t *ctx) {
+    ctx->stopping = true;
+    wake_up_all(&ctx->sq_wait);
+    wake_up_all(&ctx->cq_wait);
+    if (ctx->poller_tid) {
+        thread_join(ctx->poller_tid, NULL);
+    }
+
+    /* Let a concurrent enter finish with the rings before reuse */
+    mutex_lock(&ctx->lock);
+    ctx->ring = 0;
+    mutex_unlock(&ctx->lock);
+
+    __atomic_store_n(&ctx->in_use, false, __ATOMIC_RELEASE);
+}
+
+/* Unregister a ring, stopping and reaping its polling thread */
+int uring_unregister(int id) {
+    uring_ctx_t *ctx = uring_get(id);
+    if (!ctx) return -1;
+
+    uring_stop(ctx);
+    return 0;
+}
+
+/* The process is exiting: stop every ring it still has, so no polling
+ * thread keeps using its address space */
+void uring_release_process(void) {
+    process_t *current = process_get_current();
+    if (!current) return;
+
+    for (int i = 0; i < URING_MAX_RINGS; i++) {
+        uring_ctx_t *ctx = &uring_table[i];
+        uint64_t irq = spin_lock_irqsave(&uring_table_lock);
+        bool mine = ctx->in_use && !ctx->stopping && ctx->tgid == current->tgid;
+        if (mine) {
+            ctx->stopping = true;
+        }
+        spin_unlock_irqrestore(&uring_table_lock, irq);
+        if (mine) {
+            uring_stop(ctx);
+        }
+    }
+}
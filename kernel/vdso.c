@@ -0,0 +1,70 @@
+#include "vdso_page.h"
+#include "paging.h"
+#include "sched.h"
+#include "cpu.h"
+#include "ktime.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The time page: one kernel page, mapped read-only into each process */
+static union {
+    vdso_data_t data;
+    uint8_t bytes[PAGE_SIZE];
+} vdso_page __attribute__((aligned(PAGE_SIZE)));
+
+static uint64_t vdso_phys = 0;
+
+/* Multiplier turning TSC cycles into nanoseconds: the boot calibration
+ * when there is one, otherwise the rate observed across ticks */
+static uint64_t vdso_calc_mult(uint32_t tick_ns) {
+    uint64_t khz = ktime_tsc_khz();
+    if (khz) return (1000000ULL << VDSO_MULT_SHIFT) / khz;
+
+    uint64_t cycles = sched_tick_cycles();
+    if (!cycles) return 0;
+    return ((uint64_t)tick_ns << VDSO_MULT_SHIFT) / cycles;
+}
+
+/* Set up the page before the timer starts ticking */
+void vdso_init(uint32_t tick_ns) {
+    vdso_data_t *vd = &vdso_page.data;
+
+    vd->seq = 0;
+    vd->tick_ns = tick_ns;
+    vd->ticks = 0;
+    vd->base_tsc = rdtsc();
+    vd->base_ns = 0;
+    vd->mult = vdso_calc_mult(tick_ns);
+
+    vdso_phys = vmm_virt_to_phys((uint64_t)&vdso_page);
+}
+
+/* Publish a new tick (bootstrap CPU timer interrupt, the only writer).
+ * Nanosecond time carries on from the old rate at the current TSC, so a
+ * new calibration changes only the slope and the clock never steps back. */
+void vdso_update(uint64_t ticks) {
+    vdso_data_t *vd = &vdso_page.data;
+    uint64_t tsc = rdtsc();
+
+    __atomic_store_n(&vd->seq, vd->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (tsc > vd->base_tsc) {
+        vd->base_ns += ((tsc - vd->base_tsc) * vd->mult) >> VDSO_MULT_SHIFT;
+    }
+    vd->base_tsc = tsc;
+    vd->ticks = ticks;
+    vd->mult = vdso_calc_mult(vd->tick_ns);
+
+    __atomic_store_n(&vd->seq, vd->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* Map the page read-only for user mode at VDSO_USER_ADDR */
+bool vdso_map(pml4_t *pml4) {
+    if (!pml4 || !vdso_phys) return false;
+    return vmm_map_page(pml4, VDSO_USER_ADDR, vdso_phys, PAGE_PRESENT | PAGE_USER);
+}
+
+uint64_t vdso_kernel_clock_ns(void) {
+    return vdso_clock_ns_from(&vdso_page.data);
+}
@@ -1,5 +1,9 @@
 #include "vfs.h"
 #include "memory.h"
+#include "spinlock.h"
+#include "pipe.h"
+#include "uaccess.h"
+#include "process.h"
 #include "../../drivers/include/fat32.h"
 #include <stdint.h>
 #include <stdbool.h>
@@ -9,6 +13,7 @@
 
 /* File descriptor table */
 static vfs_file_t file_table[MAX_OPEN_FILES];
+static spinlock_t file_table_lock = SPINLOCK_INIT;
 
 /* String helpers */
 static void strcpy(char *dest, const char *src) {
@@ -24,91 +29,584 @@ static void strcpy(char *dest, const char *src) {
 void vfs_init(void) {
     for (int i = 0; i < MAX_OPEN_FILES; i++) {
         file_table[i].open = false;
+        file_table[i].claimed = false;
+        mutex_init(&file_table[i].pos_lock);
     }
     
     /* Initialize FAT32 filesystem */
     fat32_init();
 }
 
-/* Open a file */
-int vfs_open(const char *path) {
-    /* Find free file descriptor */
+/* Thread group descriptors opened now belong to: user processes own
+ * theirs, kernel code (threads without an address space) shares 0 */
+static uint32_t vfs_owner(void) {
+    process_t *current = process_get_current();
+    return (current && current->mm) ? current->tgid : 0;
+}
+
+/* Find and claim a free file descriptor for the caller, or -1. The
+ * caller fills it in and publishes it with vfs_publish_fd(). */
+static int vfs_alloc_fd(void) {
+    uint32_t owner = vfs_owner();
     int fd = -1;
+    uint64_t flags = spin_lock_irqsave(&file_table_lock);
     for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        if (!file_table[i].open) {
+        if (!file_table[i].claimed) {
+            file_table[i].claimed = true;
+            file_table[i].owner = owner;
             fd = i;
             break;
         }
     }
-    
-    if (fd == -1) {
-        return -1;  /* No free descriptors */
+    spin_unlock_irqrestore(&file_table_lock, flags);
+    return fd;
+}
+
+/* Make a filled-in descriptor visible to lookups, holding its own
+ * reference */
+static inline void vfs_publish_fd(int fd) {
+    file_table[fd].refs = 1;
+    __atomic_store_n(&file_table[fd].open, true, __ATOMIC_RELEASE);
+}
+
+/* Give back a claimed descriptor */
+static inline void vfs_release_fd(int fd) {
+    __atomic_store_n(&file_table[fd].claimed, false, __ATOMIC_RELEASE);
+}
+
+/* Open descriptor for fd if the caller owns it, with a reference the
+ * caller drops with vfs_put(); NULL otherwise */
+static vfs_file_t *vfs_get(int fd) {
+    if (fd < 0 || fd >= MAX_OPEN_FILES) return NULL;
+    vfs_file_t *file = &file_table[fd];
+    uint32_t owner = vfs_owner();
+
+    uint64_t flags = spin_lock_irqsave(&file_table_lock);
+    bool ok = file->open && file->owner == owner;
+    if (ok) {
+        file->refs++;
     }
-    
+    spin_unlock_irqrestore(&file_table_lock, flags);
+    return ok ? file : NULL;
+}
+
+/* Drop a reference; the last one closes the pipe end and frees the slot */
+static void vfs_put(vfs_file_t *file) {
+    uint64_t flags = spin_lock_irqsave(&file_table_lock);
+    bool last = --file->refs == 0;
+    spin_unlock_irqrestore(&file_table_lock, flags);
+    if (!last) return;
+
+    if (file->pipe) {
+        pipe_close(file->pipe, file->type == VFS_PIPE_WRITE);
+        file->pipe = NULL;
+    }
+    vfs_release_fd((int)(file - file_table));
+}
+
+/* Unpublish a descriptor (file_table_lock held); true if this call did */
+static bool vfs_unpublish(vfs_file_t *file, uint32_t owner) {
+    if (!file->open || file->owner != owner) return false;
+    file->open = false;
+    return true;
+}
+
+/* Open a file */
+int vfs_open(const char *path) {
     /* Check if file exists */
     if (!fat32_file_exists(path)) {
         return -1;
     }
     
+    int fd = vfs_alloc_fd();
+    if (fd == -1) {
+        return -1;  /* No free descriptors */
+    }
+    
     /* Initialize file descriptor */
-    strcpy(file_table[fd].path, path);
-    file_table[fd].position = 0;
-    file_table[fd].size = fat32_get_file_size(path);
-    file_table[fd].type = VFS_FILE;
-    file_table[fd].open = true;
+    vfs_file_t *file = &file_table[fd];
+    strcpy(file->path, path);
+    file->position = 0;
+    file->size = fat32_get_file_size(path);
+    file->type = VFS_FILE;
+    file->flags = 0;
+    file->pipe = NULL;
+    vfs_publish_fd(fd);
     
     return fd;
 }
 
-/* Close a file */
+/* Close a file. Unpublishing is the claim: of two racing closes only
+ * one drops the descriptor's reference; operations still running keep
+ * the slot and pipe end until they return. */
 void vfs_close(int fd) {
-    if (fd >= 0 && fd < MAX_OPEN_FILES) {
-        file_table[fd].open = false;
+    if (fd < 0 || fd >= MAX_OPEN_FILES) return;
+    
+    vfs_file_t *file = &file_table[fd];
+    uint32_t owner = vfs_owner();
+    uint64_t flags = spin_lock_irqsave(&file_table_lock);
+    bool closed = vfs_unpublish(file, owner);
+    spin_unlock_irqrestore(&file_table_lock, flags);
+    if (closed) {
+        vfs_put(file);
+    }
+}
+
+/* Close what a thread group left open (called when its last thread is
+ * destroyed, from another task) */
+void vfs_close_all(uint32_t owner) {
+    for (int fd = 0; fd < MAX_OPEN_FILES; fd++) {
+        vfs_file_t *file = &file_table[fd];
+        uint64_t flags = spin_lock_irqsave(&file_table_lock);
+        bool closed = vfs_unpublish(file, owner);
+        spin_unlock_irqrestore(&file_table_lock, flags);
+        if (closed) {
+            vfs_put(file);
+        }
+    }
+}
+
+static inline bool vfs_is_pipe(const vfs_file_t *file) {
+    return file->type == VFS_PIPE_READ || file->type == VFS_PIPE_WRITE;
+}
+
+/* Read or write a regular file at offset (the caller holds a reference) */
+static int vfs_file_pread(vfs_file_t *file, void *buffer, uint32_t size, uint32_t offset) {
+    if (file->type != VFS_FILE) {
+        return -1;  /* Pipes have no offsets */
+    }
+    if (offset >= file->size || size == 0) {
+        return 0;
+    }
+    
+    uint32_t bytes_read = 0;
+    if (!fat32_read_range(file->path, (uint8_t *)buffer, offset, size, &bytes_read)) {
+        return -1;
     }
+    return (int)bytes_read;
 }
 
-/* Read from file */
+static int vfs_file_pwrite(vfs_file_t *file, const void *buffer, uint32_t size, uint32_t offset) {
+    if (file->type != VFS_FILE) {
+        return -1;  /* Pipes have no offsets */
+    }
+    if (offset >= file->size || size == 0) {
+        return 0;
+    }
+    
+    uint32_t bytes_written = 0;
+    if (!fat32_write_range(file->path, (const uint8_t *)buffer, offset, size, &bytes_written)) {
+        return -1;
+    }
+    return (int)bytes_written;
+}
+
+/* Read from file at the current position */
 int vfs_read(int fd, void *buffer, uint32_t size) {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd].open) {
+    vfs_file_t *file = vfs_get(fd);
+    if (!file) {
         return -1;
     }
     
-    vfs_file_t *file = &file_table[fd];
+    int bytes;
+    if (vfs_is_pipe(file)) {
+        bytes = (file->type != VFS_PIPE_READ) ? -1
+            : pipe_read(file->pipe, buffer, size, (file->flags & VFS_NONBLOCK) != 0);
+    } else {
+        mutex_lock(&file->pos_lock);
+        bytes = vfs_file_pread(file, buffer, size, file->position);
+        if (bytes > 0) {
+            file->position += (uint32_t)bytes;
+        }
+        mutex_unlock(&file->pos_lock);
+    }
+    vfs_put(file);
+    return bytes;
+}
+
+/* Read from file at offset without moving the position */
+int vfs_pread(int fd, void *buffer, uint32_t size, uint32_t offset) {
+    vfs_file_t *file = vfs_get(fd);
+    if (!file) {
+        return -1;
+    }
+    
+    int bytes = vfs_file_pread(file, buffer, size, offset);
+    vfs_put(file);
+    return bytes;
+}
+
+/* Write to file at the current position */
+int vfs_write(int fd, const void *buffer, uint32_t size) {
+    vfs_file_t *file = vfs_get(fd);
+    if (!file) {
+        return -1;
+    }
     
-    /* Allocate temporary buffer for full file */
-    uint8_t *temp = (uint8_t *)kmalloc(file->size);
-    if (!temp) {
+    int bytes;
+    if (vfs_is_pipe(file)) {
+        bytes = (file->type != VFS_PIPE_WRITE) ? -1
+            : pipe_write(file->pipe, buffer, size, (file->flags & VFS_NONBLOCK) != 0);
+    } else {
+        mutex_lock(&file->pos_lock);
+        bytes = vfs_file_pwrite(file, buffer, size, file->position);
+        if (bytes > 0) {
+            file->position += (uint32_t)bytes;
+        }
+        mutex_unlock(&file->pos_lock);
+    }
+    vfs_put(file);
+    return bytes;
+}
+
+/* Write to file at offset without moving the position. Existing bytes
+ * are overwritten; files cannot grow yet, so the count may be short. */
+int vfs_pwrite(int fd, const void *buffer, uint32_t size, uint32_t offset) {
+    vfs_file_t *file = vfs_get(fd);
+    if (!file) {
         return -1;
     }
     
-    /* Read entire file */
-    uint32_t bytes_read = 0;
-    if (!fat32_read_file(file->path, temp, &bytes_read)) {
-        kfree(temp);
+    int bytes = vfs_file_pwrite(file, buffer, size, offset);
+    vfs_put(file);
+    return bytes;
+}
+
+/* Vectored I/O on a pipe end: each segment is one pipe_read/pipe_write.
+ * Only the first read may wait (as for vfs_read); later ones take what
+ * is buffered. Writes wait for room unless the end is non-blocking. */
+static int vfs_transfer_vector_pipe(vfs_file_t *file, const vfs_iovec_t *iov, int count,
+                                    bool write) {
+    if (file->type != (write ? VFS_PIPE_WRITE : VFS_PIPE_READ)) {
+        return -1;
+    }
+    
+    bool nonblock = (file->flags & VFS_NONBLOCK) != 0;
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        if (iov[i].len == 0) continue;
+        if (iov[i].len > 0x7FFFFFFF - (uint64_t)total) {
+            return total ? total : -1;
+        }
+        
+        uint32_t len = (uint32_t)iov[i].len;
+        int bytes = write
+            ? pipe_write(file->pipe, (const void *)iov[i].base, len, nonblock)
+            : pipe_read(file->pipe, (void *)iov[i].base, len, nonblock || total > 0);
+        if (bytes < 0) {
+            return total ? total : bytes;   /* -1 or VFS_EAGAIN */
+        }
+        
+        total += bytes;
+        if ((uint32_t)bytes < len) break;
+    }
+    return total;
+}
+
+/* Move each segment in turn starting at the file position, stopping at
+ * the first short transfer; the position advances by the total. The
+ * position lock makes the whole vector one step for other users of fd. */
+static int vfs_transfer_vector_file(vfs_file_t *file, const vfs_iovec_t *iov, int count,
+                                    bool write) {
+    mutex_lock(&file->pos_lock);
+    uint32_t offset = file->position;
+    int total = 0;
+    
+    for (int i = 0; i < count; i++) {
+        if (iov[i].len == 0) continue;
+        if (iov[i].len > 0x7FFFFFFF - (uint64_t)total) {
+            total = -1;
+            break;
+        }
+        
+        uint32_t len = (uint32_t)iov[i].len;
+        int bytes = write
+            ? vfs_file_pwrite(file, (const void *)iov[i].base, len, offset)
+            : vfs_file_pread(file, (void *)iov[i].base, len, offset);
+        if (bytes < 0) {
+            if (total == 0) total = -1;
+            break;
+        }
+        
+        total += bytes;
+        offset += (uint32_t)bytes;
+        if ((uint32_t)bytes < len) break;
+    }
+    
+    if (total > 0) {
+        file->position = offset;
+    }
+    mutex_unlock(&file->pos_lock);
+    return total;
+}
+
+static int vfs_transfer_vector(int fd, const vfs_iovec_t *iov, int count, bool write) {
+    if (!iov || count < 0 || count > VFS_IOV_MAX) {
         return -1;
     }
+    vfs_file_t *file = vfs_get(fd);
+    if (!file) {
+        return -1;
+    }
+    
+    int total = vfs_is_pipe(file) ? vfs_transfer_vector_pipe(file, iov, count, write)
+                                  : vfs_transfer_vector_file(file, iov, count, write);
+    vfs_put(file);
+    return total;
+}
+
+/* Scatter read: fill several buffers in one call */
+int vfs_readv(int fd, const vfs_iovec_t *iov, int count) {
+    return vfs_transfer_vector(fd, iov, count, false);
+}
+
+/* Gather write: write several buffers in one call */
+int vfs_writev(int fd, const vfs_iovec_t *iov, int count) {
+    return vfs_transfer_vector(fd, iov, count, true);
+}
+
+/* Read into user memory through a kernel buffer, at offset or (with
+ * VFS_POS_CURRENT) the file position. At most VFS_USER_IO_MAX bytes move
+ * per call; the short count is what read() may return anyway. */
+int vfs_read_user(int fd, uint64_t buffer, uint32_t size, int64_t offset) {
+    if (size > VFS_USER_IO_MAX) size = VFS_USER_IO_MAX;
+    if (!user_range_ok(buffer, size) || offset > 0xFFFFFFFF) return -1;
+    if (size == 0) return 0;
+    
+    void *bounce = kmalloc(size);
+    if (!bounce) return -1;
     
-    /* Copy requested portion */
-    uint32_t available = file->size - file->position;
-    uint32_t to_read = (size < available) ? size : available;
+    int bytes = (offset == VFS_POS_CURRENT)
+        ? vfs_read(fd, bounce, size)
+        : vfs_pread(fd, bounce, size, (uint32_t)offset);
+    if (bytes > 0 && copy_to_user(buffer, bounce, (uint32_t)bytes) != 0) {
+        bytes = -1;
+    }
+    kfree(bounce);
+    return bytes;
+}
+
+/* Write from user memory through a kernel buffer (see vfs_read_user) */
+int vfs_write_user(int fd, uint64_t buffer, uint32_t size, int64_t offset) {
+    if (size > VFS_USER_IO_MAX) size = VFS_USER_IO_MAX;
+    if (!user_range_ok(buffer, size) || offset > 0xFFFFFFFF) return -1;
+    if (size == 0) return 0;
     
-    memcpy(buffer, temp + file->position, to_read);
-    file->position += to_read;
+    void *bounce = kmalloc(size);
+    if (!bounce) return -1;
     
-    kfree(temp);
-    return (int)to_read;
+    int bytes = -1;
+    if (copy_from_user(bounce, buffer, size) == 0) {
+        bytes = (offset == VFS_POS_CURRENT)
+            ? vfs_write(fd, bounce, size)
+            : vfs_pwrite(fd, bounce, size, (uint32_t)offset);
+    }
+    kfree(bounce);
+    return bytes;
 }
 
-/* Write to file */
-int vfs_write(int fd, const void *buffer, uint32_t size) {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || !file_table[fd].open) {
+/* Vectored I/O on user memory: the iovec array is copied in and the
+ * segments share one kernel buffer of at most VFS_USER_IO_MAX bytes */
+static int vfs_transfer_vector_user(int fd, uint64_t iov, int count, bool write) {
+    if (count < 0 || count > VFS_IOV_MAX) return -1;
+    
+    vfs_iovec_t uiov[VFS_IOV_MAX];
+    vfs_iovec_t kiov[VFS_IOV_MAX];
+    if (copy_from_user(uiov, iov, (uint64_t)count * sizeof(vfs_iovec_t)) != 0) {
+        return -1;
+    }
+    
+    /* Clip the segments to the buffer size */
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t len = uiov[i].len;
+        if (len > VFS_USER_IO_MAX - total) len = VFS_USER_IO_MAX - total;
+        if (!user_range_ok(uiov[i].base, len)) return -1;
+        uiov[i].len = len;
+        total += len;
+    }
+    if (total == 0) return 0;
+    
+    uint8_t *bounce = kmalloc(total);
+    if (!bounce) return -1;
+    
+    uint64_t at = 0;
+    int result = 0;
+    for (int i = 0; i < count; i++) {
+        kiov[i].base = (uint64_t)(bounce + at);
+        kiov[i].len = uiov[i].len;
+        if (write && copy_from_user(bounce + at, uiov[i].base, uiov[i].len) != 0) {
+            result = -1;
+        }
+        at += uiov[i].len;
+    }
+    
+    if (result == 0) {
+        result = write ? vfs_writev(fd, kiov, count) : vfs_readv(fd, kiov, count);
+    }
+    
+    /* Hand back what was read, segment by segment */
+    if (!write && result > 0) {
+        uint64_t left = (uint64_t)result;
+        for (int i = 0; i < count && left; i++) {
+            uint64_t len = kiov[i].len < left ? kiov[i].len : left;
+            if (copy_to_user(uiov[i].base, (const void *)kiov[i].base, len) != 0) {
+                result = -1;
+                break;
+            }
+            left -= len;
+        }
+    }
+    kfree(bounce);
+    return result;
+}
+
+int vfs_readv_user(int fd, uint64_t iov, int count) {
+    return vfs_transfer_vector_user(fd, iov, count, false);
+}
+
+int vfs_writev_user(int fd, uint64_t iov, int count) {
+    return vfs_transfer_vector_user(fd, iov, count, true);
+}
+
+/* Open a path held in user memory */
+int vfs_open_user(uint64_t path) {
+    char kpath[VFS_PATH_MAX];
+    if (strncpy_from_user(kpath, path, sizeof(kpath)) < 0) {
+        return -1;
+    }
+    return vfs_open(kpath);
+}
+
+/* Set the file position; returns the new position or -1 */
+int64_t vfs_lseek(int fd, int64_t offset, int whence) {
+    vfs_file_t *file = vfs_get(fd);
+    if (!file) {
+        return -1;
+    }
+    
+    if (file->type != VFS_FILE ||
+        (whence != VFS_SEEK_SET && whence != VFS_SEEK_CUR && whence != VFS_SEEK_END)) {
+        vfs_put(file);
+        return -1;
+    }
+    
+    mutex_lock(&file->pos_lock);
+    int64_t base;
+    switch (whence) {
+        case VFS_SEEK_SET: base = 0; break;
+        case VFS_SEEK_CUR: base = file->position; break;
+        default:           base = file->size; break;
+    }
+    
+    int64_t position = base + offset;
+    if (position < 0 || position > 0xFFFFFFFF) {
+        position = -1;
+    } else {
+        file->position = (uint32_t)position;
+    }
+    mutex_unlock(&file->pos_lock);
+    vfs_put(file);
+    return position;
+}
+
+/* Create a pipe: fds[0] reads what fds[1] writes */
+int vfs_pipe(int fds[2], uint32_t flags) {
+    pipe_t *pipe = pipe_create();
+    if (!pipe) {
+        return -1;
+    }
+    
+    int rfd = vfs_alloc_fd();
+    int wfd = (rfd >= 0) ? vfs_alloc_fd() : -1;
+    if (wfd < 0) {
+        if (rfd >= 0) vfs_release_fd(rfd);
+        pipe_close(pipe, false);
+        pipe_close(pipe, true);
+        return -1;
+    }
+    
+    int ends[2] = { rfd, wfd };
+    for (int i = 0; i < 2; i++) {
+        vfs_file_t *file = &file_table[ends[i]];
+        strcpy(file->path, "pipe");
+        file->position = 0;
+        file->size = 0;
+        file->type = i ? VFS_PIPE_WRITE : VFS_PIPE_READ;
+        file->flags = flags & VFS_NONBLOCK;
+        file->pipe = pipe;
+        vfs_publish_fd(ends[i]);
+    }
+    
+    fds[0] = rfd;
+    fds[1] = wfd;
+    return 0;
+}
+
+/* Replace a descriptor's VFS_* flags */
+int vfs_set_flags(int fd, uint32_t flags) {
+    vfs_file_t *file = vfs_get(fd);
+    if (!file) {
         return -1;
     }
     
-    /* Write support not fully implemented yet */
-    (void)buffer;
-    (void)size;
-    return -1;
+    file->flags = flags & VFS_NONBLOCK;
+    vfs_put(file);
+    return 0;
+}
+
+/* File side of a splice: the pipe ring is read or written in place */
+typedef struct {
+    vfs_file_t *file;
+    uint32_t offset;
+} vfs_splice_ctx_t;
+
+static int vfs_splice_from_file(void *ctx, uint8_t *dst, uint32_t len) {
+    vfs_splice_ctx_t *sc = (vfs_splice_ctx_t *)ctx;
+    int bytes = vfs_file_pread(sc->file, dst, len, sc->offset);
+    if (bytes > 0) sc->offset += (uint32_t)bytes;
+    return bytes;
+}
+
+static int vfs_splice_to_file(void *ctx, const uint8_t *src, uint32_t len) {
+    vfs_splice_ctx_t *sc = (vfs_splice_ctx_t *)ctx;
+    int bytes = vfs_file_pwrite(sc->file, src, len, sc->offset);
+    if (bytes > 0) sc->offset += (uint32_t)bytes;
+    return bytes;
+}
+
+/* Move up to len bytes between a file and a pipe (either direction) at
+ * the file position. The file is read straight into the ring or written
+ * straight from it, with no bounce buffer. Returns the bytes moved, 0 at
+ * end of input, VFS_EAGAIN or -1. */
+int vfs_splice(int fd_in, int fd_out, uint32_t len) {
+    vfs_file_t *in = vfs_get(fd_in);
+    vfs_file_t *out = vfs_get(fd_out);
+    int bytes = -1;
+    
+    /* The file's position lock is held across the transfer, which
+     * becomes one step for other users of the descriptor */
+    if (!in || !out) {
+        /* Bad descriptor */
+    } else if (in->type == VFS_FILE && out->type == VFS_PIPE_WRITE) {
+        mutex_lock(&in->pos_lock);
+        vfs_splice_ctx_t sc = { in, in->position };
+        bytes = pipe_fill(out->pipe, vfs_splice_from_file, &sc, len,
+                          (out->flags & VFS_NONBLOCK) != 0);
+        if (bytes > 0) in->position = sc.offset;
+        mutex_unlock(&in->pos_lock);
+    } else if (in->type == VFS_PIPE_READ && out->type == VFS_FILE) {
+        mutex_lock(&out->pos_lock);
+        vfs_splice_ctx_t sc = { out, out->position };
+        bytes = pipe_drain(in->pipe, vfs_splice_to_file, &sc, len,
+                           (in->flags & VFS_NONBLOCK) != 0);
+        if (bytes > 0) out->position = sc.offset;
+        mutex_unlock(&out->pos_lock);
+    }
+    
+    if (in) vfs_put(in);
+    if (out) vfs_put(out);
+    return bytes;
 }
 
 /* Check if file exists */
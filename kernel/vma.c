@@ -0,0 +1,309 @@
+#include "vma.h"
+#include "process.h"
+#include "paging.h"
+#include "memory.h"
+#include "spinlock.h"
+#include "vfs.h"
+#include "shm.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+static inline uint64_t page_down(uint64_t addr) {
+    return addr & ~(uint64_t)(PAGE_SIZE - 1);
+}
+
+static inline uint64_t page_up(uint64_t addr) {
+    return (addr + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+}
+
+/* Whether [begin, end) overlaps a region (vma_lock held) */
+static bool vma_overlaps(const mm_t *mm, uint64_t begin, uint64_t end) {
+    for (uint32_t i = 0; i < mm->vma_count; i++) {
+        if (begin < mm->vmas[i].end && mm->vmas[i].start < end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Unmap a region's faulted-in pages; private frames are freed, shared
+ * ones belong to their object. Called without vma_lock: each unmap waits
+ * for a TLB shootdown, and another CPU spinning on the lock with
+ * interrupts off would never acknowledge it. The region is VMA_DYING, so
+ * no fault maps new pages into it meanwhile. */
+static void vma_unmap_pages(mm_t *mm, const vma_t *vma) {
+    for (uint64_t page = vma->start; page < vma->end; page += PAGE_SIZE) {
+        uint64_t phys = vmm_get_physical(mm->page_table, page);
+        if (phys) {
+            vmm_unmap_page(mm->page_table, page);
+            if (!(vma->flags & VMA_SHARED)) {
+                pmm_free_frame((void *)page_down(phys));
+            }
+        }
+    }
+}
+
+/* Record a region covering [start, start + size). The first file_size
+ * bytes come from the executable at file_offset. Nothing is mapped yet. */
+bool vma_add(mm_t *mm, uint64_t start, uint64_t size, uint64_t file_offset,
+             uint64_t file_size, uint32_t flags) {
+    if (!mm || size == 0 || file_size > size) return false;
+    if (start < USER_SPACE_BASE || start + size > USER_STACK_TOP || start + size < start) {
+        return false;
+    }
+
+    uint64_t begin = page_down(start);
+    uint64_t end = page_up(start + size);
+    bool ok = false;
+
+    uint64_t irq = spin_lock_irqsave(&mm->vma_lock);
+    if (mm->vma_count < MM_MAX_VMAS && !vma_overlaps(mm, begin, end)) {
+        vma_t *vma = &mm->vmas[mm->vma_count++];
+        vma->start = begin;
+        vma->end = end;
+        vma->file_start = start;
+        vma->file_end = start + file_size;
+        vma->file_offset = file_offset;
+        vma->flags = flags;
+        vma->shm_id = 0;
+        ok = true;
+    }
+    spin_unlock_irqrestore(&mm->vma_lock, irq);
+    return ok;
+}
+
+/* Record a region at the lowest free address from VMA_SHARED_BASE that
+ * leaves guard unmapped bytes below it; returns its start or 0 */
+static uint64_t vma_place(mm_t *mm, uint64_t guard, uint64_t size, uint32_t flags,
+                          uint32_t shm_id) {
+    if (!mm || size == 0) return 0;
+
+    size = page_up(size);
+    uint64_t start = 0;
+
+    uint64_t irq = spin_lock_irqsave(&mm->vma_lock);
+    if (mm->vma_count < MM_MAX_VMAS) {
+        /* Step past each region in the way until nothing overlaps */
+        uint64_t candidate = VMA_SHARED_BASE;
+        bool moved = true;
+        while (moved && candidate + guard + size <= USER_STACK_TOP - USER_STACK_SIZE) {
+            moved = false;
+            for (uint32_t i = 0; i < mm->vma_count; i++) {
+                if (candidate < mm->vmas[i].end &&
+                    mm->vmas[i].start < candidate + guard + size) {
+                    candidate = mm->vmas[i].end;
+                    moved = true;
+                }
+            }
+        }
+        if (!moved) {
+            vma_t *vma = &mm->vmas[mm->vma_count++];
+            vma->start = candidate + guard;
+            vma->end = candidate + guard + size;
+            vma->file_start = 0;
+            vma->file_end = 0;
+            vma->file_offset = 0;
+            vma->flags = flags;
+            vma->shm_id = shm_id;
+            start = vma->start;
+        }
+    }
+    spin_unlock_irqrestore(&mm->vma_lock, irq);
+    return start;
+}
+
+/* Record a region for a shared memory object at a free address; returns
+ * its start or 0. The caller holds a reference on the object that the
+ * region now owns. */
+uint64_t vma_add_shared(mm_t *mm, uint32_t shm_id, uint64_t size, uint32_t flags) {
+    return vma_place(mm, 0, size, flags | VMA_SHARED, shm_id);
+}
+
+/* Record a zero-filled region at a free address with an unmapped guard
+ * page below it (for a thread's stack); returns its start or 0 */
+uint64_t vma_add_anon(mm_t *mm, uint64_t size, uint32_t flags) {
+    return vma_place(mm, PAGE_SIZE, size, flags & ~VMA_SHARED, 0);
+}
+
+/* Whether the region starting at start is still live (vma_lock held) */
+static bool vma_live(const mm_t *mm, uint64_t start) {
+    for (uint32_t i = 0; i < mm->vma_count; i++) {
+        if (mm->vmas[i].start == start) {
+            return !(mm->vmas[i].flags & VMA_DYING);
+        }
+    }
+    return false;
+}
+
+/* Forget every VMA_DYING region (vma_lock held) */
+static void vma_reap(mm_t *mm) {
+    uint32_t i = 0;
+    while (i < mm->vma_count) {
+        if (mm->vmas[i].flags & VMA_DYING) {
+            mm->vmas[i] = mm->vmas[--mm->vma_count];
+        } else {
+            i++;
+        }
+    }
+}
+
+/* Remove the region starting at start, dropping its object reference if
+ * it maps shared memory. The region is marked dying under the lock and
+ * unmapped after dropping it (see vma_unmap_pages). */
+bool vma_remove(mm_t *mm, uint64_t start) {
+    if (!mm) return false;
+
+    vma_t vma;
+    bool found = false;
+
+    uint64_t irq = spin_lock_irqsave(&mm->vma_lock);
+    for (uint32_t i = 0; i < mm->vma_count; i++) {
+        if (mm->vmas[i].start != start || (mm->vmas[i].flags & VMA_DYING)) continue;
+
+        mm->vmas[i].flags |= VMA_DYING;
+        vma = mm->vmas[i];
+        found = true;
+        break;
+    }
+    spin_unlock_irqrestore(&mm->vma_lock, irq);
+    if (!found) return false;
+
+    vma_unmap_pages(mm, &vma);
+
+    irq = spin_lock_irqsave(&mm->vma_lock);
+    for (uint32_t i = 0; i < mm->vma_count; i++) {
+        if (mm->vmas[i].start == start && (mm->vmas[i].flags & VMA_DYING)) {
+            mm->vmas[i] = mm->vmas[--mm->vma_count];
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&mm->vma_lock, irq);
+
+    if (vma.shm_id) {
+        shm_put(vma.shm_id);
+    }
+    return true;
+}
+
+/* Unmap and free every faulted-in page, forget the regions and close
+ * the executable (unmapping outside the lock, as in vma_remove) */
+void vma_clear(mm_t *mm) {
+    if (!mm) return;
+
+    vma_t vmas[MM_MAX_VMAS];
+    uint32_t count = 0;
+
+    uint64_t irq = spin_lock_irqsave(&mm->vma_lock);
+    for (uint32_t i = 0; i < mm->vma_count; i++) {
+        if (mm->vmas[i].flags & VMA_DYING) continue;   /* Being removed already */
+        mm->vmas[i].flags |= VMA_DYING;
+        vmas[count++] = mm->vmas[i];
+    }
+    int fd = mm->exec_fd;
+    mm->exec_fd = -1;
+    spin_unlock_irqrestore(&mm->vma_lock, irq);
+
+    for (uint32_t i = 0; i < count; i++) {
+        vma_unmap_pages(mm, &vmas[i]);
+    }
+
+    irq = spin_lock_irqsave(&mm->vma_lock);
+    vma_reap(mm);
+    spin_unlock_irqrestore(&mm->vma_lock, irq);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (vmas[i].shm_id) {
+            shm_put(vmas[i].shm_id);
+        }
+    }
+    if (fd >= 0) {
+        vfs_close(fd);
+    }
+}
+
+/* Fill a page of a region: file bytes where the region has them, zero
+ * elsewhere (the tail of .data and all of .bss and the stack) */
+static bool vma_fill_page(const mm_t *mm, const vma_t *vma, uint64_t page, uint8_t *dst) {
+    memset(dst, 0, PAGE_SIZE);
+
+    uint64_t from = page > vma->file_start ? page : vma->file_start;
+    uint64_t to = page + PAGE_SIZE < vma->file_end ? page + PAGE_SIZE : vma->file_end;
+    if (from >= to) return true;
+
+    uint32_t len = (uint32_t)(to - from);
+    uint32_t offset = (uint32_t)(vma->file_offset + (from - vma->file_start));
+    return vfs_pread(mm->exec_fd, dst + (from - page), len, offset) == (int)len;
+}
+
+/* Demand paging: map the page under addr if it belongs to a region of
+ * the current address space. Returns false for a genuine fault. */
+bool vma_handle_fault(uint64_t addr, uint64_t error) {
+    process_t *current = process_get_current();
+    mm_t *mm = current ? current->mm : NULL;
+    if (!mm || (error & PF_PRESENT)) return false;
+
+    uint64_t page = page_down(addr);
+    vma_t vma;
+    bool found = false;
+
+    uint64_t irq = spin_lock_irqsave(&mm->vma_lock);
+    for (uint32_t i = 0; i < mm->vma_count; i++) {
+        if (addr >= mm->vmas[i].start && addr < mm->vmas[i].end &&
+            !(mm->vmas[i].flags & VMA_DYING)) {
+            vma = mm->vmas[i];
+            found = true;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&mm->vma_lock, irq);
+
+    if (!found) return false;
+    if ((error & PF_WRITE) && !(vma.flags & VMA_WRITE)) return false;
+
+    uint64_t flags = PAGE_PRESENT | PAGE_USER;
+    if (vma.flags & VMA_WRITE) {
+        flags |= PAGE_WRITE;
+    }
+
+    /* Shared memory: map the object's own page, nothing to allocate */
+    if (vma.flags & VMA_SHARED) {
+        uint64_t phys = shm_page_phys(vma.shm_id, (page - vma.start) / PAGE_SIZE);
+        if (!phys) return false;
+
+        bool mapped = true;
+        irq = spin_lock_irqsave(&mm->vma_lock);
+        if (!vma_live(mm, vma.start)) {
+            mapped = false;     /* Removed while we looked it up */
+        } else if (!vmm_get_physical(mm->page_table, page)) {
+            mapped = vmm_map_page(mm->page_table, page, phys, flags);
+        }
+        spin_unlock_irqrestore(&mm->vma_lock, irq);
+        return mapped;
+    }
+
+    /* Read outside the lock: only the touched part of the file is loaded */
+    void *frame = pmm_alloc_frame();
+    if (!frame) return false;
+    if (!vma_fill_page(mm, &vma, page, (uint8_t *)phys_to_virt((uint64_t)frame))) {
+        pmm_free_frame(frame);
+        return false;
+    }
+
+    /* Another thread may have faulted the same page in meanwhile, or
+     * removed the region while the page was read */
+    bool mapped = true;
+    irq = spin_lock_irqsave(&mm->vma_lock);
+    if (!vma_live(mm, vma.start)) {
+        mapped = false;
+    } else if (vmm_get_physical(mm->page_table, page)) {
+        pmm_free_frame(frame);
+    } else {
+        mapped = vmm_map_page(mm->page_table, page, (uint64_t)frame, flags);
+    }
+    spin_unlock_irqrestore(&mm->vma_lock, irq);
+
+    if (!mapped) {
+        pmm_free_frame(frame);
+    }
+    return mapped;
+}
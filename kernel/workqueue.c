@@ -0,0 +1,199 @@
+#include "workqueue.h"
+#include "process.h"
+#include "memory.h"
+#include "spinlock.h"
+#include "../../drivers/include/timer.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Shared general-purpose workqueue */
+workqueue_t *system_wq = NULL;
+
+/* String copy helper */
+static void wq_strncpy(char *dest, const char *src, int n) {
+    int i;
+    for (i = 0; i < n - 1 && src[i]; i++) {
+        dest[i] = src[i];
+    }
+    dest[i] = '\0';
+}
+
+/* Append a work item (queue lock held) */
+static void wq_append(workqueue_t *wq, work_t *work) {
+    work->next = NULL;
+    work->pending = true;
+    if (wq->tail) {
+        wq->tail->next = work;
+    } else {
+        wq->head = work;
+    }
+    wq->tail = work;
+    wq->queued++;
+}
+
+/* Move expired delayed items to the run list and return the earliest
+ * remaining expiry (0 = none). Queue lock held. */
+static uint64_t wq_promote_delayed(workqueue_t *wq, uint64_t now) {
+    uint64_t earliest = 0;
+    delayed_work_t **link = &wq->delayed;
+
+    while (*link) {
+        delayed_work_t *dwork = *link;
+        if (dwork->expires <= now) {
+            *link = dwork->next;
+            dwork->next = NULL;
+            dwork->timer_pending = false;
+            wq_append(wq, &dwork->work);
+        } else {
+            if (earliest == 0 || dwork->expires < earliest) {
+                earliest = dwork->expires;
+            }
+            link = &dwork->next;
+        }
+    }
+    return earliest;
+}
+
+/* Worker thread main loop */
+static void worker_thread(void *arg) {
+    workqueue_t *wq = (workqueue_t *)arg;
+
+    for (;;) {
+        uint64_t flags = spin_lock_irqsave(&wq->lock);
+        uint64_t now = timer_get_ticks();
+        uint64_t earliest = wq_promote_delayed(wq, now);
+
+        work_t *work = wq->head;
+        if (!work) {
+            /* Nothing to do: sleep until the next delayed item or a wakeup.
+             * Blocking before dropping the lock means a concurrent
+             * queue_work() wakeup cannot be missed. */
+            process_set_blocked(earliest ? earliest - now : 0);
+            spin_unlock_irqrestore(&wq->lock, flags);
+            schedule();
+            continue;
+        }
+
+        wq->head = work->next;
+        if (!wq->head) {
+            wq->tail = NULL;
+        }
+        work->next = NULL;
+        work->pending = false;
+        spin_unlock_irqrestore(&wq->lock, flags);
+
+        /* Run the item with interrupts enabled */
+        work->func(work->data);
+
+        flags = spin_lock_irqsave(&wq->lock);
+        wq->completed++;
+        spin_unlock_irqrestore(&wq->lock, flags);
+        wake_up_all(&wq->flush_wait);
+    }
+}
+
+/* Initialize the system workqueue */
+void workqueue_init(void) {
+    system_wq = workqueue_create("events");
+}
+
+/* Create a workqueue and start its worker thread */
+workqueue_t *workqueue_create(const char *name) {
+    workqueue_t *wq = (workqueue_t *)kmalloc(sizeof(workqueue_t));
+    if (!wq) return NULL;
+
+    memset(wq, 0, sizeof(workqueue_t));
+    wq_strncpy(wq->name, name, 32);
+    spin_init(&wq->lock);
+    wait_queue_init(&wq->flush_wait);
+
+    wq->worker = kthread_run(wq->name, worker_thread, wq);
+    if (!wq->worker) {
+        kfree(wq);
+        return NULL;
+    }
+    return wq;
+}
+
+/* Queue work for the worker thread (safe from interrupt context) */
+bool queue_work(workqueue_t *wq, work_t *work) {
+    if (!wq || !work) return false;
+
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    if (work->pending) {
+        spin_unlock_irqrestore(&wq->lock, flags);
+        return false;  /* Already queued */
+    }
+    wq_append(wq, work);
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    process_wake(wq->worker);
+    return true;
+}
+
+/* Queue work after delay_ticks timer ticks */
+bool queue_delayed_work(workqueue_t *wq, delayed_work_t *dwork, uint64_t delay_ticks) {
+    if (!wq || !dwork) return false;
+    if (delay_ticks == 0) {
+        return queue_work(wq, &dwork->work);
+    }
+
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    if (dwork->timer_pending || dwork->work.pending) {
+        spin_unlock_irqrestore(&wq->lock, flags);
+        return false;
+    }
+    dwork->expires = timer_get_ticks() + delay_ticks;
+    dwork->timer_pending = true;
+    dwork->next = wq->delayed;
+    wq->delayed = dwork;
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    /* Let the worker recompute its sleep deadline */
+    process_wake(wq->worker);
+    return true;
+}
+
+/* Cancel a delayed item that has not been queued yet */
+bool cancel_delayed_work(workqueue_t *wq, delayed_work_t *dwork) {
+    if (!wq || !dwork) return false;
+
+    bool cancelled = false;
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    delayed_work_t **link = &wq->delayed;
+    while (*link) {
+        if (*link == dwork) {
+            *link = dwork->next;
+            dwork->next = NULL;
+            dwork->timer_pending = false;
+            cancelled = true;
+            break;
+        }
+        link = &(*link)->next;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+    return cancelled;
+}
+
+/* Wait until every item queued so far has completed */
+void flush_workqueue(workqueue_t *wq) {
+    if (!wq) return;
+
+    /* The worker cannot wait for itself */
+    if (process_get_current() == wq->worker) return;
+
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    uint64_t target = wq->queued;
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    wait_event(&wq->flush_wait, wq->completed >= target);
+}
+
+/* Queue on the system workqueue */
+bool schedule_work(work_t *work) {
+    return queue_work(system_wq, work);
+}
+
+bool schedule_delayed_work(delayed_work_t *dwork, uint64_t delay_ticks) {
+    return queue_delayed_work(system_wq, dwork, delay_ticks);
+}
@@ -0,0 +1,129 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "usyscall.h"
+
+/* Submission/completion rings shared between a process and the kernel.
+ * The process fills submission entries and advances sq_tail; the kernel
+ * consumes them (on SYS_URING_ENTER or from a polling thread), advances
+ * sq_head and posts one completion per entry at cq_tail. */
+
+/* Ring sizes (powers of two) */
+#define URING_SQ_ENTRIES 64
+#define URING_CQ_ENTRIES 128
+
+/* Operations */
+#define URING_OP_NOP   0
+#define URING_OP_READ  1    /* fd, addr = buffer, len */
+#define URING_OP_WRITE 2    /* fd, addr = buffer, len */
+#define URING_OP_OPEN  3    /* addr = path; res = fd */
+#define URING_OP_CLOSE 4    /* fd */
+
+/* Setup flags: a kernel thread polls the submission ring */
+#define URING_SETUP_SQPOLL 0x1
+
+/* sq_flags: the polling thread went to sleep and needs a wakeup */
+#define URING_SQ_NEED_WAKEUP 0x1
+
+/* Enter flags */
+#define URING_ENTER_GETEVENTS 0x1   /* Wait for min_complete completions */
+#define URING_ENTER_SQ_WAKEUP 0x2   /* Wake the polling thread */
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t reserved;
+    int32_t fd;
+    uint64_t addr;
+    uint32_t len;
+    uint32_t reserved2;
+    uint64_t user_data;     /* Copied to the completion */
+} uring_sqe_t;
+
+typedef struct {
+    uint64_t user_data;
+    int64_t res;            /* Result of the operation, -1 on error */
+} uring_cqe_t;
+
+typedef struct {
+    volatile uint32_t sq_head;      /* Written by the kernel */
+    volatile uint32_t sq_tail;      /* Written by the process */
+    volatile uint32_t cq_head;      /* Written by the process */
+    volatile uint32_t cq_tail;      /* Written by the kernel */
+    volatile uint32_t sq_flags;     /* URING_SQ_* (kernel) */
+    uint32_t reserved;
+    uring_sqe_t sqes[URING_SQ_ENTRIES];
+    uring_cqe_t cqes[URING_CQ_ENTRIES];
+} uring_t;
+
+/* Register a zeroed ring; returns its id or -1 */
+static inline int uring_setup(uring_t *ring, uint32_t flags) {
+    return (int)usyscall2(SYS_URING_SETUP, (uint64_t)ring, flags);
+}
+
+/* Have the kernel consume submissions and optionally wait; returns the
+ * number of entries consumed or -1 */
+static inline int uring_enter(int id, uint32_t min_complete, uint32_t flags) {
+    return (int)usyscall3(SYS_URING_ENTER, (uint64_t)id, min_complete, flags);
+}
+
+/* Unregister a ring (stops its polling thread) */
+static inline int uring_exit(int id) {
+    return (int)usyscall1(SYS_URING_EXIT, (uint64_t)id);
+}
+
+/* Next free submission entry, or NULL if the ring is full */
+static inline uring_sqe_t *uring_get_sqe(uring_t *ring) {
+    uint32_t head = __atomic_load_n(&ring->sq_head, __ATOMIC_ACQUIRE);
+    uint32_t tail = ring->sq_tail;
+    if (tail - head >= URING_SQ_ENTRIES) return NULL;
+
+    uring_sqe_t *sqe = &ring->sqes[tail & (URING_SQ_ENTRIES - 1)];
+    sqe->flags = 0;
+    sqe->reserved = 0;
+    sqe->reserved2 = 0;
+    return sqe;
+}
+
+/* Publish count prepared entries. Without a polling thread this enters
+ * the kernel once for the whole batch; with one it only does so if the
+ * thread is asleep. */
+static inline int uring_submit(int id, uring_t *ring, uint32_t count, bool sqpoll) {
+    __atomic_store_n(&ring->sq_tail, ring->sq_tail + count, __ATOMIC_RELEASE);
+    if (!sqpoll) {
+        return uring_enter(id, 0, 0);
+    }
+
+    /* Pairs with the thread setting NEED_WAKEUP before its last check */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (ring->sq_flags & URING_SQ_NEED_WAKEUP) {
+        uring_enter(id, 0, URING_ENTER_SQ_WAKEUP);
+    }
+    return (int)count;
+}
+
+/* Oldest unread completion, or NULL */
+static inline uring_cqe_t *uring_peek_cqe(uring_t *ring) {
+    uint32_t head = ring->cq_head;
+    if (head == __atomic_load_n(&ring->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &ring->cqes[head & (URING_CQ_ENTRIES - 1)];
+}
+
+/* Wait until a completion is available */
+static inline uring_cqe_t *uring_wait_cqe(int id, uring_t *ring) {
+    uring_cqe_t *cqe;
+    while (!(cqe = uring_peek_cqe(ring))) {
+        if (uring_enter(id, 1, URING_ENTER_GETEVENTS) < 0) return NULL;
+    }
+    return cqe;
+}
+
+/* Release the completion returned by peek/wait */
+static inline void uring_cqe_seen(uring_t *ring) {
+    __atomic_store_n(&ring->cq_head, ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+#endif /* URING_H */
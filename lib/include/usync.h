@@ -0,0 +1,86 @@
+#ifndef USYNC_H
+#define USYNC_H
+
+#include <stdint.h>
+#include "usyscall.h"
+
+/* Futex-based locks for threads and processes sharing memory. The
+ * uncontended paths are a single atomic instruction; the kernel is
+ * entered only to sleep or to wake a sleeper. */
+
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
+static inline int u_futex_wait(volatile uint32_t *addr, uint32_t expected, uint64_t timeout) {
+    return (int)usyscall4(SYS_FUTEX, (uint64_t)addr, FUTEX_WAIT, expected, timeout);
+}
+
+static inline int u_futex_wake(volatile uint32_t *addr, uint32_t count) {
+    return (int)usyscall3(SYS_FUTEX, (uint64_t)addr, FUTEX_WAKE, count);
+}
+
+/* Mutex states */
+#define UMUTEX_UNLOCKED  0
+#define UMUTEX_LOCKED    1   /* Held, nobody sleeping */
+#define UMUTEX_CONTENDED 2   /* Held, sleepers may exist */
+
+typedef struct {
+    volatile uint32_t state;
+} umutex_t;
+
+#define UMUTEX_INIT { UMUTEX_UNLOCKED }
+
+static inline int umutex_trylock(umutex_t *m) {
+    uint32_t expected = UMUTEX_UNLOCKED;
+    return __atomic_compare_exchange_n(&m->state, &expected, UMUTEX_LOCKED, 0,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/* Take the lock as contended: whoever unlocks must then wake a sleeper */
+static inline void umutex_lock_contended(umutex_t *m) {
+    while (__atomic_exchange_n(&m->state, UMUTEX_CONTENDED, __ATOMIC_ACQUIRE) != UMUTEX_UNLOCKED) {
+        u_futex_wait(&m->state, UMUTEX_CONTENDED, 0);
+    }
+}
+
+static inline void umutex_lock(umutex_t *m) {
+    if (!umutex_trylock(m)) {
+        umutex_lock_contended(m);
+    }
+}
+
+static inline void umutex_unlock(umutex_t *m) {
+    if (__atomic_exchange_n(&m->state, UMUTEX_UNLOCKED, __ATOMIC_RELEASE) == UMUTEX_CONTENDED) {
+        u_futex_wake(&m->state, 1);
+    }
+}
+
+/* Condition variable: waiters sleep on a sequence number that every
+ * signal bumps, so a signal between unlock and sleep is not lost */
+typedef struct {
+    volatile uint32_t seq;
+} ucond_t;
+
+#define UCOND_INIT { 0 }
+
+/* Wakeups may be spurious: call in a loop on the predicate */
+static inline void ucond_wait(ucond_t *cv, umutex_t *m) {
+    uint32_t seq = __atomic_load_n(&cv->seq, __ATOMIC_RELAXED);
+    umutex_unlock(m);
+    u_futex_wait(&cv->seq, seq, 0);
+
+    /* Other waiters may be queued behind us on the mutex */
+    umutex_lock_contended(m);
+}
+
+static inline void ucond_signal(ucond_t *cv) {
+    __atomic_add_fetch(&cv->seq, 1, __ATOMIC_RELEASE);
+    u_futex_wake(&cv->seq, 1);
+}
+
+static inline void ucond_broadcast(ucond_t *cv) {
+    __atomic_add_fetch(&cv->seq, 1, __ATOMIC_RELEASE);
+    u_futex_wake(&cv->seq, 0x7FFFFFFF);
+}
+
+#endif /* USYNC_H */
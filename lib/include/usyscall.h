@@ -0,0 +1,176 @@
+#ifndef USYSCALL_H
+#define USYSCALL_H
+
+#include <stdint.h>
+
+/* System call numbers (match kernel/include/syscall.h) */
+#define SYS_EXIT          0
+#define SYS_FORK          1
+#define SYS_READ          2
+#define SYS_WRITE         3
+#define SYS_OPEN          4
+#define SYS_CLOSE         5
+#define SYS_WAIT          6
+#define SYS_EXEC          7
+#define SYS_GETPID        8
+#define SYS_SLEEP         9
+#define SYS_YIELD         10
+#define SYS_THREAD_CREATE 11
+#define SYS_THREAD_JOIN   12
+#define SYS_SET_TLS       13
+#define SYS_URING_SETUP   14
+#define SYS_URING_ENTER   15
+#define SYS_URING_EXIT    16
+#define SYS_PREAD         17
+#define SYS_PWRITE        18
+#define SYS_READV         19
+#define SYS_WRITEV        20
+#define SYS_LSEEK         21
+#define SYS_FUTEX         22
+#define SYS_SHM_OPEN      23
+#define SYS_SHM_MAP       24
+#define SYS_SHM_UNMAP     25
+#define SYS_SHM_UNLINK    26
+#define SYS_PIPE          27
+#define SYS_SPLICE        28
+
+/* lseek origins */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+/* u_shm_open flags */
+#define SHM_CREATE 0x1
+#define SHM_EXCL   0x2
+#define SHM_SHARED 0x4   /* Other processes may open and map it */
+
+/* u_pipe flags */
+#define O_NONBLOCK 0x1
+
+/* Returned by a non-blocking pipe end that would have to wait */
+#define U_EAGAIN -2
+
+/* One readv/writev segment */
+typedef struct {
+    void *base;
+    uint64_t len;
+} u_iovec_t;
+
+/* Enter the kernel with SYSCALL: number in rax, arguments in rdi, rsi,
+ * rdx, r10; the CPU uses rcx and r11 for the return address and flags */
+static inline uint64_t usyscall4(uint64_t num, uint64_t arg1, uint64_t arg2, uint64_t arg3,
+                                 uint64_t arg4) {
+    uint64_t ret;
+    register uint64_t r10 __asm__("r10") = arg4;
+    __asm__ volatile ("syscall"
+                      : "=a"(ret)
+                      : "a"(num), "D"(arg1), "S"(arg2), "d"(arg3), "r"(r10)
+                      : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline uint64_t usyscall3(uint64_t num, uint64_t arg1, uint64_t arg2, uint64_t arg3) {
+    return usyscall4(num, arg1, arg2, arg3, 0);
+}
+
+static inline uint64_t usyscall0(uint64_t num) {
+    return usyscall3(num, 0, 0, 0);
+}
+
+static inline uint64_t usyscall1(uint64_t num, uint64_t arg1) {
+    return usyscall3(num, arg1, 0, 0);
+}
+
+static inline uint64_t usyscall2(uint64_t num, uint64_t arg1, uint64_t arg2) {
+    return usyscall3(num, arg1, arg2, 0);
+}
+
+/* Convenience wrappers */
+static inline void u_exit(int status) {
+    usyscall1(SYS_EXIT, (uint64_t)status);
+}
+
+static inline int64_t u_read(int fd, void *buf, uint32_t size) {
+    return (int64_t)usyscall3(SYS_READ, (uint64_t)fd, (uint64_t)buf, size);
+}
+
+static inline int64_t u_write(int fd, const void *buf, uint32_t size) {
+    return (int64_t)usyscall3(SYS_WRITE, (uint64_t)fd, (uint64_t)buf, size);
+}
+
+static inline int64_t u_pread(int fd, void *buf, uint32_t size, uint64_t offset) {
+    return (int64_t)usyscall4(SYS_PREAD, (uint64_t)fd, (uint64_t)buf, size, offset);
+}
+
+static inline int64_t u_pwrite(int fd, const void *buf, uint32_t size, uint64_t offset) {
+    return (int64_t)usyscall4(SYS_PWRITE, (uint64_t)fd, (uint64_t)buf, size, offset);
+}
+
+static inline int64_t u_readv(int fd, const u_iovec_t *iov, int count) {
+    return (int64_t)usyscall3(SYS_READV, (uint64_t)fd, (uint64_t)iov, (uint64_t)count);
+}
+
+static inline int64_t u_writev(int fd, const u_iovec_t *iov, int count) {
+    return (int64_t)usyscall3(SYS_WRITEV, (uint64_t)fd, (uint64_t)iov, (uint64_t)count);
+}
+
+static inline int64_t u_lseek(int fd, int64_t offset, int whence) {
+    return (int64_t)usyscall3(SYS_LSEEK, (uint64_t)fd, (uint64_t)offset, (uint64_t)whence);
+}
+
+/* Shared memory: open or create by name, then map to get the address */
+static inline int u_shm_open(const char *name, uint32_t size, uint32_t flags) {
+    return (int)usyscall3(SYS_SHM_OPEN, (uint64_t)name, size, flags);
+}
+
+static inline void *u_shm_map(int id) {
+    return (void *)usyscall1(SYS_SHM_MAP, (uint64_t)id);
+}
+
+static inline int u_shm_unmap(void *addr) {
+    return (int)usyscall1(SYS_SHM_UNMAP, (uint64_t)addr);
+}
+
+static inline int u_shm_unlink(const char *name) {
+    return (int)usyscall1(SYS_SHM_UNLINK, (uint64_t)name);
+}
+
+/* Pipe: fds[0] reads what fds[1] writes; returns 0 or -1 */
+static inline int u_pipe(int fds[2], uint32_t flags) {
+    return (int)usyscall2(SYS_PIPE, (uint64_t)fds, flags);
+}
+
+/* Move up to len bytes between a pipe and a file inside the kernel */
+static inline int u_splice(int fd_in, int fd_out, uint32_t len) {
+    return (int)usyscall3(SYS_SPLICE, (uint64_t)fd_in, (uint64_t)fd_out, len);
+}
+
+/* Replace the process image; returns only on failure */
+static inline int u_exec(const char *path) {
+    return (int)usyscall1(SYS_EXEC, (uint64_t)path);
+}
+
+/* Threads: entry(arg) runs on a stack of its own with FS base tls and
+ * must end with u_exit (returning faults); returns the tid or -1 */
+static inline int u_thread_create(void (*entry)(void *arg), void *arg, void *tls) {
+    return (int)usyscall3(SYS_THREAD_CREATE, (uint64_t)entry, (uint64_t)arg, (uint64_t)tls);
+}
+
+/* Wait for a thread to exit; its status is stored at status if non-NULL */
+static inline int u_thread_join(int tid, int *status) {
+    return (int)usyscall2(SYS_THREAD_JOIN, (uint64_t)tid, (uint64_t)status);
+}
+
+static inline void u_set_tls(void *tls) {
+    usyscall1(SYS_SET_TLS, (uint64_t)tls);
+}
+
+static inline uint32_t u_getpid(void) {
+    return (uint32_t)usyscall0(SYS_GETPID);
+}
+
+static inline void u_yield(void) {
+    usyscall0(SYS_YIELD);
+}
+
+#endif /* USYSCALL_H */
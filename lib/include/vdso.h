@@ -0,0 +1,80 @@
+#ifndef VDSO_H
+#define VDSO_H
+
+#include <stdint.h>
+
+/* Read-only time page the kernel maps into every process, so clock reads
+ * need no system call. Written by the kernel on each timer tick. */
+
+/* User virtual address of the page (top page of the lower half) */
+#define VDSO_USER_ADDR 0x00007FFFFFFFF000ULL
+
+/* Fixed point shift of the TSC-to-nanosecond multiplier */
+#define VDSO_MULT_SHIFT 24
+
+typedef struct {
+    volatile uint32_t seq;      /* Odd while the kernel is updating */
+    uint32_t tick_ns;           /* Length of a timer tick */
+    uint64_t ticks;             /* Timer ticks since boot */
+    uint64_t base_tsc;          /* TSC at the last update */
+    uint64_t base_ns;           /* Nanoseconds since boot at base_tsc */
+    uint64_t mult;              /* ns = (cycles * mult) >> VDSO_MULT_SHIFT */
+} vdso_data_t;
+
+static inline uint64_t vdso_rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Seqlock read side: retry while an update is in progress or happened
+ * during the read */
+static inline uint32_t vdso_read_begin(const vdso_data_t *vd) {
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&vd->seq, __ATOMIC_ACQUIRE)) & 1) {
+        __asm__ volatile ("pause");
+    }
+    return seq;
+}
+
+static inline int vdso_read_retry(const vdso_data_t *vd, uint32_t seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&vd->seq, __ATOMIC_RELAXED) != seq;
+}
+
+/* Nanoseconds since boot from a time page */
+static inline uint64_t vdso_clock_ns_from(const vdso_data_t *vd) {
+    uint32_t seq;
+    uint64_t ns;
+    do {
+        seq = vdso_read_begin(vd);
+        uint64_t tsc = vdso_rdtsc();
+        ns = vd->base_ns;
+        if (tsc > vd->base_tsc) {
+            ns += ((tsc - vd->base_tsc) * vd->mult) >> VDSO_MULT_SHIFT;
+        }
+    } while (vdso_read_retry(vd, seq));
+    return ns;
+}
+
+/* Timer ticks since boot from a time page */
+static inline uint64_t vdso_ticks_from(const vdso_data_t *vd) {
+    uint32_t seq;
+    uint64_t ticks;
+    do {
+        seq = vdso_read_begin(vd);
+        ticks = vd->ticks;
+    } while (vdso_read_retry(vd, seq));
+    return ticks;
+}
+
+/* User-mode clock reads through the mapped page */
+static inline uint64_t vdso_clock_ns(void) {
+    return vdso_clock_ns_from((const vdso_data_t *)VDSO_USER_ADDR);
+}
+
+static inline uint64_t vdso_ticks(void) {
+    return vdso_ticks_from((const vdso_data_t *)VDSO_USER_ADDR);
+}
+
+#endif /* VDSO_H */